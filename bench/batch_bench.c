@@ -0,0 +1,175 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// 批量 API 基准测试：连接本机运行中的服务器，比较按键逐个请求、流水线逐个请求
+// 和一次 /batch/get 读取同一组键时每个键的耗时
+// 用法: batch_bench [端口] [每批键数] [轮数]，默认 8080、100 个键、1000 轮
+
+#define VALUE_SIZE 32
+#define RESPONSE_BUFFER (4 * 1024 * 1024)
+
+static char *response_buffer;
+static size_t response_len;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *phase, size_t keys, double seconds) {
+    printf("  %-16s %10.1f ns/键  %8.2f M 键/s\n", phase, seconds * 1e9 / keys, keys / seconds / 1e6);
+}
+
+static int connect_server(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, 0);
+        if (n <= 0) return -1;
+        data += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// 读取 count 个响应，返回最后一个响应的状态码；响应体留在 response_buffer 开头之后，失败时返回 -1
+static int read_responses(int fd, size_t count) {
+    int status = -1;
+    size_t consumed = 0;
+    for (size_t i = 0; i < count; i++) {
+        char *header_end;
+        while (!(header_end = memmem(response_buffer + consumed, response_len - consumed, "\r\n\r\n", 4))) {
+            if (response_len == RESPONSE_BUFFER) return -1;
+            ssize_t n = recv(fd, response_buffer + response_len, RESPONSE_BUFFER - response_len, 0);
+            if (n <= 0) return -1;
+            response_len += (size_t)n;
+        }
+        char *response = response_buffer + consumed;
+        status = atoi(response + 9);
+        const char *length_header = memmem(response, (size_t)(header_end - response), "Content-Length:", 15);
+        size_t body_length = length_header ? strtoul(length_header + 15, NULL, 10) : 0;
+        size_t end = (size_t)(header_end + 4 - response_buffer) + body_length;
+        while (response_len < end) {
+            ssize_t n = recv(fd, response_buffer + response_len, RESPONSE_BUFFER - response_len, 0);
+            if (n <= 0) return -1;
+            response_len += (size_t)n;
+        }
+        consumed = end;
+    }
+    // 剩余的数据移到开头（正常情况下没有）
+    memmove(response_buffer, response_buffer + consumed, response_len - consumed);
+    response_len -= consumed;
+    return status;
+}
+
+static size_t append_netstring(char *out, const char *data, size_t length) {
+    int prefix = sprintf(out, "%zu:", length);
+    memcpy(out + prefix, data, length);
+    out[prefix + length] = ',';
+    return (size_t)prefix + length + 1;
+}
+
+static size_t make_key(char *buf, size_t i) {
+    return (size_t)sprintf(buf, "bench:%zu", i);
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : 8080;
+    size_t keys = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+    size_t rounds = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000;
+    if (keys == 0 || rounds == 0) return 1;
+
+    response_buffer = malloc(RESPONSE_BUFFER);
+    size_t body_cap = keys * (2 * 24 + VALUE_SIZE + 32) + 256;
+    char *body = malloc(body_cap);
+    char *requests = malloc(keys * 64);
+    if (!response_buffer || !body || !requests) return 1;
+    int fd = connect_server(port);
+    if (fd == -1) {
+        fprintf(stderr, "无法连接 127.0.0.1:%d\n", port);
+        return 1;
+    }
+
+    // 写入测试数据
+    char key[32];
+    char value[VALUE_SIZE];
+    memset(value, 'v', sizeof(value));
+    size_t body_len = 0;
+    for (size_t i = 0; i < keys; i++) {
+        body_len += append_netstring(body + body_len, key, make_key(key, i));
+        body_len += append_netstring(body + body_len, value, sizeof(value));
+    }
+    char header[128];
+    int header_len = snprintf(header, sizeof(header), "POST /batch/set HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", body_len);
+    if (send_all(fd, header, (size_t)header_len) || send_all(fd, body, body_len) || read_responses(fd, 1) != 200) {
+        fprintf(stderr, "写入测试数据失败（服务器是否支持 /batch/set？）\n");
+        return 1;
+    }
+    printf("%zu 个键 x %zu 轮，值 %d 字节:\n", keys, rounds, VALUE_SIZE);
+
+    // 逐个请求：每个键一次往返
+    size_t requests_len = 0;
+    for (size_t i = 0; i < keys; i++) {
+        make_key(key, i);
+        requests_len += (size_t)sprintf(requests + requests_len, "GET /api/%s HTTP/1.1\r\n\r\n", key);
+    }
+    double start = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        const char *request = requests;
+        for (size_t i = 0; i < keys; i++) {
+            const char *next = strstr(request, "\r\n\r\n") + 4;
+            if (send_all(fd, request, (size_t)(next - request)) || read_responses(fd, 1) != 200) return 1;
+            request = next;
+        }
+    }
+    report("逐个请求", keys * rounds, now_seconds() - start);
+
+    // 流水线：一次发出全部单键请求，再依次读取响应
+    start = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        if (send_all(fd, requests, requests_len) || read_responses(fd, keys) != 200) return 1;
+    }
+    report("流水线逐个请求", keys * rounds, now_seconds() - start);
+
+    // 批量：一个请求读取全部键
+    body_len = 0;
+    for (size_t i = 0; i < keys; i++) {
+        body_len += append_netstring(body + body_len, key, make_key(key, i));
+    }
+    header_len = snprintf(header, sizeof(header), "POST /batch/get HTTP/1.1\r\nContent-Length: %zu\r\n\r\n", body_len);
+    start = now_seconds();
+    for (size_t r = 0; r < rounds; r++) {
+        if (send_all(fd, header, (size_t)header_len) || send_all(fd, body, body_len) ||
+            read_responses(fd, 1) != 200) return 1;
+    }
+    report("批量请求", keys * rounds, now_seconds() - start);
+
+    close(fd);
+    free(requests);
+    free(body);
+    free(response_buffer);
+    return 0;
+}
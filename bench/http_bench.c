@@ -0,0 +1,458 @@
+#include "http_parser.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+// HTTP 请求解析基准测试：对比逐请求复制 + strtok + 多次分配的旧解析器（保留在本文件中作为基线）
+// 与返回缓冲区片段、不分配内存的 http_parse_request，包括请求分两次到达时的增量解析；
+// 另外对比旧的响应构建（strdup + 两次 snprintf + malloc）与按模板写入复用缓冲区的 http_write_header
+// 用法: http_bench [每种请求的迭代次数]，默认 2M 次
+
+// ---- 旧实现（分帧 + 解析 + 释放），只用于对比 ----
+
+typedef struct {
+    HttpMethod method;
+    char *path;
+    size_t path_length;
+    char *body;
+    size_t body_length;
+    char *headers;
+    bool keep_alive;
+} LegacyRequest;
+
+#define LEGACY_FRAME_ERROR -1
+#define LEGACY_FRAME_INCOMPLETE 0
+#define LEGACY_FRAME_COMPLETE 1
+
+// 在请求头块中查找指定头部（名称不区分大小写），返回去掉首尾空白的值
+static const char* find_header_value(const char *headers, size_t length, const char *name, size_t *value_len) {
+    size_t name_len = strlen(name);
+    const char *end = headers + length;
+    const char *line = headers;
+    while (line < end) {
+        const char *line_end = memchr(line, '\n', end - line);
+        if (!line_end) line_end = end;
+        if ((size_t)(line_end - line) > name_len && line[name_len] == ':' &&
+            strncasecmp(line, name, name_len) == 0) {
+            const char *value = line + name_len + 1;
+            const char *value_end = line_end;
+            while (value < value_end && (*value == ' ' || *value == '\t')) value++;
+            while (value_end > value && isspace((unsigned char)value_end[-1])) value_end--;
+            *value_len = value_end - value;
+            return value;
+        }
+        line = line_end + 1;
+    }
+    return NULL;
+}
+
+// 在长度为 length 的缓冲区中查找字节序列（缓冲区不要求以 '\0' 结尾，也可以包含 '\0'）
+static const char* find_sequence(const char *data, size_t length, const char *sequence, size_t sequence_len) {
+    if (sequence_len == 0 || length < sequence_len) return NULL;
+    const char *end = data + length - sequence_len + 1;
+    for (const char *p = data; p < end; p++) {
+        p = memchr(p, sequence[0], end - p);
+        if (!p) return NULL;
+        if (memcmp(p, sequence, sequence_len) == 0) return p;
+    }
+    return NULL;
+}
+// 判断缓冲区开头是否已有一个完整请求（请求头 + Content-Length 指定的请求体）
+// 请求头完整时 *request_length 为整个请求的长度，即使请求体尚未全部到达；
+// header_length 不为 NULL 时同时返回请求头（含结尾空行）的长度
+static int legacy_frame_request(const char *data, size_t length, size_t *request_length, size_t *header_length) {
+    if (!data || !request_length) return LEGACY_FRAME_ERROR;
+    const char *header_end = NULL;
+    size_t separator_len = 0;
+    // 请求头以空行结束："\r\n\r\n" 或 "\n\n"
+    for (size_t i = 0; i + 1 < length; i++) {
+        if (data[i] != '\n') continue;
+        if (data[i + 1] == '\n') {
+            header_end = data + i + 1;
+            separator_len = 1;
+            break;
+        }
+        if (data[i + 1] == '\r' && i + 2 < length && data[i + 2] == '\n') {
+            header_end = data + i + 1;
+            separator_len = 2;
+            break;
+        }
+    }
+    if (!header_end) return LEGACY_FRAME_INCOMPLETE;
+
+    size_t headers_len = header_end - data;
+    size_t body_len = 0;
+    size_t value_len = 0;
+    if (find_header_value(data, headers_len, "Transfer-Encoding", &value_len)) {
+        // 不支持分块传输编码，无法确定请求边界
+        return LEGACY_FRAME_ERROR;
+    }
+    const char *value = find_header_value(data, headers_len, "Content-Length", &value_len);
+    if (value) {
+        if (value_len == 0 || value_len > 15) return LEGACY_FRAME_ERROR;
+        for (size_t i = 0; i < value_len; i++) {
+            if (!isdigit((unsigned char)value[i])) return LEGACY_FRAME_ERROR;
+            body_len = body_len * 10 + (size_t)(value[i] - '0');
+        }
+    }
+    *request_length = headers_len + separator_len + body_len;
+    if (header_length) {
+        *header_length = headers_len + separator_len;
+    }
+    return *request_length <= length ? LEGACY_FRAME_COMPLETE : LEGACY_FRAME_INCOMPLETE;
+}
+
+// 根据 Connection 头部（逗号分隔的选项列表）调整连接保持策略
+static void apply_connection_header(LegacyRequest *request, size_t headers_len) {
+    size_t value_len = 0;
+    const char *value = find_header_value(request->headers, headers_len, "Connection", &value_len);
+    const char *end = value ? value + value_len : NULL;
+    while (value && value < end) {
+        while (value < end && (*value == ' ' || *value == ',')) value++;
+        const char *token_end = value;
+        while (token_end < end && *token_end != ',') token_end++;
+        size_t token_len = token_end - value;
+        while (token_len > 0 && value[token_len - 1] == ' ') token_len--;
+        if (token_len == 5 && strncasecmp(value, "close", 5) == 0) {
+            request->keep_alive = false;
+        } else if (token_len == 10 && strncasecmp(value, "keep-alive", 10) == 0) {
+            request->keep_alive = true;
+        }
+        value = token_end;
+    }
+}
+
+// 解析 HTTP 请求
+static LegacyRequest* legacy_parse_request(const char *raw_request, size_t length) {
+    if (!raw_request || length == 0) {
+        return NULL;
+    }
+
+    LegacyRequest *request = calloc(1, sizeof(LegacyRequest));
+    if (!request) {
+        return NULL;
+    }
+
+    // 复制原始请求以便解析
+    char *request_copy = malloc(length + 1);
+    if (!request_copy) {
+        free(request);
+        return NULL;
+    }
+    memcpy(request_copy, raw_request, length);
+    request_copy[length] = '\0';
+
+    // 查找请求行结束位置
+    char *line_end = strstr(request_copy, "\r\n");
+    bool has_crlf = true;
+    if (!line_end) {
+        line_end = strstr(request_copy, "\n");
+        has_crlf = false;
+        if (!line_end) {
+            free(request_copy);
+            free(request);
+            return NULL;
+        }
+    }
+
+    // 计算请求行长度
+    size_t line_len = line_end - request_copy;
+
+    // 解析请求行：METHOD PATH HTTP/1.1
+    *line_end = '\0';
+    char *method_str = strtok(request_copy, " ");
+    char *path_str = strtok(NULL, " ");
+    char *version_str = strtok(NULL, " ");
+
+    if (!method_str || !path_str || !version_str) {
+        free(request_copy);
+        free(request);
+        return NULL;
+    }
+
+    // 设置方法
+    request->method = http_string_to_method(method_str);
+
+    // HTTP/1.1 默认保持连接，HTTP/1.0 默认关闭，可被 Connection 头部覆盖
+    request->keep_alive = strcmp(version_str, "HTTP/1.1") == 0;
+
+    // 设置路径
+    request->path_length = strlen(path_str);
+    request->path = strdup(path_str);
+    if (!request->path) {
+        free(request_copy);
+        free(request);
+        return NULL;
+    }
+
+    // 查找请求头和请求体的分界线（基于原始请求）
+    const char *body_separator = find_sequence(raw_request, length, "\r\n\r\n", 4);
+    int separator_len = 4;
+    if (!body_separator) {
+        body_separator = find_sequence(raw_request, length, "\n\n", 2);
+        separator_len = 2;
+    }
+
+    // 计算请求头开始位置（基于原始请求）
+    size_t headers_start_offset = line_len + (has_crlf ? 2 : 1);
+
+    // 安全检查：确保偏移量不超过请求长度
+    if (headers_start_offset >= length) {
+        free(request_copy);
+        return request; // 只有请求行，没有头部
+    }
+
+    const char *headers_start_in_raw = raw_request + headers_start_offset;
+
+    if (body_separator) {
+        // 有请求体
+        // 安全检查：确保 body_separator 在有效范围内
+        if (body_separator < headers_start_in_raw || body_separator >= raw_request + length) {
+            free(request_copy);
+            return request;
+        }
+
+        size_t headers_len = body_separator - headers_start_in_raw;
+        if (headers_len > 0 && headers_len < 8192) { // 限制头部大小
+            request->headers = malloc(headers_len + 1);
+            if (request->headers) {
+                memcpy(request->headers, headers_start_in_raw, headers_len);
+                request->headers[headers_len] = '\0';
+            }
+            apply_connection_header(request, headers_len);
+        }
+
+        // 解析请求体
+        const char *body_start = body_separator + separator_len;
+
+        // 安全检查：确保 body_start 在有效范围内
+        if (body_start >= raw_request + length) {
+            free(request_copy);
+            return request;
+        }
+
+        size_t body_len = length - (body_start - raw_request);
+
+        if (body_len > 0 && body_len < 1024 * 1024) { // 限制请求体大小为1MB
+            request->body = malloc(body_len + 1);
+            if (request->body) {
+                memcpy(request->body, body_start, body_len);
+                request->body[body_len] = '\0';
+                request->body_length = body_len;
+            }
+        }
+    } else {
+        // 没有请求体，只有请求头
+        size_t headers_len = length - headers_start_offset;
+        if (headers_len > 0 && headers_len < 8192) { // 限制头部大小
+            request->headers = malloc(headers_len + 1);
+            if (request->headers) {
+                memcpy(request->headers, headers_start_in_raw, headers_len);
+                request->headers[headers_len] = '\0';
+            }
+            apply_connection_header(request, headers_len);
+        }
+    }
+
+    free(request_copy);
+    return request;
+}
+
+// 释放 HTTP 请求
+static void legacy_free_request(LegacyRequest *request) {
+    if (request) {
+        free(request->path);
+        free(request->body);
+        free(request->headers);
+        free(request);
+    }
+}
+
+// 旧的响应构建：复制状态文本、内容类型和响应体，snprintf 一次求长度、一次填充
+static char* legacy_build_response(int status_code, const char *body, size_t body_length,
+                                   bool keep_alive, size_t *response_length) {
+    char *status_text = strdup(http_status_text(status_code));
+    char *content_type = strdup("text/plain");
+    char *body_copy = malloc(body_length + 1);
+    char *response = NULL;
+    if (status_text && content_type && body_copy) {
+        memcpy(body_copy, body, body_length);
+        const char *format = "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                             "Access-Control-Allow-Origin: *\r\n"
+                             "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
+                             "Access-Control-Allow-Headers: Content-Type\r\n"
+                             "Connection: %s\r\n\r\n";
+        const char *connection = keep_alive ? "keep-alive" : "close";
+        int header_size = snprintf(NULL, 0, format, status_code, status_text, content_type, body_length, connection);
+        response = malloc((size_t)header_size + body_length + 1);
+        if (response) {
+            snprintf(response, (size_t)header_size + 1, format, status_code, status_text, content_type,
+                     body_length, connection);
+            memcpy(response + header_size, body_copy, body_length);
+            *response_length = (size_t)header_size + body_length;
+        }
+    }
+    free(status_text);
+    free(content_type);
+    free(body_copy);
+    return response;
+}
+
+// ---- 基准测试 ----
+
+typedef struct {
+    const char *name;
+    const char *text;
+} BenchRequest;
+
+static const BenchRequest requests[] = {
+    { "GET（curl）",
+      "GET /api/user:1001 HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "User-Agent: curl/8.5.0\r\n"
+      "Accept: */*\r\n"
+      "\r\n" },
+    { "POST 128B",
+      "POST /api/session:42 HTTP/1.1\r\n"
+      "Host: localhost:8080\r\n"
+      "Content-Type: application/octet-stream\r\n"
+      "Content-Length: 128\r\n"
+      "\r\n"
+      "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+      "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef" },
+    { "GET（浏览器）",
+      "GET /api/profile%3A12345 HTTP/1.1\r\n"
+      "Host: kv.example.com\r\n"
+      "Connection: keep-alive\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+      "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+      "Accept-Encoding: gzip, deflate, br\r\n"
+      "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+      "Cache-Control: max-age=0\r\n"
+      "Cookie: session=4f9a1c2e7b3d8f6a0e5c9b2d1a7f3e8c; theme=dark; lang=zh-CN\r\n"
+      "Sec-Fetch-Dest: document\r\n"
+      "Sec-Fetch-Mode: navigate\r\n"
+      "Upgrade-Insecure-Requests: 1\r\n"
+      "\r\n" },
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *phase, size_t count, size_t bytes, double seconds) {
+    printf("  %-22s %8.1f ns/请求  %8.2f M 请求/s  %8.1f MB/s\n",
+           phase, seconds * 1e9 / count, count / seconds / 1e6, bytes * (double)count / seconds / 1e6);
+}
+
+// 旧流程：每次读取后先分帧，完整后再解析（复制请求、strtok、分配路径/请求头/请求体）
+static size_t legacy_round(const char *data, size_t length, size_t split) {
+    size_t request_len = 0;
+    size_t header_len = 0;
+    size_t sink = 0;
+    if (split > 0) {
+        legacy_frame_request(data, split, &request_len, &header_len);
+    }
+    if (legacy_frame_request(data, length, &request_len, &header_len) != LEGACY_FRAME_COMPLETE) return 0;
+    LegacyRequest *request = legacy_parse_request(data, request_len);
+    if (!request) return 0;
+    sink = request->path_length + request->body_length + request->keep_alive;
+    legacy_free_request(request);
+    return sink;
+}
+
+// 新流程：一次解析得到全部字段；分两次到达时第二次从上次扫描的位置继续
+static size_t span_round(const char *data, size_t length, size_t split) {
+    HttpRequest request;
+    size_t scanned = 0;
+    if (split > 0) {
+        http_parse_request(data, split, &scanned, &request);
+    }
+    if (http_parse_request(data, length, &scanned, &request) != HTTP_PARSE_COMPLETE) return 0;
+    return request.path.length + request.body.length + request.keep_alive + request.host.length;
+}
+
+static int run(const BenchRequest *bench, size_t iterations) {
+    size_t length = strlen(bench->text);
+    // 复制到堆上，与连接读缓冲区的情况一致
+    char *data = malloc(length + 1);
+    if (!data) return 1;
+    memcpy(data, bench->text, length + 1);
+    printf("%s（%zu 字节）:\n", bench->name, length);
+
+    size_t splits[] = { 0, length / 2 };
+    const char *labels[][2] = { { "旧解析器", "新解析器" }, { "旧解析器（分两次到达）", "新解析器（分两次到达）" } };
+    size_t legacy_sink = 0, span_sink = 0;
+    for (int s = 0; s < 2; s++) {
+        double start = now_seconds();
+        for (size_t i = 0; i < iterations; i++) {
+            legacy_sink += legacy_round(data, length, splits[s]);
+        }
+        report(labels[s][0], iterations, length, now_seconds() - start);
+
+        start = now_seconds();
+        for (size_t i = 0; i < iterations; i++) {
+            span_sink += span_round(data, length, splits[s]);
+        }
+        report(labels[s][1], iterations, length, now_seconds() - start);
+    }
+    free(data);
+    if (legacy_sink == 0 || span_sink == 0) {
+        fprintf(stderr, "  解析失败\n");
+        return 1;
+    }
+    return 0;
+}
+
+// 响应构建：旧流程每个响应分配并释放一次，新流程写入同一个复用的输出缓冲区
+static int run_response(size_t iterations) {
+    static const char body[] = "Key not found";
+    size_t body_length = sizeof(body) - 1;
+    printf("响应（404 + CORS，响应体 %zu 字节）:\n", body_length);
+
+    size_t legacy_sink = 0, response_length = 0;
+    double start = now_seconds();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t length = 0;
+        char *response = legacy_build_response(404, body, body_length, true, &length);
+        legacy_sink += length + (size_t)(response ? response[length - 1] : 0);
+        response_length = length;
+        free(response);
+    }
+    report("旧响应构建", iterations, response_length, now_seconds() - start);
+
+    char output[HTTP_HEADER_MAX + sizeof(body)];
+    size_t template_sink = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t length = http_write_header(output, HTTP_HEADER_MAX, 404, HTTP_CONTENT_TEXT, NULL,
+                                          body_length, true, true);
+        memcpy(output + length, body, body_length);
+        template_sink += length + body_length + (size_t)output[length];
+        response_length = length + body_length;
+    }
+    report("模板响应构建", iterations, response_length, now_seconds() - start);
+
+    if (legacy_sink == 0 || template_sink == 0) {
+        fprintf(stderr, "  响应构建失败\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    if (iterations == 0) iterations = 1;
+    int status = 0;
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        status |= run(&requests[i], iterations);
+    }
+    http_response_init();
+    status |= run_response(iterations);
+    return status;
+}
@@ -0,0 +1,217 @@
+#include "kv_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// KV 存储引擎基准测试：插入、命中查找（逐个和批量）、未命中查找的吞吐量，
+// 以及随机改写/删除大小不一的值之后 slab 的内存占用和碎片率
+// 用法: kv_bench_<engine> [键数量...]，默认测试 1M 和 10M 个键（碎片测试使用其中 1/10 的键）
+
+#define KEY_SIZE 32
+#define BATCH_SIZE 100  // 批量查找每组的键数（与一次页面渲染读取的键数相当）
+#define CHURN_MIN_VALUE 16
+#define CHURN_MAX_VALUE 1024
+#define CHURN_ROUNDS 10 // 每个键平均被改写或删除的次数
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 简单的 xorshift 随机数，用于打乱查找顺序
+static unsigned long long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static size_t make_key(char *buf, const char *prefix, size_t i) {
+    return (size_t)snprintf(buf, KEY_SIZE, "%s:%zu", prefix, i);
+}
+
+static void report(const char *phase, size_t count, double seconds) {
+    printf("  %-12s %10zu 次  %8.3f 秒  %8.2f M ops/s  %7.1f ns/op\n",
+           phase, count, seconds, count / seconds / 1e6, seconds * 1e9 / count);
+}
+
+// 进程常驻内存，只在 Linux 上可用，其他平台返回 0
+static size_t resident_bytes(void) {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    unsigned long size = 0, resident = 0;
+    int fields = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    return fields == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+static void report_memory(const char *phase, KVStore *store) {
+    SlabStats stats;
+    kv_store_memory(store, &stats);
+    double fragmentation = stats.reserved_bytes ? 1.0 - (double)stats.used_bytes / stats.reserved_bytes : 0;
+    printf("  %-12s 键 %8zu  请求 %8.1f MB  占用 %8.1f MB  保留 %8.1f MB  碎片 %5.1f%%  RSS %8.1f MB\n",
+           phase, kv_size(store), stats.requested_bytes / 1048576.0, stats.used_bytes / 1048576.0,
+           stats.reserved_bytes / 1048576.0, fragmentation * 100, resident_bytes() / 1048576.0);
+}
+
+static bool set_random_value(KVStore *store, const char *key, size_t key_length, const char *fill,
+                             unsigned long long *seed) {
+    size_t length = CHURN_MIN_VALUE + next_random(seed) % (CHURN_MAX_VALUE - CHURN_MIN_VALUE + 1);
+    KVValue *value = kv_value_create(kv_store_allocator(store), fill, length);
+    if (!value) return false;
+    bool ok = kv_set_value(store, key, key_length, value);
+    kv_value_release(value);
+    return ok;
+}
+
+// 碎片测试：写入大小随机的值，再随机改写和删除，最后删除大部分键
+static int run_churn(size_t count) {
+    if (count == 0) return 0;
+    printf("引擎 %s，碎片测试 %zu 个键\n", kv_store_engine(), count);
+    KVStore *store = kv_store_create(0, NULL);
+    if (!store) return 1;
+    char fill[CHURN_MAX_VALUE];
+    memset(fill, 'v', sizeof(fill));
+    char key[KEY_SIZE];
+    unsigned long long seed = 2463534242ULL;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t key_length = make_key(key, "churn", i);
+        if (!set_random_value(store, key, key_length, fill, &seed)) {
+            kv_store_destroy(store);
+            return 1;
+        }
+    }
+    report_memory("写入后", store);
+
+    // 3/4 改写为其他大小，1/4 删除（被删除的键之后可能被重新写入）
+    double start = now_seconds();
+    size_t ops = count * CHURN_ROUNDS;
+    for (size_t i = 0; i < ops; i++) {
+        size_t key_length = make_key(key, "churn", next_random(&seed) % count);
+        if (next_random(&seed) % 4 == 0) {
+            kv_delete(store, key, key_length);
+        } else if (!set_random_value(store, key, key_length, fill, &seed)) {
+            kv_store_destroy(store);
+            return 1;
+        }
+    }
+    report("改写/删除", ops, now_seconds() - start);
+    report_memory("改写后", store);
+
+    for (size_t i = 0; i < count; i++) {
+        if (i % 10 != 0) {
+            size_t key_length = make_key(key, "churn", i);
+            kv_delete(store, key, key_length);
+        }
+    }
+    report_memory("删除 90% 后", store);
+
+    kv_store_destroy(store);
+    return 0;
+}
+
+static int run(size_t count) {
+    printf("引擎 %s，%zu 个键\n", kv_store_engine(), count);
+    KVStore *store = kv_store_create(0, NULL);
+    if (!store) return 1;
+
+    char key[KEY_SIZE];
+    double start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        size_t key_length = make_key(key, "user", i);
+        if (!kv_set(store, key, key_length, "value", 5)) {
+            fprintf(stderr, "插入失败: %s\n", key);
+            kv_store_destroy(store);
+            return 1;
+        }
+    }
+    report("插入", count, now_seconds() - start);
+
+    unsigned long long seed = 88172645463325252ULL;
+    size_t found = 0;
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        size_t key_length = make_key(key, "user", next_random(&seed) % count);
+        char *value = kv_get(store, key, key_length, NULL);
+        if (value) {
+            found++;
+            free(value);
+        }
+    }
+    report("命中查找", count, now_seconds() - start);
+    if (found != count) {
+        fprintf(stderr, "查找结果错误: %zu/%zu\n", found, count);
+    }
+
+    // 批量查找：同样的随机键每 BATCH_SIZE 个一组交给 kv_get_values（键先生成好，两种方式都计入生成时间）
+    seed = 88172645463325252ULL;
+    found = 0;
+    char batch_keys[BATCH_SIZE][KEY_SIZE];
+    KVKey batch[BATCH_SIZE];
+    KVValue *values[BATCH_SIZE];
+    start = now_seconds();
+    for (size_t i = 0; i < count; i += BATCH_SIZE) {
+        size_t n = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+        for (size_t j = 0; j < n; j++) {
+            batch[j].data = batch_keys[j];
+            batch[j].length = make_key(batch_keys[j], "user", next_random(&seed) % count);
+        }
+        kv_get_values(store, batch, n, values);
+        for (size_t j = 0; j < n; j++) {
+            if (values[j]) {
+                found++;
+                kv_value_release(values[j]);
+            }
+        }
+    }
+    report("批量命中查找", count, now_seconds() - start);
+    if (found != count) {
+        fprintf(stderr, "批量查找结果错误: %zu/%zu\n", found, count);
+    }
+
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        size_t key_length = make_key(key, "miss", i);
+        char *value = kv_get(store, key, key_length, NULL);
+        free(value);
+    }
+    report("未命中查找", count, now_seconds() - start);
+
+    start = now_seconds();
+    for (size_t i = 0; i < count; i++) {
+        size_t key_length = make_key(key, "user", i);
+        kv_delete(store, key, key_length);
+    }
+    report("删除", count, now_seconds() - start);
+
+    kv_store_destroy(store);
+    return found == count ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    size_t defaults[] = { 1000000, 10000000 };
+    int status = 0;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            size_t count = strtoul(argv[i], NULL, 10);
+            status |= run(count);
+            status |= run_churn(count / 10);
+        }
+    } else {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+            status |= run(defaults[i]);
+            status |= run_churn(defaults[i] / 10);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,66 @@
+#ifndef APPEND_LOG_H
+#define APPEND_LOG_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 追加日志：记录 SET / DELETE / EXPIRE 修改的二进制文件。文件以 8 字节魔数开头，之后是连续的记录：
+//   crc32c(4 字节，小端，覆盖其后的整条记录) | 操作(1 字节) | 键长度(varint) | 值长度(varint，DELETE 没有) | 键 | 值
+// EXPIRE 的值是 8 字节小端的过期时刻（Unix 毫秒），0 表示取消过期。
+// 崩溃时文件末尾可能留下不完整的记录，重放在第一条不完整或校验失败的记录处停止
+
+#define APPEND_LOG_MAGIC "CXLOG001"
+#define APPEND_LOG_HEADER_SIZE 8
+#define APPEND_LOG_RECORD_MAX_OVERHEAD (4 + 1 + 10 + 10)
+
+typedef enum {
+    APPEND_LOG_SET = 1,
+    APPEND_LOG_DELETE = 2,
+    APPEND_LOG_EXPIRE = 3
+} AppendLogOp;
+
+// 一个日志文件的写入端：记录先追加到内存缓冲区，由所属线程在一轮事件处理结束时一次写入（组提交）
+typedef struct {
+    int fd;                           // -1 表示未启用
+    char *buf;
+    size_t len;
+    size_t cap;
+    atomic_uint_fast64_t written;     // 已写入文件的字节数（含文件头），其他线程读取以决定同步和重写
+    bool write_failed;                // 最近一次写入失败（磁盘满等），错误只报告一次，下一轮重试
+} AppendLog;
+
+void append_log_init(AppendLog *log);
+// 创建（截断）path 并写入文件头；O_APPEND 打开，失败时返回 false
+bool append_log_open(AppendLog *log, const char *path);
+// 把已打开的 fd 换进来（文件头已写入），返回原来的 fd；缓冲区必须已经写出
+int append_log_swap(AppendLog *log, int fd);
+void append_log_close(AppendLog *log); // 写出缓冲区后关闭，不同步
+void append_log_free(AppendLog *log);
+
+// 确保缓冲区还能再容纳 bytes 字节，之后这些字节以内的记录追加不会因内存不足失败
+bool append_log_reserve(AppendLog *log, size_t bytes);
+bool append_log_set(AppendLog *log, const char *key, size_t key_length, const char *value, size_t value_length);
+bool append_log_delete(AppendLog *log, const char *key, size_t key_length);
+bool append_log_expire(AppendLog *log, const char *key, size_t key_length, uint64_t expire_ms);
+uint64_t append_log_expire_time(const char *value, size_t value_length); // 解码 EXPIRE 记录的值
+bool append_log_write(AppendLog *log); // 把缓冲区写入文件，写入失败时保留缓冲区
+static inline bool append_log_pending(const AppendLog *log) {
+    return log->len > 0;
+}
+
+// 创建日志文件并写入文件头，返回 fd，失败时返回 -1
+int append_log_create_file(const char *path);
+
+// 重放：对每条完整且校验通过的记录调用 visit，返回 false 时停止。
+// 返回 false 表示文件无法读取或文件头不对；*valid_bytes 为有效数据（含文件头）的长度，
+// 小于文件大小说明末尾有不完整或损坏的记录
+typedef bool (*AppendLogVisitFn)(void *arg, AppendLogOp op, const char *key, size_t key_length,
+                                 const char *value, size_t value_length);
+bool append_log_replay(const char *path, AppendLogVisitFn visit, void *arg, uint64_t *valid_bytes,
+                       uint64_t *file_size);
+
+uint32_t append_log_crc32c(uint32_t crc, const void *data, size_t length);
+
+#endif // APPEND_LOG_H
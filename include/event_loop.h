@@ -0,0 +1,39 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// 关注的事件掩码
+#define EVENT_READ  0x01 // 可读
+#define EVENT_WRITE 0x02 // 可写
+#define EVENT_EDGE  0x04 // 边缘触发（默认水平触发）
+
+// 就绪事件的附加标志（仅出现在 event_loop_wait 的结果中）
+#define EVENT_EOF   0x08 // 对端关闭连接
+#define EVENT_ERROR 0x10 // 套接字出错
+
+// 事件循环（具体实现由构建时选择的后端提供：epoll 或 kqueue）
+typedef struct EventLoop EventLoop;
+
+// 就绪事件
+typedef struct {
+    int fd;
+    int events; // EVENT_READ / EVENT_WRITE / EVENT_EOF / EVENT_ERROR 的组合
+    void *data; // 注册时传入的用户数据
+} LoopEvent;
+
+// 事件循环接口
+EventLoop* event_loop_create(int max_events);
+void event_loop_destroy(EventLoop *loop);
+bool event_loop_add(EventLoop *loop, int fd, int events, void *data);
+bool event_loop_modify(EventLoop *loop, int fd, int events, void *data);
+bool event_loop_delete(EventLoop *loop, int fd);
+
+// 等待事件，timeout_ms < 0 表示无限等待；返回就绪事件数，出错返回 -1（errno 保留）
+int event_loop_wait(EventLoop *loop, LoopEvent *events, int max_events, int timeout_ms);
+
+// 后端名称，例如 "epoll"、"kqueue"
+const char* event_loop_backend(void);
+
+#endif // EVENT_LOOP_H
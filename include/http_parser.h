@@ -13,34 +13,63 @@ typedef enum {
     HTTP_UNKNOWN
 } HttpMethod;
 
-// HTTP 请求结构
+// 指向被解析缓冲区中的一段字节：不复制，也不以 '\0' 结尾
+typedef struct {
+    const char *data;
+    size_t length;
+} HttpSpan;
+
+// HTTP 请求结构：所有片段都指向被解析的缓冲区，缓冲区移动或释放后失效
 typedef struct {
     HttpMethod method;
-    char *path;
-    char *body;
-    size_t body_length;
-    char *headers;
+    HttpSpan path;           // 不含查询字符串
+    HttpSpan query;          // '?' 之后的查询字符串（不含 '?'），没有时长度为 0
+    HttpSpan host;           // 没有 Host 头部时长度为 0
+    HttpSpan if_none_match;  // 条件请求的实体标签列表，没有时长度为 0
+    HttpSpan ttl;            // X-TTL 头部（键的存活秒数），没有时长度为 0
+    HttpSpan body;           // 请求体全部到达后有效
+    size_t header_length;    // 请求行 + 请求头 + 结尾空行的长度，请求头不完整时为 0
+    size_t content_length;
+    bool keep_alive; // HTTP/1.1 默认保持连接，HTTP/1.0 需要 Connection: keep-alive
+    bool accept_gzip; // Accept-Encoding 中接受 gzip
 } HttpRequest;
 
-// HTTP 响应结构
-typedef struct {
-    int status_code;
-    char *status_text;
-    char *content_type;
-    char *body;
-    size_t body_length;
-} HttpResponse;
+// 响应的 Content-Type
+typedef enum {
+    HTTP_CONTENT_TEXT,  // text/plain
+    HTTP_CONTENT_HTML,  // text/html; charset=utf-8
+    HTTP_CONTENT_JSON,  // application/json
+    HTTP_CONTENT_CSS,   // text/css; charset=utf-8
+    HTTP_CONTENT_JS,    // application/javascript; charset=utf-8
+    HTTP_CONTENT_SVG,   // image/svg+xml
+    HTTP_CONTENT_PNG,   // image/png
+    HTTP_CONTENT_ICO,   // image/x-icon
+    HTTP_CONTENT_BINARY, // application/octet-stream
+    HTTP_CONTENT_TYPE_COUNT
+} HttpContentType;
+
+#define HTTP_HEADER_MAX 512 // http_write_header 输出缓冲区的建议大小，足够容纳任何模板加上短的额外头部
+
+// 请求解析结果
+#define HTTP_PARSE_ERROR -1      // 请求格式错误（例如缺少 HTTP 版本、非法的 Content-Length）
+#define HTTP_PARSE_INCOMPLETE 0  // 数据不足一个完整请求（header_length 不为 0 时只差请求体）
+#define HTTP_PARSE_COMPLETE 1    // 缓冲区开头是一个完整请求
 
 // HTTP 解析和构建接口
-HttpRequest* http_parse_request(const char *raw_request, size_t length);
-void http_free_request(HttpRequest *request);
+// scanned 不为 NULL 时记录已确认不含请求头结尾的前缀长度，数据增加后从这里继续扫描（新请求前置 0）
+int http_parse_request(const char *data, size_t length, size_t *scanned, HttpRequest *request);
+bool http_span_equals(HttpSpan span, const char *text);
+bool http_span_has_prefix(HttpSpan span, const char *prefix);
+// 在查询字符串（name=value&...）中查找参数，找到时 value 指向未解码的值（可以为空）
+bool http_query_param(HttpSpan query, const char *name, HttpSpan *value);
 
-HttpResponse* http_create_response(int status_code, const char *body);
-char* http_build_response(HttpResponse *response, size_t *response_length);
-char* http_build_response_with_cors(HttpResponse *response, size_t *response_length);
-void http_free_response(HttpResponse *response);
+// 响应头按启动时构建的模板写入，每个响应只格式化 Content-Length 和 Connection
+void http_response_init(void);
+size_t http_write_header(char *buffer, size_t size, int status_code, HttpContentType type,
+                         const char *extra, size_t content_length, bool keep_alive, bool cors);
 
 // 辅助函数
+size_t http_url_decode(char *data, size_t length); // 就地解码 %XX 转义，返回解码后的长度
 const char* http_method_to_string(HttpMethod method);
 HttpMethod http_string_to_method(const char *method_str);
 const char* http_status_text(int status_code);
@@ -1,45 +1,210 @@
 #ifndef KQUEUE_NET_H
 #define KQUEUE_NET_H
 
-#include <sys/event.h>
+#include "event_loop.h"
+#include "shard_queue.h"
+#include "out_queue.h"
+#include "http_parser.h"
+#include "static_cache.h"
+#include "resp_protocol.h"
+#include "append_log.h"
+#include "persistence.h"
+#include "snapshot.h"
+#include "timer_wheel.h"
+#include "metrics.h"
+#include "logger.h"
+#include <sys/socket.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 
-// 外部声明全局详细日志标志
-extern bool g_verbose;
-
-// 详细日志宏
-#define VERBOSE_LOG(fmt, ...) do { \
-    if (g_verbose) { \
-        printf("[VERBOSE] " fmt "\n", ##__VA_ARGS__); \
-        fflush(stdout); \
-    } \
-} while(0)
-
 // 前向声明
 struct KVStore;
 
 #define MAX_EVENTS 64
-#define BUFFER_SIZE 4096
-#define MAX_CLIENTS 1000
+#define BUFFER_SIZE 4096          // 读缓冲区的初始大小，请求较大时按需扩大
+#define MAX_HEADER_SIZE 8192      // 请求头（含请求行）的上限
+#define STREAM_BODY_MIN BUFFER_SIZE // 超过该长度的请求体直接读入值的存储，不经过读缓冲区
+#define DEFAULT_MAX_BODY_SIZE (64UL * 1024 * 1024)
+#define SPARE_BUFFER_COUNT 64     // 每个反应器缓存的空闲读缓冲区数
+#define MAX_CLIENT_OUTPUT (1UL * 1024 * 1024)  // 单个连接待发送输出的上限，超过后暂停读取和处理新请求
+#define DEFAULT_MAX_OUTPUT_SIZE (256UL * 1024 * 1024) // 全部连接待发送输出的上限，按反应器均分
+#define CLIENT_CHUNK_SIZE 256    // 连接对象按块分配，每块的连接数
+#define INITIAL_FD_CAPACITY 1024  // 连接表按 fd 索引的初始容量，更大的 fd 到来时加倍
+#define MAX_ACCEPTS_PER_EVENT 128
+#define MAX_REACTORS 64
+#define MAX_BATCH_KEYS 10000     // 一个批量请求最多包含的键数
+#define MAX_COMMAND_ARGS (2 * MAX_BATCH_KEYS + 1) // RESP 命令的参数个数上限（MSET 的键值对加命令名）
+#define INITIAL_ARG_CAPACITY 64  // 反应器参数数组的初始容量
+#define MAX_KEEPALIVE_CLIENTS 131072 // 每个反应器保持连接的上限，超过后响应改为 Connection: close
+#define BASE_MERGE_BATCH 256     // 每轮事件处理最多从映射的快照分区合并到内存的记录数
+#define EXPIRE_BATCH 256         // 每轮事件处理最多推进的过期定时器数（删除的键和时间轮下放的定时器）
+#define MAX_TTL_MS (100ULL * 365 * 24 * 3600 * 1000) // 键的存活时间上限
+#define REAP_BATCH 256           // 每轮事件处理最多检查的连接期限定时器数
+#define LOG_RETRY_INTERVAL_MS 1000 // 追加日志写出或同步失败后，每隔多久重试一次
+#define DEFAULT_HEADER_TIMEOUT_MS 10000
+#define DEFAULT_BODY_TIMEOUT_MS 30000
+#define DEFAULT_IDLE_TIMEOUT_MS 300000
+#define DEFAULT_WRITE_TIMEOUT_MS 30000
+#define METRICS_SAMPLE_INTERVAL_MS 1000 // 存储索引取样的最短间隔（只在键数变化后取样）
+#define METRICS_TABLE_SAMPLES 1024      // 每次取样检查的桶数
+
+// 连接使用的协议，由接受连接的监听套接字决定
+typedef enum {
+    CLIENT_PROTOCOL_HTTP,
+    CLIENT_PROTOCOL_RESP  // Redis 序列化协议（RESP2）的命令子集
+} ClientProtocol;
 
 // 客户端连接结构
-typedef struct {
+typedef struct ClientConnection {
     int fd;
-    char buffer[BUFFER_SIZE];
+    ClientProtocol protocol;
+    char *buffer;        // 有未处理的输入时才持有，处理完后归还给反应器
     size_t buffer_len;
+    size_t buffer_cap;
+    KVValue *body_value; // 正在流式接收的请求体，请求头保留在 buffer 开头
+    size_t body_received;
+    size_t header_length;
+    size_t header_scanned; // 当前请求中已确认不含请求头结尾的字节数，下次读取后从这里继续扫描
+    bool awaiting_body;  // 当前请求的请求头已完整，较短的请求体在缓冲区中尚未到齐（按请求体期限计）
     bool request_complete;
+    bool awaiting_shard; // 请求已转发给其他分片，等待应答
+    bool keep_alive;     // 最近一个请求的响应是否保持连接
+    bool keepalive_counted; // 已计入反应器的保持连接数
+    bool close_after_write; // 输出发送完毕后关闭连接，不再处理后续请求
+    bool output_held;    // 落盘策略为 always 时，响应等待本轮的日志同步完成后再发送（同步失败时丢弃并关闭连接）
+    int loop_events;     // 事件循环引擎：当前注册的事件（等待应答或输出积压时不含 EVENT_READ）
+    size_t output_charged; // 已计入反应器 output_bytes 的待发送字节数
+    unsigned generation; // 每次复用槽位递增，用于丢弃过期的跨分片应答
+    OutQueue out;        // 待发送的响应，由 IO 引擎负责发送（流水线请求的响应按顺序追加）
+    // 连接期限：活动时只记录时刻，定时器到期时再按连接当前的状态计算真正的期限（见 reactor_reap_clients）
+    TimerNode deadline;  // 刻度为反应器的单调时钟毫秒
+    uint64_t request_started; // 未完成请求的第一个字节到达的时刻，0 表示没有未完成的请求
+    uint64_t last_read;  // 最近一次读到数据的时刻
+    uint64_t last_write; // 最近一次发送有进展的时刻
+    bool timed_out;      // 已超时并关闭套接字，等待 IO 引擎释放连接
+    ReactorMetrics *metrics; // 所属反应器的统计
+    HttpMethod method;   // 当前 HTTP 请求的方法，响应按方法和状态码计数
+    uint64_t send_started; // io_uring 引擎：被取样计时的在途发送的提交时刻，0 表示不计时
+    // io_uring 引擎的在途操作状态
+    bool recv_pending;
+    bool send_pending;
+    bool closing;
+    bool uring_deferred; // 提交队列满时有操作未能提交，在引擎的重试链表中（槽位复用时保留）
+    struct ClientConnection *next_deferred;
+    OutQueue sending;    // 正在发送的输出队列，发送完成前不可修改
+    struct iovec send_iov[OUT_QUEUE_MAX_IOV];
+    struct msghdr send_msg;
+    struct ClientConnection *next_free; // 连接表空闲链表
 } ClientConnection;
 
-// 服务器结构
+// 连接表：按 fd 直接索引，查找为 O(1)；连接对象按块分配，地址在反应器生命周期内不变
+// （跨分片消息和 io_uring 的 user_data 持有连接指针），关闭后挂入空闲链表复用
+typedef struct {
+    ClientConnection **by_fd;    // 下标为 fd，没有连接的项为 NULL
+    int fd_capacity;
+    ClientConnection *free_list;
+    ClientConnection **chunks;   // 每块 CLIENT_CHUNK_SIZE 个连接
+    int chunk_count;
+    atomic_int active;           // 当前连接数，/health 跨线程读取
+} ClientTable;
+
+// IO 引擎类型
+typedef enum {
+    SERVER_ENGINE_LOOP,    // 基于就绪通知的事件循环（epoll / kqueue）
+    SERVER_ENGINE_IO_URING // 基于 io_uring 的批量提交引擎（仅 Linux）
+} ServerEngine;
+
+// 连接输入处理结果
+typedef enum {
+    CLIENT_NEED_MORE,         // 缓冲区中已无完整请求，发送已有输出后继续读取
+    CLIENT_CLOSE_AFTER_WRITE, // 发送已有输出后关闭连接
+    CLIENT_AWAITING_SHARD,    // 请求已转发给其他分片，应答到达后由 Reactor.complete 继续处理
+    CLIENT_OUTPUT_FULL        // 待发送输出超过上限，发送完成后再次调用 server_process_client_input 继续处理
+} ClientState;
+
+struct Reactor;
+struct KVServer;
+
+// 连接期限（毫秒），0 表示不限制；超时的连接被关闭，慢速或不活动的客户端不能长期占用连接
 typedef struct {
+    uint32_t header_ms; // 从请求的第一个字节到达起收齐请求头的期限
+    uint32_t body_ms;   // 接收请求体期间两次读到数据的最大间隔
+    uint32_t idle_ms;   // 没有未完成的请求和待发送的输出时，连接保持的期限
+    uint32_t write_ms;  // 有待发送的输出时，两次发送进展的最大间隔
+} ServerTimeouts;
+
+// 跨分片应答写入输出缓冲区后，由当前 IO 引擎继续处理流水线中的后续请求并发送响应
+typedef void (*ReactorCompleteFn)(struct Reactor *reactor, ClientConnection *client);
+
+// 反应器：每个线程一个，独占监听套接字、事件循环、连接表和键空间分片
+typedef struct Reactor {
+    int id;
+    struct KVServer *server;
     int server_fd;
-    int kqueue_fd;
+    int resp_fd;                // RESP 监听套接字，未启用时为 -1
+    EventLoop *loop;
+    struct KVStore *kv_store;   // 本线程拥有的键空间分片
+    SlabAllocator *slab;        // 本线程创建的条目和值从这里分配
+    ShardMailbox mailbox;       // 其他反应器投递的跨分片请求和应答
+    ClientTable clients;        // 本反应器的连接，容量随连接数增长
+    StaticCache static_cache;   // web 目录下文件的内存缓存
+    int keepalive_count;        // 当前保持连接的连接数
+    char *spare_buffers[SPARE_BUFFER_COUNT]; // 空闲的 BUFFER_SIZE 读缓冲区
+    int spare_count;
+    KVKey *args;                // 解析批量请求和 RESP 命令时复用的参数数组，只在处理一个请求期间有效
+    size_t arg_cap;
+    size_t output_bytes;        // 所有连接待发送的字节数
+    size_t output_limit;        // output_bytes 的上限（服务器上限按反应器均分）
+    AppendLog log;              // 本分片的追加日志，未启用持久化时 fd 为 -1
+    bool log_sync_always;       // 每轮写入日志后同步，同步前暂缓发送响应
+    bool log_failed;            // 日志写入或同步失败（或缓冲区内存不足），恢复前拒绝写操作
+    uint64_t log_retry_ms;      // 失败状态下下一次重试写出日志的时刻（单调时钟毫秒）
+    ClientConnection **held_clients; // 等待本轮日志同步才能发送响应的连接
+    size_t held_count;
+    size_t held_cap;
+    ShardMessage *held_replies; // 等待本轮日志同步的跨分片应答，通过 next 链接
+    SnapshotShard *base;        // 启动时映射的快照分区，键在读取时或由后台合并复制到内存存储；NULL 表示没有
+    struct timespec base_opened;
+    TimerWheel client_timers;   // 连接期限，刻度为单调时钟毫秒
+    uint64_t now_ms;            // 本轮事件处理开始时的单调时钟（毫秒），连接的活动时刻按它记录
+    uint32_t reap_interval_ms;  // 连接最长隔多久检查一次期限（启用的期限中最短的），0 表示不检查
+    ReactorMetrics metrics;     // 本线程的运行统计，/metrics 跨线程读取
+    size_t table_sample_cursor;
+    size_t table_sampled_keys;  // 最近一次取样时内存存储中的键数，与映射的键数都不变时不重新取样
+    size_t table_sampled_mapped; // 最近一次取样时映射的快照分区中的键数
+    uint64_t table_sampled_ms;  // 最近一次取样的时刻（单调时钟毫秒）
+    ReactorCompleteFn complete;
+    void *engine_data;          // IO 引擎私有状态
+    pthread_t thread;
+} Reactor;
+
+// 服务器结构
+typedef struct KVServer {
     int port;
-    struct KVStore *kv_store;
-    ClientConnection clients[MAX_CLIENTS];
-    bool running;
+    int resp_port;       // RESP 监听端口，0 表示不启用
+    ServerEngine engine;
+    int reactor_count;
+    Reactor *reactors;
+    size_t max_body_size; // 请求体上限，超过时响应 413
+    size_t max_output_size; // 所有连接待发送输出的上限
+    char *log_dir;       // 追加日志目录，NULL 表示不启用持久化
+    FsyncPolicy fsync_policy;
+    int fsync_interval_ms;
+    char *snapshot_path; // 快照文件，NULL 表示不启用快照
+    int snapshot_interval_s; // 定时快照的间隔（秒），0 表示只按请求写
+    size_t max_memory;   // 键空间的内存上限，按反应器均分，0 表示不限
+    KVEvictPolicy evict_policy; // 达到上限后的淘汰策略
+    ServerTimeouts timeouts;
+    Persistence *persistence;
+    // 反应器暂停屏障：持久化线程切换日志和 fork 时让所有反应器停在事件之间
+    pthread_mutex_t pause_lock;
+    pthread_cond_t pause_cond;
+    int paused;          // 已进入本次暂停的反应器数
+    unsigned pause_epoch; // 每次恢复时递增，反应器据此识别过期的暂停请求
+    atomic_bool running; // 信号处理函数通过 server_stop 修改
 } KVServer;
 
 // 网络服务器接口
@@ -48,17 +213,36 @@ void server_destroy(KVServer *server);
 bool server_start(KVServer *server);
 void server_stop(KVServer *server);
 void server_run(KVServer *server);
+bool server_set_engine(KVServer *server, ServerEngine engine);
+bool server_set_threads(KVServer *server, int threads);
+bool server_set_max_body(KVServer *server, size_t bytes);
+bool server_set_max_output(KVServer *server, size_t bytes);
+bool server_set_resp_port(KVServer *server, int port);
+bool server_set_append_log(KVServer *server, const char *dir, FsyncPolicy policy, int interval_ms);
+bool server_set_snapshot(KVServer *server, const char *path, int interval_s);
+bool server_set_max_memory(KVServer *server, size_t bytes, KVEvictPolicy policy);
+bool server_set_timeouts(KVServer *server, const ServerTimeouts *timeouts);
+const char* server_engine_name(ServerEngine engine);
 
-// 内部函数
-static bool setup_server_socket(KVServer *server);
-static bool setup_kqueue(KVServer *server);
-static void handle_new_connection(KVServer *server);
-static void handle_client_data(KVServer *server, int client_fd);
-static void handle_client_disconnect(KVServer *server, int client_fd);
-static void process_http_request(KVServer *server, int client_fd, const char *request, size_t length);
-static ClientConnection* find_client(KVServer *server, int fd);
-static void init_client(ClientConnection *client, int fd);
-static void cleanup_client(ClientConnection *client);
+// IO 引擎共享的连接处理接口
+ClientConnection* server_acquire_client(Reactor *reactor, int fd, ClientProtocol protocol);
+bool server_client_read_buffer(Reactor *reactor, ClientConnection *client, char **data, size_t *length);
+void server_client_read_done(Reactor *reactor, ClientConnection *client, size_t bytes);
+void server_client_output_update(Reactor *reactor, ClientConnection *client);
+bool server_hold_client_output(Reactor *reactor, ClientConnection *client);
+ClientState server_process_client_input(Reactor *reactor, ClientConnection *client);
+void server_release_client(Reactor *reactor, ClientConnection *client);
+void reactor_drain_mailbox(Reactor *reactor);
+void reactor_commit_log(Reactor *reactor);
+void reactor_merge_base(Reactor *reactor);
+void reactor_expire_keys(Reactor *reactor);
+void reactor_update_clock(Reactor *reactor);
+void reactor_reap_clients(Reactor *reactor);
+void reactor_sample_metrics(Reactor *reactor);
+int reactor_wait_timeout(Reactor *reactor);
+size_t reactor_key_count(Reactor *reactor);
+bool server_pause_reactors(KVServer *server);
+void server_resume_reactors(KVServer *server);
 
 #endif // KQUEUE_NET_H
 
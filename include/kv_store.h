@@ -3,28 +3,193 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "slab.h"
+#include "timer_wheel.h"
 
-// 哈希表条目结构
+// 引用计数的不可变值：存储和正在发送的响应各持有一个引用，
+// 读取时借用而不复制；引用计数为原子操作，可以跨反应器线程释放（内存归还给分配它的 slab）
+typedef struct KVValue {
+    atomic_size_t refs;
+    size_t length;
+    char data[]; // length 字节，结尾额外的 '\0' 便于按字符串使用
+} KVValue;
+
+struct KVExpiry;
+
+// 哈希表条目结构（键值由各存储引擎共用，引擎只负责索引）；
+// 键和值都按长度处理，可以包含任意字节（包括 '\0'）
 typedef struct HashEntry {
-    char *key;
-    char *value;
-    struct HashEntry *next; // 用于解决哈希冲突（链地址法）
+    KVValue *value;
+    size_t hash;            // 键的完整哈希值，rehash 时无需重新计算
+    struct HashEntry *next; // 用于解决哈希冲突（链地址法），开放寻址引擎不使用
+    struct KVExpiry *expiry; // 设置了过期时刻的键才有，NULL 表示不过期
+    uint32_t key_length;
+    uint32_t access;        // 淘汰策略的访问信息（CLOCK 引用位、LRU 访问刻度或 LFU 计数），占用原有的对齐空隙
+    char key[];             // 键内联在条目之后，结尾额外的 '\0' 便于日志输出
 } HashEntry;
 
-// KV 存储结构
+// 键的过期定时器：按需从存储的 slab 分配，挂在存储的时间轮上（刻度为 Unix 毫秒）
+typedef struct KVExpiry {
+    TimerNode timer;        // timer.expire 为过期时刻
+    HashEntry *entry;
+} KVExpiry;
+
+// 达到内存上限后的处理方式；淘汰只使用条目中的 access 字段，不为每个条目维护链表指针
+typedef enum {
+    KV_EVICT_NONE,  // 不淘汰，拒绝需要更多内存的写入
+    KV_EVICT_CLOCK, // CLOCK（二次机会）：指针按槽位顺序扫过条目，清除引用位，淘汰引用位已清除的
+    KV_EVICT_LRU,   // 近似 LRU：随机取样 KV_EVICT_SAMPLES 个条目，淘汰最久未访问的
+    KV_EVICT_LFU    // 近似 LFU：随机取样，淘汰访问频率最低的（8 位对数计数，按分钟衰减）
+} KVEvictPolicy;
+
+#define KV_EVICT_SAMPLES 5   // LRU/LFU 每次淘汰取样的条目数
+#define KV_CLOCK_BATCH 16    // CLOCK 指针每次取出的条目数
+
+// 条目被淘汰前调用（例如把删除写入日志）
+typedef void (*KVEvictFn)(void *arg, const HashEntry *entry);
+
+// 内存上限和淘汰状态，嵌在各引擎的存储结构中。memory 计入条目（含内联的键）、值、过期定时器的
+// slab 大小类字节数和索引数组；计数只由所有者线程修改，其他线程可以随时读取
 typedef struct {
-    HashEntry **buckets;
-    size_t capacity;
-    size_t size;
-} KVStore;
+    KVEvictPolicy policy;
+    size_t limit;           // 0 表示不限
+    size_t cursor;          // CLOCK 指针（槽位编号）
+    uint64_t rng;           // 取样位置的随机数状态
+    uint64_t now_ms;        // LRU/LFU 使用的时钟，在 kv_expire 和淘汰时更新，访问时不读系统时钟
+    KVEvictFn on_evict;
+    void *evict_arg;
+    atomic_size_t memory;
+    atomic_size_t hits;     // 读取命中和未命中的键数
+    atomic_size_t misses;
+    atomic_size_t evictions;
+} KVEvictor;
 
-// KV 存储接口
-KVStore* kv_store_create(size_t initial_capacity);
+// 供其他线程读取的统计快照
+typedef struct {
+    size_t memory;
+    size_t limit;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} KVCacheStats;
+
+// KV 存储结构，由构建时选择的引擎定义（kv_store_chained.c 或 kv_store_swiss.c）
+typedef struct KVStore KVStore;
+
+// KV 存储接口；条目从 slab 分配，slab 为 NULL 时存储自己创建一个。
+// 共享的 slab 要在所有使用它的存储销毁、所有值释放之后再销毁
+KVStore* kv_store_create(size_t initial_capacity, SlabAllocator *slab);
 void kv_store_destroy(KVStore *store);
-bool kv_set(KVStore *store, const char *key, const char *value);
-char* kv_get(KVStore *store, const char *key);
-bool kv_delete(KVStore *store, const char *key);
+bool kv_set(KVStore *store, const char *key, size_t key_length, const char *value, size_t value_length);
+char* kv_get(KVStore *store, const char *key, size_t key_length, size_t *value_length); // 返回的副本需 free
+bool kv_delete(KVStore *store, const char *key, size_t key_length);
 size_t kv_size(KVStore *store);
+SlabAllocator* kv_store_allocator(KVStore *store);
+void kv_store_memory(KVStore *store, SlabStats *stats); // 存储所用分配器的内存统计
 
-#endif // KV_STORE_H
+// 遍历存储中的所有条目（包括渐进式 rehash 期间两张表中的条目），visit 返回 false 时停止；
+// 遍历期间不能修改存储
+typedef bool (*KVVisitFn)(void *arg, const HashEntry *entry);
+void kv_store_foreach(KVStore *store, KVVisitFn visit, void *arg);
+
+// 批量操作中的一个键
+typedef struct {
+    const char *data;
+    size_t length;
+} KVKey;
+
+// 零复制接口：kv_get_value 返回增加了引用计数的值，调用方用完后 kv_value_release；
+// kv_set_value 让存储持有 value 的一个新引用
+KVValue* kv_get_value(KVStore *store, const char *key, size_t key_length);
+bool kv_set_value(KVStore *store, const char *key, size_t key_length, KVValue *value);
+// 批量读取：values[i] 为 keys[i] 的值的引用，不存在时为 NULL；
+// 按窗口先计算哈希并预取桶，再逐个探测，多个键的缓存未命中互相重叠
+void kv_get_values(KVStore *store, const KVKey *keys, size_t count, KVValue **values);
 
+// 过期：键可以带一个过期时刻（Unix 毫秒，0 表示不过期）。过期的键在被访问时删除（读取、删除和
+// 查询过期时刻都把它当作不存在），没有被访问的由 kv_expire 按时间轮分批删除。
+// 普通的写入（kv_set_value）会清除原有的过期时刻
+uint64_t kv_now_ms(void);
+bool kv_set_value_expire(KVStore *store, const char *key, size_t key_length, KVValue *value, uint64_t expire_ms);
+// 修改已有键的过期时刻，0 表示取消；键不存在或内存不足时返回 false
+bool kv_set_expire(KVStore *store, const char *key, size_t key_length, uint64_t expire_ms);
+// 键不存在时返回 false；没有过期时刻时 *expire_ms 为 0
+bool kv_get_expire(KVStore *store, const char *key, size_t key_length, uint64_t *expire_ms);
+// 删除到 now_ms 为止过期的键，最多消耗 budget 个时间轮操作，返回删除的键数
+size_t kv_expire(KVStore *store, uint64_t now_ms, size_t budget);
+// 下一次需要调用 kv_expire 的时刻，没有带过期时刻的键时返回 TIMER_WHEEL_NEVER
+uint64_t kv_next_expire(KVStore *store);
+// 重放日志期间打开：已过期的键在访问时不删除，之后的记录（例如取消过期）照常作用于它们，
+// 重放结束后由 kv_expire 回收
+void kv_set_loading(KVStore *store, bool loading);
+
+// 内存上限：memory 超过 bytes（0 表示不限）后，写入按 policy 先淘汰其他键，KV_EVICT_NONE 时写入失败；
+// 覆盖写入不增加内存时总是允许。设置时内存已经超限的，由之后的写入逐步淘汰
+void kv_set_memory_limit(KVStore *store, size_t bytes, KVEvictPolicy policy);
+void kv_set_evict_callback(KVStore *store, KVEvictFn on_evict, void *arg);
+bool kv_memory_fits(KVStore *store, size_t key_length, size_t value_length); // 不淘汰也能写入这样大小的新键
+void kv_cache_stats(KVStore *store, KVCacheStats *stats); // 可以在任意线程调用
+const char* kv_evict_policy_name(KVEvictPolicy policy);
+bool kv_evict_policy_parse(const char *name, KVEvictPolicy *policy); // noeviction、clock、lru 或 lfu
+
+// 索引结构的取样统计：capacity 为桶（开放寻址为槽位）数，渐进式 rehash 期间为两张表之和；
+// chains[i] 为取样中长度为 i 的个数，0 为空桶，最后一项包含更长的。链地址法按桶统计链长，
+// 开放寻址按已占用的槽位统计键从起始组起探测的组数（1 表示在起始组中）
+#define KV_CHAIN_LENGTHS 9
+
+typedef struct {
+    size_t capacity;
+    size_t sampled;
+    size_t chains[KV_CHAIN_LENGTHS];
+} KVTableStats;
+
+// 由各引擎实现：均匀取样最多 samples 个桶，*cursor 为取样起点的偏移，每次调用后推进，
+// 多次取样覆盖不同的桶。只能在所有者线程调用
+void kv_table_sample(KVStore *store, size_t *cursor, size_t samples, KVTableStats *stats);
+
+// 值的创建和引用计数：值从创建线程的 slab 分配，可以交给其他分片的存储持有
+KVValue* kv_value_create(SlabAllocator *slab, const char *data, size_t length);
+KVValue* kv_value_alloc(SlabAllocator *slab, size_t length); // 内容由调用方填写（例如直接从套接字读入）
+KVValue* kv_value_retain(KVValue *value);
+void kv_value_release(KVValue *value);
+const char* kv_store_engine(void); // 当前存储引擎名称
+
+#define KV_BATCH_WINDOW 16 // kv_get_values 一次预取的键数
+
+// 计算键所属的分片（与桶索引使用不同的哈希，避免分片内桶分布倾斜）
+size_t kv_shard_index(const char *key, size_t key_length, size_t shard_count);
+
+// 引擎共用的辅助函数
+size_t kv_hash_key(const char *key, size_t key_length);
+HashEntry* kv_entry_create(SlabAllocator *slab, const char *key, size_t key_length, KVValue *value, size_t hash);
+void kv_entry_free(HashEntry *entry); // 同时取消并释放条目的过期定时器
+bool kv_entry_set_expire(KVStore *store, HashEntry *entry, uint64_t expire_ms); // 0 表示取消，内存不足时返回 false
+bool kv_entry_expired(const HashEntry *entry);
+static inline uint64_t kv_entry_expire(const HashEntry *entry) {
+    return entry->expiry ? entry->expiry->timer.expire : 0;
+}
+
+// 内存记账和访问记录：条目放入索引时 attach（计入内存并初始化访问信息），移出时 detach；
+// 写入前用 kv_reserve 腾出空间（existing 为被覆盖的条目，不会被淘汰），读取后用 kv_entry_touch
+// 记录命中（entry 为 NULL 表示未命中）。索引数组的内存由引擎自己 charge/uncharge
+size_t kv_value_memory(const KVValue *value);
+size_t kv_entry_memory(const HashEntry *entry); // 条目、值和过期定时器
+void kv_memory_charge(KVStore *store, size_t bytes);
+void kv_memory_uncharge(KVStore *store, size_t bytes);
+bool kv_reserve(KVStore *store, const HashEntry *existing, size_t key_length, const KVValue *value,
+                uint64_t expire_ms);
+void kv_entry_attach(KVStore *store, HashEntry *entry);
+void kv_entry_detach(KVStore *store, HashEntry *entry);
+void kv_entry_replace_value(KVStore *store, HashEntry *entry, KVValue *value);
+void kv_entry_touch(KVStore *store, HashEntry *entry);
+
+// 由各引擎实现：查找未过期的条目（过期的在这里删除），存储的时间轮和淘汰状态，
+// 以及从槽位 *cursor 起按顺序取出最多 max 个条目（到达末尾后回到开头，*cursor 更新为下一个槽位）
+HashEntry* kv_find_entry(KVStore *store, const char *key, size_t key_length);
+TimerWheel* kv_store_timers(KVStore *store);
+KVEvictor* kv_store_evictor(KVStore *store);
+size_t kv_scan_entries(KVStore *store, size_t *cursor, HashEntry **out, size_t max);
+
+#endif // KV_STORE_H
@@ -0,0 +1,67 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 异步日志：调用方只把格式串指针和参数的原始值写入一条定长的二进制记录，放进无锁环形缓冲区，
+// 不格式化也不进系统调用；后台线程按格式串还原文本后批量写出。缓冲区满时丢弃记录并计数，调用方从不等待。
+// 格式串必须是字符串字面量（宏会检查），%s 参数在记录中保存副本，总长超过记录空间的部分被截断
+
+typedef enum {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+#define LOG_RING_SLOTS 4096        // 环形缓冲区的记录数（2 的幂）
+#define LOG_RATE_LIMIT 20          // 同一调用位置每秒最多记录的条数，超出的只计数
+
+// 每个调用位置一份，由宏定义为静态变量；限速状态在线程间共享
+typedef struct {
+    const char *format;
+    LogLevel level;
+    atomic_uint window;            // 当前限速窗口（秒）
+    atomic_uint count;             // 窗口内已记录的条数
+    atomic_uint suppressed;        // 被限速省略、尚未报告的条数
+} LogSite;
+
+extern atomic_int g_log_level;
+
+static inline bool log_enabled(LogLevel level) {
+    return (int)level <= atomic_load_explicit(&g_log_level, memory_order_relaxed);
+}
+
+// format 与 site->format 相同，作为参数传入只为让编译器按 printf 检查格式串和参数
+void log_write(LogSite *site, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// 第一个参数是格式串；用 LOG_FORMAT_ 取出它来初始化调用位置，不依赖 GNU 的 ##__VA_ARGS__
+#define LOG_FORMAT_(format, ...) format
+#define LOG_AT(level, ...) do { \
+    if (log_enabled(level)) { \
+        static LogSite log_site_ = {"" LOG_FORMAT_(__VA_ARGS__, ""), level, 0, 0, 0}; \
+        log_write(&log_site_, __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+void logger_set_level(LogLevel level);
+bool logger_parse_level(const char *name, LogLevel *level);
+const char* logger_level_name(LogLevel level);
+
+// 启动后台写出线程；启动前写入的记录留在缓冲区中，启动后写出
+bool logger_start(void);
+// 停止后台线程并写出缓冲区中剩余的记录，可重复调用
+void logger_stop(void);
+
+size_t logger_dropped(void);    // 因缓冲区满而丢弃的记录数
+size_t logger_suppressed(void); // 因限速而省略的记录数
+
+#endif // LOGGER_H
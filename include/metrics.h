@@ -0,0 +1,122 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "kv_store.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// 运行统计：每个反应器一份 ReactorMetrics，只由本线程修改（单写者，relaxed 读后写，不用原子的读-改-写，
+// 不加锁也不进系统调用），/metrics 在任意线程按 relaxed 读取后汇总成 Prometheus 文本格式
+
+// 延迟直方图（HDR 风格的对数-线性分桶）：每个 2 的幂区间再均分为 2^METRIC_HIST_SUB_BITS 个子桶，
+// 相对误差不超过 1/8；单位为纳秒，超过 2^METRIC_HIST_MAX_BITS 纳秒（约 68 秒）的计入最后一个桶
+#define METRIC_HIST_SUB_BITS 3
+#define METRIC_HIST_MAX_BITS 36
+#define METRIC_HIST_BUCKETS ((METRIC_HIST_MAX_BITS - METRIC_HIST_SUB_BITS + 1) << METRIC_HIST_SUB_BITS)
+#define METRIC_TIMING_SAMPLE 8   // 每个阶段每 8 次操作计时一次，计时的开销分摊到所有请求
+
+typedef struct {
+    atomic_size_t buckets[METRIC_HIST_BUCKETS];
+    atomic_size_t count;
+    atomic_size_t sum_ns;
+} MetricHistogram;
+
+// 汇总后的直方图（普通整数，可以跨反应器累加）
+typedef struct {
+    size_t buckets[METRIC_HIST_BUCKETS];
+    size_t count;
+    size_t sum_ns;
+} MetricHistogramSnapshot;
+
+// 计时的阶段
+typedef enum {
+    METRIC_STAGE_PARSE, // 解析一个 HTTP 请求头或一条 RESP 命令
+    METRIC_STAGE_STORE, // 在所属分片上执行一个存储操作（含批量操作在本分片的部分）
+    METRIC_STAGE_SEND,  // 发送：事件循环引擎为一次 sendmsg，io_uring 引擎为提交到完成
+    METRIC_STAGE_COUNT
+} MetricStage;
+
+// HTTP 响应按方法（与 HttpMethod 的顺序相同）和状态码计数，列表外的状态码计入最后一项
+#define METRIC_HTTP_METHODS 5
+#define METRIC_HTTP_CODES 16
+
+typedef struct {
+    atomic_size_t http_responses[METRIC_HTTP_METHODS][METRIC_HTTP_CODES];
+    atomic_size_t resp_commands;
+    atomic_size_t resp_errors;      // 错误应答数（协议错误、参数错误、内存不足等）
+    atomic_size_t bytes_in;
+    atomic_size_t bytes_out;
+    atomic_size_t accepted;         // 接受的连接数
+    atomic_size_t timeouts;         // 因超过连接期限而关闭的连接数
+    // 存储的规模，由所属线程定期取样（见 reactor_sample_metrics）
+    atomic_size_t table_keys;       // 内存存储的键数
+    atomic_size_t mapped_keys;      // 映射的快照分区中尚未合并的键数
+    atomic_size_t table_buckets;    // 索引的桶（槽位）数
+    atomic_size_t table_chains[KV_CHAIN_LENGTHS]; // 按取样估计的各链长的桶数（开放寻址为各探测长度的槽位数）
+    unsigned timing_ticks[METRIC_STAGE_COUNT]; // 计时取样的计数，只由所属线程读写
+    MetricHistogram stages[METRIC_STAGE_COUNT];
+} ReactorMetrics;
+
+// 计数只由所有者线程修改，其他线程只读，不需要原子的读-改-写
+static inline void metric_add(atomic_size_t *counter, size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+static inline void metric_set(atomic_size_t *gauge, size_t value) {
+    atomic_store_explicit(gauge, value, memory_order_relaxed);
+}
+
+static inline size_t metric_read(const atomic_size_t *counter) {
+    return atomic_load_explicit((atomic_size_t *)counter, memory_order_relaxed);
+}
+
+static inline uint64_t metrics_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now); // vDSO，不进入内核
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// 阶段开始：本次被取样时返回开始时刻，否则返回 0，metrics_finish 对 0 什么也不做
+static inline uint64_t metrics_start(ReactorMetrics *metrics, MetricStage stage) {
+    if ((metrics->timing_ticks[stage]++ & (METRIC_TIMING_SAMPLE - 1)) != 0) return 0;
+    return metrics_now_ns();
+}
+
+void metric_histogram_record(MetricHistogram *histogram, uint64_t ns);
+
+static inline void metrics_finish(ReactorMetrics *metrics, MetricStage stage, uint64_t start_ns) {
+    if (start_ns != 0) {
+        metric_histogram_record(&metrics->stages[stage], metrics_now_ns() - start_ns);
+    }
+}
+
+int metric_http_code_index(int status_code); // 状态码在 http_responses 中的列下标
+int metric_http_code(int index);             // 列下标对应的状态码，最后一列（其他）为 0
+const char* metric_stage_name(MetricStage stage);
+
+void metric_histogram_merge(MetricHistogramSnapshot *snapshot, const MetricHistogram *histogram);
+
+// Prometheus 文本格式的输出缓冲区；内存不足后 failed 为 true，之后的写入被忽略
+typedef struct {
+    char *data;
+    size_t length;
+    size_t cap;
+    bool failed;
+} MetricsText;
+
+void metrics_text_init(MetricsText *text);
+void metrics_text_free(MetricsText *text);
+void metrics_text_printf(MetricsText *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void metrics_text_family(MetricsText *text, const char *name, const char *type, const char *help); // HELP 和 TYPE 行
+// 直方图的一组序列：按 2 的幂纳秒为边界（以秒表示）输出累计的 _bucket，以及 _sum 和 _count；labels 可以为空串
+void metrics_text_histogram(MetricsText *text, const char *name, const char *labels,
+                            const MetricHistogramSnapshot *snapshot);
+
+struct KVServer;
+// 服务器的全部指标：汇总各反应器的统计、存储和内存的用量；内存不足时 text->failed 为 true
+void metrics_text_server(MetricsText *text, struct KVServer *server);
+
+#endif // METRICS_H
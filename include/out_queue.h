@@ -0,0 +1,42 @@
+#ifndef OUT_QUEUE_H
+#define OUT_QUEUE_H
+
+#include "kv_store.h"
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#define OUT_QUEUE_MAX_IOV 64       // 一次 writev/sendmsg 最多提交的分段数
+#define OUT_QUEUE_INLINE_MAX 1024  // 小于该长度的值直接复制进缓冲区，比单独一个 iovec 更便宜
+
+// 输出分段：引用存储中的值，或者指向缓冲区中的一段区间
+typedef struct {
+    KVValue *value; // 非 NULL 时持有值的一个引用
+    size_t offset;  // value 为 NULL 时是在 buf 中的偏移
+    size_t length;
+} OutSegment;
+
+// 连接的输出队列：响应头等小块数据追加到连续缓冲区，大值以引用方式排队，
+// 发送时组装成 iovec 交给 writev/sendmsg，值本身不被复制
+typedef struct {
+    char *buf;
+    size_t buf_len;
+    size_t buf_cap;
+    OutSegment *segs;
+    size_t seg_count;
+    size_t seg_cap;
+    size_t seg_head;  // 第一个未发送完的分段
+    size_t head_sent; // 该分段中已发送的字节数
+    size_t pending;   // 尚未发送的总字节数
+} OutQueue;
+
+bool out_queue_append(OutQueue *queue, const char *data, size_t length);
+char* out_queue_reserve(OutQueue *queue, size_t length); // 就地写入：先预留，再提交实际长度
+bool out_queue_commit(OutQueue *queue, size_t length);
+bool out_queue_append_value(OutQueue *queue, KVValue *value);
+int out_queue_fill_iov(const OutQueue *queue, struct iovec *iov, int max_iov);
+void out_queue_consume(OutQueue *queue, size_t bytes);
+void out_queue_clear(OutQueue *queue); // 丢弃未发送的数据，保留已分配的内存
+void out_queue_free(OutQueue *queue);
+
+#endif // OUT_QUEUE_H
@@ -0,0 +1,70 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 追加日志持久化：每个反应器把本分片的修改追加到自己的增量日志（incr-<代数>-<分片>.cxl），
+// 一轮事件处理中的记录一次写入；后台线程按策略同步落盘，日志增长到上次重写结果的两倍后
+// fork 子进程把全部数据写成新的基础文件（base-<代数>.cxl），完成后删除更早的文件。
+// 启动时重放最新的基础文件和代数不小于它的增量日志。
+// 快照：按请求或定时 fork 子进程把 fork 时刻的全部数据写入一个快照文件（见 snapshot.h），
+// 反应器只在 fork 前后短暂暂停。未启用追加日志时启动从快照恢复
+
+#define PERSIST_REWRITE_MIN_SIZE (64ULL * 1024 * 1024) // 日志总大小低于该值时不自动重写
+#define PERSIST_REWRITE_GROWTH 100   // 日志总大小超过基础文件的 (100 + 该值)% 时自动重写
+#define PERSIST_TICK_MS 100          // 后台线程检查重写条件和子进程的间隔
+#define PERSIST_DEFAULT_FSYNC_MS 1000
+#define PERSIST_STATUS_JSON_MAX 512   // persistence_snapshot_json 的缓冲区大小
+
+// 落盘策略
+typedef enum {
+    FSYNC_ALWAYS,   // 每轮事件处理写入后立即同步，同步完成前不发送这一轮的响应
+    FSYNC_INTERVAL, // 后台线程每隔固定毫秒数同步一次
+    FSYNC_NO        // 只写入，由操作系统决定何时落盘
+} FsyncPolicy;
+
+// 快照状态
+typedef struct {
+    bool configured;          // 配置了快照文件
+    bool requested;           // 有请求在等待执行
+    bool running;
+    uint64_t keys_total;      // 正在写的快照开始时的键数
+    uint64_t keys_written;
+    uint64_t bytes_written;
+    double elapsed_ms;
+    double pause_ms;          // 正在写的快照 fork 时反应器的暂停时间
+    bool has_last;            // 以下为最近一次结束的快照
+    bool last_ok;
+    uint64_t last_keys;
+    uint64_t last_bytes;
+    double last_duration_ms;
+    double last_pause_ms;
+    long long last_finished;  // 结束时刻（Unix 秒）
+} SnapshotStatus;
+
+struct KVServer;
+struct Reactor;
+typedef struct Persistence Persistence;
+
+// 按服务器的日志目录、落盘策略和快照配置创建
+Persistence* persistence_create(struct KVServer *server);
+void persistence_destroy(Persistence *persistence);
+// 确定需要重放的文件并为每个反应器创建新一代增量日志，在反应器线程启动前调用
+bool persistence_open(Persistence *persistence);
+// 在反应器自己的线程中调用：重放日志（未启用日志时加载快照）中属于本分片的记录（值从本反应器的 slab 分配）
+void persistence_load_shard(Persistence *persistence, struct Reactor *reactor);
+bool persistence_start(Persistence *persistence); // 启动后台线程
+// 停止后台线程，终止未完成的重写或快照，把各分片日志写出并同步；反应器线程退出后调用
+void persistence_stop(Persistence *persistence);
+// 请求一次重写；已有请求在排队时返回 false，重写正在进行时请求在其结束后执行
+bool persistence_request_rewrite(Persistence *persistence);
+// 请求一次快照；未配置快照文件时返回 false，已有子进程在运行时请求在其结束后执行
+bool persistence_request_snapshot(Persistence *persistence);
+void persistence_snapshot_status(Persistence *persistence, SnapshotStatus *status);
+// 快照状态的 JSON 表示，buffer 至少 PERSIST_STATUS_JSON_MAX 字节，返回长度
+size_t persistence_snapshot_json(Persistence *persistence, char *buffer, size_t size);
+const char* fsync_policy_name(FsyncPolicy policy);
+
+#endif // PERSISTENCE_H
@@ -0,0 +1,41 @@
+#ifndef RESP_PROTOCOL_H
+#define RESP_PROTOCOL_H
+
+#include "kv_store.h"
+#include "out_queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Redis 序列化协议（RESP2）的命令解析和应答编码，只包含服务器需要的部分
+
+#define RESP_MAX_INLINE (64 * 1024)   // 内联命令（一行以空白分隔的文本，例如 telnet 输入）的长度上限
+#define RESP_MAX_ARGS (1024 * 1024)   // 一条命令的参数个数上限
+
+// 命令解析结果
+#define RESP_PARSE_ERROR -1      // 协议错误，连接上的字节流无法继续使用
+#define RESP_PARSE_INCOMPLETE 0  // 数据不足一条完整命令
+#define RESP_PARSE_COMPLETE 1    // 缓冲区开头是一条完整命令（argc 为 0 的空命令应跳过）
+#define RESP_PARSE_NEED_ARGS 2   // 参数数组容量不足，argc 为需要的容量，扩大后重新解析
+
+typedef struct {
+    KVKey *args;    // 调用方提供的参数数组，解析出的参数指向输入数据，不复制
+    size_t arg_cap; // args 的容量
+    size_t argc;    // 参数个数（第一个是命令名）
+    size_t length;  // 完整命令占用的字节数
+} RespCommand;
+
+// 解析 data 开头的一条命令：多条批量字符串组成的数组（客户端库的格式），或者内联命令；
+// 单个参数超过 max_bulk 字节时按协议错误处理
+int resp_parse_command(const char *data, size_t length, size_t max_bulk, RespCommand *command);
+bool resp_arg_equals(KVKey arg, const char *name); // 命令名比较，不区分大小写
+bool resp_arg_to_integer(KVKey arg, long long *value); // 十进制整数参数（最多 18 位），格式错误时返回 false
+
+// 应答编码：追加到输出队列，内存不足时返回 false
+bool resp_write_simple(OutQueue *queue, const char *text);   // "+text\r\n"
+bool resp_write_error(OutQueue *queue, const char *message); // "-message\r\n"
+bool resp_write_integer(OutQueue *queue, long long value);   // ":value\r\n"
+bool resp_write_array(OutQueue *queue, size_t count);        // 数组头 "*count\r\n"，随后写入 count 个元素
+bool resp_write_bulk(OutQueue *queue, KVValue *value);       // 值以引用方式排队；NULL 写入空值 "$-1\r\n"
+bool resp_write_bulk_data(OutQueue *queue, const char *data, size_t length);
+
+#endif // RESP_PROTOCOL_H
@@ -0,0 +1,63 @@
+#ifndef SERVER_INTERNAL_H
+#define SERVER_INTERNAL_H
+
+#include "kqueue_net.h"
+#include "kv_store.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 服务器内部各模块之间调用的函数，只在服务器的源文件中使用：
+// kqueue_net.c 负责反应器、连接和输入的分帧，shard_ops.c 在本线程拥有的分片上执行存储操作，
+// http_api.c 和 resp_commands.c 按协议分派请求并写入响应，persistence.c 负责日志的组提交和反应器暂停
+
+// 字符串字面量作为响应体：长度在编译期确定
+#define RESPONSE_TEXT(text) text, sizeof(text) - 1
+
+// 过期时刻距现在的毫秒数，已到期（应答途中）时为 0
+static inline uint64_t remaining_ms(uint64_t expire_ms) {
+    uint64_t now = kv_now_ms();
+    return expire_ms > now ? expire_ms - now : 0;
+}
+
+// kqueue_net.c：连接和反应器的缓冲区
+bool client_write(ClientConnection *client, const char *data, size_t length);
+bool client_keep_alive(Reactor *reactor, ClientConnection *client, bool requested);
+bool reactor_reserve_args(Reactor *reactor, size_t count);
+
+// shard_ops.c：分片上的存储操作和跨分片转发
+void shard_evicted(void *arg, const HashEntry *entry);
+void execute_shard_op(Reactor *reactor, ShardMessage *message);
+ShardBatch* create_batch(Reactor *reactor, ShardOp op, const KVKey *args, size_t count, size_t stride,
+                         size_t *shard_start);
+void run_batch(Reactor *reactor, ClientConnection *client, ShardBatch *batch, const size_t *shard_start);
+void run_kv_op(Reactor *reactor, ClientConnection *client, ShardOp op, const char *key, size_t key_length,
+               KVValue *value, uint64_t expire_ms);
+
+// persistence.c：追加日志的预留、组提交和暂停屏障
+bool shard_log_reserve(Reactor *reactor, size_t key_length, size_t value_length);
+void shard_log_appended(Reactor *reactor, bool ok);
+bool reactor_log_unsynced(const Reactor *reactor);
+void reactor_pause(Reactor *reactor, unsigned epoch);
+
+// http_api.c：HTTP 请求的路由和响应，以及按连接协议选择格式的应答
+void process_http_request(Reactor *reactor, ClientConnection *client, char *request,
+                          const HttpRequest *http_req, KVValue *body);
+bool write_header(ClientConnection *client, int status_code, HttpContentType type,
+                  const char *extra, size_t content_length, bool cors);
+void write_response(ClientConnection *client, int status_code, HttpContentType type,
+                    const char *extra, const char *body, size_t body_length, bool cors);
+void write_api_response(ClientConnection *client, int status_code, const char *body, size_t body_length);
+void write_plain_response(ClientConnection *client, int status_code, const char *body, size_t body_length);
+void write_internal_error(ClientConnection *client);
+void write_log_error(ClientConnection *client);
+void write_kv_response(ClientConnection *client, const ShardMessage *message);
+void write_batch_response(ClientConnection *client, const ShardBatch *batch);
+
+// resp_commands.c：RESP 命令的分派和应答
+void process_resp_command(Reactor *reactor, ClientConnection *client, const KVKey *args, size_t argc);
+void write_resp_error(ClientConnection *client, const char *message);
+void write_resp_kv_reply(ClientConnection *client, const ShardMessage *message);
+void write_resp_batch_reply(ClientConnection *client, const ShardBatch *batch);
+
+#endif // SERVER_INTERNAL_H
@@ -0,0 +1,100 @@
+#ifndef SHARD_QUEUE_H
+#define SHARD_QUEUE_H
+
+#include "kv_store.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// 跨分片操作类型
+typedef enum {
+    SHARD_OP_GET,
+    SHARD_OP_SET,
+    SHARD_OP_DELETE,
+    SHARD_OP_EXISTS, // 只判断键是否存在，不返回值
+    SHARD_OP_TTL,    // 查询键的过期时刻，RESP 应答剩余秒数
+    SHARD_OP_PTTL,   // 同 SHARD_OP_TTL，RESP 应答剩余毫秒数
+    SHARD_OP_EXPIRE, // 修改已有键的过期时刻（0 表示取消）
+    SHARD_OP_PERSIST, // 取消过期时刻，键原来带过期时刻时成功
+    SHARD_OP_COUNT,  // 仅用于批次：统计分片中的键数
+    SHARD_OP_BATCH,  // 执行 ShardBatch 中属于本分片的一段
+    SHARD_OP_PAUSE   // 持久化线程的暂停请求，client_gen 为暂停代数，不应答
+} ShardOp;
+
+// 修改键空间的操作，追加日志不可用时被拒绝
+static inline bool shard_op_writes(ShardOp op) {
+    return op == SHARD_OP_SET || op == SHARD_OP_DELETE || op == SHARD_OP_EXPIRE || op == SHARD_OP_PERSIST;
+}
+
+// 批量操作：请求中的键按所属分片分组存放（同一分片的项连续），发给其他分片的
+// SHARD_OP_BATCH 消息只引用其中一段，各分片写入互不重叠的项；批次由发起线程创建和释放
+typedef struct ShardBatch {
+    ShardOp op;          // 每一项执行的操作（GET / SET / DELETE / EXISTS），COUNT 时没有项
+    size_t count;
+    KVKey *keys;         // 键内容在批次自己的存储中，不引用连接的读缓冲区
+    KVValue **values;    // SET 时为要写入的值，GET 执行后为查到的值的引用（不存在时为 NULL）
+    bool *ok;            // SET / DELETE / EXISTS 的执行结果
+    uint32_t *order;     // order[j] 是请求中第 j 项在上面数组中的下标
+    int pending;         // 尚未应答的分片消息数，只由发起线程访问
+    atomic_size_t total; // COUNT：各分片的键数之和，由各分片线程累加
+    atomic_bool failed;  // 有分片的追加日志不可用，写操作被拒绝或未能落盘，整个批次应答为错误
+    bool incomplete;     // 有分片的消息未能创建（内存不足），其中的项没有执行，整个批次应答为内部错误；只由发起线程访问
+} ShardBatch;
+
+// 跨分片消息：请求由发起线程创建，拥有者线程执行后原样作为应答发回
+typedef struct ShardMessage {
+    struct ShardMessage *_Atomic next; // MPSC 队列链接
+    ShardOp op;
+    bool is_reply;     // false: 待执行的请求；true: 已执行的应答
+    bool ok;           // 执行结果
+    bool failed;       // 写操作因追加日志不可用被拒绝或未能落盘，应答为错误
+    int origin;        // 发起请求的 reactor 编号
+    void *client;      // 发起请求的连接
+    unsigned client_gen; // 连接代数，用于识别连接已被关闭或复用
+    char *key;         // 指向消息之后的内联存储，可以包含任意字节
+    size_t key_length;
+    KVValue *value;    // SET 的值；GET 成功时为存储中值的引用（由发起线程发送后释放）
+    uint64_t expire_ms; // SET / EXPIRE 要设置的过期时刻（Unix 毫秒，0 表示不过期）；TTL 应答时为键的过期时刻
+    ShardBatch *batch; // SHARD_OP_BATCH：由本分片执行 batch 中 [batch_start, batch_start + batch_count) 的项
+    size_t batch_start;
+    size_t batch_count;
+} ShardMessage;
+
+// 无锁多生产者单消费者队列（侵入式链表，生产者只需一次原子交换）
+typedef struct {
+    ShardMessage *_Atomic head; // 生产者端
+    ShardMessage *tail;         // 消费者端
+    ShardMessage stub;
+} ShardQueue;
+
+// 信箱：队列 + 唤醒 fd，多个生产者的通知被合并为一次写入
+typedef struct {
+    ShardQueue queue;
+    atomic_bool notified;
+    int wake_read_fd;
+    int wake_write_fd;
+} ShardMailbox;
+
+// 队列接口
+void shard_queue_init(ShardQueue *queue);
+void shard_queue_push(ShardQueue *queue, ShardMessage *message);
+ShardMessage* shard_queue_pop(ShardQueue *queue);
+
+// 信箱接口
+bool shard_mailbox_init(ShardMailbox *mailbox);
+void shard_mailbox_destroy(ShardMailbox *mailbox);
+void shard_mailbox_post(ShardMailbox *mailbox, ShardMessage *message);
+void shard_mailbox_wake(ShardMailbox *mailbox); // 无条件唤醒，可在信号处理函数中调用
+void shard_mailbox_ack(ShardMailbox *mailbox, bool drain_fd); // 消费唤醒通知，之后需取空队列
+ShardMessage* shard_mailbox_take(ShardMailbox *mailbox);
+
+// 消息辅助函数
+ShardMessage* shard_message_create(ShardOp op, const char *key, size_t key_length, KVValue *value);
+void shard_message_free(ShardMessage *message);
+
+// 批次辅助函数：数组和 key_bytes 字节的键存储在同一次分配中，*key_storage 指向键存储
+ShardBatch* shard_batch_create(ShardOp op, size_t count, size_t key_bytes, char **key_storage);
+void shard_batch_free(ShardBatch *batch);
+
+#endif // SHARD_QUEUE_H
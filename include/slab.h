@@ -0,0 +1,67 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SLAB_PAGE_SIZE (128 * 1024) // 每页大小，页按自身大小对齐，释放时由地址找到页头
+#define SLAB_MAX_OBJECT (16 * 1024) // 更大的对象直接使用 malloc
+#define SLAB_CLASS_COUNT 36         // 16..128 每 16 字节一档，之后每个 2 的幂区间分 4 档
+
+typedef struct SlabAllocator SlabAllocator;
+
+// 页头：同一页中的对象大小相同，空闲对象组成页内链表
+typedef struct SlabPage {
+    SlabAllocator *owner;
+    struct SlabPage *prev;  // 所在大小类的可用页链表
+    struct SlabPage *next;
+    struct SlabPage *all_prev; // 分配器的全部页，销毁时遍历
+    struct SlabPage *all_next;
+    void *free_list;
+    uint32_t class_index;
+    uint32_t capacity;      // 页内对象数
+    uint32_t in_use;
+    uint32_t carved;        // 已切分过的对象数，其余部分尚未使用
+    bool listed;            // 是否在可用页链表中
+} SlabPage;
+
+typedef struct {
+    SlabPage *available; // 还有空闲对象的页
+    size_t object_size;
+} SlabClass;
+
+// 内存统计：used 为存活对象按大小类取整后的字节数，requested 为调用方请求的字节数，
+// reserved 为向系统申请的字节数（页 + 大对象）
+typedef struct {
+    size_t requested_bytes;
+    size_t used_bytes;
+    size_t reserved_bytes;
+} SlabStats;
+
+// 按大小类分配的 slab 分配器，归一个线程（反应器）所有；
+// 其他线程释放的对象先进入无锁的远程释放栈，由所有者线程在下次分配时或每轮事件循环中回收
+struct SlabAllocator {
+    SlabClass classes[SLAB_CLASS_COUNT];
+    SlabPage *pages;
+    void *_Atomic remote_free;
+    pthread_t owner_thread;
+    bool owner_set;
+    // 统计只由所有者线程修改（大对象除外），其他线程可以随时读取
+    atomic_size_t requested_bytes;
+    atomic_size_t used_bytes;
+    atomic_size_t reserved_bytes;
+    atomic_size_t large_bytes; // 大对象可能在任意线程释放，使用原子加减
+};
+
+SlabAllocator* slab_create(void);
+void slab_destroy(SlabAllocator *slab); // 释放所有页，调用前其他线程不能再持有对象
+void* slab_alloc(SlabAllocator *slab, size_t size);
+void slab_free(void *ptr, size_t size); // size 与分配时相同，可以在任意线程调用
+void slab_drain_remote(SlabAllocator *slab); // 回收远程释放栈中的对象，只能在所有者线程调用
+void slab_stats(SlabAllocator *slab, SlabStats *stats);
+size_t slab_object_size(size_t size); // 分配 size 字节实际占用的字节数（按大小类取整，与 used_bytes 的计法相同）
+
+#endif // SLAB_H
@@ -0,0 +1,115 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "kv_store.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 快照文件：某一时刻全部分片的数据，按本机字节序（小端）存储。布局：
+//   SnapshotHeader | SnapshotSection × shard_count | 各分片的记录区和哈希索引
+// 每条记录为 SnapshotRecord 加键和值，按 8 字节对齐；每个分片的记录区单独校验（CRC32C），
+// 每条记录也带自己的 CRC32C。带过期时刻的键保存绝对时刻，加载时已过期的跳过。记录区之后是该分片的开放寻址索引，文件映射后可以直接查找，
+// 启动时不必把所有键插入内存存储（见 SnapshotShard）
+
+#define SNAPSHOT_MAGIC "CXSNAPSH"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_ALIGN 8
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t shard_count;
+    uint64_t created_ms;  // 快照时刻（Unix 毫秒）
+    uint64_t key_count;
+    uint32_t reserved;
+    uint32_t crc;         // 文件头和分区表的 CRC32C（计算时本字段为 0）
+} SnapshotHeader;
+
+typedef struct {
+    uint64_t offset;       // 记录区在文件中的偏移
+    uint64_t length;       // 记录区字节数
+    uint64_t key_count;
+    uint64_t index_offset; // 哈希索引在文件中的偏移
+    uint64_t index_slots;  // 索引槽数，2 的幂；分区为空时为 0
+    uint32_t crc;          // 记录区的 CRC32C
+    uint32_t reserved;
+} SnapshotSection;
+
+typedef struct {
+    uint64_t value_length;
+    uint64_t expire_ms;    // 过期时刻（Unix 毫秒），0 表示不过期
+    uint32_t key_length;
+    uint32_t crc;          // 过期时刻、键和值的 CRC32C
+    // 之后是键和值，整条记录补齐到 SNAPSHOT_ALIGN 字节
+} SnapshotRecord;
+
+// 索引槽：0 表示空，否则低 48 位为记录在文件中的偏移，高 16 位为键哈希（kv_hash_key）的高 16 位；
+// 槽位置由哈希的低位决定，冲突时线性探测，装载率不超过 3/4
+#define SNAPSHOT_SLOT_OFFSET_BITS 48
+#define SNAPSHOT_SLOT_OFFSET_MASK ((1ULL << SNAPSHOT_SLOT_OFFSET_BITS) - 1)
+
+// 写入进度，放在父子进程共享的内存中，由写快照的子进程更新
+typedef struct {
+    atomic_uint_fast64_t keys;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t elapsed_us; // 写完（含落盘）后设置的总用时
+} SnapshotProgress;
+
+// 映射的快照分区：直接在文件上按索引查找。修改、删除、过期或复制到内存存储的记录在位图中标记为失效，
+// 之后的查找不再返回它；cursor 按文件顺序记录后台合并的进度
+typedef struct {
+    const unsigned char *data;    // 整个文件的只读映射
+    size_t size;
+    const unsigned char *records; // 本分区的记录区
+    uint64_t records_length;
+    const uint64_t *index;
+    uint64_t index_mask;          // 索引槽数减一
+    uint8_t *dropped;             // 按索引槽编号的失效位图
+    size_t live;                  // 尚未失效的记录数
+    uint64_t cursor;              // 下一条待合并记录在记录区中的偏移
+    size_t corrupt;               // 校验失败而被跳过的记录数
+} SnapshotShard;
+
+// 每个分区的数据来源：内存存储，加上尚未合并完的映射分区（可以为 NULL）
+typedef struct {
+    KVStore *store;
+    const SnapshotShard *base;
+} SnapshotSource;
+
+// 把 sources[0..count) 写入 path（先写 path.tmp，落盘后改名），progress 可以为 NULL
+bool snapshot_write(const char *path, const SnapshotSource *sources, int count, SnapshotProgress *progress);
+
+// 只读映射的快照文件，文件头和分区表已校验
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const SnapshotHeader *header;
+    const SnapshotSection *sections;
+} SnapshotFile;
+
+bool snapshot_open(SnapshotFile *file, const char *path); // 文件不存在或格式错误时返回 false
+void snapshot_close(SnapshotFile *file);
+// 校验第 section 个分区后对其中每条记录调用 visit，返回 false 时停止；校验失败时返回 false
+typedef bool (*SnapshotVisitFn)(void *arg, const char *key, size_t key_length, const char *value,
+                                size_t value_length, uint64_t expire_ms);
+bool snapshot_visit_section(const SnapshotFile *file, uint32_t section, SnapshotVisitFn visit, void *arg);
+
+// 映射 path 中的第 section 个分区；文件的分区数不等于 shard_count、文件不存在或格式错误时返回 false。
+// 为了秒级启动，打开时只校验文件头和分区表，记录在读取时逐条校验
+bool snapshot_shard_open(SnapshotShard *shard, const char *path, uint32_t section, uint32_t shard_count);
+void snapshot_shard_close(SnapshotShard *shard);
+// 查找未失效的键，返回索引槽号，不存在或已过期时返回 -1；value 不为 NULL 时校验记录并给出值（指向映射），
+// expire_ms 不为 NULL 时给出过期时刻
+int64_t snapshot_shard_find(SnapshotShard *shard, const char *key, size_t key_length, const char **value,
+                            size_t *value_length, uint64_t *expire_ms);
+void snapshot_shard_drop(SnapshotShard *shard, int64_t slot); // 标记为失效
+// 按文件顺序取出下一条未失效且未过期的记录并推进合并进度，没有更多记录时返回 -1
+int64_t snapshot_shard_next(SnapshotShard *shard, const char **key, size_t *key_length, const char **value,
+                            size_t *value_length, uint64_t *expire_ms);
+bool snapshot_shard_merging(const SnapshotShard *shard); // 合并进度尚未到达记录区末尾
+// 对每条未失效、未过期且校验通过的记录调用 visit，返回 false 时停止
+void snapshot_shard_foreach(const SnapshotShard *shard, SnapshotVisitFn visit, void *arg);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,50 @@
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include "kv_store.h"
+#include "http_parser.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define STATIC_ROOT "web"                          // 静态文件目录，相对于工作目录
+#define STATIC_MAX_FILE_SIZE (4UL * 1024 * 1024)   // 超过该大小的文件不缓存，响应 404
+#define STATIC_RECHECK_INTERVAL 1                  // 两次 stat 检查文件是否修改的最小间隔（秒）
+#define STATIC_MAX_NAME 255
+
+// 文件的一种表示：原文件，或者旁边预压缩的 <name>.gz
+typedef struct {
+    KVValue *body;       // 文件内容，发送时以引用方式进入输出队列；为 NULL 表示没有这种表示
+    char etag[80];       // 带引号的强实体标签，由 inode、修改时间（含纳秒）和大小生成
+    char headers[192];   // 响应中的额外头部行：ETag、Cache-Control、Vary，gzip 表示另有 Content-Encoding
+    struct timespec mtime;
+    off_t size;
+    ino_t inode;
+} StaticVariant;
+
+typedef struct StaticAsset {
+    char name[STATIC_MAX_NAME + 1]; // 相对 STATIC_ROOT 的路径
+    HttpContentType type;
+    StaticVariant identity;
+    StaticVariant gzip;
+    time_t checked_at;              // 上次 stat 的时间
+    struct StaticAsset *next;
+} StaticAsset;
+
+// 每个反应器一份，只由所属线程访问；文件首次请求时加载，之后按修改时间重新加载
+typedef struct {
+    SlabAllocator *slab;
+    StaticAsset *assets;
+} StaticCache;
+
+void static_cache_init(StaticCache *cache, SlabAllocator *slab);
+void static_cache_destroy(StaticCache *cache);
+// name 为空或以 '/' 结尾时映射到目录下的 index.html；不合法的路径、不存在或不可读的文件返回 NULL
+const StaticAsset* static_cache_lookup(StaticCache *cache, const char *name, size_t length);
+// 按客户端是否接受 gzip 选择表示
+const StaticVariant* static_asset_variant(const StaticAsset *asset, bool accept_gzip);
+// If-None-Match 中的任一实体标签（弱比较）与该表示相同，或者为 "*" 时返回 true
+bool static_variant_matches(const StaticVariant *variant, HttpSpan if_none_match);
+
+#endif // STATIC_CACHE_H
@@ -0,0 +1,46 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 分层时间轮：TIMER_WHEEL_LEVELS 层，每层 TIMER_WHEEL_SLOTS 个槽，第 l 层的一个槽覆盖 64^l 个刻度。
+// 定时器按到期刻度与当前刻度的距离放入最低的能容纳它的一层，时间推进到高层某个槽的起点时，
+// 槽中的定时器下放（cascade）到更低的层。添加和删除为 O(1)；推进时直接跳到下一个非空的槽，
+// 空闲期间不逐个刻度空转，到期和下放的工作量由调用方的预算限制，可以分多轮完成
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 6          // 覆盖 2^36 个刻度，更远的定时器先放在最高层，下放时重新计算
+#define TIMER_WHEEL_NEVER UINT64_MAX
+
+// 定时器节点，嵌入到使用者的结构中；初始化为全零表示不在时间轮中
+typedef struct TimerNode {
+    struct TimerNode *prev;
+    struct TimerNode *next;
+    uint64_t expire; // 到期刻度
+} TimerNode;
+
+typedef struct {
+    TimerNode slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // 循环链表的哨兵
+    uint64_t occupied[TIMER_WHEEL_LEVELS]; // 可能非空的槽：删除定时器时不更新，扫描到空槽时再清除
+    TimerNode cascading; // 已到达起点、尚未下放完的高层槽中的定时器
+    uint64_t now;        // 当前刻度，它的槽中的定时器都已到期
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now);
+// 添加或重新设置定时器；早于当前刻度的按当前刻度处理，下一次推进时到期
+void timer_wheel_add(TimerWheel *wheel, TimerNode *node, uint64_t expire);
+void timer_wheel_remove(TimerNode *node); // 不在时间轮中时什么也不做
+static inline bool timer_wheel_pending(const TimerNode *node) {
+    return node->next != NULL;
+}
+
+// 推进到 now 并取出一个到期的定时器（已从时间轮移除），没有到期的定时器或预算用完时返回 NULL。
+// 取出的定时器和下放的定时器各消耗一个预算
+TimerNode* timer_wheel_expire(TimerWheel *wheel, uint64_t now, size_t *budget);
+// 下一次需要推进的刻度（有定时器到期或需要下放），没有定时器时返回 TIMER_WHEEL_NEVER
+uint64_t timer_wheel_next(TimerWheel *wheel);
+
+#endif // TIMER_WHEEL_H
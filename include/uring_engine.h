@@ -0,0 +1,15 @@
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include "kqueue_net.h"
+#include <stdbool.h>
+
+#define URING_ENTRIES 1024   // 提交队列深度
+#define URING_BUF_COUNT 1024 // 提供给内核的接收缓冲区数量
+#define URING_BUF_GROUP 1    // 接收缓冲区组 ID
+
+// 在反应器线程上运行 io_uring 引擎（multishot accept + 内核选择缓冲区的 recv + 每连接单个在途 send）
+// 初始化失败时返回 false，调用方可以回退到就绪通知事件循环
+bool uring_engine_run(Reactor *reactor);
+
+#endif // URING_ENGINE_H
@@ -0,0 +1,10 @@
+#ifndef C_X_VERSION_H
+#define C_X_VERSION_H
+
+#define C_X_VERSION_MAJOR 0
+#define C_X_VERSION_MINOR 1
+#define C_X_VERSION_PATCH 0
+#define C_X_VERSION "0.1.0"
+
+#endif /* C_X_VERSION_H */
+
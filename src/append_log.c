@@ -0,0 +1,316 @@
+#include "append_log.h"
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define APPEND_LOG_INITIAL_BUFFER (64 * 1024)
+
+// CRC32C（Castagnoli）：x86 上 CPU 支持 SSE4.2 时使用 crc32 指令，否则按 8 字节一组查表
+static uint32_t crc_table[8][256];
+static uint32_t (*crc_impl)(uint32_t crc, const unsigned char *p, size_t length);
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static uint32_t crc32c_table(uint32_t crc, const unsigned char *p, size_t length) {
+    while (length > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        word ^= crc;
+        crc = crc_table[7][word & 0xFF] ^ crc_table[6][(word >> 8) & 0xFF] ^
+              crc_table[5][(word >> 16) & 0xFF] ^ crc_table[4][(word >> 24) & 0xFF] ^
+              crc_table[3][(word >> 32) & 0xFF] ^ crc_table[2][(word >> 40) & 0xFF] ^
+              crc_table[1][(word >> 48) & 0xFF] ^ crc_table[0][word >> 56];
+        p += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *p, size_t length) {
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    uint32_t crc32 = (uint32_t)crc64;
+    while (length > 0) {
+        crc32 = __builtin_ia32_crc32qi(crc32, *p++);
+        length--;
+    }
+    return crc32;
+}
+#endif
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0x82F63B78U & (0U - (crc & 1)));
+        }
+        crc_table[0][i] = crc;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            crc_table[k][i] = crc_table[0][crc_table[k - 1][i] & 0xFF] ^ (crc_table[k - 1][i] >> 8);
+        }
+    }
+    crc_impl = crc32c_table;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_impl = crc32c_sse42;
+    }
+#endif
+}
+
+uint32_t append_log_crc32c(uint32_t crc, const void *data, size_t length) {
+    pthread_once(&crc_once, crc_init);
+    return ~crc_impl(~crc, data, length);
+}
+
+void append_log_init(AppendLog *log) {
+    log->fd = -1;
+    log->buf = NULL;
+    log->len = 0;
+    log->cap = 0;
+    atomic_init(&log->written, 0);
+    log->write_failed = false;
+}
+
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+int append_log_create_file(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return -1;
+    if (!write_all(fd, APPEND_LOG_MAGIC, APPEND_LOG_HEADER_SIZE)) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+bool append_log_open(AppendLog *log, const char *path) {
+    int fd = append_log_create_file(path);
+    if (fd == -1) return false;
+    log->fd = fd;
+    atomic_store_explicit(&log->written, APPEND_LOG_HEADER_SIZE, memory_order_relaxed);
+    return true;
+}
+
+int append_log_swap(AppendLog *log, int fd) {
+    int old_fd = log->fd;
+    log->fd = fd;
+    atomic_store_explicit(&log->written, APPEND_LOG_HEADER_SIZE, memory_order_relaxed);
+    return old_fd;
+}
+
+void append_log_close(AppendLog *log) {
+    if (log->fd == -1) return;
+    append_log_write(log);
+    close(log->fd);
+    log->fd = -1;
+}
+
+void append_log_free(AppendLog *log) {
+    append_log_close(log);
+    free(log->buf);
+    log->buf = NULL;
+    log->len = 0;
+    log->cap = 0;
+}
+
+static size_t put_varint(unsigned char *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// 读取 varint，数据不足或超过 10 字节时返回 0
+static size_t get_varint(const unsigned char *p, const unsigned char *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < 10 && p + i < end; i++) {
+        result |= (uint64_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool append_log_reserve(AppendLog *log, size_t bytes) {
+    if (log->cap - log->len >= bytes) return true;
+    size_t new_cap = log->cap > 0 ? log->cap * 2 : APPEND_LOG_INITIAL_BUFFER;
+    while (new_cap - log->len < bytes) {
+        new_cap *= 2;
+    }
+    char *buf = realloc(log->buf, new_cap);
+    if (!buf) return false;
+    log->buf = buf;
+    log->cap = new_cap;
+    return true;
+}
+
+static bool append_record(AppendLog *log, AppendLogOp op, const char *key, size_t key_length,
+                          const char *value, size_t value_length) {
+    if (!append_log_reserve(log, APPEND_LOG_RECORD_MAX_OVERHEAD + key_length + value_length)) return false;
+    unsigned char *record = (unsigned char *)log->buf + log->len;
+    unsigned char *p = record + 4;
+    *p++ = (unsigned char)op;
+    p += put_varint(p, key_length);
+    if (op != APPEND_LOG_DELETE) {
+        p += put_varint(p, value_length);
+    }
+    memcpy(p, key, key_length);
+    p += key_length;
+    if (op != APPEND_LOG_DELETE) {
+        memcpy(p, value, value_length);
+        p += value_length;
+    }
+    uint32_t crc = append_log_crc32c(0, record + 4, (size_t)(p - record - 4));
+    record[0] = (unsigned char)crc;
+    record[1] = (unsigned char)(crc >> 8);
+    record[2] = (unsigned char)(crc >> 16);
+    record[3] = (unsigned char)(crc >> 24);
+    log->len += (size_t)(p - record);
+    return true;
+}
+
+bool append_log_set(AppendLog *log, const char *key, size_t key_length, const char *value, size_t value_length) {
+    return append_record(log, APPEND_LOG_SET, key, key_length, value, value_length);
+}
+
+bool append_log_delete(AppendLog *log, const char *key, size_t key_length) {
+    return append_record(log, APPEND_LOG_DELETE, key, key_length, NULL, 0);
+}
+
+bool append_log_expire(AppendLog *log, const char *key, size_t key_length, uint64_t expire_ms) {
+    unsigned char value[8];
+    for (int i = 0; i < 8; i++) {
+        value[i] = (unsigned char)(expire_ms >> (8 * i));
+    }
+    return append_record(log, APPEND_LOG_EXPIRE, key, key_length, (const char *)value, sizeof(value));
+}
+
+uint64_t append_log_expire_time(const char *value, size_t value_length) {
+    uint64_t expire_ms = 0;
+    for (size_t i = 0; i < value_length && i < 8; i++) {
+        expire_ms |= (uint64_t)(unsigned char)value[i] << (8 * i);
+    }
+    return expire_ms;
+}
+
+bool append_log_write(AppendLog *log) {
+    if (log->fd == -1 || log->len == 0) return true;
+    size_t done = 0;
+    while (done < log->len) {
+        ssize_t n = write(log->fd, log->buf + done, log->len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // 已写入的部分从缓冲区移除，剩余的下一轮重试
+            if (!log->write_failed) {
+                LOG_ERROR("追加日志写入失败: %s", strerror(errno));
+                log->write_failed = true;
+            }
+            memmove(log->buf, log->buf + done, log->len - done);
+            log->len -= done;
+            atomic_fetch_add_explicit(&log->written, done, memory_order_relaxed);
+            return false;
+        }
+        done += (size_t)n;
+    }
+    atomic_fetch_add_explicit(&log->written, done, memory_order_relaxed);
+    log->len = 0;
+    if (log->write_failed) {
+        LOG_INFO("追加日志恢复写入");
+        log->write_failed = false;
+    }
+    return true;
+}
+
+bool append_log_replay(const char *path, AppendLogVisitFn visit, void *arg, uint64_t *valid_bytes,
+                       uint64_t *file_size) {
+    *valid_bytes = 0;
+    *file_size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (uint64_t)st.st_size < APPEND_LOG_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    *file_size = size;
+    const unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    if (memcmp(data, APPEND_LOG_MAGIC, APPEND_LOG_HEADER_SIZE) != 0) {
+        munmap((void *)data, size);
+        return false;
+    }
+    madvise((void *)data, size, MADV_SEQUENTIAL);
+
+    const unsigned char *p = data + APPEND_LOG_HEADER_SIZE;
+    const unsigned char *end = data + size;
+    while (p < end) {
+        if (end - p < 6) break;
+        const unsigned char *q = p + 4;
+        unsigned op = *q++;
+        if (op != APPEND_LOG_SET && op != APPEND_LOG_DELETE && op != APPEND_LOG_EXPIRE) break;
+        uint64_t key_length, value_length = 0;
+        size_t n = get_varint(q, end, &key_length);
+        if (n == 0) break;
+        q += n;
+        if (op != APPEND_LOG_DELETE) {
+            n = get_varint(q, end, &value_length);
+            if (n == 0) break;
+            q += n;
+        }
+        if (key_length > (uint64_t)(end - q) || value_length > (uint64_t)(end - q) - key_length) break;
+        const unsigned char *record_end = q + key_length + value_length;
+        uint32_t crc = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        if (append_log_crc32c(0, p + 4, (size_t)(record_end - p - 4)) != crc) break;
+        if (!visit(arg, (AppendLogOp)op, (const char *)q, (size_t)key_length,
+                   (const char *)q + key_length, (size_t)value_length)) {
+            break;
+        }
+        p = record_end;
+    }
+    *valid_bytes = (uint64_t)(p - data);
+    munmap((void *)data, size);
+    return true;
+}
@@ -0,0 +1,124 @@
+#include "event_loop.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// epoll 的 data 字段只能保存 fd 或指针之一，这里按 fd 索引保存用户数据
+struct EventLoop {
+    int epoll_fd;
+    struct epoll_event *fired;
+    int max_events;
+    void **data_by_fd;
+    size_t data_capacity;
+};
+
+static bool reserve_data_slot(EventLoop *loop, int fd) {
+    if ((size_t)fd < loop->data_capacity) return true;
+    size_t new_capacity = loop->data_capacity ? loop->data_capacity : 1024;
+    while (new_capacity <= (size_t)fd) {
+        new_capacity *= 2;
+    }
+    void **new_data = realloc(loop->data_by_fd, new_capacity * sizeof(void *));
+    if (!new_data) return false;
+    memset(new_data + loop->data_capacity, 0, (new_capacity - loop->data_capacity) * sizeof(void *));
+    loop->data_by_fd = new_data;
+    loop->data_capacity = new_capacity;
+    return true;
+}
+
+static uint32_t to_epoll_events(int events) {
+    uint32_t mask = 0;
+    if (events & EVENT_READ) mask |= EPOLLIN | EPOLLRDHUP;
+    if (events & EVENT_WRITE) mask |= EPOLLOUT;
+    if (events & EVENT_EDGE) mask |= EPOLLET;
+    return mask;
+}
+
+EventLoop* event_loop_create(int max_events) {
+    if (max_events <= 0) return NULL;
+    EventLoop *loop = calloc(1, sizeof(EventLoop));
+    if (!loop) return NULL;
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd == -1) {
+        free(loop);
+        return NULL;
+    }
+    loop->fired = calloc(max_events, sizeof(struct epoll_event));
+    if (!loop->fired) {
+        close(loop->epoll_fd);
+        free(loop);
+        return NULL;
+    }
+    loop->max_events = max_events;
+    return loop;
+}
+
+void event_loop_destroy(EventLoop *loop) {
+    if (!loop) return;
+    close(loop->epoll_fd);
+    free(loop->fired);
+    free(loop->data_by_fd);
+    free(loop);
+}
+
+static bool epoll_apply(EventLoop *loop, int op, int fd, int events, void *data) {
+    if (!loop || fd < 0) return false;
+    if (!reserve_data_slot(loop, fd)) return false;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = to_epoll_events(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epoll_fd, op, fd, &ev) == -1) return false;
+    loop->data_by_fd[fd] = data;
+    return true;
+}
+
+bool event_loop_add(EventLoop *loop, int fd, int events, void *data) {
+    return epoll_apply(loop, EPOLL_CTL_ADD, fd, events, data);
+}
+
+bool event_loop_modify(EventLoop *loop, int fd, int events, void *data) {
+    return epoll_apply(loop, EPOLL_CTL_MOD, fd, events, data);
+}
+
+bool event_loop_delete(EventLoop *loop, int fd) {
+    if (!loop || fd < 0) return false;
+    if ((size_t)fd < loop->data_capacity) {
+        loop->data_by_fd[fd] = NULL;
+    }
+    // 关闭 fd 时内核会自动移除，这里的 ENOENT/EBADF 不算错误
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
+        return errno == ENOENT || errno == EBADF;
+    }
+    return true;
+}
+
+int event_loop_wait(EventLoop *loop, LoopEvent *events, int max_events, int timeout_ms) {
+    if (!loop || !events || max_events <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (max_events > loop->max_events) {
+        max_events = loop->max_events;
+    }
+    int count = epoll_wait(loop->epoll_fd, loop->fired, max_events, timeout_ms < 0 ? -1 : timeout_ms);
+    if (count == -1) return -1;
+    for (int i = 0; i < count; i++) {
+        uint32_t mask = loop->fired[i].events;
+        int fd = loop->fired[i].data.fd;
+        events[i].fd = fd;
+        events[i].events = 0;
+        if (mask & EPOLLIN) events[i].events |= EVENT_READ;
+        if (mask & EPOLLOUT) events[i].events |= EVENT_WRITE;
+        if (mask & (EPOLLRDHUP | EPOLLHUP)) events[i].events |= EVENT_EOF;
+        if (mask & EPOLLERR) events[i].events |= EVENT_ERROR;
+        events[i].data = (size_t)fd < loop->data_capacity ? loop->data_by_fd[fd] : NULL;
+    }
+    return count;
+}
+
+const char* event_loop_backend(void) {
+    return "epoll";
+}
@@ -0,0 +1,114 @@
+#include "event_loop.h"
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct EventLoop {
+    int kqueue_fd;
+    struct kevent *fired;
+    int max_events;
+};
+
+EventLoop* event_loop_create(int max_events) {
+    if (max_events <= 0) return NULL;
+    EventLoop *loop = calloc(1, sizeof(EventLoop));
+    if (!loop) return NULL;
+    loop->kqueue_fd = kqueue();
+    if (loop->kqueue_fd == -1) {
+        free(loop);
+        return NULL;
+    }
+    loop->fired = calloc(max_events, sizeof(struct kevent));
+    if (!loop->fired) {
+        close(loop->kqueue_fd);
+        free(loop);
+        return NULL;
+    }
+    loop->max_events = max_events;
+    return loop;
+}
+
+void event_loop_destroy(EventLoop *loop) {
+    if (!loop) return;
+    close(loop->kqueue_fd);
+    free(loop->fired);
+    free(loop);
+}
+
+// kqueue 按过滤器注册：读写各对应一个 EVFILT，未关注的过滤器执行删除
+static bool kqueue_apply(EventLoop *loop, int fd, int events, void *data, bool allow_missing) {
+    if (!loop || fd < 0) return false;
+    unsigned short clear = (events & EVENT_EDGE) ? EV_CLEAR : 0;
+    struct kevent changes[2];
+    struct kevent results[2];
+    EV_SET(&changes[0], fd, EVFILT_READ,
+           (events & EVENT_READ) ? (EV_ADD | EV_ENABLE | clear | EV_RECEIPT) : (EV_DELETE | EV_RECEIPT),
+           0, 0, data);
+    EV_SET(&changes[1], fd, EVFILT_WRITE,
+           (events & EVENT_WRITE) ? (EV_ADD | EV_ENABLE | clear | EV_RECEIPT) : (EV_DELETE | EV_RECEIPT),
+           0, 0, data);
+    // EV_RECEIPT 让每个变更都返回一条结果，一次系统调用完成读写两个过滤器的更新
+    int n = kevent(loop->kqueue_fd, changes, 2, results, 2, NULL);
+    if (n == -1) return false;
+    for (int i = 0; i < n; i++) {
+        if ((results[i].flags & EV_ERROR) && results[i].data != 0) {
+            // 删除一个从未注册过的过滤器不算错误
+            if (results[i].data == ENOENT && (allow_missing || !(changes[i].flags & EV_ADD))) {
+                continue;
+            }
+            errno = (int)results[i].data;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool event_loop_add(EventLoop *loop, int fd, int events, void *data) {
+    return kqueue_apply(loop, fd, events, data, false);
+}
+
+bool event_loop_modify(EventLoop *loop, int fd, int events, void *data) {
+    return kqueue_apply(loop, fd, events, data, true);
+}
+
+bool event_loop_delete(EventLoop *loop, int fd) {
+    return kqueue_apply(loop, fd, 0, NULL, true);
+}
+
+int event_loop_wait(EventLoop *loop, LoopEvent *events, int max_events, int timeout_ms) {
+    if (!loop || !events || max_events <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (max_events > loop->max_events) {
+        max_events = loop->max_events;
+    }
+    struct timespec timeout;
+    struct timespec *timeout_ptr = NULL;
+    if (timeout_ms >= 0) {
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+        timeout_ptr = &timeout;
+    }
+    int count = kevent(loop->kqueue_fd, NULL, 0, loop->fired, max_events, timeout_ptr);
+    if (count == -1) return -1;
+    for (int i = 0; i < count; i++) {
+        struct kevent *kev = &loop->fired[i];
+        events[i].fd = (int)kev->ident;
+        events[i].events = 0;
+        if (kev->filter == EVFILT_READ) events[i].events |= EVENT_READ;
+        if (kev->filter == EVFILT_WRITE) events[i].events |= EVENT_WRITE;
+        if (kev->flags & EV_EOF) events[i].events |= EVENT_EOF;
+        if (kev->flags & EV_ERROR) events[i].events |= EVENT_ERROR;
+        events[i].data = kev->udata;
+    }
+    return count;
+}
+
+const char* event_loop_backend(void) {
+    return "kqueue";
+}
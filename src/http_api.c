@@ -0,0 +1,560 @@
+#include "server_internal.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// 按模板把响应头直接写进连接的输出缓冲区，不经过临时缓冲区，也不分配内存（缓冲区容量足够时）
+bool write_header(ClientConnection *client, int status_code, HttpContentType type,
+                  const char *extra, size_t content_length, bool cors) {
+    metric_add(&client->metrics->http_responses[client->method][metric_http_code_index(status_code)], 1);
+    char *header = out_queue_reserve(&client->out, HTTP_HEADER_MAX);
+    if (!header) return false;
+    size_t header_len = http_write_header(header, HTTP_HEADER_MAX, status_code, type, extra,
+                                          content_length, client->keep_alive, cors);
+    return header_len > 0 && out_queue_commit(&client->out, header_len);
+}
+
+// 写入完整响应：响应头和响应体依次追加到输出缓冲区
+void write_response(ClientConnection *client, int status_code, HttpContentType type,
+                    const char *extra, const char *body, size_t body_length, bool cors) {
+    LOG_DEBUG("发送响应，状态码: %d，响应体长度: %zu", status_code, body_length);
+    if (write_header(client, status_code, type, extra, body_length, cors)) {
+        client_write(client, body, body_length);
+    }
+}
+
+// 写入带 CORS 头部的 API 响应
+void write_api_response(ClientConnection *client, int status_code, const char *body, size_t body_length) {
+    write_response(client, status_code, HTTP_CONTENT_TEXT, NULL, body, body_length, true);
+}
+
+// 写入不带 CORS 头部的纯文本响应（错误和未匹配的路径）
+void write_plain_response(ClientConnection *client, int status_code, const char *body, size_t body_length) {
+    write_response(client, status_code, HTTP_CONTENT_TEXT, NULL, body, body_length, false);
+}
+
+// 写入 GET 命中的响应：响应头进入输出缓冲区，值以引用方式排队，由 writev/sendmsg 直接发送
+static void write_value_response(ClientConnection *client, KVValue *value) {
+    LOG_DEBUG("发送响应，状态码: 200，响应体长度: %zu", value->length);
+    if (write_header(client, 200, HTTP_CONTENT_TEXT, NULL, value->length, true)) {
+        out_queue_append_value(&client->out, value);
+    }
+}
+
+// 内部错误（内存不足）的响应
+void write_internal_error(ClientConnection *client) {
+    if (client->protocol == CLIENT_PROTOCOL_RESP) {
+        write_resp_error(client, "ERR out of memory");
+    } else {
+        write_api_response(client, 500, RESPONSE_TEXT("Internal Server Error"));
+    }
+}
+
+// 写操作因追加日志不可用被拒绝或未能落盘时的响应
+void write_log_error(ClientConnection *client) {
+    if (client->protocol == CLIENT_PROTOCOL_RESP) {
+        write_resp_error(client, "MISCONF append log is not writable, write commands are disabled");
+    } else {
+        write_api_response(client, 500, RESPONSE_TEXT("Append log unavailable"));
+    }
+}
+
+// 把 KV 操作结果转换为连接所用协议的响应
+void write_kv_response(ClientConnection *client, const ShardMessage *message) {
+    if (message->failed) {
+        write_log_error(client);
+        return;
+    }
+    if (client->protocol == CLIENT_PROTOCOL_RESP) {
+        write_resp_kv_reply(client, message);
+        return;
+    }
+    switch (message->op) {
+        case SHARD_OP_GET:
+            if (message->ok) {
+                LOG_DEBUG("GET 成功，值: '%.*s%s'", (int)(message->value->length > 50 ? 50 : message->value->length),
+                            message->value->data, message->value->length > 50 ? "..." : "");
+                write_value_response(client, message->value);
+            } else {
+                LOG_DEBUG("GET 失败，键不存在");
+                write_api_response(client, 404, RESPONSE_TEXT("Key not found"));
+            }
+            break;
+        case SHARD_OP_SET:
+            if (message->ok) {
+                LOG_DEBUG("POST 成功");
+                write_api_response(client, 201, RESPONSE_TEXT("Created"));
+            } else {
+                LOG_DEBUG("POST 失败，内部错误");
+                write_api_response(client, 500, RESPONSE_TEXT("Internal Server Error"));
+            }
+            break;
+        case SHARD_OP_DELETE:
+            if (message->ok) {
+                LOG_DEBUG("DELETE 成功");
+                write_api_response(client, 204, RESPONSE_TEXT(""));
+            } else {
+                LOG_DEBUG("DELETE 失败，键不存在");
+                write_api_response(client, 404, RESPONSE_TEXT("Key not found"));
+            }
+            break;
+        case SHARD_OP_TTL:
+        case SHARD_OP_PTTL:
+            if (message->ok) {
+                // 剩余毫秒数，不过期时为 -1
+                char json[48];
+                int json_len = snprintf(json, sizeof(json), "{\"ttl_ms\":%lld}",
+                                        message->expire_ms == 0 ? -1LL : (long long)remaining_ms(message->expire_ms));
+                write_response(client, 200, HTTP_CONTENT_JSON, NULL, json, (size_t)json_len, true);
+            } else {
+                write_api_response(client, 404, RESPONSE_TEXT("Key not found"));
+            }
+            break;
+        case SHARD_OP_EXPIRE:
+        case SHARD_OP_PERSIST:
+            if (message->ok) {
+                LOG_DEBUG("修改过期时间成功");
+                write_api_response(client, 204, RESPONSE_TEXT(""));
+            } else {
+                LOG_DEBUG("修改过期时间失败，键不存在");
+                write_api_response(client, 404, RESPONSE_TEXT("Key not found"));
+            }
+            break;
+        case SHARD_OP_EXISTS:
+        case SHARD_OP_COUNT:
+        case SHARD_OP_BATCH:
+        case SHARD_OP_PAUSE:
+            break;
+    }
+}
+
+// 批量请求的响应：/batch/get 按请求顺序返回每个键的值（netstring，不存在时为 "-,"），
+// 值以引用方式排队；/batch/set 和 /batch/delete 返回成功的项数。有分片未能执行时整个批次应答为错误
+void write_batch_response(ClientConnection *client, const ShardBatch *batch) {
+    if (batch->incomplete) {
+        write_internal_error(client);
+        return;
+    }
+    if (atomic_load_explicit(&batch->failed, memory_order_relaxed)) {
+        write_log_error(client);
+        return;
+    }
+    if (client->protocol == CLIENT_PROTOCOL_RESP) {
+        write_resp_batch_reply(client, batch);
+        return;
+    }
+    if (batch->op != SHARD_OP_GET) {
+        size_t done = 0;
+        for (size_t i = 0; i < batch->count; i++) {
+            done += batch->ok[i];
+        }
+        char text[24];
+        int text_len = snprintf(text, sizeof(text), "%zu", done);
+        LOG_DEBUG("批量操作完成 %zu/%zu 项", done, batch->count);
+        write_api_response(client, 200, text, (size_t)text_len);
+        return;
+    }
+
+    char prefix[24];
+    size_t length = 0;
+    for (size_t j = 0; j < batch->count; j++) {
+        const KVValue *value = batch->values[batch->order[j]];
+        length += value ? (size_t)snprintf(prefix, sizeof(prefix), "%zu:", value->length) + value->length + 1 : 2;
+    }
+    LOG_DEBUG("批量读取 %zu 个键，响应体长度: %zu", batch->count, length);
+    if (!write_header(client, 200, HTTP_CONTENT_BINARY, NULL, length, true)) return;
+    for (size_t j = 0; j < batch->count; j++) {
+        KVValue *value = batch->values[batch->order[j]];
+        if (!value) {
+            client_write(client, "-,", 2);
+            continue;
+        }
+        int prefix_len = snprintf(prefix, sizeof(prefix), "%zu:", value->length);
+        client_write(client, prefix, (size_t)prefix_len);
+        out_queue_append_value(&client->out, value);
+        client_write(client, ",", 1);
+    }
+}
+
+// 静态文件从反应器的缓存发送，文件内容以引用方式进入输出队列，不复制也不读盘；
+// "/web" 和 "/web/" 映射到 index.html，"/web/<name>" 映射到 web/<name>，查询串忽略
+static void serve_static_file(Reactor *reactor, ClientConnection *client, const HttpRequest *http_req) {
+    HttpSpan path = http_req->path;
+    const char *query = memchr(path.data, '?', path.length);
+    if (query) path.length = (size_t)(query - path.data);
+    const StaticAsset *asset = NULL;
+    if (path.length == 4) {
+        asset = static_cache_lookup(&reactor->static_cache, "", 0);
+    } else if (path.data[4] == '/') {
+        asset = static_cache_lookup(&reactor->static_cache, path.data + 5, path.length - 5);
+    }
+    if (!asset) {
+        write_plain_response(client, 404, RESPONSE_TEXT("Not Found"));
+        return;
+    }
+
+    const StaticVariant *variant = static_asset_variant(asset, http_req->accept_gzip);
+    if (static_variant_matches(variant, http_req->if_none_match)) {
+        LOG_DEBUG("静态文件未修改: %s", asset->name);
+        write_header(client, 304, asset->type, variant->headers, variant->body->length, false);
+        return;
+    }
+    LOG_DEBUG("发送静态文件: %s%s，长度: %zu", asset->name, variant == &asset->gzip ? "（gzip）" : "",
+                variant->body->length);
+    if (write_header(client, 200, asset->type, variant->headers, variant->body->length, false)) {
+        out_queue_append_value(&client->out, variant->body);
+    }
+}
+
+// 读取下一个 netstring（"<长度>:<字节>,"），前面的空白字符跳过；没有更多项时 *data 为 NULL，格式错误时返回 false
+static bool next_netstring(const char **cursor, const char *end, const char **data, size_t *length) {
+    const char *p = *cursor;
+    while (p < end && (*p == ' ' || *p == '\r' || *p == '\n' || *p == '\t')) p++;
+    *data = NULL;
+    *cursor = p;
+    if (p == end) return true;
+    const char *digits = p;
+    size_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - digits < 15) {
+        value = value * 10 + (size_t)(*p - '0');
+        p++;
+    }
+    if (p == digits || p == end || *p != ':') return false;
+    p++;
+    if ((size_t)(end - p) <= value || p[value] != ',') return false;
+    *data = p;
+    *length = value;
+    *cursor = p + value + 1;
+    return true;
+}
+
+// 快照管理接口 /admin/snapshot：GET 返回快照状态，POST 请求后台写一次快照并返回 202
+static void process_snapshot_request(Reactor *reactor, ClientConnection *client, const HttpRequest *http_req) {
+    Persistence *persistence = reactor->server->persistence;
+    if (!persistence || !reactor->server->snapshot_path) {
+        write_api_response(client, 404, RESPONSE_TEXT("Snapshot not configured"));
+        return;
+    }
+    if (http_req->method != HTTP_GET && http_req->method != HTTP_POST) {
+        write_plain_response(client, 405, RESPONSE_TEXT("Method Not Allowed"));
+        return;
+    }
+    int status_code = 200;
+    if (http_req->method == HTTP_POST) {
+        persistence_request_snapshot(persistence);
+        status_code = 202;
+    }
+    char json[PERSIST_STATUS_JSON_MAX];
+    size_t length = persistence_snapshot_json(persistence, json, sizeof(json));
+    write_response(client, status_code, HTTP_CONTENT_JSON, NULL, json, length, true);
+}
+
+// Prometheus 指标，由 metrics_text_server 汇总各反应器的计数
+static void process_metrics_request(Reactor *reactor, ClientConnection *client) {
+    MetricsText text;
+    metrics_text_init(&text);
+    metrics_text_server(&text, reactor->server);
+    if (text.failed) {
+        write_internal_error(client);
+    } else {
+        write_response(client, 200, HTTP_CONTENT_TEXT, NULL, text.data, text.length, false);
+    }
+    metrics_text_free(&text);
+}
+
+// 批量 API：请求体是 netstring 序列，/batch/get 和 /batch/delete 为键，/batch/set 为键、值交替。
+// 键按所属分片分组，本分片的一段直接执行，其他分片各投递一条消息，全部应答后一次发送响应
+static void process_batch_request(Reactor *reactor, ClientConnection *client, const HttpRequest *http_req,
+                                  KVValue *body) {
+    ShardOp op;
+    if (http_span_equals(http_req->path, "/batch/get")) {
+        op = SHARD_OP_GET;
+    } else if (http_span_equals(http_req->path, "/batch/set")) {
+        op = SHARD_OP_SET;
+    } else if (http_span_equals(http_req->path, "/batch/delete")) {
+        op = SHARD_OP_DELETE;
+    } else {
+        write_plain_response(client, 404, RESPONSE_TEXT("Not Found"));
+        return;
+    }
+    if (http_req->method != HTTP_POST) {
+        write_plain_response(client, 405, RESPONSE_TEXT("Method Not Allowed"));
+        return;
+    }
+    const char *data = body ? body->data : http_req->body.data;
+    const char *end = data + (body ? body->length : http_req->body.length);
+
+    // 校验格式，把每个 netstring 的位置记入反应器的参数数组
+    size_t stride = op == SHARD_OP_SET ? 2 : 1;
+    size_t argc = 0;
+    const char *cursor = data;
+    for (;;) {
+        const char *item;
+        size_t item_length;
+        if (!next_netstring(&cursor, end, &item, &item_length)) goto bad_request;
+        if (!item) break;
+        if (item_length == 0) goto bad_request;
+        if (argc == MAX_BATCH_KEYS * stride) {
+            write_api_response(client, 400, RESPONSE_TEXT("Bad Request - Too many keys"));
+            return;
+        }
+        if (!reactor_reserve_args(reactor, argc + 1)) {
+            write_api_response(client, 500, RESPONSE_TEXT("Internal Server Error"));
+            return;
+        }
+        reactor->args[argc].data = item;
+        reactor->args[argc].length = item_length;
+        argc++;
+    }
+    if (argc == 0 || argc % stride != 0) goto bad_request;
+
+    size_t shard_start[MAX_REACTORS + 1];
+    ShardBatch *batch = create_batch(reactor, op, reactor->args, argc / stride, stride, shard_start);
+    if (!batch) {
+        write_api_response(client, 500, RESPONSE_TEXT("Internal Server Error"));
+        return;
+    }
+    run_batch(reactor, client, batch, shard_start);
+    return;
+
+bad_request:
+    write_api_response(client, 400, RESPONSE_TEXT("Bad Request - Malformed batch body"));
+}
+
+// 请求指定的存活时间：X-TTL 头部，或者 ttl 查询参数，单位为秒，最多三位小数。
+// 没有指定时 *ttl_ms 为 0；格式错误、为 0 或超过 MAX_TTL_MS 时返回 false
+static bool request_ttl(const HttpRequest *http_req, uint64_t *ttl_ms) {
+    HttpSpan text = http_req->ttl;
+    *ttl_ms = 0;
+    if (text.length == 0 && !http_query_param(http_req->query, "ttl", &text)) return true;
+    uint64_t ms = 0;
+    size_t i = 0;
+    for (; i < text.length && text.data[i] >= '0' && text.data[i] <= '9'; i++) {
+        if (i >= 10) return false;
+        ms = ms * 10 + (uint64_t)(text.data[i] - '0');
+    }
+    if (i == 0) return false;
+    int fraction = 0;
+    if (i < text.length && text.data[i] == '.') {
+        for (i++; i < text.length && fraction < 3 && text.data[i] >= '0' && text.data[i] <= '9'; i++, fraction++) {
+            ms = ms * 10 + (uint64_t)(text.data[i] - '0');
+        }
+    }
+    if (i != text.length) return false;
+    for (; fraction < 3; fraction++) {
+        ms *= 10;
+    }
+    if (ms == 0 || ms > MAX_TTL_MS) return false;
+    *ttl_ms = ms;
+    return true;
+}
+
+// 过期时间接口 /ttl/<键>：GET 返回剩余毫秒数，POST 按 X-TTL 头部或 ttl 参数重新设置，DELETE 取消过期
+static void process_ttl_request(Reactor *reactor, ClientConnection *client, char *request,
+                                const HttpRequest *http_req) {
+    if (http_req->method != HTTP_GET && http_req->method != HTTP_POST && http_req->method != HTTP_DELETE) {
+        write_plain_response(client, 405, RESPONSE_TEXT("Method Not Allowed"));
+        return;
+    }
+    // 跳过 "/ttl/" 前缀并就地解码
+    char *key = request + (http_req->path.data - request) + 5;
+    size_t key_length = http_url_decode(key, http_req->path.length - 5);
+    if (key_length == 0) {
+        write_plain_response(client, 400, RESPONSE_TEXT("Bad Request - Key cannot be empty"));
+        return;
+    }
+    if (http_req->method == HTTP_GET) {
+        run_kv_op(reactor, client, SHARD_OP_TTL, key, key_length, NULL, 0);
+        return;
+    }
+    uint64_t ttl_ms = 0;
+    if (http_req->method == HTTP_POST && (!request_ttl(http_req, &ttl_ms) || ttl_ms == 0)) {
+        write_api_response(client, 400, RESPONSE_TEXT("Bad Request - Invalid TTL"));
+        return;
+    }
+    LOG_DEBUG("修改键 '%.*s' 的过期时间，存活 %" PRIu64 " ms", (int)key_length, key, ttl_ms);
+    run_kv_op(reactor, client, SHARD_OP_EXPIRE, key, key_length, NULL, ttl_ms ? kv_now_ms() + ttl_ms : 0);
+}
+
+// http_req 的片段指向 request（本连接的读缓冲区），键在其中就地解码；
+// body 不为 NULL 时是已流式接收到值中的请求体，否则请求体是 http_req->body
+void process_http_request(Reactor *reactor, ClientConnection *client, char *request,
+                          const HttpRequest *http_req, KVValue *body) {
+    LOG_DEBUG("=== 处理 HTTP 请求 ===");
+    LOG_DEBUG("客户端 fd: %d", client->fd);
+    LOG_DEBUG("请求头长度: %zu", http_req->header_length);
+    LOG_DEBUG("请求头: %.*s", (int)(http_req->header_length > 200 ? 200 : http_req->header_length), request);
+    client->keep_alive = client_keep_alive(reactor, client, http_req->keep_alive);
+    client->method = http_req->method;
+
+    LOG_DEBUG("HTTP 请求解析成功:");
+    LOG_DEBUG("  方法: %d", http_req->method);
+    LOG_DEBUG("  路径: %.*s", (int)http_req->path.length, http_req->path.data);
+    LOG_DEBUG("  请求体长度: %zu", http_req->content_length);
+    if (!body && http_req->body.length > 0) {
+        LOG_DEBUG("  请求体: %.*s%s", (int)(http_req->body.length > 100 ? 100 : http_req->body.length),
+                    http_req->body.data, http_req->body.length > 100 ? "..." : "");
+    }
+
+    // 严格按照 HTTP 协议处理请求，只允许特定的合法操作
+
+    // 1. 处理根路径重定向 (仅 GET 方法)
+    if (http_req->method == HTTP_GET && http_span_equals(http_req->path, "/")) {
+        LOG_DEBUG("处理根路径重定向到 /web/");
+        static const char redirect_body[] = "<html><body>Redirecting to <a href=\"/web/\">/web/</a></body></html>";
+        write_response(client, 302, HTTP_CONTENT_HTML, "Location: /web/\r\n",
+                       RESPONSE_TEXT(redirect_body), false);
+        LOG_DEBUG("根路径重定向处理完成");
+        return;
+    }
+
+    // 2. 处理静态文件请求 (仅 GET 方法，仅 /web 路径)
+    if (http_req->method == HTTP_GET && http_span_has_prefix(http_req->path, "/web")) {
+        LOG_DEBUG("处理静态文件请求: %.*s", (int)http_req->path.length, http_req->path.data);
+        serve_static_file(reactor, client, http_req);
+        LOG_DEBUG("静态文件请求处理完成");
+        return;
+    }
+
+    // 2.5. 处理健康检查和连接测试请求 (仅 GET 方法)
+    if (http_req->method == HTTP_GET &&
+        (http_span_equals(http_req->path, "/test_connection") || http_span_equals(http_req->path, "/health"))) {
+        LOG_DEBUG("处理健康检查/连接测试请求: %.*s", (int)http_req->path.length, http_req->path.data);
+
+        // 汇总各反应器的连接数、slab 内存统计和键空间的缓存统计（只读原子计数，不需要跨线程同步）
+        SlabStats memory = {0};
+        KVCacheStats cache = {0};
+        long connections = 0;
+        for (int i = 0; i < reactor->server->reactor_count; i++) {
+            SlabStats stats;
+            KVCacheStats shard;
+            slab_stats(reactor->server->reactors[i].slab, &stats);
+            kv_cache_stats(reactor->server->reactors[i].kv_store, &shard);
+            connections += atomic_load_explicit(&reactor->server->reactors[i].clients.active, memory_order_relaxed);
+            memory.requested_bytes += stats.requested_bytes;
+            memory.used_bytes += stats.used_bytes;
+            memory.reserved_bytes += stats.reserved_bytes;
+            cache.memory += shard.memory;
+            cache.limit += shard.limit;
+            cache.hits += shard.hits;
+            cache.misses += shard.misses;
+            cache.evictions += shard.evictions;
+        }
+        size_t lookups = cache.hits + cache.misses;
+
+        // 构建 JSON 响应
+        char json_response[512];
+        int json_len = snprintf(json_response, sizeof(json_response),
+            "{\"status\":\"ok\",\"service\":\"KV Storage Server\",\"timestamp\":%ld,"
+            "\"connections\":%ld,\"memory\":{\"requested\":%zu,\"used\":%zu,\"reserved\":%zu},"
+            "\"keyspace\":{\"memory\":%zu,\"maxmemory\":%zu,\"policy\":\"%s\",\"hits\":%zu,\"misses\":%zu,"
+            "\"hit_ratio\":%.4f,\"evictions\":%zu}}",
+            time(NULL), connections, memory.requested_bytes, memory.used_bytes, memory.reserved_bytes,
+            cache.memory, cache.limit, kv_evict_policy_name(reactor->server->evict_policy), cache.hits,
+            cache.misses, lookups ? (double)cache.hits / (double)lookups : 0.0, cache.evictions);
+
+        if (json_len > 0 && json_len < (int)sizeof(json_response)) {
+            write_response(client, 200, HTTP_CONTENT_JSON, NULL, json_response, json_len, true);
+        }
+
+        LOG_DEBUG("健康检查/连接测试请求处理完成");
+        return;
+    }
+
+    // 2.55. 处理 Prometheus 指标请求 (仅 GET 方法)
+    if (http_req->method == HTTP_GET && http_span_equals(http_req->path, "/metrics")) {
+        process_metrics_request(reactor, client);
+        return;
+    }
+
+    // 2.6. 处理 OPTIONS 请求（CORS 预检）
+    if (http_req->method == HTTP_OPTIONS) {
+        LOG_DEBUG("处理 OPTIONS 预检请求: %.*s", (int)http_req->path.length, http_req->path.data);
+        write_response(client, 200, HTTP_CONTENT_TEXT, "Access-Control-Max-Age: 86400\r\n", NULL, 0, true);
+        LOG_DEBUG("OPTIONS 预检请求处理完成");
+        return;
+    }
+
+    // 2.7. 处理批量 API 请求 (仅 POST 方法，/batch/get、/batch/set、/batch/delete)
+    if (http_span_has_prefix(http_req->path, "/batch/")) {
+        LOG_DEBUG("处理批量 API 请求: %.*s", (int)http_req->path.length, http_req->path.data);
+        process_batch_request(reactor, client, http_req, body);
+        return;
+    }
+
+    // 2.8. 处理快照管理请求 (GET 查询状态，POST 触发快照)
+    if (http_span_equals(http_req->path, "/admin/snapshot")) {
+        LOG_DEBUG("处理快照管理请求");
+        process_snapshot_request(reactor, client, http_req);
+        return;
+    }
+
+    // 2.9. 处理过期时间请求 (GET 查询，POST 设置，DELETE 取消，仅 /ttl/ 路径)
+    if (http_span_has_prefix(http_req->path, "/ttl/")) {
+        LOG_DEBUG("处理过期时间请求: %.*s", (int)http_req->path.length, http_req->path.data);
+        process_ttl_request(reactor, client, request, http_req);
+        return;
+    }
+
+    // 3. 处理 API 请求 (GET, POST, DELETE 方法，仅 /api/ 路径)
+    if (http_span_has_prefix(http_req->path, "/api/")) {
+        LOG_DEBUG("处理 API 请求: %.*s", (int)http_req->path.length, http_req->path.data);
+        // 检查 HTTP 方法是否合法
+        if (http_req->method != HTTP_GET && http_req->method != HTTP_POST && http_req->method != HTTP_DELETE) {
+            LOG_DEBUG("API 请求方法不允许: %d", http_req->method);
+            write_plain_response(client, 405, RESPONSE_TEXT("Method Not Allowed"));
+            return;
+        }
+
+        // 处理 API 操作
+        // 跳过 "/api/" 前缀并解码 %XX 转义，解码后的键可以包含任意字节
+        char *key = request + (http_req->path.data - request) + 5;
+        size_t key_length = http_url_decode(key, http_req->path.length - 5);
+        LOG_DEBUG("提取的键名: '%.*s'", (int)key_length, key);
+
+        if (key_length == 0) {
+            LOG_DEBUG("键名为空，返回 400 错误");
+            write_plain_response(client, 400, RESPONSE_TEXT("Bad Request - Key cannot be empty"));
+            return;
+        }
+
+        // 执行 KV 操作
+        LOG_DEBUG("执行 KV 操作，方法: %d，键: '%.*s'", http_req->method, (int)key_length, key);
+        ShardOp op = http_req->method == HTTP_GET ? SHARD_OP_GET
+                   : http_req->method == HTTP_POST ? SHARD_OP_SET : SHARD_OP_DELETE;
+        size_t body_length = body ? body->length : http_req->body.length;
+        if (op == SHARD_OP_SET && body_length == 0) {
+            LOG_DEBUG("POST 失败，缺少请求体");
+            write_api_response(client, 400, RESPONSE_TEXT("Request body required"));
+            return;
+        }
+        // POST 可以用 X-TTL 头部或 ttl 查询参数指定存活秒数
+        uint64_t ttl_ms = 0;
+        if (op == SHARD_OP_SET && !request_ttl(http_req, &ttl_ms)) {
+            LOG_DEBUG("POST 失败，存活时间格式错误");
+            write_api_response(client, 400, RESPONSE_TEXT("Bad Request - Invalid TTL"));
+            return;
+        }
+        KVValue *value = NULL;
+        if (op == SHARD_OP_SET) {
+            LOG_DEBUG("POST 请求体长度: %zu", body_length);
+            // 请求体最多复制一次（流式接收的已经在值中），之后存储和跨分片消息都持有同一个值的引用
+            value = body ? kv_value_retain(body) : kv_value_create(reactor->slab, http_req->body.data, body_length);
+            if (!value) {
+                write_api_response(client, 500, RESPONSE_TEXT("Internal Server Error"));
+                return;
+            }
+        }
+
+        run_kv_op(reactor, client, op, key, key_length, value, ttl_ms ? kv_now_ms() + ttl_ms : 0);
+        LOG_DEBUG("API 请求处理完成");
+        return;
+    }
+
+    // 4. 所有其他请求一律返回 404
+    LOG_DEBUG("未匹配任何路径，返回 404: %.*s", (int)http_req->path.length, http_req->path.data);
+    write_plain_response(client, 404, RESPONSE_TEXT("Not Found"));
+    LOG_DEBUG("404 响应发送完成");
+}
@@ -1,7 +1,13 @@
 #include "http_parser.h"
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // HTTP 方法转字符串
 const char* http_method_to_string(HttpMethod method) {
@@ -28,295 +34,394 @@ const char* http_status_text(int status_code) {
     switch (status_code) {
         case 200: return "OK";
         case 201: return "Created";
+        case 202: return "Accepted";
         case 204: return "No Content";
+        case 302: return "Found";
+        case 304: return "Not Modified";
         case 400: return "Bad Request";
         case 404: return "Not Found";
         case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
         case 500: return "Internal Server Error";
         default: return "Unknown";
     }
 }
 
-// 解析 HTTP 请求
-HttpRequest* http_parse_request(const char *raw_request, size_t length) {
-    if (!raw_request || length == 0) {
-        return NULL;
+// 返回 [p, end) 中第一个等于 c 的字节，没有时返回 end；
+// SSE2/AVX2 下一次比较 16/32 个字节，请求行和请求头中的分隔符扫描都经过这里
+static inline const char* scan_byte(const char *p, const char *end, char c) {
+#if defined(__AVX2__)
+    __m256i needle32 = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle32));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
     }
-
-    HttpRequest *request = calloc(1, sizeof(HttpRequest));
-    if (!request) {
-        return NULL;
-    }
-
-    // 复制原始请求以便解析
-    char *request_copy = malloc(length + 1);
-    if (!request_copy) {
-        free(request);
-        return NULL;
-    }
-    memcpy(request_copy, raw_request, length);
-    request_copy[length] = '\0';
-
-    // 查找请求行结束位置
-    char *line_end = strstr(request_copy, "\r\n");
-    bool has_crlf = true;
-    if (!line_end) {
-        line_end = strstr(request_copy, "\n");
-        has_crlf = false;
-        if (!line_end) {
-            free(request_copy);
-            free(request);
-            return NULL;
-        }
-    }
-
-    // 计算请求行长度
-    size_t line_len = line_end - request_copy;
-
-    // 解析请求行：METHOD PATH HTTP/1.1
-    *line_end = '\0';
-    char *method_str = strtok(request_copy, " ");
-    char *path_str = strtok(NULL, " ");
-    char *version_str = strtok(NULL, " ");
-
-    if (!method_str || !path_str || !version_str) {
-        free(request_copy);
-        free(request);
-        return NULL;
+#endif
+#if defined(__SSE2__)
+    __m128i needle16 = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
     }
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
 
-    // 设置方法
-    request->method = http_string_to_method(method_str);
+bool http_span_equals(HttpSpan span, const char *text) {
+    size_t length = strlen(text);
+    return span.length == length && memcmp(span.data, text, length) == 0;
+}
 
-    // 设置路径
-    request->path = strdup(path_str);
-    if (!request->path) {
-        free(request_copy);
-        free(request);
-        return NULL;
-    }
+bool http_span_has_prefix(HttpSpan span, const char *prefix) {
+    size_t length = strlen(prefix);
+    return span.length >= length && memcmp(span.data, prefix, length) == 0;
+}
 
-    // 查找请求头和请求体的分界线（基于原始请求）
-    char *body_separator = strstr(raw_request, "\r\n\r\n");
-    int separator_len = 4;
-    if (!body_separator) {
-        body_separator = strstr(raw_request, "\n\n");
-        separator_len = 2;
+bool http_query_param(HttpSpan query, const char *name, HttpSpan *value) {
+    size_t name_length = strlen(name);
+    const char *p = query.data;
+    const char *end = query.data + query.length;
+    while (p < end) {
+        const char *item_end = scan_byte(p, end, '&');
+        const char *equals = scan_byte(p, item_end, '=');
+        if ((size_t)(equals - p) == name_length && memcmp(p, name, name_length) == 0) {
+            value->data = equals < item_end ? equals + 1 : item_end;
+            value->length = (size_t)(item_end - value->data);
+            return true;
+        }
+        p = item_end + 1;
     }
+    return false;
+}
 
-    // 计算请求头开始位置（基于原始请求）
-    size_t headers_start_offset = line_len + (has_crlf ? 2 : 1);
-
-    // 安全检查：确保偏移量不超过请求长度
-    if (headers_start_offset >= length) {
-        free(request_copy);
-        return request; // 只有请求行，没有头部
-    }
+static bool span_equals_nocase(const char *data, size_t length, const char *name, size_t name_length) {
+    return length == name_length && strncasecmp(data, name, name_length) == 0;
+}
 
-    char *headers_start_in_raw = raw_request + headers_start_offset;
+static HttpMethod method_from_span(const char *data, size_t length) {
+    if (length == 3 && memcmp(data, "GET", 3) == 0) return HTTP_GET;
+    if (length == 4 && memcmp(data, "POST", 4) == 0) return HTTP_POST;
+    if (length == 6 && memcmp(data, "DELETE", 6) == 0) return HTTP_DELETE;
+    if (length == 7 && memcmp(data, "OPTIONS", 7) == 0) return HTTP_OPTIONS;
+    return HTTP_UNKNOWN;
+}
 
-    if (body_separator) {
-        // 有请求体
-        // 安全检查：确保 body_separator 在有效范围内
-        if (body_separator < headers_start_in_raw || body_separator >= raw_request + length) {
-            free(request_copy);
-            return request;
-        }
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-        size_t headers_len = body_separator - headers_start_in_raw;
-        if (headers_len > 0 && headers_len < 8192) { // 限制头部大小
-            request->headers = malloc(headers_len + 1);
-            if (request->headers) {
-                memcpy(request->headers, headers_start_in_raw, headers_len);
-                request->headers[headers_len] = '\0';
-            }
+// 解码结果可以包含任意字节（例如 %00），不合法的转义原样保留
+size_t http_url_decode(char *data, size_t length) {
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
+        int high, low;
+        if (data[i] == '%' && i + 2 < length &&
+            (high = hex_value(data[i + 1])) >= 0 && (low = hex_value(data[i + 2])) >= 0) {
+            data[out++] = (char)(high << 4 | low);
+            i += 2;
+        } else {
+            data[out++] = data[i];
         }
+    }
+    return out;
+}
 
-        // 解析请求体
-        char *body_start = body_separator + separator_len;
-
-        // 安全检查：确保 body_start 在有效范围内
-        if (body_start >= raw_request + length) {
-            free(request_copy);
-            return request;
+// 查找请求头结尾的空行（"\r\n\r\n" 或 "\n\n"），返回请求头块（含空行）的长度，未找到时返回 0。
+// *scanned 之前的字节已确认不含结尾，只从这里继续扫描；返回时更新为下一次扫描的起点
+static size_t find_header_end(const char *data, size_t length, size_t *scanned) {
+    const char *end = data + length;
+    const char *p = data + (*scanned < length ? *scanned : length);
+    while ((p = scan_byte(p, end, '\n')) < end) {
+        size_t rest = (size_t)(end - p);
+        if (rest < 2 || (p[1] == '\r' && rest < 3)) break; // 换行之后的数据还没到
+        if (p[1] == '\n') {
+            *scanned = (size_t)(p - data);
+            return (size_t)(p - data) + 2;
         }
-
-        size_t body_len = length - (body_start - raw_request);
-
-        if (body_len > 0 && body_len < 1024 * 1024) { // 限制请求体大小为1MB
-            request->body = malloc(body_len + 1);
-            if (request->body) {
-                memcpy(request->body, body_start, body_len);
-                request->body[body_len] = '\0';
-                request->body_length = body_len;
-            }
-        }
-    } else {
-        // 没有请求体，只有请求头
-        size_t headers_len = length - headers_start_offset;
-        if (headers_len > 0 && headers_len < 8192) { // 限制头部大小
-            request->headers = malloc(headers_len + 1);
-            if (request->headers) {
-                memcpy(request->headers, headers_start_in_raw, headers_len);
-                request->headers[headers_len] = '\0';
-            }
+        if (p[1] == '\r' && p[2] == '\n') {
+            *scanned = (size_t)(p - data);
+            return (size_t)(p - data) + 3;
         }
+        p++;
     }
+    *scanned = (size_t)(p - data);
+    return 0;
+}
 
-    free(request_copy);
-    return request;
+// 去掉行尾的 '\r' 和首尾空白
+static void trim_span(const char **begin, const char **end) {
+    while (*begin < *end && (**begin == ' ' || **begin == '\t')) (*begin)++;
+    while (*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t' || (*end)[-1] == '\r')) (*end)--;
 }
 
-// 释放 HTTP 请求
-void http_free_request(HttpRequest *request) {
-    if (request) {
-        free(request->path);
-        free(request->body);
-        free(request->headers);
-        free(request);
+// 解析请求行：METHOD SP PATH SP VERSION（分隔符可以是多个空格）
+static bool parse_request_line(const char *line, const char *line_end, HttpRequest *request) {
+    trim_span(&line, &line_end);
+    const char *method_end = scan_byte(line, line_end, ' ');
+    const char *path = method_end;
+    while (path < line_end && *path == ' ') path++;
+    const char *path_end = scan_byte(path, line_end, ' ');
+    const char *version = path_end;
+    while (version < line_end && *version == ' ') version++;
+    if (method_end == line || path_end == path || version == line_end) return false;
+    if (scan_byte(version, line_end, ' ') != line_end) return false;
+    request->method = method_from_span(line, (size_t)(method_end - line));
+    const char *query = scan_byte(path, path_end, '?');
+    request->path.data = path;
+    request->path.length = (size_t)(query - path);
+    if (query < path_end) {
+        request->query.data = query + 1;
+        request->query.length = (size_t)(path_end - query - 1);
     }
+    // HTTP/1.1 默认保持连接，HTTP/1.0 默认关闭，可被 Connection 头部覆盖
+    request->keep_alive = line_end - version == 8 && memcmp(version, "HTTP/1.1", 8) == 0;
+    return true;
 }
 
-// 创建 HTTP 响应
-HttpResponse* http_create_response(int status_code, const char *body) {
-    HttpResponse *response = calloc(1, sizeof(HttpResponse));
-    if (!response) {
-        return NULL;
+// Connection 头部是逗号分隔的选项列表
+static void apply_connection_header(HttpRequest *request, const char *value, const char *end) {
+    while (value < end) {
+        while (value < end && (*value == ' ' || *value == ',')) value++;
+        const char *token_end = value;
+        while (token_end < end && *token_end != ',') token_end++;
+        size_t token_len = (size_t)(token_end - value);
+        while (token_len > 0 && value[token_len - 1] == ' ') token_len--;
+        if (span_equals_nocase(value, token_len, "close", 5)) {
+            request->keep_alive = false;
+        } else if (span_equals_nocase(value, token_len, "keep-alive", 10)) {
+            request->keep_alive = true;
+        }
+        value = token_end;
     }
+}
 
-    response->status_code = status_code;
-    response->status_text = strdup(http_status_text(status_code));
-    response->content_type = strdup("text/plain");
-
-    if (body) {
-        response->body = strdup(body);
-        response->body_length = strlen(body);
-    } else {
-        response->body = strdup("");
-        response->body_length = 0;
+// Accept-Encoding 是逗号分隔的编码列表，每项可以带 ";q=" 权重，q=0 表示不接受
+static bool accepts_gzip(const char *value, const char *end) {
+    while (value < end) {
+        while (value < end && (*value == ' ' || *value == ',')) value++;
+        const char *item_end = value;
+        while (item_end < end && *item_end != ',') item_end++;
+        const char *token_end = value;
+        while (token_end < item_end && *token_end != ';' && *token_end != ' ') token_end++;
+        size_t token_len = (size_t)(token_end - value);
+        if (span_equals_nocase(value, token_len, "gzip", 4) || span_equals_nocase(value, token_len, "x-gzip", 6)) {
+            const char *q = token_end;
+            while (q < item_end && (*q == ' ' || *q == ';')) q++;
+            bool zero = item_end - q >= 3 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=';
+            for (const char *p = q + 2; zero && p < item_end; p++) {
+                if (*p != '0' && *p != '.' && *p != ' ') zero = false;
+            }
+            return !zero;
+        }
+        value = item_end;
     }
+    return false;
+}
 
-    if (!response->status_text || !response->content_type || !response->body) {
-        http_free_response(response);
-        return NULL;
+// 解析一行请求头，只识别服务器需要的几个字段，其他头部忽略
+static bool parse_header_line(const char *line, const char *line_end, HttpRequest *request, bool *has_length) {
+    const char *colon = scan_byte(line, line_end, ':');
+    if (colon == line_end) return true; // 不是 "名称: 值" 格式的行直接忽略
+    size_t name_len = (size_t)(colon - line);
+    const char *value = colon + 1;
+    const char *value_end = line_end;
+    trim_span(&value, &value_end);
+    if (span_equals_nocase(line, name_len, "Content-Length", 14)) {
+        size_t value_len = (size_t)(value_end - value);
+        if (*has_length || value_len == 0 || value_len > 15) return false;
+        size_t content_length = 0;
+        for (const char *p = value; p < value_end; p++) {
+            if (*p < '0' || *p > '9') return false;
+            content_length = content_length * 10 + (size_t)(*p - '0');
+        }
+        request->content_length = content_length;
+        *has_length = true;
+    } else if (span_equals_nocase(line, name_len, "Connection", 10)) {
+        apply_connection_header(request, value, value_end);
+    } else if (span_equals_nocase(line, name_len, "Host", 4)) {
+        request->host.data = value;
+        request->host.length = (size_t)(value_end - value);
+    } else if (span_equals_nocase(line, name_len, "If-None-Match", 13)) {
+        request->if_none_match.data = value;
+        request->if_none_match.length = (size_t)(value_end - value);
+    } else if (span_equals_nocase(line, name_len, "X-TTL", 5)) {
+        request->ttl.data = value;
+        request->ttl.length = (size_t)(value_end - value);
+    } else if (span_equals_nocase(line, name_len, "Accept-Encoding", 15)) {
+        request->accept_gzip = accepts_gzip(value, value_end);
+    } else if (span_equals_nocase(line, name_len, "Transfer-Encoding", 17)) {
+        // 不支持分块传输编码，无法确定请求边界
+        return false;
     }
-
-    return response;
+    return true;
 }
 
-// 构建 HTTP 响应字符串
-char* http_build_response(HttpResponse *response, size_t *response_length) {
-    if (!response) {
-        return NULL;
+// 一次扫描解析缓冲区开头的请求，不分配内存也不复制：请求头不完整时只记录扫描位置，
+// 完整后逐行解析请求行和请求头，结果中的片段指向 data
+int http_parse_request(const char *data, size_t length, size_t *scanned, HttpRequest *request) {
+    if (!data || !request) return HTTP_PARSE_ERROR;
+    memset(request, 0, sizeof(*request));
+    size_t scan_from = scanned ? *scanned : 0;
+    size_t header_length = find_header_end(data, length, &scan_from);
+    if (scanned) *scanned = scan_from;
+    if (header_length == 0) return HTTP_PARSE_INCOMPLETE;
+
+    const char *end = data + header_length;
+    const char *line_end = scan_byte(data, end, '\n');
+    if (!parse_request_line(data, line_end, request)) return HTTP_PARSE_ERROR;
+    bool has_length = false;
+    for (const char *line = line_end + 1; line < end; line = line_end + 1) {
+        line_end = scan_byte(line, end, '\n');
+        if (!parse_header_line(line, line_end, request, &has_length)) return HTTP_PARSE_ERROR;
     }
+    request->header_length = header_length;
+    if (request->content_length > length - header_length) return HTTP_PARSE_INCOMPLETE;
+    request->body.data = data + header_length;
+    request->body.length = request->content_length;
+    return HTTP_PARSE_COMPLETE;
+}
 
-    // 计算响应字符串的大小
-    size_t header_size = snprintf(NULL, 0,
-        "HTTP/1.1 %d %s\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        response->status_code,
-        response->status_text,
-        response->content_type,
-        response->body_length);
-
-    size_t total_size = header_size + response->body_length;
-    char *response_str = malloc(total_size + 1);
-    if (!response_str) {
-        return NULL;
+// 创建 HTTP 响应
+// 响应头模板：状态行 + Content-Type + 可选的 CORS 头部，启动时一次性拼好；
+// 每个响应只复制模板，再填入额外头部、Content-Length 和 Connection
+#define HTTP_TEMPLATE_MAX 256
+
+#define CORS_HEADERS "Access-Control-Allow-Origin: *\r\n" \
+                     "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n" \
+                     "Access-Control-Allow-Headers: Content-Type, X-TTL\r\n"
+
+typedef struct {
+    char data[HTTP_TEMPLATE_MAX];
+    size_t length;
+} HeaderTemplate;
+
+static const int template_status_codes[] = {200, 201, 204, 302, 304, 400, 404, 405, 413, 431, 500};
+#define TEMPLATE_STATUS_COUNT (sizeof(template_status_codes) / sizeof(template_status_codes[0]))
+
+static const char *const content_type_names[HTTP_CONTENT_TYPE_COUNT] = {
+    [HTTP_CONTENT_TEXT] = "text/plain",
+    [HTTP_CONTENT_HTML] = "text/html; charset=utf-8",
+    [HTTP_CONTENT_JSON] = "application/json",
+    [HTTP_CONTENT_CSS] = "text/css; charset=utf-8",
+    [HTTP_CONTENT_JS] = "application/javascript; charset=utf-8",
+    [HTTP_CONTENT_SVG] = "image/svg+xml",
+    [HTTP_CONTENT_PNG] = "image/png",
+    [HTTP_CONTENT_ICO] = "image/x-icon",
+    [HTTP_CONTENT_BINARY] = "application/octet-stream",
+};
+
+static HeaderTemplate header_templates[TEMPLATE_STATUS_COUNT][HTTP_CONTENT_TYPE_COUNT][2];
+static bool templates_ready = false;
+
+// 状态码在模板表中的下标，不在表中时返回 -1
+static int template_index(int status_code) {
+    switch (status_code) {
+        case 200: return 0;
+        case 201: return 1;
+        case 204: return 2;
+        case 302: return 3;
+        case 304: return 4;
+        case 400: return 5;
+        case 404: return 6;
+        case 405: return 7;
+        case 413: return 8;
+        case 431: return 9;
+        case 500: return 10;
+        default: return -1;
     }
+}
 
-    // 构建响应头
-    int written = snprintf(response_str, header_size + 1,
-        "HTTP/1.1 %d %s\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        response->status_code,
-        response->status_text,
-        response->content_type,
-        response->body_length);
-
-    // 添加响应体
-    if (response->body_length > 0) {
-        memcpy(response_str + written, response->body, response->body_length);
+// 构建全部响应头模板；在启动工作线程之前调用，之后只读
+void http_response_init(void) {
+    if (templates_ready) {
+        return;
     }
-
-    response_str[total_size] = '\0';
-
-    if (response_length) {
-        *response_length = total_size;
+    for (size_t s = 0; s < TEMPLATE_STATUS_COUNT; s++) {
+        for (int type = 0; type < HTTP_CONTENT_TYPE_COUNT; type++) {
+            for (int cors = 0; cors < 2; cors++) {
+                HeaderTemplate *template = &header_templates[s][type][cors];
+                int length = snprintf(template->data, sizeof(template->data),
+                    "HTTP/1.1 %d %s\r\n"
+                    "Content-Type: %s\r\n"
+                    "%s",
+                    template_status_codes[s], http_status_text(template_status_codes[s]),
+                    content_type_names[type], cors ? CORS_HEADERS : "");
+                template->length = length > 0 ? (size_t)length : 0;
+            }
+        }
     }
-
-    return response_str;
+    templates_ready = true;
 }
 
-// 构建带 CORS 头部的 HTTP 响应字符串
-char* http_build_response_with_cors(HttpResponse *response, size_t *response_length) {
-    if (!response) {
-        return NULL;
-    }
-
-    // 计算响应字符串的大小（包含 CORS 头部）
-    size_t header_size = snprintf(NULL, 0,
-        "HTTP/1.1 %d %s\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Access-Control-Allow-Origin: *\r\n"
-        "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
-        "Access-Control-Allow-Headers: Content-Type\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        response->status_code,
-        response->status_text,
-        response->content_type,
-        response->body_length);
-
-    size_t total_size = header_size + response->body_length;
-    char *response_str = malloc(total_size + 1);
-    if (!response_str) {
-        return NULL;
+// 把 value 按十进制写入 buffer（至少 20 字节），返回位数
+static size_t format_decimal(char *buffer, size_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < count; i++) {
+        buffer[i] = digits[count - 1 - i];
     }
+    return count;
+}
 
-    // 构建响应头
-    int written = snprintf(response_str, header_size + 1,
-        "HTTP/1.1 %d %s\r\n"
-        "Content-Type: %s\r\n"
-        "Content-Length: %zu\r\n"
-        "Access-Control-Allow-Origin: *\r\n"
-        "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
-        "Access-Control-Allow-Headers: Content-Type\r\n"
-        "Connection: close\r\n"
-        "\r\n",
-        response->status_code,
-        response->status_text,
-        response->content_type,
-        response->body_length);
-
-    // 添加响应体
-    if (response->body_length > 0) {
-        memcpy(response_str + written, response->body, response->body_length);
+// 写入响应头（不含响应体），返回写入的字节数，buffer 放不下时返回 0；
+// extra 是额外的完整头部行（例如 "Location: /web/\r\n"），可以为 NULL
+size_t http_write_header(char *buffer, size_t size, int status_code, HttpContentType type,
+                         const char *extra, size_t content_length, bool keep_alive, bool cors) {
+    static const char length_name[] = "Content-Length: ";
+    static const char keep_alive_tail[] = "\r\nConnection: keep-alive\r\n\r\n";
+    static const char close_tail[] = "\r\nConnection: close\r\n\r\n";
+
+    int index = templates_ready ? template_index(status_code) : -1;
+    if (index < 0) {
+        // 模板表之外的状态码走格式化，只在少见的路径上出现
+        int length = snprintf(buffer, size,
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "%s%s"
+            "Content-Length: %zu\r\n"
+            "Connection: %s\r\n"
+            "\r\n",
+            status_code, http_status_text(status_code), content_type_names[type],
+            cors ? CORS_HEADERS : "", extra ? extra : "", content_length,
+            keep_alive ? "keep-alive" : "close");
+        return length > 0 && (size_t)length < size ? (size_t)length : 0;
     }
 
-    response_str[total_size] = '\0';
+    const HeaderTemplate *template = &header_templates[index][type][cors ? 1 : 0];
+    size_t extra_length = extra ? strlen(extra) : 0;
+    const char *tail = keep_alive ? keep_alive_tail : close_tail;
+    size_t tail_length = keep_alive ? sizeof(keep_alive_tail) - 1 : sizeof(close_tail) - 1;
+    char digits[20];
+    size_t digit_count = format_decimal(digits, content_length);
 
-    if (response_length) {
-        *response_length = total_size;
+    size_t total = template->length + extra_length + sizeof(length_name) - 1 + digit_count + tail_length;
+    if (total > size) {
+        return 0;
     }
-
-    return response_str;
-}
-
-// 释放 HTTP 响应
-void http_free_response(HttpResponse *response) {
-    if (response) {
-        free(response->status_text);
-        free(response->content_type);
-        free(response->body);
-        free(response);
+    char *p = buffer;
+    memcpy(p, template->data, template->length);
+    p += template->length;
+    if (extra_length > 0) {
+        memcpy(p, extra, extra_length);
+        p += extra_length;
     }
+    memcpy(p, length_name, sizeof(length_name) - 1);
+    p += sizeof(length_name) - 1;
+    memcpy(p, digits, digit_count);
+    p += digit_count;
+    memcpy(p, tail, tail_length);
+    return total;
 }
-
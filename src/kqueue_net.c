@@ -1,585 +1,1288 @@
-#include "kqueue_net.h"
+#include "server_internal.h"
 #include "kv_store.h"
 #include "http_parser.h"
+#ifdef C_X_HAVE_IO_URING
+#include "uring_engine.h"
+#endif
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <time.h>
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS 没有该标志，main 中已忽略 SIGPIPE
+#endif
+
+// 内部函数
+static int setup_server_socket(int port);
+static bool setup_event_loop(Reactor *reactor);
+static void handle_new_connection(Reactor *reactor, int listen_fd, ClientProtocol protocol);
+static void handle_client_data(Reactor *reactor, int client_fd);
+static void handle_client_writable(Reactor *reactor, int client_fd);
+static void handle_client_disconnect(Reactor *reactor, int client_fd);
+static ClientConnection* find_client(Reactor *reactor, int fd);
+static void init_client(ClientConnection *client, int fd);
+static void cleanup_client(Reactor *reactor, ClientConnection *client);
+static uint64_t client_deadline(const Reactor *reactor, const ClientConnection *client);
+static void client_arm_deadline(Reactor *reactor, ClientConnection *client);
+static ClientState process_resp_input(Reactor *reactor, ClientConnection *client);
+
 static bool set_nonblocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags == -1) return false;
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
 }
 
+// 默认反应器数量：每个在线 CPU 一个
+static int default_reactor_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) return 1;
+    return cpus > MAX_REACTORS ? MAX_REACTORS : (int)cpus;
+}
+
 KVServer* server_create(int port) {
     KVServer *server = calloc(1, sizeof(KVServer));
     if (!server) return NULL;
     server->port = port;
-    server->server_fd = -1;
-    server->kqueue_fd = -1;
-    server->running = false;
-    server->kv_store = kv_store_create(0);
-    if (!server->kv_store) {
-        free(server);
-        return NULL;
-    }
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        server->clients[i].fd = -1;
-    }
+    server->engine = SERVER_ENGINE_LOOP;
+    server->reactor_count = default_reactor_count();
+    server->reactors = NULL;
+    server->max_body_size = DEFAULT_MAX_BODY_SIZE;
+    server->max_output_size = DEFAULT_MAX_OUTPUT_SIZE;
+    server->fsync_policy = FSYNC_INTERVAL;
+    server->fsync_interval_ms = PERSIST_DEFAULT_FSYNC_MS;
+    server->timeouts.header_ms = DEFAULT_HEADER_TIMEOUT_MS;
+    server->timeouts.body_ms = DEFAULT_BODY_TIMEOUT_MS;
+    server->timeouts.idle_ms = DEFAULT_IDLE_TIMEOUT_MS;
+    server->timeouts.write_ms = DEFAULT_WRITE_TIMEOUT_MS;
+    pthread_mutex_init(&server->pause_lock, NULL);
+    pthread_cond_init(&server->pause_cond, NULL);
+    atomic_init(&server->running, false);
     return server;
 }
 
+static void server_close(KVServer *server);
+
 void server_destroy(KVServer *server) {
     if (!server) return;
     server_stop(server);
-    if (server->kv_store) {
-        kv_store_destroy(server->kv_store);
-    }
+    server_close(server);
+    pthread_mutex_destroy(&server->pause_lock);
+    pthread_cond_destroy(&server->pause_cond);
+    free(server->log_dir);
+    free(server->snapshot_path);
     free(server);
 }
 
-static bool setup_server_socket(KVServer *server) {
-    server->server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server->server_fd == -1) return false;
+// 设置反应器（线程）数量，每个反应器拥有一个键空间分片
+bool server_set_threads(KVServer *server, int threads) {
+    if (!server || server->reactors || threads < 1 || threads > MAX_REACTORS) return false;
+    server->reactor_count = threads;
+    return true;
+}
+
+// 设置请求体上限（字节），更大的请求以 413 拒绝
+bool server_set_max_body(KVServer *server, size_t bytes) {
+    if (!server || server->reactors || bytes == 0) return false;
+    server->max_body_size = bytes;
+    return true;
+}
+
+// 设置所有连接待发送输出的总上限（字节），由各反应器均分
+bool server_set_max_output(KVServer *server, size_t bytes) {
+    if (!server || server->reactors || bytes == 0) return false;
+    server->max_output_size = bytes;
+    return true;
+}
+
+// 设置 RESP 监听端口，0 表示不启用；与 HTTP 共用反应器、事件循环和键空间
+bool server_set_resp_port(KVServer *server, int port) {
+    if (!server || server->reactors || port < 0 || port > 65535 || (port != 0 && port == server->port)) return false;
+    server->resp_port = port;
+    return true;
+}
+
+// 启用追加日志：修改写入 dir 下的日志文件，启动时从中恢复数据；
+// policy 为 FSYNC_INTERVAL 时每 interval_ms 毫秒同步一次
+bool server_set_append_log(KVServer *server, const char *dir, FsyncPolicy policy, int interval_ms) {
+    if (!server || server->reactors || !dir || dir[0] == '\0' || interval_ms <= 0) return false;
+    char *copy = strdup(dir);
+    if (!copy) return false;
+    free(server->log_dir);
+    server->log_dir = copy;
+    server->fsync_policy = policy;
+    server->fsync_interval_ms = interval_ms;
+    return true;
+}
+
+// 配置快照文件：BGSAVE 或 POST /admin/snapshot 时在后台写入 path，interval_s 大于 0 时每隔
+// interval_s 秒自动写一次；未启用追加日志时启动从该文件恢复数据
+bool server_set_snapshot(KVServer *server, const char *path, int interval_s) {
+    if (!server || server->reactors || !path || path[0] == '\0' || interval_s < 0) return false;
+    char *copy = strdup(path);
+    if (!copy) return false;
+    free(server->snapshot_path);
+    server->snapshot_path = copy;
+    server->snapshot_interval_s = interval_s;
+    return true;
+}
+
+// 设置键空间的内存上限（字节），由各反应器的分片均分；达到上限后按 policy 淘汰，
+// KV_EVICT_NONE 时拒绝需要更多内存的写入。启动恢复的数据不受上限约束，之后的写入逐步淘汰
+bool server_set_max_memory(KVServer *server, size_t bytes, KVEvictPolicy policy) {
+    if (!server || server->reactors || policy > KV_EVICT_LFU) return false;
+    server->max_memory = bytes;
+    server->evict_policy = policy;
+    return true;
+}
+
+// 设置连接期限，各项为 0 时不限制
+bool server_set_timeouts(KVServer *server, const ServerTimeouts *timeouts) {
+    if (!server || server->reactors || !timeouts) return false;
+    server->timeouts = *timeouts;
+    return true;
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// 启用的连接期限中最短的一个，0 表示都不启用
+static uint32_t reap_interval(const ServerTimeouts *timeouts) {
+    uint32_t limits[] = {timeouts->header_ms, timeouts->body_ms, timeouts->idle_ms, timeouts->write_ms};
+    uint32_t interval = 0;
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++) {
+        if (limits[i] > 0 && (interval == 0 || limits[i] < interval)) interval = limits[i];
+    }
+    return interval;
+}
+
+// 创建监听 port 的非阻塞套接字，失败时返回 -1
+static int setup_server_socket(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
     int opt = 1;
-    if (setsockopt(server->server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
-        close(server->server_fd);
-        return false;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
+        close(fd);
+        return -1;
     }
-    if (!set_nonblocking(server->server_fd)) {
-        close(server->server_fd);
-        return false;
+#ifdef C_X_REUSEPORT_LB
+    // 每个反应器绑定自己的监听套接字，由内核在它们之间均衡新连接
+    if (setsockopt(fd, SOL_SOCKET, C_X_REUSEPORT_LB, &opt, sizeof(opt)) == -1) {
+        close(fd);
+        return -1;
+    }
+#endif
+    if (!set_nonblocking(fd)) {
+        close(fd);
+        return -1;
     }
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(server->port);
-    if (bind(server->server_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        close(server->server_fd);
-        return false;
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+        close(fd);
+        return -1;
     }
-    if (listen(server->server_fd, SOMAXCONN) == -1) {
-        close(server->server_fd);
-        return false;
+    return fd;
+}
+
+// 反应器 id 监听 port 的套接字；没有负载均衡的 SO_REUSEPORT 时共享第一个反应器的监听套接字 first_fd
+static int reactor_listen(int id, int port, int first_fd) {
+#ifdef C_X_REUSEPORT_LB
+    (void)id;
+    (void)first_fd;
+    return setup_server_socket(port);
+#else
+    return id == 0 ? setup_server_socket(port) : dup(first_fd);
+#endif
+}
+
+// 扩大反应器的参数数组，已有内容保留
+bool reactor_reserve_args(Reactor *reactor, size_t count) {
+    if (count <= reactor->arg_cap) return true;
+    size_t new_cap = reactor->arg_cap > 0 ? reactor->arg_cap * 2 : INITIAL_ARG_CAPACITY;
+    while (new_cap < count) {
+        new_cap *= 2;
     }
+    KVKey *args = realloc(reactor->args, new_cap * sizeof(KVKey));
+    if (!args) return false;
+    reactor->args = args;
+    reactor->arg_cap = new_cap;
     return true;
 }
 
-static bool setup_kqueue(KVServer *server) {
-    server->kqueue_fd = kqueue();
-    if (server->kqueue_fd == -1) return false;
-    struct kevent event;
-    EV_SET(&event, server->server_fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, NULL);
-    if (kevent(server->kqueue_fd, &event, 1, NULL, 0, NULL) == -1) {
-        close(server->kqueue_fd);
+static bool setup_event_loop(Reactor *reactor) {
+    reactor->loop = event_loop_create(MAX_EVENTS);
+    if (!reactor->loop) return false;
+    if (!event_loop_add(reactor->loop, reactor->server_fd, EVENT_READ, NULL) ||
+        (reactor->resp_fd != -1 && !event_loop_add(reactor->loop, reactor->resp_fd, EVENT_READ, NULL)) ||
+        !event_loop_add(reactor->loop, reactor->mailbox.wake_read_fd, EVENT_READ, &reactor->mailbox)) {
+        event_loop_destroy(reactor->loop);
+        reactor->loop = NULL;
         return false;
     }
     return true;
 }
 
-bool server_start(KVServer *server) {
-    if (!server || server->running) return false;
-    if (!setup_server_socket(server)) return false;
-    if (!setup_kqueue(server)) {
-        close(server->server_fd);
-        return false;
+static bool client_table_init(ClientTable *table) {
+    table->by_fd = calloc(INITIAL_FD_CAPACITY, sizeof(ClientConnection *));
+    if (!table->by_fd) return false;
+    table->fd_capacity = INITIAL_FD_CAPACITY;
+    table->free_list = NULL;
+    table->chunks = NULL;
+    table->chunk_count = 0;
+    atomic_init(&table->active, 0);
+    return true;
+}
+
+// 释放连接表的全部内存，调用前所有连接必须已经释放
+static void client_table_destroy(ClientTable *table) {
+    for (int i = 0; i < table->chunk_count; i++) {
+        free(table->chunks[i]);
     }
-    server->running = true;
-    printf("KV 存储服务器启动成功，监听端口 %d\n", server->port);
+    free(table->chunks);
+    free(table->by_fd);
+    table->chunks = NULL;
+    table->chunk_count = 0;
+    table->by_fd = NULL;
+    table->fd_capacity = 0;
+    table->free_list = NULL;
+}
+
+// 扩大 fd 索引使其能容纳 fd；只移动指针数组，连接对象本身不移动
+static bool client_table_reserve_fd(ClientTable *table, int fd) {
+    if (fd < table->fd_capacity) return true;
+    int new_capacity = table->fd_capacity * 2;
+    while (new_capacity <= fd) {
+        new_capacity *= 2;
+    }
+    ClientConnection **by_fd = realloc(table->by_fd, (size_t)new_capacity * sizeof(ClientConnection *));
+    if (!by_fd) return false;
+    memset(by_fd + table->fd_capacity, 0, (size_t)(new_capacity - table->fd_capacity) * sizeof(ClientConnection *));
+    table->by_fd = by_fd;
+    table->fd_capacity = new_capacity;
     return true;
 }
 
-void server_stop(KVServer *server) {
-    if (!server || !server->running) return;
-    server->running = false;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i].fd != -1) {
-            close(server->clients[i].fd);
-            server->clients[i].fd = -1;
+// 空闲链表为空时分配一块新的连接对象
+static bool client_table_add_chunk(ClientTable *table) {
+    ClientConnection **chunks = realloc(table->chunks, (size_t)(table->chunk_count + 1) * sizeof(ClientConnection *));
+    if (!chunks) return false;
+    table->chunks = chunks;
+    ClientConnection *chunk = calloc(CLIENT_CHUNK_SIZE, sizeof(ClientConnection));
+    if (!chunk) return false;
+    table->chunks[table->chunk_count++] = chunk;
+    for (int i = CLIENT_CHUNK_SIZE - 1; i >= 0; i--) {
+        chunk[i].fd = -1;
+        chunk[i].next_free = table->free_list;
+        table->free_list = &chunk[i];
+    }
+    return true;
+}
+
+static bool reactor_init(KVServer *server, Reactor *reactor, int id) {
+    reactor->id = id;
+    reactor->server = server;
+    reactor->server_fd = -1;
+    reactor->resp_fd = -1;
+    reactor->mailbox.wake_read_fd = -1;
+    reactor->mailbox.wake_write_fd = -1;
+    reactor->output_limit = server->max_output_size / server->reactor_count;
+    append_log_init(&reactor->log);
+    reactor->log_sync_always = server->log_dir && server->fsync_policy == FSYNC_ALWAYS;
+    reactor->now_ms = monotonic_ms();
+    timer_wheel_init(&reactor->client_timers, reactor->now_ms);
+    reactor->reap_interval_ms = reap_interval(&server->timeouts);
+    reactor->slab = slab_create();
+    if (!reactor->slab) return false;
+    reactor->kv_store = kv_store_create(0, reactor->slab);
+    static_cache_init(&reactor->static_cache, reactor->slab);
+    if (!reactor->kv_store || !client_table_init(&reactor->clients)) return false;
+    kv_set_evict_callback(reactor->kv_store, shard_evicted, reactor);
+    if (!reactor_reserve_args(reactor, INITIAL_ARG_CAPACITY)) return false;
+    if (!shard_mailbox_init(&reactor->mailbox)) return false;
+    Reactor *first = &server->reactors[0];
+    reactor->server_fd = reactor_listen(id, server->port, first->server_fd);
+    if (reactor->server_fd == -1) return false;
+    if (server->resp_port > 0) {
+        reactor->resp_fd = reactor_listen(id, server->resp_port, first->resp_fd);
+        if (reactor->resp_fd == -1) return false;
+    }
+    return setup_event_loop(reactor);
+}
+
+// 关闭反应器的所有连接、套接字和事件循环并释放分片；
+// 值可能被其他反应器的连接或分片引用，slab 由 server_release_reactors 最后统一销毁
+static void reactor_close(Reactor *reactor) {
+    ClientTable *table = &reactor->clients;
+    for (int fd = 0; fd < table->fd_capacity; fd++) {
+        ClientConnection *client = table->by_fd[fd];
+        if (client) {
+            close(fd);
+            server_release_client(reactor, client);
         }
     }
-    if (server->server_fd != -1) {
-        close(server->server_fd);
-        server->server_fd = -1;
+    client_table_destroy(table);
+    while (reactor->spare_count > 0) {
+        free(reactor->spare_buffers[--reactor->spare_count]);
+    }
+    if (reactor->server_fd != -1) {
+        close(reactor->server_fd);
+        reactor->server_fd = -1;
+    }
+    if (reactor->resp_fd != -1) {
+        close(reactor->resp_fd);
+        reactor->resp_fd = -1;
     }
-    if (server->kqueue_fd != -1) {
-        close(server->kqueue_fd);
-        server->kqueue_fd = -1;
+    free(reactor->args);
+    reactor->args = NULL;
+    reactor->arg_cap = 0;
+    free(reactor->held_clients);
+    reactor->held_clients = NULL;
+    reactor->held_count = 0;
+    reactor->held_cap = 0;
+    append_log_free(&reactor->log);
+    if (reactor->base) {
+        snapshot_shard_close(reactor->base);
+        free(reactor->base);
+        reactor->base = NULL;
     }
-    printf("KV 存储服务器已停止\n");
+    if (reactor->loop) {
+        event_loop_destroy(reactor->loop);
+        reactor->loop = NULL;
+    }
+    if (reactor->mailbox.wake_read_fd != -1) {
+        shard_mailbox_destroy(&reactor->mailbox);
+    }
+    if (reactor->kv_store) {
+        kv_store_destroy(reactor->kv_store);
+        reactor->kv_store = NULL;
+    }
+    static_cache_destroy(&reactor->static_cache);
 }
 
-static ClientConnection* find_client(KVServer *server, int fd) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i].fd == fd) {
-            return &server->clients[i];
+static void server_release_reactors(KVServer *server, int count) {
+    for (int i = 0; i < count; i++) {
+        reactor_close(&server->reactors[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        slab_destroy(server->reactors[i].slab);
+    }
+    free(server->reactors);
+    server->reactors = NULL;
+}
+
+bool server_start(KVServer *server) {
+    if (!server || server->running || server->reactors) return false;
+    server->reactors = calloc(server->reactor_count, sizeof(Reactor));
+    if (!server->reactors) return false;
+    http_response_init(); // 响应头模板在工作线程启动前构建，之后只读
+    for (int i = 0; i < server->reactor_count; i++) {
+        if (!reactor_init(server, &server->reactors[i], i)) {
+            server_release_reactors(server, i + 1);
+            return false;
+        }
+    }
+    if (server->log_dir || server->snapshot_path) {
+        server->persistence = persistence_create(server);
+        if (!server->persistence || !persistence_open(server->persistence)) {
+            persistence_destroy(server->persistence);
+            server->persistence = NULL;
+            server_release_reactors(server, server->reactor_count);
+            return false;
+        }
+    }
+    server->running = true;
+    LOG_INFO("KV 存储服务器启动成功，监听端口 %d（事件后端: %s，存储引擎: %s，反应器线程: %d）",
+             server->port, event_loop_backend(), kv_store_engine(), server->reactor_count);
+    if (server->resp_port > 0) {
+        LOG_INFO("RESP 协议监听端口 %d", server->resp_port);
+    }
+    return true;
+}
+
+// 请求事件循环退出；只修改标志并写唤醒 fd，可以在信号处理函数中安全调用
+void server_stop(KVServer *server) {
+    if (!server) return;
+    server->running = false;
+    if (server->reactors) {
+        for (int i = 0; i < server->reactor_count; i++) {
+            if (server->reactors[i].mailbox.wake_write_fd != -1) {
+                shard_mailbox_wake(&server->reactors[i].mailbox);
+            }
         }
     }
-    return NULL;
+}
+
+// 关闭所有反应器，仅在事件循环退出后调用
+static void server_close(KVServer *server) {
+    if (!server->reactors) return;
+    persistence_destroy(server->persistence);
+    server->persistence = NULL;
+    server_release_reactors(server, server->reactor_count);
+    LOG_INFO("KV 存储服务器已停止");
+}
+
+static ClientConnection* find_client(Reactor *reactor, int fd) {
+    if (fd < 0 || fd >= reactor->clients.fd_capacity) return NULL;
+    return reactor->clients.by_fd[fd];
 }
 
 static void init_client(ClientConnection *client, int fd) {
     client->fd = fd;
+    client->buffer = NULL;
     client->buffer_len = 0;
+    client->buffer_cap = 0;
+    client->body_value = NULL;
+    client->body_received = 0;
+    client->header_length = 0;
+    client->header_scanned = 0;
+    client->awaiting_body = false;
     client->request_complete = false;
-    memset(client->buffer, 0, BUFFER_SIZE);
+    client->awaiting_shard = false;
+    client->keep_alive = false;
+    client->keepalive_counted = false;
+    client->close_after_write = false;
+    client->output_held = false;
+    client->loop_events = EVENT_READ;
+    client->output_charged = 0;
+    client->recv_pending = false;
+    client->send_pending = false;
+    client->closing = false;
+    client->method = HTTP_UNKNOWN;
+    client->send_started = 0;
+    client->generation++;
+    out_queue_clear(&client->out);
 }
 
-static void cleanup_client(ClientConnection *client) {
-    if (client->fd != -1) {
-        VERBOSE_LOG("清理客户端连接，fd: %d", client->fd);
-        close(client->fd);
-        client->fd = -1;
+// 为读取准备至少 min_free 字节的空间（另保留结尾 '\0'）；优先复用反应器缓存的缓冲区
+static bool client_reserve_buffer(Reactor *reactor, ClientConnection *client, size_t min_free) {
+    if (!client->buffer) {
+        client->buffer = reactor->spare_count > 0 ? reactor->spare_buffers[--reactor->spare_count]
+                                                  : malloc(BUFFER_SIZE);
+        if (!client->buffer) return false;
+        client->buffer_cap = BUFFER_SIZE;
+        client->buffer_len = 0;
+    }
+    if (client->buffer_cap - client->buffer_len - 1 >= min_free) return true;
+    size_t new_cap = client->buffer_cap * 2;
+    while (new_cap - client->buffer_len - 1 < min_free) {
+        new_cap *= 2;
+    }
+    char *new_buffer = realloc(client->buffer, new_cap);
+    if (!new_buffer) return false;
+    client->buffer = new_buffer;
+    client->buffer_cap = new_cap;
+    return true;
+}
+
+// 输入处理完后归还读缓冲区，空闲连接不占用缓冲区；扩大过的缓冲区直接释放
+static void client_release_buffer(Reactor *reactor, ClientConnection *client) {
+    if (!client->buffer) return;
+    if (client->buffer_cap == BUFFER_SIZE && reactor->spare_count < SPARE_BUFFER_COUNT) {
+        reactor->spare_buffers[reactor->spare_count++] = client->buffer;
+    } else {
+        free(client->buffer);
     }
+    client->buffer = NULL;
     client->buffer_len = 0;
+    client->buffer_cap = 0;
+}
+
+static bool client_streaming_body(const ClientConnection *client) {
+    return client->body_value && client->body_received < client->body_value->length;
+}
+
+// 下一次读取的目标：流式接收请求体时直接读入值的存储，否则追加到读缓冲区
+bool server_client_read_buffer(Reactor *reactor, ClientConnection *client, char **data, size_t *length) {
+    if (client_streaming_body(client)) {
+        *data = client->body_value->data + client->body_received;
+        *length = client->body_value->length - client->body_received;
+        return true;
+    }
+    if (!client_reserve_buffer(reactor, client, BUFFER_SIZE / 4)) return false;
+    *data = client->buffer + client->buffer_len;
+    *length = client->buffer_cap - client->buffer_len - 1;
+    return true;
+}
+
+// 记录读入 server_client_read_buffer 返回区域的字节数
+void server_client_read_done(Reactor *reactor, ClientConnection *client, size_t bytes) {
+    metric_add(&reactor->metrics.bytes_in, bytes);
+    client->last_read = reactor->now_ms;
+    if (client->request_started == 0) client->request_started = reactor->now_ms;
+    if (client_streaming_body(client)) {
+        client->body_received += bytes;
+        return;
+    }
+    client->buffer_len += bytes;
+    client->buffer[client->buffer_len] = '\0';
+}
+
+// 把连接的待发送字节数同步到反应器的统计中，输出生成或发送之后调用
+void server_client_output_update(Reactor *reactor, ClientConnection *client) {
+    size_t pending = client->out.pending + client->sending.pending;
+    if (pending < client->output_charged) client->last_write = reactor->now_ms;
+    reactor->output_bytes = reactor->output_bytes - client->output_charged + pending;
+    client->output_charged = pending;
+}
+
+// 连接的输出超过单连接上限，或反应器的输出总量超过上限时，有积压的连接暂停处理新请求，
+// 慢速读取的客户端只会阻塞自己，服务器缓存的输出总量有界
+static bool client_output_full(Reactor *reactor, ClientConnection *client) {
+    server_client_output_update(reactor, client);
+    if (client->output_charged == 0) return false;
+    return client->output_charged >= MAX_CLIENT_OUTPUT || reactor->output_bytes >= reactor->output_limit;
+}
+
+// 重置连接状态并释放槽位，不关闭 fd（由调用方或 IO 引擎负责关闭）
+void server_release_client(Reactor *reactor, ClientConnection *client) {
+    timer_wheel_remove(&client->deadline);
+    if (client->keepalive_counted) {
+        reactor->keepalive_count--;
+        client->keepalive_counted = false;
+    }
+    reactor->output_bytes -= client->output_charged;
+    client->output_charged = 0;
+    ClientTable *table = &reactor->clients;
+    if (client->fd != -1 && table->by_fd[client->fd] == client) {
+        table->by_fd[client->fd] = NULL;
+        client->next_free = table->free_list;
+        table->free_list = client;
+        atomic_fetch_sub_explicit(&table->active, 1, memory_order_relaxed);
+    }
+    client->fd = -1;
+    client_release_buffer(reactor, client);
+    kv_value_release(client->body_value);
+    client->body_value = NULL;
+    client->awaiting_body = false;
     client->request_complete = false;
-    VERBOSE_LOG("客户端连接清理完成");
+    client->awaiting_shard = false;
+    client->keep_alive = false;
+    client->close_after_write = false;
+    client->output_held = false;
+    out_queue_free(&client->out);
+    out_queue_free(&client->sending);
+}
+
+static void cleanup_client(Reactor *reactor, ClientConnection *client) {
+    if (client->fd != -1) {
+        LOG_DEBUG("清理客户端连接，fd: %d", client->fd);
+        close(client->fd);
+    }
+    server_release_client(reactor, client);
+    LOG_DEBUG("客户端连接清理完成");
 }
 
-static void handle_new_connection(KVServer *server) {
+// 为新连接分配连接对象并登记到 fd 索引，内存不足时返回 NULL
+ClientConnection* server_acquire_client(Reactor *reactor, int fd, ClientProtocol protocol) {
+    ClientTable *table = &reactor->clients;
+    if (!client_table_reserve_fd(table, fd)) return NULL;
+    // 关闭 Nagle：流水线请求的响应分几次写出时，后一段不必等待客户端的延迟确认
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (!table->free_list && !client_table_add_chunk(table)) return NULL;
+    ClientConnection *client = table->free_list;
+    table->free_list = client->next_free;
+    client->next_free = NULL;
+    init_client(client, fd);
+    client->protocol = protocol;
+    client->request_started = 0; // 连接池可能先建立连接再发请求，尚未发送数据的连接按空闲期限处理
+    client->last_read = reactor->now_ms;
+    client->last_write = reactor->now_ms;
+    client->timed_out = false;
+    client->metrics = &reactor->metrics;
+    client_arm_deadline(reactor, client);
+    metric_add(&reactor->metrics.accepted, 1);
+    table->by_fd[fd] = client;
+    atomic_fetch_add_explicit(&table->active, 1, memory_order_relaxed);
+    return client;
+}
+
+// 追加数据到连接的输出队列，由 IO 引擎统一发送
+bool client_write(ClientConnection *client, const char *data, size_t length) {
+    return out_queue_append(&client->out, data, length);
+}
+
+// 决定响应后是否保持连接：客户端要求保持且反应器未超过保持连接上限
+bool client_keep_alive(Reactor *reactor, ClientConnection *client, bool requested) {
+    if (!requested) return false;
+    if (client->keepalive_counted) return true;
+    if (reactor->keepalive_count >= MAX_KEEPALIVE_CLIENTS) {
+        LOG_DEBUG("保持连接数已达上限 %d，fd %d 响应后关闭", MAX_KEEPALIVE_CLIENTS, client->fd);
+        return false;
+    }
+    client->keepalive_counted = true;
+    reactor->keepalive_count++;
+    return true;
+}
+
+// 从 listen_fd 接受一个新连接；监听队列已空或出错时返回 false
+static bool accept_one_connection(Reactor *reactor, int listen_fd, ClientProtocol protocol) {
     struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
-    VERBOSE_LOG("处理新连接请求");
-    int client_fd = accept(server->server_fd, (struct sockaddr*)&client_addr, &client_len);
+#ifdef SOCK_NONBLOCK
+    // Linux 上 accept4 直接返回非阻塞 fd，省去两次 fcntl 系统调用；与 io_uring 引擎一样设置 close-on-exec
+    int client_fd = accept4(listen_fd, (struct sockaddr*)&client_addr, &client_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int client_fd = accept(listen_fd, (struct sockaddr*)&client_addr, &client_len);
+#endif
     if (client_fd == -1) {
-        VERBOSE_LOG("accept 失败: %s", strerror(errno));
-        return;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_DEBUG("accept 失败: %s", strerror(errno));
+        }
+        return errno == EINTR || errno == ECONNABORTED;
     }
-    VERBOSE_LOG("接受新连接，fd: %d，地址: %s:%d",
-                client_fd, inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+#ifndef SOCK_NONBLOCK
     if (!set_nonblocking(client_fd)) {
-        VERBOSE_LOG("设置非阻塞失败，关闭连接 fd: %d", client_fd);
+        LOG_DEBUG("设置非阻塞失败，关闭连接 fd: %d", client_fd);
         close(client_fd);
-        return;
-    }
-    VERBOSE_LOG("设置客户端 fd %d 为非阻塞模式", client_fd);
-    ClientConnection *client = NULL;
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (server->clients[i].fd == -1) {
-            client = &server->clients[i];
-            break;
-        }
+        return true;
     }
+    LOG_DEBUG("设置客户端 fd %d 为非阻塞模式", client_fd);
+#endif
+    ClientConnection *client = server_acquire_client(reactor, client_fd, protocol);
     if (!client) {
-        VERBOSE_LOG("客户端连接数已满，关闭 fd %d", client_fd);
+        LOG_DEBUG("分配连接失败，关闭 fd %d", client_fd);
         close(client_fd);
-        return;
+        return true;
     }
-    init_client(client, client_fd);
-    struct kevent event;
-    EV_SET(&event, client_fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, NULL);
-    if (kevent(server->kqueue_fd, &event, 1, NULL, 0, NULL) == -1) {
-        VERBOSE_LOG("添加客户端到 kqueue 失败: %s", strerror(errno));
-        cleanup_client(client);
-        return;
+    if (!event_loop_add(reactor->loop, client_fd, EVENT_READ, client)) {
+        LOG_DEBUG("添加客户端到事件循环失败: %s", strerror(errno));
+        cleanup_client(reactor, client);
+        return true;
     }
-    VERBOSE_LOG("客户端 fd %d 已添加到 kqueue", client_fd);
-    printf("新客户端连接: %s:%d (fd=%d)\n",
-           inet_ntoa(client_addr.sin_addr),
-           ntohs(client_addr.sin_port),
-           client_fd);
-    VERBOSE_LOG("客户端连接初始化完成");
-}
-
-// 处理静态文件请求
-static void serve_static_file(int client_fd, const char *path) {
-    // 如果请求 /web 路径，返回测试页面
-    if (strcmp(path, "/web") == 0 || strcmp(path, "/web/") == 0 || strcmp(path, "/web/index.html") == 0) {
-        FILE *file = fopen("web/index.html", "r");
-        if (file) {
-            fseek(file, 0, SEEK_END);
-            long file_size = ftell(file);
-            fseek(file, 0, SEEK_SET);
-
-            // 检查文件大小是否合理
-            if (file_size <= 0 || file_size > 1024 * 1024) { // 限制文件大小为1MB
-                fclose(file);
-                goto send_404;
-            }
-
-            char *file_content = malloc(file_size + 1);
-            if (!file_content) {
-                fclose(file);
-                goto send_404;
-            }
+    // 地址按字节记录，由日志线程格式化，不在这里调用 inet_ntoa
+    const unsigned char *address = (const unsigned char *)&client_addr.sin_addr.s_addr;
+    LOG_INFO("新客户端连接: %d.%d.%d.%d:%d (反应器 %d, fd=%d)", address[0], address[1], address[2], address[3],
+             (int)ntohs(client_addr.sin_port), reactor->id, client_fd);
+    return true;
+}
 
-            size_t bytes_read = fread(file_content, 1, file_size, file);
-            fclose(file);
+static void handle_new_connection(Reactor *reactor, int listen_fd, ClientProtocol protocol) {
+    LOG_DEBUG("处理新连接请求");
+    // 一次就绪通知中尽量取空监听队列，减少高连接速率下的事件循环往返
+    for (int i = 0; i < MAX_ACCEPTS_PER_EVENT; i++) {
+        if (!accept_one_connection(reactor, listen_fd, protocol)) break;
+    }
+}
 
-            if (bytes_read != (size_t)file_size) {
-                free(file_content);
-                goto send_404;
-            }
+// 主动过期：删除本分片中到期的键，每轮最多推进 EXPIRE_BATCH 个定时器，其余的留到下一轮。
+// 没有被访问的过期键也由这里回收，访问时的惰性检查保证到期后立即不可见
+void reactor_expire_keys(Reactor *reactor) {
+    size_t removed = kv_expire(reactor->kv_store, kv_now_ms(), EXPIRE_BATCH);
+    if (removed > 0) {
+        LOG_DEBUG("反应器 %d: 删除 %zu 个过期的键", reactor->id, removed);
+    }
+}
 
-            file_content[file_size] = '\0';
-
-            // 发送 HTML 响应 - 分别发送头部和内容
-            char header[300];
-            int header_len = snprintf(header, sizeof(header),
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Type: text/html; charset=utf-8\r\n"
-                "Content-Length: %ld\r\n"
-                "Connection: close\r\n"
-                "\r\n", file_size);
-
-            if (header_len > 0 && header_len < (int)sizeof(header)) {
-                // 先发送头部
-                send(client_fd, header, header_len, 0);
-                // 再发送文件内容
-                send(client_fd, file_content, file_size, 0);
-            }
+// 事件循环返回后更新反应器的单调时钟，连接的活动时刻和期限都按它计算
+void reactor_update_clock(Reactor *reactor) {
+    reactor->now_ms = monotonic_ms();
+}
 
-            free(file_content);
-            return;
-        }
+// 按连接当前的状态计算期限，没有适用的期限时返回 TIMER_WHEEL_NEVER：
+// 有待发送的输出时看发送进展，接收请求体时看读取进展，有未完成的请求时看请求头期限，否则看空闲期限。
+// 等待跨分片应答或日志同步的连接由服务器自己推进，不计期限
+static uint64_t client_deadline(const Reactor *reactor, const ClientConnection *client) {
+    const ServerTimeouts *timeouts = &reactor->server->timeouts;
+    if (client->awaiting_shard || client->output_held || client->closing) return TIMER_WHEEL_NEVER;
+    if (client->out.pending > 0 || client->sending.pending > 0) {
+        if (timeouts->write_ms == 0) return TIMER_WHEEL_NEVER;
+        uint64_t last = client->last_write > client->last_read ? client->last_write : client->last_read;
+        return last + timeouts->write_ms;
     }
-
-send_404:
-    // 文件未找到，返回 404
-    {
-        const char *not_found = "HTTP/1.1 404 Not Found\r\n"
-                               "Content-Type: text/plain\r\n"
-                               "Content-Length: 9\r\n"
-                               "Connection: close\r\n"
-                               "\r\nNot Found";
-        send(client_fd, not_found, strlen(not_found), 0);
-    }
-}
-
-static void process_http_request(KVServer *server, int client_fd, const char *request, size_t length) {
-    VERBOSE_LOG("=== 处理 HTTP 请求 ===");
-    VERBOSE_LOG("客户端 fd: %d", client_fd);
-    VERBOSE_LOG("请求长度: %zu", length);
-    VERBOSE_LOG("请求内容: %.200s%s", request, length > 200 ? "..." : "");
-
-    HttpRequest *http_req = http_parse_request(request, length);
-    if (!http_req) {
-        VERBOSE_LOG("HTTP 请求解析失败");
-        HttpResponse *response = http_create_response(400, "Bad Request");
-        if (response) {
-            size_t response_len;
-            char *response_str = http_build_response(response, &response_len);
-            if (response_str) {
-                send(client_fd, response_str, response_len, 0);
-                free(response_str);
-            }
-            http_free_response(response);
-        }
-        return;
+    // 请求头已完整、只差请求体，或超过请求头上限的输入（只能是请求体或 RESP 的大参数），只要求持续有进展
+    if (client->body_value || client->awaiting_body || client->buffer_len > MAX_HEADER_SIZE) {
+        return timeouts->body_ms > 0 ? client->last_read + timeouts->body_ms : TIMER_WHEEL_NEVER;
     }
-
-    VERBOSE_LOG("HTTP 请求解析成功:");
-    VERBOSE_LOG("  方法: %d", http_req->method);
-    VERBOSE_LOG("  路径: %s", http_req->path ? http_req->path : "NULL");
-    VERBOSE_LOG("  请求体长度: %zu", http_req->body_length);
-    if (http_req->body && http_req->body_length > 0) {
-        VERBOSE_LOG("  请求体: %.100s%s", http_req->body, http_req->body_length > 100 ? "..." : "");
-    }
-
-    // 严格按照 HTTP 协议处理请求，只允许特定的合法操作
-
-    // 1. 处理根路径重定向 (仅 GET 方法)
-    if (http_req->method == HTTP_GET && strcmp(http_req->path, "/") == 0) {
-        VERBOSE_LOG("处理根路径重定向到 /web/");
-        const char *redirect_response = "HTTP/1.1 302 Found\r\n"
-                                      "Location: /web/\r\n"
-                                      "Content-Type: text/html\r\n"
-                                      "Content-Length: 47\r\n"
-                                      "Connection: close\r\n"
-                                      "\r\n"
-                                      "<html><body>Redirecting to <a href=\"/web/\">/web/</a></body></html>";
-        send(client_fd, redirect_response, strlen(redirect_response), 0);
-        http_free_request(http_req);
-        VERBOSE_LOG("根路径重定向处理完成");
-        return;
+    if (client->request_started != 0) {
+        return timeouts->header_ms > 0 ? client->request_started + timeouts->header_ms : TIMER_WHEEL_NEVER;
     }
+    if (timeouts->idle_ms == 0) return TIMER_WHEEL_NEVER;
+    uint64_t last = client->last_write > client->last_read ? client->last_write : client->last_read;
+    return last + timeouts->idle_ms;
+}
 
-    // 2. 处理静态文件请求 (仅 GET 方法，仅 /web 路径)
-    if (http_req->method == HTTP_GET && strncmp(http_req->path, "/web", 4) == 0) {
-        VERBOSE_LOG("处理静态文件请求: %s", http_req->path);
-        serve_static_file(client_fd, http_req->path);
-        http_free_request(http_req);
-        VERBOSE_LOG("静态文件请求处理完成");
-        return;
-    }
+// 重新设置连接的定时器：到期时刻取期限和下一次检查时刻中较早的一个。
+// 读写只更新活动时刻，不操作时间轮；状态变化后适用的期限可能更短，最多晚一个检查间隔发现
+static void client_arm_deadline(Reactor *reactor, ClientConnection *client) {
+    if (reactor->reap_interval_ms == 0) return;
+    uint64_t expire = reactor->now_ms + reactor->reap_interval_ms;
+    uint64_t deadline = client_deadline(reactor, client);
+    if (deadline < expire) expire = deadline;
+    timer_wheel_add(&reactor->client_timers, &client->deadline, expire);
+}
 
-    // 2.5. 处理健康检查和连接测试请求 (仅 GET 方法)
-    if (http_req->method == HTTP_GET &&
-        (strcmp(http_req->path, "/test_connection") == 0 || strcmp(http_req->path, "/health") == 0)) {
-        VERBOSE_LOG("处理健康检查/连接测试请求: %s", http_req->path);
-
-        // 构建 JSON 响应
-        char json_response[200];
-        int json_len = snprintf(json_response, sizeof(json_response),
-            "{\"status\":\"ok\",\"service\":\"KV Storage Server\",\"timestamp\":%ld}",
-            time(NULL));
-
-        char *health_response = malloc(json_len + 300);
-        if (health_response) {
-            int response_len = snprintf(health_response, json_len + 300,
-                "HTTP/1.1 200 OK\r\n"
-                "Content-Type: application/json\r\n"
-                "Content-Length: %d\r\n"
-                "Access-Control-Allow-Origin: *\r\n"
-                "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
-                "Access-Control-Allow-Headers: Content-Type\r\n"
-                "Connection: close\r\n"
-                "\r\n%s", json_len, json_response);
-
-            send(client_fd, health_response, response_len, 0);
-            free(health_response);
+// 检查到期的连接定时器，每轮最多 REAP_BATCH 个：期限已过的连接关闭套接字（shutdown），
+// 之后的读写立即失败，由 IO 引擎按连接断开的正常路径释放；其余的按当前状态重新设置定时器。
+// 只访问到期的连接，不扫描连接表
+void reactor_reap_clients(Reactor *reactor) {
+    size_t budget = REAP_BATCH;
+    TimerNode *node;
+    while ((node = timer_wheel_expire(&reactor->client_timers, reactor->now_ms, &budget)) != NULL) {
+        ClientConnection *client = (ClientConnection *)((char *)node - offsetof(ClientConnection, deadline));
+        if (!client->timed_out && client_deadline(reactor, client) <= reactor->now_ms) {
+            LOG_DEBUG("反应器 %d: 连接超时，fd: %d，关闭连接", reactor->id, client->fd);
+            client->timed_out = true;
+            metric_add(&reactor->metrics.timeouts, 1);
+            shutdown(client->fd, SHUT_RDWR);
         }
+        client_arm_deadline(reactor, client);
+    }
+}
 
-        http_free_request(http_req);
-        VERBOSE_LOG("健康检查/连接测试请求处理完成");
-        return;
+// 上次取样后内存存储或映射的快照分区中的键数有变化；后台合并把键从分区移到存储，总键数不变
+static bool table_sample_stale(const Reactor *reactor) {
+    size_t mapped = reactor->base ? reactor->base->live : 0;
+    return kv_size(reactor->kv_store) != reactor->table_sampled_keys || mapped != reactor->table_sampled_mapped;
+}
+
+// 存储规模的取样：键数变化后最多每 METRICS_SAMPLE_INTERVAL_MS 取样一次。索引只能由所有者线程访问，
+// 这里在本线程检查 METRICS_TABLE_SAMPLES 个桶，按比例换算成整张表的估计值后写入统计，/metrics 只读统计
+void reactor_sample_metrics(Reactor *reactor) {
+    if (reactor->table_sampled_ms != 0 && !table_sample_stale(reactor)) return;
+    if (reactor->now_ms - reactor->table_sampled_ms < METRICS_SAMPLE_INTERVAL_MS) return;
+    KVTableStats stats;
+    kv_table_sample(reactor->kv_store, &reactor->table_sample_cursor, METRICS_TABLE_SAMPLES, &stats);
+    ReactorMetrics *metrics = &reactor->metrics;
+    reactor->table_sampled_keys = kv_size(reactor->kv_store);
+    reactor->table_sampled_mapped = reactor->base ? reactor->base->live : 0;
+    metric_set(&metrics->table_keys, reactor->table_sampled_keys);
+    metric_set(&metrics->mapped_keys, reactor->table_sampled_mapped);
+    metric_set(&metrics->table_buckets, stats.capacity);
+    for (int i = 0; i < KV_CHAIN_LENGTHS; i++) {
+        size_t estimate = stats.sampled ? (size_t)((double)stats.chains[i] * (double)stats.capacity / (double)stats.sampled) : 0;
+        metric_set(&metrics->table_chains[i], estimate);
     }
+    reactor->table_sampled_ms = reactor->now_ms;
+}
 
-    // 2.6. 处理 OPTIONS 请求（CORS 预检）
-    if (http_req->method == HTTP_OPTIONS) {
-        VERBOSE_LOG("处理 OPTIONS 预检请求: %s", http_req->path);
-        const char *options_response = "HTTP/1.1 200 OK\r\n"
-                                     "Access-Control-Allow-Origin: *\r\n"
-                                     "Access-Control-Allow-Methods: GET, POST, DELETE, OPTIONS\r\n"
-                                     "Access-Control-Allow-Headers: Content-Type\r\n"
-                                     "Access-Control-Max-Age: 86400\r\n"
-                                     "Content-Length: 0\r\n"
-                                     "Connection: close\r\n"
-                                     "\r\n";
-        send(client_fd, options_response, strlen(options_response), 0);
-        http_free_request(http_req);
-        VERBOSE_LOG("OPTIONS 预检请求处理完成");
-        return;
+// 等待事件的超时（毫秒）：映射的快照分区尚未合并完或已有到期的键时为 0，否则等到键的时间轮或连接期限的
+// 时间轮下一次需要推进的时刻（键数变化后还有存储规模的取样，日志不可用时还有下一次重试），
+// 都没有时为 -1（无限等待）
+int reactor_wait_timeout(Reactor *reactor) {
+    if (reactor->base && snapshot_shard_merging(reactor->base)) return 0;
+    uint64_t wait = TIMER_WHEEL_NEVER;
+    uint64_t next = kv_next_expire(reactor->kv_store);
+    if (next != TIMER_WHEEL_NEVER) {
+        uint64_t now = kv_now_ms();
+        wait = next > now ? next - now : 0;
+    }
+    // 两个时间轮的时钟不同（键的过期时刻是 Unix 毫秒），分别换算成等待时长
+    next = timer_wheel_next(&reactor->client_timers);
+    if (table_sample_stale(reactor)) {
+        // 键数变化后，空闲的反应器也要醒来更新存储规模的取样
+        uint64_t sample_at = reactor->table_sampled_ms + METRICS_SAMPLE_INTERVAL_MS;
+        if (sample_at < next) next = sample_at;
+    }
+    // 日志不可用时，空闲的反应器也按时重试写出
+    if (reactor->log_failed && reactor->log_retry_ms < next) next = reactor->log_retry_ms;
+    if (next != TIMER_WHEEL_NEVER) {
+        uint64_t now = monotonic_ms();
+        uint64_t delta = next > now ? next - now : 0;
+        if (delta < wait) wait = delta;
     }
+    if (wait == TIMER_WHEEL_NEVER) return -1;
+    return wait > INT_MAX ? INT_MAX : (int)wait;
+}
 
-    // 3. 处理 API 请求 (GET, POST, DELETE 方法，仅 /api/ 路径)
-    if (strncmp(http_req->path, "/api/", 5) == 0) {
-        VERBOSE_LOG("处理 API 请求: %s", http_req->path);
-        // 检查 HTTP 方法是否合法
-        if (http_req->method != HTTP_GET && http_req->method != HTTP_POST && http_req->method != HTTP_DELETE) {
-            VERBOSE_LOG("API 请求方法不允许: %d", http_req->method);
-            HttpResponse *response = http_create_response(405, "Method Not Allowed");
-            if (response) {
-                size_t response_len;
-                char *response_str = http_build_response(response, &response_len);
-                if (response_str) {
-                    send(client_fd, response_str, response_len, 0);
-                    free(response_str);
-                }
-                http_free_response(response);
+// 处理信箱中的跨分片消息：执行发给本分片的请求，并完成本线程发起的请求
+void reactor_drain_mailbox(Reactor *reactor) {
+    ShardMessage *message;
+    while ((message = shard_mailbox_take(&reactor->mailbox)) != NULL) {
+        if (message->op == SHARD_OP_PAUSE) {
+            reactor_pause(reactor, message->client_gen);
+            shard_message_free(message);
+            continue;
+        }
+        if (!message->is_reply) {
+            execute_shard_op(reactor, message);
+            message->is_reply = true;
+            if (reactor_log_unsynced(reactor)) {
+                atomic_store_explicit(&message->next, reactor->held_replies, memory_order_relaxed);
+                reactor->held_replies = message;
+                continue;
             }
-            http_free_request(http_req);
-            return;
+            shard_mailbox_post(&reactor->server->reactors[message->origin].mailbox, message);
+            continue;
         }
-
-        // 处理 API 操作
-        const char *key = http_req->path + 5; // 跳过 "/api/" 前缀
-        VERBOSE_LOG("提取的键名: '%s'", key);
-
-        if (strlen(key) == 0) {
-            VERBOSE_LOG("键名为空，返回 400 错误");
-            HttpResponse *response = http_create_response(400, "Bad Request - Key cannot be empty");
-            if (response) {
-                size_t response_len;
-                char *response_str = http_build_response(response, &response_len);
-                if (response_str) {
-                    send(client_fd, response_str, response_len, 0);
-                    free(response_str);
+        ClientConnection *client = message->client;
+        bool current = client->fd != -1 && client->awaiting_shard && client->generation == message->client_gen;
+        if (message->op == SHARD_OP_BATCH) {
+            // 批次在最后一个分片应答后完成；连接已关闭时同样在这里释放
+            ShardBatch *batch = message->batch;
+            if (--batch->pending == 0) {
+                if (current) {
+                    client->awaiting_shard = false;
+                    write_batch_response(client, batch);
+                    reactor->complete(reactor, client);
                 }
-                http_free_response(response);
+                shard_batch_free(batch);
             }
-            http_free_request(http_req);
-            return;
+            shard_message_free(message);
+            continue;
         }
+        if (current) {
+            client->awaiting_shard = false;
+            write_kv_response(client, message);
+            reactor->complete(reactor, client);
+        } else {
+            LOG_DEBUG("丢弃过期的跨分片应答，键: '%.*s'", (int)message->key_length, message->key);
+        }
+        shard_message_free(message);
+    }
+}
 
-        // 执行 KV 操作
-        HttpResponse *response = NULL;
-        VERBOSE_LOG("执行 KV 操作，方法: %d，键: '%s'", http_req->method, key);
-        switch (http_req->method) {
-            case HTTP_GET: {
-                VERBOSE_LOG("执行 GET 操作");
-                char *value = kv_get(server->kv_store, key);
-                if (value) {
-                    VERBOSE_LOG("GET 成功，值: '%.50s%s'", value, strlen(value) > 50 ? "..." : "");
-                    response = http_create_response(200, value);
-                    free(value);
-                } else {
-                    VERBOSE_LOG("GET 失败，键不存在");
-                    response = http_create_response(404, "Key not found");
-                }
+// 拒绝超过大小限制的请求，响应后关闭连接（请求体未读取，连接上的字节流无法继续使用）
+static void reject_request(ClientConnection *client, int status_code, const char *body, size_t body_length) {
+    LOG_DEBUG("请求过大，拒绝处理，fd: %d，状态码: %d", client->fd, status_code);
+    client->keep_alive = false;
+    write_plain_response(client, status_code, body, body_length);
+    client->close_after_write = true;
+}
+
+// 请求体较大时不再放入读缓冲区：分配值，把已到达的部分移入，之后的读取直接写入值中。
+// 请求头留在缓冲区的 offset 处，请求体接收完整后连同值一起处理
+static bool start_body_stream(Reactor *reactor, ClientConnection *client, size_t offset,
+                              size_t header_length, size_t body_length) {
+    KVValue *value = kv_value_alloc(reactor->slab, body_length);
+    if (!value) return false;
+    size_t received = client->buffer_len - offset - header_length;
+    memcpy(value->data, client->buffer + offset + header_length, received);
+    client->buffer_len = offset + header_length;
+    client->buffer[client->buffer_len] = '\0';
+    client->body_value = value;
+    client->body_received = received;
+    client->header_length = header_length;
+    LOG_DEBUG("流式接收请求体，fd: %d，长度: %zu，已收到: %zu", client->fd, body_length, received);
+    return true;
+}
+
+// 移除已处理的输入，缓冲区为空时归还；返回连接在本轮处理后的状态
+static ClientState finish_client_input(Reactor *reactor, ClientConnection *client, size_t consumed) {
+    if (consumed > 0) {
+        client->buffer_len -= consumed;
+        memmove(client->buffer, client->buffer + consumed, client->buffer_len);
+        client->buffer[client->buffer_len] = '\0';
+        // 剩余的输入是下一个请求的开头，它的请求头期限从现在开始计算
+        client->request_started = client->buffer_len > 0 ? reactor->now_ms : 0;
+    }
+    if (client->buffer_len == 0 && !client->body_value) {
+        client_release_buffer(reactor, client);
+    }
+    if (client->awaiting_shard) return CLIENT_AWAITING_SHARD;
+    if (client->close_after_write) return CLIENT_CLOSE_AFTER_WRITE;
+    return client_output_full(reactor, client) ? CLIENT_OUTPUT_FULL : CLIENT_NEED_MORE;
+}
+
+// RESP 连接：依次执行缓冲区中所有完整的命令（支持流水线），应答按命令顺序追加到输出缓冲区；
+// 暂停和继续的条件与 HTTP 请求相同。单个参数不超过请求体上限，协议错误时回复错误后关闭连接
+static ClientState process_resp_input(Reactor *reactor, ClientConnection *client) {
+    size_t consumed = 0;
+    size_t max_bulk = reactor->server->max_body_size;
+    while (!client->awaiting_shard && !client->close_after_write &&
+           consumed < client->buffer_len && !client_output_full(reactor, client)) {
+        size_t available = client->buffer_len - consumed;
+        RespCommand command = {reactor->args, reactor->arg_cap, 0, 0};
+        uint64_t parse_start = metrics_start(&reactor->metrics, METRIC_STAGE_PARSE);
+        int result = resp_parse_command(client->buffer + consumed, available, max_bulk, &command);
+        metrics_finish(&reactor->metrics, METRIC_STAGE_PARSE, parse_start);
+        if (result == RESP_PARSE_NEED_ARGS) {
+            if (command.argc > MAX_COMMAND_ARGS || !reactor_reserve_args(reactor, command.argc)) {
+                LOG_DEBUG("RESP 命令参数过多，fd: %d，参数个数: %zu", client->fd, command.argc);
+                write_resp_error(client, "ERR too many arguments");
+                client->close_after_write = true;
                 break;
             }
-            case HTTP_POST: {
-                VERBOSE_LOG("执行 POST 操作");
-                if (http_req->body && http_req->body_length > 0) {
-                    VERBOSE_LOG("POST 请求体: '%.50s%s'", http_req->body, http_req->body_length > 50 ? "..." : "");
-                    if (kv_set(server->kv_store, key, http_req->body)) {
-                        VERBOSE_LOG("POST 成功");
-                        response = http_create_response(201, "Created");
-                    } else {
-                        VERBOSE_LOG("POST 失败，内部错误");
-                        response = http_create_response(500, "Internal Server Error");
-                    }
-                } else {
-                    VERBOSE_LOG("POST 失败，缺少请求体");
-                    response = http_create_response(400, "Request body required");
-                }
-                break;
+            continue;
+        }
+        if (result == RESP_PARSE_ERROR) {
+            LOG_DEBUG("RESP 命令解析失败，fd: %d", client->fd);
+            write_resp_error(client, "ERR Protocol error");
+            client->close_after_write = true;
+            break;
+        }
+        if (result == RESP_PARSE_INCOMPLETE) {
+            if (available > max_bulk + RESP_MAX_INLINE) {
+                LOG_DEBUG("RESP 命令过大，fd: %d，已缓冲: %zu", client->fd, available);
+                write_resp_error(client, "ERR Protocol error: command too large");
+                client->close_after_write = true;
+            }
+            break;
+        }
+        consumed += command.length;
+        if (command.argc > 0) {
+            metric_add(&reactor->metrics.resp_commands, 1);
+            process_resp_command(reactor, client, command.args, command.argc);
+        }
+    }
+    return finish_client_input(reactor, client, consumed);
+}
+
+// 依次处理缓冲区中所有完整的请求（支持流水线），响应按请求顺序追加到输出缓冲区
+// 请求被转发给其他分片或输出积压超过上限时暂停，应答到达或输出发送后由 IO 引擎再次调用以继续处理剩余请求
+ClientState server_process_client_input(Reactor *reactor, ClientConnection *client) {
+    LOG_DEBUG("客户端 fd %d 缓冲区总长度: %zu", client->fd, client->buffer_len);
+    if (client->protocol == CLIENT_PROTOCOL_RESP) {
+        return process_resp_input(reactor, client);
+    }
+    size_t consumed = 0;
+    client->awaiting_body = false;
+    if (client->body_value && !client_streaming_body(client) &&
+        !client->awaiting_shard && !client->close_after_write) {
+        // 流式接收的请求体已完整，请求头在缓冲区开头；缓冲区已移动过，重新解析请求头（不分配内存）
+        KVValue *body = client->body_value;
+        client->body_value = NULL;
+        HttpRequest http_req;
+        http_parse_request(client->buffer, client->header_length, NULL, &http_req);
+        process_http_request(reactor, client, client->buffer, &http_req, body);
+        kv_value_release(body);
+        consumed = client->header_length;
+        if (!client->keep_alive) {
+            client->close_after_write = true;
+        }
+    }
+    while (!client->body_value && !client->awaiting_shard && !client->close_after_write &&
+           consumed < client->buffer_len && !client_output_full(reactor, client)) {
+        char *request = client->buffer + consumed;
+        size_t available = client->buffer_len - consumed;
+        HttpRequest http_req;
+        uint64_t parse_start = metrics_start(&reactor->metrics, METRIC_STAGE_PARSE);
+        int frame = http_parse_request(request, available, &client->header_scanned, &http_req);
+        metrics_finish(&reactor->metrics, METRIC_STAGE_PARSE, parse_start);
+        // 请求头完整之前的错误响应（400、431）按未知方法计数
+        client->method = frame == HTTP_PARSE_ERROR || http_req.header_length == 0 ? HTTP_UNKNOWN : http_req.method;
+        if (frame == HTTP_PARSE_ERROR) {
+            LOG_DEBUG("HTTP 请求解析失败，fd: %d", client->fd);
+            client->keep_alive = false;
+            write_plain_response(client, 400, RESPONSE_TEXT("Bad Request"));
+            client->close_after_write = true;
+            break;
+        }
+        size_t header_len = http_req.header_length;
+        if (header_len == 0) {
+            // 请求头尚未完整
+            if (available > MAX_HEADER_SIZE) {
+                reject_request(client, 431, RESPONSE_TEXT("Request Header Fields Too Large"));
+            } else {
+                LOG_DEBUG("等待更多数据，fd: %d，当前长度: %zu", client->fd, available);
             }
-            case HTTP_DELETE: {
-                VERBOSE_LOG("执行 DELETE 操作");
-                if (kv_delete(server->kv_store, key)) {
-                    VERBOSE_LOG("DELETE 成功");
-                    response = http_create_response(204, "");
-                } else {
-                    VERBOSE_LOG("DELETE 失败，键不存在");
-                    response = http_create_response(404, "Key not found");
+            break;
+        }
+        size_t body_len = http_req.content_length;
+        if (header_len > MAX_HEADER_SIZE) {
+            reject_request(client, 431, RESPONSE_TEXT("Request Header Fields Too Large"));
+            break;
+        }
+        if (body_len > reactor->server->max_body_size) {
+            reject_request(client, 413, RESPONSE_TEXT("Payload Too Large"));
+            break;
+        }
+        if (frame == HTTP_PARSE_INCOMPLETE) {
+            if (body_len > STREAM_BODY_MIN) {
+                client->header_scanned = 0;
+                if (!start_body_stream(reactor, client, consumed, header_len, body_len)) {
+                    reject_request(client, 500, RESPONSE_TEXT("Internal Server Error"));
                 }
-                break;
+            } else {
+                client->awaiting_body = true;
             }
-            default:
-                VERBOSE_LOG("不支持的方法: %d", http_req->method);
-                response = http_create_response(405, "Method Not Allowed");
-                break;
+            break;
         }
+        size_t request_len = header_len + body_len;
+        LOG_DEBUG("检测到完整的 HTTP 请求，fd: %d，长度: %zu", client->fd, request_len);
+        client->header_scanned = 0;
+        process_http_request(reactor, client, request, &http_req, NULL);
+        consumed += request_len;
+        if (!client->keep_alive) {
+            client->close_after_write = true;
+        }
+    }
+    return finish_client_input(reactor, client, consumed);
+}
 
-        if (response) {
-            size_t response_len;
-            char *response_str = http_build_response_with_cors(response, &response_len);
-            if (response_str) {
-                VERBOSE_LOG("发送响应，状态码: %d，长度: %zu", response->status_code, response_len);
-                send(client_fd, response_str, response_len, 0);
-                free(response_str);
+// 把输出队列写到套接字，响应头和存储中的值通过 sendmsg 一次提交；
+// 套接字发送缓冲区已满时保留剩余输出，等待可写事件后继续。连接出错时返回 false
+static bool flush_client_output(Reactor *reactor, ClientConnection *client) {
+    struct iovec iov[OUT_QUEUE_MAX_IOV];
+    while (client->out.pending > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = out_queue_fill_iov(&client->out, iov, OUT_QUEUE_MAX_IOV);
+        uint64_t send_start = metrics_start(&reactor->metrics, METRIC_STAGE_SEND);
+        ssize_t n = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+        metrics_finish(&reactor->metrics, METRIC_STAGE_SEND, send_start);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                LOG_DEBUG("发送缓冲区已满，fd: %d，剩余 %zu 字节等待可写", client->fd, client->out.pending);
+                return true;
             }
-            http_free_response(response);
+            LOG_DEBUG("发送响应失败，fd: %d，剩余 %zu 字节", client->fd, client->out.pending);
+            out_queue_clear(&client->out);
+            return false;
         }
-        http_free_request(http_req);
-        VERBOSE_LOG("API 请求处理完成");
-        return;
+        out_queue_consume(&client->out, (size_t)n);
+        metric_add(&reactor->metrics.bytes_out, (size_t)n);
     }
+    return true;
+}
+
+// 事件循环引擎：只在关注的事件变化时调用 event_loop_modify
+static bool loop_set_events(Reactor *reactor, ClientConnection *client, int events) {
+    if (client->loop_events == events) return true;
+    if (!event_loop_modify(reactor->loop, client->fd, events, client)) return false;
+    client->loop_events = events;
+    return true;
+}
 
-    // 4. 所有其他请求一律返回 404
-    VERBOSE_LOG("未匹配任何路径，返回 404: %s", http_req->path);
-    HttpResponse *response = http_create_response(404, "Not Found");
-    if (response) {
-        size_t response_len;
-        char *response_str = http_build_response(response, &response_len);
-        if (response_str) {
-            send(client_fd, response_str, response_len, 0);
-            free(response_str);
+// 事件循环引擎：发送已生成的响应，未发完的部分等待可写事件；
+// 按连接状态关闭连接，或在等待跨分片应答、输出积压期间暂停读取
+static void loop_after_input(Reactor *reactor, ClientConnection *client, ClientState state) {
+    if (server_hold_client_output(reactor, client)) return;
+    for (;;) {
+        if (client->out.pending > 0 && !flush_client_output(reactor, client)) {
+            cleanup_client(reactor, client);
+            return;
         }
-        http_free_response(response);
+        server_client_output_update(reactor, client);
+        // 积压的输出已全部发出，继续处理暂停时留在缓冲区中的请求
+        if (state != CLIENT_OUTPUT_FULL || client->out.pending > 0) break;
+        state = server_process_client_input(reactor, client);
+    }
+    int events = client->out.pending > 0 ? EVENT_WRITE : 0;
+    switch (state) {
+        case CLIENT_CLOSE_AFTER_WRITE:
+            if (client->out.pending == 0) {
+                cleanup_client(reactor, client);
+                return;
+            }
+            break;
+        case CLIENT_NEED_MORE:
+            events |= EVENT_READ;
+            break;
+        case CLIENT_AWAITING_SHARD: // 等待应答期间不读取后续请求，保证响应顺序
+        case CLIENT_OUTPUT_FULL:    // 输出发出前不读取新请求
+            break;
+    }
+    if (!loop_set_events(reactor, client, events)) {
+        cleanup_client(reactor, client);
     }
-    http_free_request(http_req);
-    VERBOSE_LOG("404 响应发送完成");
-    return;
-
 }
 
-static void handle_client_data(KVServer *server, int client_fd) {
-    VERBOSE_LOG("处理客户端数据，fd: %d", client_fd);
-    ClientConnection *client = find_client(server, client_fd);
+static void handle_client_data(Reactor *reactor, int client_fd) {
+    LOG_DEBUG("处理客户端数据，fd: %d", client_fd);
+    ClientConnection *client = find_client(reactor, client_fd);
     if (!client) {
-        VERBOSE_LOG("未找到客户端连接，fd: %d", client_fd);
+        LOG_DEBUG("未找到客户端连接，fd: %d", client_fd);
         return;
     }
 
-    // 安全检查：确保缓冲区有足够空间
-    if (client->buffer_len >= BUFFER_SIZE - 1) {
-        VERBOSE_LOG("客户端缓冲区已满，fd: %d", client_fd);
-        cleanup_client(client);
+    char *target;
+    size_t space;
+    if (!server_client_read_buffer(reactor, client, &target, &space)) {
+        LOG_DEBUG("分配读缓冲区失败，fd: %d", client_fd);
+        cleanup_client(reactor, client);
         return;
     }
+    ssize_t bytes_read = recv(client_fd, target, space, 0);
 
-    ssize_t bytes_read = recv(client_fd,
-                             client->buffer + client->buffer_len,
-                             BUFFER_SIZE - client->buffer_len - 1,
-                             0);
-
-    VERBOSE_LOG("从客户端 fd %d 读取 %zd 字节", client_fd, bytes_read);
+    LOG_DEBUG("从客户端 fd %d 读取 %zd 字节", client_fd, bytes_read);
 
     if (bytes_read <= 0) {
+        if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (client->buffer_len == 0 && !client->body_value) {
+                client_release_buffer(reactor, client);
+            }
+            return;
+        }
         if (bytes_read == 0) {
-            VERBOSE_LOG("客户端 fd %d 关闭连接", client_fd);
+            LOG_DEBUG("客户端 fd %d 关闭连接", client_fd);
         } else {
-            VERBOSE_LOG("从客户端 fd %d 读取数据失败: %s", client_fd, strerror(errno));
+            LOG_DEBUG("从客户端 fd %d 读取数据失败: %s", client_fd, strerror(errno));
         }
-        cleanup_client(client);
+        cleanup_client(reactor, client);
         return;
     }
 
-    client->buffer_len += bytes_read;
-    client->buffer[client->buffer_len] = '\0';
+    server_client_read_done(reactor, client, (size_t)bytes_read);
+    loop_after_input(reactor, client, server_process_client_input(reactor, client));
+}
 
-    VERBOSE_LOG("客户端 fd %d 缓冲区总长度: %zu", client_fd, client->buffer_len);
-
-    char *request_end = strstr(client->buffer, "\r\n\r\n");
-    if (!request_end) {
-        request_end = strstr(client->buffer, "\n\n");
-    }
-
-    if (request_end) {
-        VERBOSE_LOG("检测到完整的 HTTP 请求，fd: %d", client_fd);
-        process_http_request(server, client_fd, client->buffer, client->buffer_len);
-        cleanup_client(client);
-    } else if (client->buffer_len >= BUFFER_SIZE - 1) {
-        VERBOSE_LOG("请求过大，拒绝处理，fd: %d", client_fd);
-        HttpResponse *response = http_create_response(400, "Request too large");
-        if (response) {
-            size_t response_len;
-            char *response_str = http_build_response(response, &response_len);
-            if (response_str) {
-                send(client_fd, response_str, response_len, 0);
-                free(response_str);
-            }
-            http_free_response(response);
-        }
-        cleanup_client(client);
-    } else {
-        VERBOSE_LOG("等待更多数据，fd: %d，当前长度: %zu", client_fd, client->buffer_len);
+// 事件循环引擎：跨分片应答到达后继续处理流水线中的请求并发送响应
+static void loop_complete(Reactor *reactor, ClientConnection *client) {
+    loop_after_input(reactor, client, server_process_client_input(reactor, client));
+}
+
+// 事件循环引擎：套接字可写时继续发送积压的输出，并处理因输出积压而暂停的请求
+static void handle_client_writable(Reactor *reactor, int client_fd) {
+    ClientConnection *client = find_client(reactor, client_fd);
+    if (client) {
+        loop_after_input(reactor, client, server_process_client_input(reactor, client));
     }
 }
 
-static void handle_client_disconnect(KVServer *server, int client_fd) {
-    ClientConnection *client = find_client(server, client_fd);
+static void handle_client_disconnect(Reactor *reactor, int client_fd) {
+    ClientConnection *client = find_client(reactor, client_fd);
     if (client) {
-        cleanup_client(client);
+        cleanup_client(reactor, client);
     }
 }
 
-void server_run(KVServer *server) {
-    if (!server || !server->running) return;
-    struct kevent events[MAX_EVENTS];
-    printf("服务器开始运行，按 Ctrl+C 停止...\n");
+const char* server_engine_name(ServerEngine engine) {
+    switch (engine) {
+        case SERVER_ENGINE_LOOP: return event_loop_backend();
+        case SERVER_ENGINE_IO_URING: return "io_uring";
+        default: return "unknown";
+    }
+}
+
+// 选择 IO 引擎，当前构建不支持时返回 false
+bool server_set_engine(KVServer *server, ServerEngine engine) {
+    if (!server || server->running) return false;
+#ifndef C_X_HAVE_IO_URING
+    if (engine == SERVER_ENGINE_IO_URING) return false;
+#endif
+    server->engine = engine;
+    return true;
+}
+
+static void reactor_run_loop(Reactor *reactor) {
+    KVServer *server = reactor->server;
+    LoopEvent events[MAX_EVENTS];
+    reactor->complete = loop_complete;
 
     while (server->running) {
-        int event_count = kevent(server->kqueue_fd, NULL, 0, events, MAX_EVENTS, NULL);
+        // 映射的快照分区尚未合并完时不阻塞等待，空闲的轮次用来合并；有带过期时刻的键时最多等到下一个到期
+        int event_count = event_loop_wait(reactor->loop, events, MAX_EVENTS, reactor_wait_timeout(reactor));
         if (event_count == -1) {
             if (errno == EINTR) continue;
-            perror("kevent");
+            LOG_ERROR("event_loop_wait: %s", strerror(errno));
             break;
         }
+        reactor_update_clock(reactor);
 
         for (int i = 0; i < event_count; i++) {
-            struct kevent *event = &events[i];
-            if (event->ident == (uintptr_t)server->server_fd) {
-                handle_new_connection(server);
+            LoopEvent *event = &events[i];
+            if (event->fd == reactor->server_fd) {
+                handle_new_connection(reactor, reactor->server_fd, CLIENT_PROTOCOL_HTTP);
+            } else if (event->fd == reactor->resp_fd) {
+                handle_new_connection(reactor, reactor->resp_fd, CLIENT_PROTOCOL_RESP);
+            } else if (event->fd == reactor->mailbox.wake_read_fd) {
+                shard_mailbox_ack(&reactor->mailbox, true);
+                reactor_drain_mailbox(reactor);
             } else {
-                if (event->flags & EV_EOF) {
-                    handle_client_disconnect(server, event->ident);
-                } else if (event->filter == EVFILT_READ) {
-                    handle_client_data(server, event->ident);
+                // 对端半关闭时仍先读完已到达的请求，读到 EOF 后再关闭
+                if (event->events & EVENT_ERROR) {
+                    handle_client_disconnect(reactor, event->fd);
+                } else if (event->events & EVENT_READ) {
+                    handle_client_data(reactor, event->fd);
+                } else if (event->events & EVENT_WRITE) {
+                    handle_client_writable(reactor, event->fd);
+                } else if (event->events & EVENT_EOF) {
+                    handle_client_disconnect(reactor, event->fd);
                 }
             }
         }
+        reactor_commit_log(reactor);
+        if (reactor->base) {
+            reactor_merge_base(reactor);
+        }
+        reactor_expire_keys(reactor);
+        reactor_reap_clients(reactor);
+        // 其他反应器释放的值不必等到本线程下次分配才归还所在的页
+        slab_drain_remote(reactor->slab);
+        reactor_sample_metrics(reactor);
+    }
+}
+
+static void reactor_run(Reactor *reactor) {
+    KVServer *server = reactor->server;
+    // 每个反应器在自己的线程中恢复自己的分片，值从本线程的 slab 分配；恢复完成后再设置内存上限
+    if (server->persistence) {
+        persistence_load_shard(server->persistence, reactor);
+    }
+    if (server->max_memory > 0) {
+        kv_set_memory_limit(reactor->kv_store, server->max_memory / (size_t)server->reactor_count,
+                            server->evict_policy);
+    }
+#ifdef C_X_HAVE_IO_URING
+    if (server->engine == SERVER_ENGINE_IO_URING) {
+        if (uring_engine_run(reactor)) return;
+        LOG_WARN("反应器 %d: io_uring 引擎不可用，回退到 %s 事件循环",
+                 reactor->id, event_loop_backend());
+    }
+#endif
+    reactor_run_loop(reactor);
+}
+
+static void* reactor_thread_main(void *arg) {
+    Reactor *reactor = arg;
+#ifdef __linux__
+    // 每个反应器固定在一个 CPU 上，保持分片数据在本核缓存中
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(reactor->id % CPU_SETSIZE, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    reactor_run(reactor);
+    return NULL;
+}
+
+void server_run(KVServer *server) {
+    if (!server || !server->running) return;
+    LOG_INFO("服务器开始运行，按 Ctrl+C 停止...");
+
+    // 工作线程屏蔽停止信号，信号只由运行 0 号反应器的主线程处理
+    sigset_t block, previous;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &previous);
+    int started = 1;
+    for (int i = 1; i < server->reactor_count; i++) {
+        Reactor *reactor = &server->reactors[i];
+        if (pthread_create(&reactor->thread, NULL, reactor_thread_main, reactor) != 0) {
+            LOG_ERROR("创建反应器线程 %d 失败", i);
+            server_stop(server);
+            break;
+        }
+        started++;
+    }
+    if (server->persistence && server->running && !persistence_start(server->persistence)) {
+        LOG_ERROR("创建持久化线程失败");
+        server_stop(server);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (server->running) {
+        if (server->reactor_count > 1) {
+            reactor_thread_main(&server->reactors[0]);
+        } else {
+            reactor_run(&server->reactors[0]);
+        }
+    }
+
+    server_stop(server);
+    for (int i = 1; i < started; i++) {
+        pthread_join(server->reactors[i].thread, NULL);
     }
+    // 反应器都已退出，写出并同步最后一批日志记录
+    persistence_stop(server->persistence);
 }
@@ -1,128 +1,427 @@
 #include "kv_store.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#define DEFAULT_CAPACITY 1024
+// djb2 加 64 位混合收尾，使所有位都足够随机（开放寻址引擎用低 7 位做控制字节、其余位选组）
+size_t kv_hash_key(const char *key, size_t key_length) {
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t hash = 5381;
+    for (size_t i = 0; i < key_length; i++) {
+        hash = ((hash << 5) + hash) + p[i];
+    }
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return (size_t)hash;
+}
+
+KVValue *kv_value_alloc(SlabAllocator *slab, size_t length) {
+    KVValue *value = slab_alloc(slab, sizeof(KVValue) + length + 1);
+    if (!value) return NULL;
+    atomic_init(&value->refs, 1);
+    value->length = length;
+    value->data[length] = '\0';
+    return value;
+}
+
+KVValue *kv_value_create(SlabAllocator *slab, const char *data, size_t length) {
+    KVValue *value = kv_value_alloc(slab, length);
+    if (value) {
+        memcpy(value->data, data, length);
+    }
+    return value;
+}
 
-static size_t hash_function(const char *key, size_t capacity) {
-    size_t hash = 5381;
-    int c;
-    while ((c = *key++)) {
-        hash = ((hash << 5) + hash) + c;
+KVValue *kv_value_retain(KVValue *value) {
+    if (value) {
+        atomic_fetch_add_explicit(&value->refs, 1, memory_order_relaxed);
     }
-    return hash % capacity;
+    return value;
 }
 
-static HashEntry *create_entry(const char *key, const char *value) {
-    HashEntry *entry = malloc(sizeof(HashEntry));
+void kv_value_release(KVValue *value) {
+    if (value && atomic_fetch_sub_explicit(&value->refs, 1, memory_order_acq_rel) == 1) {
+        slab_free(value, sizeof(KVValue) + value->length + 1);
+    }
+}
+
+// 键与条目在同一次分配中，比较键时不需要再访问另一块堆内存；条目持有值的一个引用
+HashEntry *kv_entry_create(SlabAllocator *slab, const char *key, size_t key_length, KVValue *value, size_t hash) {
+    if (key_length > UINT32_MAX) return NULL;
+    HashEntry *entry = slab_alloc(slab, sizeof(HashEntry) + key_length + 1);
     if (!entry) return NULL;
-    entry->key = strdup(key);
-    entry->value = strdup(value);
+    entry->key_length = (uint32_t)key_length;
+    memcpy(entry->key, key, key_length);
+    entry->key[key_length] = '\0';
+    entry->value = kv_value_retain(value);
+    entry->hash = hash;
     entry->next = NULL;
-    if (!entry->key || !entry->value) {
-        free(entry->key);
-        free(entry->value);
-        free(entry);
-        return NULL;
-    }
+    entry->expiry = NULL;
+    entry->access = 0;
     return entry;
 }
 
-static void free_entry(HashEntry *entry) {
+static void expiry_free(HashEntry *entry) {
+    timer_wheel_remove(&entry->expiry->timer);
+    slab_free(entry->expiry, sizeof(KVExpiry));
+    entry->expiry = NULL;
+}
+
+void kv_entry_free(HashEntry *entry) {
     if (entry) {
-        free(entry->key);
-        free(entry->value);
-        free(entry);
+        if (entry->expiry) {
+            expiry_free(entry);
+        }
+        kv_value_release(entry->value);
+        slab_free(entry, sizeof(HashEntry) + entry->key_length + 1);
+    }
+}
+
+uint64_t kv_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+bool kv_entry_expired(const HashEntry *entry) {
+    return entry->expiry && entry->expiry->timer.expire <= kv_now_ms();
+}
+
+// 过期定时器在条目 attach 之后才分配或释放，单独计入内存
+bool kv_entry_set_expire(KVStore *store, HashEntry *entry, uint64_t expire_ms) {
+    if (expire_ms == 0) {
+        if (entry->expiry) {
+            expiry_free(entry);
+            kv_memory_uncharge(store, slab_object_size(sizeof(KVExpiry)));
+        }
+        return true;
+    }
+    if (!entry->expiry) {
+        KVExpiry *expiry = slab_alloc(kv_store_allocator(store), sizeof(KVExpiry));
+        if (!expiry) return false;
+        memset(&expiry->timer, 0, sizeof(expiry->timer));
+        expiry->entry = entry;
+        entry->expiry = expiry;
+        kv_memory_charge(store, slab_object_size(sizeof(KVExpiry)));
+    }
+    timer_wheel_add(kv_store_timers(store), &entry->expiry->timer, expire_ms);
+    return true;
+}
+
+bool kv_set_value(KVStore *store, const char *key, size_t key_length, KVValue *value) {
+    return kv_set_value_expire(store, key, key_length, value, 0);
+}
+
+bool kv_set_expire(KVStore *store, const char *key, size_t key_length, uint64_t expire_ms) {
+    HashEntry *entry = store && key ? kv_find_entry(store, key, key_length) : NULL;
+    return entry && kv_entry_set_expire(store, entry, expire_ms);
+}
+
+bool kv_get_expire(KVStore *store, const char *key, size_t key_length, uint64_t *expire_ms) {
+    HashEntry *entry = store && key ? kv_find_entry(store, key, key_length) : NULL;
+    if (!entry) return false;
+    *expire_ms = kv_entry_expire(entry);
+    return true;
+}
+
+// 时间轮的刻度不后退：系统时钟回拨时，已经推进过的时间内的键照常删除
+size_t kv_expire(KVStore *store, uint64_t now_ms, size_t budget) {
+    kv_store_evictor(store)->now_ms = now_ms;
+    size_t removed = 0;
+    TimerNode *node;
+    while ((node = timer_wheel_expire(kv_store_timers(store), now_ms, &budget)) != NULL) {
+        HashEntry *entry = ((KVExpiry *)node)->entry;
+        kv_delete(store, entry->key, entry->key_length);
+        removed++;
+    }
+    return removed;
+}
+
+uint64_t kv_next_expire(KVStore *store) {
+    return timer_wheel_next(kv_store_timers(store));
+}
+
+// 计数只由所有者线程修改，其他线程只读，不需要原子的读-改-写
+static inline void counter_add(atomic_size_t *counter, size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+static inline void counter_sub(atomic_size_t *counter, size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) - delta, memory_order_relaxed);
+}
+
+void kv_memory_charge(KVStore *store, size_t bytes) {
+    counter_add(&kv_store_evictor(store)->memory, bytes);
+}
+
+void kv_memory_uncharge(KVStore *store, size_t bytes) {
+    counter_sub(&kv_store_evictor(store)->memory, bytes);
+}
+
+size_t kv_value_memory(const KVValue *value) {
+    return slab_object_size(sizeof(KVValue) + value->length + 1);
+}
+
+size_t kv_entry_memory(const HashEntry *entry) {
+    size_t bytes = slab_object_size(sizeof(HashEntry) + entry->key_length + 1) + kv_value_memory(entry->value);
+    return entry->expiry ? bytes + slab_object_size(sizeof(KVExpiry)) : bytes;
+}
+
+// xorshift64*，只用于选择取样位置和 LFU 的概率递增
+static uint64_t next_random(KVEvictor *evictor) {
+    uint64_t x = evictor->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    evictor->rng = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// LRU 的访问刻度为 16 毫秒，32 位约两年一轮，按无符号差值比较
+#define LRU_CLOCK_SHIFT 4
+
+static uint32_t lru_clock(const KVEvictor *evictor) {
+    return (uint32_t)(evictor->now_ms >> LRU_CLOCK_SHIFT);
+}
+
+// LFU 的 access：高 24 位为最近一次衰减的分钟数，低 8 位为对数计数。计数越大递增概率越低
+// （约 100 万次访问到达 255），每闲置一分钟减一；新键从 LFU_INIT 开始，避免刚写入就被淘汰
+#define LFU_INIT 5
+#define LFU_LOG_FACTOR 10
+#define LFU_MINUTE_MASK 0xFFFFFFu
+
+static uint32_t lfu_minutes(const KVEvictor *evictor) {
+    return (uint32_t)(evictor->now_ms / 60000) & LFU_MINUTE_MASK;
+}
+
+static uint32_t lfu_decayed(const KVEvictor *evictor, uint32_t access) {
+    uint32_t idle = (lfu_minutes(evictor) - (access >> 8)) & LFU_MINUTE_MASK;
+    uint32_t counter = access & 0xFF;
+    return idle < counter ? counter - idle : 0;
+}
+
+static uint32_t lfu_increment(KVEvictor *evictor, uint32_t counter) {
+    if (counter == 255) return counter;
+    double base = counter > LFU_INIT ? (double)(counter - LFU_INIT) : 0.0;
+    double random = (double)(next_random(evictor) >> 11) / (double)(1ULL << 53);
+    return random < 1.0 / (base * LFU_LOG_FACTOR + 1.0) ? counter + 1 : counter;
+}
+
+static void entry_access(KVEvictor *evictor, HashEntry *entry) {
+    switch (evictor->policy) {
+        case KV_EVICT_CLOCK:
+            entry->access = 1;
+            break;
+        case KV_EVICT_LRU:
+            entry->access = lru_clock(evictor);
+            break;
+        case KV_EVICT_LFU:
+            entry->access = lfu_minutes(evictor) << 8 | lfu_increment(evictor, lfu_decayed(evictor, entry->access));
+            break;
+        case KV_EVICT_NONE:
+            break;
     }
 }
 
-KVStore *kv_store_create(size_t initial_capacity) {
-    if (initial_capacity == 0) {
-        initial_capacity = DEFAULT_CAPACITY;
+void kv_entry_attach(KVStore *store, HashEntry *entry) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    counter_add(&evictor->memory, kv_entry_memory(entry));
+    if (evictor->policy == KV_EVICT_LFU) {
+        entry->access = lfu_minutes(evictor) << 8 | LFU_INIT;
+    } else {
+        entry_access(evictor, entry);
     }
-    KVStore *store = malloc(sizeof(KVStore));
-    if (!store) return NULL;
-    store->buckets = calloc(initial_capacity, sizeof(HashEntry *));
-    if (!store->buckets) {
-        free(store);
-        return NULL;
+}
+
+void kv_entry_detach(KVStore *store, HashEntry *entry) {
+    counter_sub(&kv_store_evictor(store)->memory, kv_entry_memory(entry));
+}
+
+void kv_entry_replace_value(KVStore *store, HashEntry *entry, KVValue *value) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    KVValue *old_value = entry->value;
+    counter_add(&evictor->memory, kv_value_memory(value));
+    counter_sub(&evictor->memory, kv_value_memory(old_value));
+    entry->value = kv_value_retain(value);
+    kv_value_release(old_value);
+    entry_access(evictor, entry);
+}
+
+void kv_entry_touch(KVStore *store, HashEntry *entry) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    if (!entry) {
+        counter_add(&evictor->misses, 1);
+        return;
     }
-    store->capacity = initial_capacity;
-    store->size = 0;
-    return store;
+    counter_add(&evictor->hits, 1);
+    entry_access(evictor, entry);
+}
+
+static void evict_entry(KVStore *store, KVEvictor *evictor, HashEntry *entry) {
+    if (evictor->on_evict) {
+        evictor->on_evict(evictor->evict_arg, entry);
+    }
+    kv_delete(store, entry->key, entry->key_length);
+    counter_add(&evictor->evictions, 1);
+}
+
+static bool within_limit(const KVEvictor *evictor, size_t needed) {
+    return atomic_load_explicit(&evictor->memory, memory_order_relaxed) + needed <= evictor->limit;
 }
 
-void kv_store_destroy(KVStore *store) {
-    if (!store) return;
-    for (size_t i = 0; i < store->capacity; i++) {
-        HashEntry *entry = store->buckets[i];
-        while (entry) {
-            HashEntry *next = entry->next;
-            free_entry(entry);
-            entry = next;
+// CLOCK：从指针处取出一批条目，引用位为 1 的清零后跳过，为 0 的淘汰，直到腾出 needed 字节。
+// 每个条目最多被跳过一次，除 keep 外至少还有一个条目时两圈之内一定能淘汰
+static void evict_clock(KVStore *store, KVEvictor *evictor, const HashEntry *keep, size_t needed) {
+    HashEntry *batch[KV_CLOCK_BATCH];
+    size_t count = kv_scan_entries(store, &evictor->cursor, batch, KV_CLOCK_BATCH);
+    for (size_t i = 0; i < count && !within_limit(evictor, needed); i++) {
+        if (batch[i] == keep) continue;
+        if (batch[i]->access) {
+            batch[i]->access = 0;
+        } else {
+            evict_entry(store, evictor, batch[i]);
         }
     }
-    free(store->buckets);
-    free(store);
 }
 
-bool kv_set(KVStore *store, const char *key, const char *value) {
-    if (!store || !key || !value) return false;
-    size_t index = hash_function(key, store->capacity);
-    HashEntry *entry = store->buckets[index];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            char *new_value = strdup(value);
-            if (!new_value) return false;
-            free(entry->value);
-            entry->value = new_value;
-            return true;
+// 取样淘汰：从随机槽位起取 KV_EVICT_SAMPLES 个条目，淘汰其中闲置最久（LRU）或计数最低（LFU）的
+static void evict_sampled(KVStore *store, KVEvictor *evictor, const HashEntry *keep) {
+    HashEntry *samples[KV_EVICT_SAMPLES];
+    size_t cursor = (size_t)next_random(evictor);
+    size_t count = kv_scan_entries(store, &cursor, samples, KV_EVICT_SAMPLES);
+    HashEntry *victim = NULL;
+    uint32_t best = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i] == keep) continue;
+        uint32_t score = evictor->policy == KV_EVICT_LRU ? lru_clock(evictor) - samples[i]->access
+                                                         : 255 - lfu_decayed(evictor, samples[i]->access);
+        if (!victim || score > best) {
+            victim = samples[i];
+            best = score;
         }
-        entry = entry->next;
     }
-    HashEntry *new_entry = create_entry(key, value);
-    if (!new_entry) return false;
-    new_entry->next = store->buckets[index];
-    store->buckets[index] = new_entry;
-    store->size++;
-    return true;
+    if (victim) {
+        evict_entry(store, evictor, victim);
+    }
 }
 
-char *kv_get(KVStore *store, const char *key) {
-    if (!store || !key) return NULL;
-    size_t index = hash_function(key, store->capacity);
-    HashEntry *entry = store->buckets[index];
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            return strdup(entry->value);
+bool kv_reserve(KVStore *store, const HashEntry *existing, size_t key_length, const KVValue *value,
+                uint64_t expire_ms) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    if (evictor->limit == 0) return true;
+    size_t needed = kv_value_memory(value);
+    if (existing) {
+        size_t old = kv_value_memory(existing->value);
+        needed = needed > old ? needed - old : 0;
+    } else {
+        needed += slab_object_size(sizeof(HashEntry) + key_length + 1);
+    }
+    if (expire_ms != 0 && !(existing && existing->expiry)) {
+        needed += slab_object_size(sizeof(KVExpiry));
+    }
+    if (needed == 0 || within_limit(evictor, needed)) return true;
+    if (evictor->policy == KV_EVICT_NONE || needed > evictor->limit) return false;
+    evictor->now_ms = kv_now_ms();
+    while (!within_limit(evictor, needed)) {
+        if (kv_size(store) <= (existing ? 1 : 0)) return false;
+        if (evictor->policy == KV_EVICT_CLOCK) {
+            evict_clock(store, evictor, existing, needed);
+        } else {
+            evict_sampled(store, evictor, existing);
         }
-        entry = entry->next;
-    }
-    return NULL;
-}
-
-bool kv_delete(KVStore *store, const char *key) {
-    if (!store || !key) return false;
-    size_t index = hash_function(key, store->capacity);
-    HashEntry *entry = store->buckets[index];
-    HashEntry *prev = NULL;
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            if (prev) {
-                prev->next = entry->next;
-            } else {
-                store->buckets[index] = entry->next;
-            }
-            free_entry(entry);
-            store->size--;
+    }
+    return true;
+}
+
+void kv_set_memory_limit(KVStore *store, size_t bytes, KVEvictPolicy policy) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    evictor->limit = bytes;
+    evictor->policy = policy;
+    evictor->now_ms = kv_now_ms();
+    evictor->rng = ((uint64_t)(uintptr_t)store ^ evictor->now_ms) | 1;
+}
+
+void kv_set_evict_callback(KVStore *store, KVEvictFn on_evict, void *arg) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    evictor->on_evict = on_evict;
+    evictor->evict_arg = arg;
+}
+
+bool kv_memory_fits(KVStore *store, size_t key_length, size_t value_length) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    return evictor->limit == 0 ||
+           within_limit(evictor, slab_object_size(sizeof(HashEntry) + key_length + 1) +
+                                 slab_object_size(sizeof(KVValue) + value_length + 1));
+}
+
+void kv_cache_stats(KVStore *store, KVCacheStats *stats) {
+    KVEvictor *evictor = kv_store_evictor(store);
+    stats->memory = atomic_load_explicit(&evictor->memory, memory_order_relaxed);
+    stats->limit = evictor->limit;
+    stats->hits = atomic_load_explicit(&evictor->hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&evictor->misses, memory_order_relaxed);
+    stats->evictions = atomic_load_explicit(&evictor->evictions, memory_order_relaxed);
+}
+
+static const char *const evict_policy_names[] = {"noeviction", "clock", "lru", "lfu"};
+
+const char *kv_evict_policy_name(KVEvictPolicy policy) {
+    return policy <= KV_EVICT_LFU ? evict_policy_names[policy] : "unknown";
+}
+
+bool kv_evict_policy_parse(const char *name, KVEvictPolicy *policy) {
+    for (int i = KV_EVICT_NONE; i <= KV_EVICT_LFU; i++) {
+        if (strcmp(name, evict_policy_names[i]) == 0) {
+            *policy = (KVEvictPolicy)i;
             return true;
         }
-        prev = entry;
-        entry = entry->next;
     }
     return false;
 }
 
-size_t kv_size(KVStore *store) {
-    return store ? store->size : 0;
+bool kv_set(KVStore *store, const char *key, size_t key_length, const char *value, size_t value_length) {
+    if (!store || !key || !value) return false;
+    KVValue *stored = kv_value_create(kv_store_allocator(store), value, value_length);
+    if (!stored) return false;
+    bool ok = kv_set_value(store, key, key_length, stored);
+    kv_value_release(stored);
+    return ok;
+}
+
+char *kv_get(KVStore *store, const char *key, size_t key_length, size_t *value_length) {
+    KVValue *value = kv_get_value(store, key, key_length);
+    if (!value) return NULL;
+    char *copy = malloc(value->length + 1);
+    if (copy) {
+        memcpy(copy, value->data, value->length + 1);
+        if (value_length) {
+            *value_length = value->length;
+        }
+    }
+    kv_value_release(value);
+    return copy;
+}
+
+void kv_store_memory(KVStore *store, SlabStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (store) {
+        slab_stats(kv_store_allocator(store), stats);
+    }
+}
+
+size_t kv_shard_index(const char *key, size_t key_length, size_t shard_count) {
+    if (!key || shard_count <= 1) return 0;
+    // FNV-1a 加 64 位混合收尾
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *p = (const unsigned char *)key;
+    for (size_t i = 0; i < key_length; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return (size_t)(hash % shard_count);
 }
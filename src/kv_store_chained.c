@@ -0,0 +1,364 @@
+#include "kv_store.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY 1024
+#define REHASH_STEP 1             // 每次操作迁移的非空桶数
+#define REHASH_EMPTY_VISITS 10    // 每迁移一个桶最多跳过的空桶数，限制单次操作的工作量
+#define GROW_LOAD_FACTOR 1        // 条目数达到容量的该倍数时扩容
+#define SHRINK_LOAD_FACTOR 8      // 条目数低于容量的 1/8 时缩容
+
+// 单个桶数组，容量为 2 的幂
+typedef struct {
+    HashEntry **buckets;
+    size_t capacity;
+    size_t used;
+} HashTable;
+
+// 链地址法引擎：扩容/缩容时新旧两张表并存，
+// 条目在之后的每次操作中逐桶迁移（渐进式 rehash），避免单个请求承担整表迁移
+struct KVStore {
+    HashTable tables[2]; // tables[1] 仅在 rehash 期间使用
+    long rehash_index;   // 下一个待迁移的旧表桶，-1 表示未在 rehash
+    size_t min_capacity; // 缩容下限（创建时的容量）
+    size_t size;
+    SlabAllocator *slab; // 条目从这里分配
+    bool owns_slab;
+    TimerWheel timers;   // 带过期时刻的键的定时器
+    bool loading;        // 正在重放日志：访问时不删除过期的键
+    KVEvictor evictor;   // 内存上限、淘汰状态和命中统计
+};
+
+static size_t round_up_power_of_two(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static bool table_init(HashTable *table, size_t capacity) {
+    table->buckets = calloc(capacity, sizeof(HashEntry *));
+    if (!table->buckets) return false;
+    table->capacity = capacity;
+    table->used = 0;
+    return true;
+}
+
+static size_t table_memory(size_t capacity) {
+    return capacity * sizeof(HashEntry *);
+}
+
+static void table_free(HashTable *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        HashEntry *entry = table->buckets[i];
+        while (entry) {
+            HashEntry *next = entry->next;
+            kv_entry_free(entry);
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = NULL;
+    table->capacity = 0;
+    table->used = 0;
+}
+
+static bool is_rehashing(const KVStore *store) {
+    return store->rehash_index != -1;
+}
+
+static void check_load_factor(KVStore *store);
+
+// 迁移最多 steps 个非空旧桶；全部迁移完成后用新表替换旧表
+static void rehash_step(KVStore *store, size_t steps) {
+    if (!is_rehashing(store)) return;
+    HashTable *from = &store->tables[0];
+    HashTable *to = &store->tables[1];
+    size_t empty_visits = steps * REHASH_EMPTY_VISITS;
+    while (steps > 0 && from->used > 0) {
+        while (from->buckets[store->rehash_index] == NULL) {
+            store->rehash_index++;
+            if (--empty_visits == 0) return;
+        }
+        HashEntry *entry = from->buckets[store->rehash_index];
+        while (entry) {
+            HashEntry *next = entry->next;
+            size_t index = entry->hash & (to->capacity - 1);
+            entry->next = to->buckets[index];
+            to->buckets[index] = entry;
+            from->used--;
+            to->used++;
+            entry = next;
+        }
+        from->buckets[store->rehash_index] = NULL;
+        store->rehash_index++;
+        steps--;
+    }
+    if (from->used == 0) {
+        kv_memory_uncharge(store, table_memory(from->capacity));
+        free(from->buckets);
+        *from = *to;
+        memset(to, 0, sizeof(*to));
+        store->rehash_index = -1;
+        // 目标容量按开始时的条目数计算，迁移期间的写入和删除不会再触发调整，完成后重新检查；
+        // 否则删除停止后表会停在中间的容量上
+        check_load_factor(store);
+    }
+}
+
+// 开始渐进式 rehash 到新容量；分配失败时保持原表继续工作
+static void start_resize(KVStore *store, size_t capacity) {
+    if (is_rehashing(store) || capacity == store->tables[0].capacity) return;
+    if (!table_init(&store->tables[1], capacity)) return;
+    kv_memory_charge(store, table_memory(capacity));
+    store->rehash_index = 0;
+}
+
+// 根据负载因子决定是否扩容或缩容
+static void check_load_factor(KVStore *store) {
+    if (is_rehashing(store)) return;
+    size_t capacity = store->tables[0].capacity;
+    if (store->size >= capacity * GROW_LOAD_FACTOR) {
+        start_resize(store, capacity * 2);
+    } else if (capacity > store->min_capacity && store->size < capacity / SHRINK_LOAD_FACTOR) {
+        size_t target = round_up_power_of_two(store->size * 2);
+        start_resize(store, target < store->min_capacity ? store->min_capacity : target);
+    }
+}
+
+// 在两张表中查找键，返回指向该条目链接指针的指针（便于删除），不存在时返回 NULL
+static HashEntry **find_entry(KVStore *store, const char *key, size_t key_length, size_t hash,
+                              HashTable **table_out) {
+    for (int t = 0; t < 2; t++) {
+        HashTable *table = &store->tables[t];
+        if (table->capacity == 0) break;
+        HashEntry **link = &table->buckets[hash & (table->capacity - 1)];
+        while (*link) {
+            if ((*link)->hash == hash && (*link)->key_length == key_length &&
+                memcmp((*link)->key, key, key_length) == 0) {
+                if (table_out) *table_out = table;
+                return link;
+            }
+            link = &(*link)->next;
+        }
+        if (!is_rehashing(store)) break;
+    }
+    return NULL;
+}
+
+// 从链表中摘下 link 指向的条目并释放
+static void remove_at(KVStore *store, HashTable *table, HashEntry **link) {
+    HashEntry *entry = *link;
+    *link = entry->next;
+    kv_entry_detach(store, entry);
+    kv_entry_free(entry);
+    table->used--;
+    store->size--;
+    check_load_factor(store);
+}
+
+// 查找未过期的条目，过期的顺便删除
+static HashEntry *find_live(KVStore *store, const char *key, size_t key_length, size_t hash) {
+    HashTable *table = NULL;
+    HashEntry **link = find_entry(store, key, key_length, hash, &table);
+    if (!link) return NULL;
+    if (!store->loading && kv_entry_expired(*link)) {
+        remove_at(store, table, link);
+        return NULL;
+    }
+    return *link;
+}
+
+KVStore *kv_store_create(size_t initial_capacity, SlabAllocator *slab) {
+    if (initial_capacity == 0) {
+        initial_capacity = DEFAULT_CAPACITY;
+    }
+    initial_capacity = round_up_power_of_two(initial_capacity);
+    KVStore *store = calloc(1, sizeof(KVStore));
+    if (!store) return NULL;
+    if (!slab) {
+        slab = slab_create();
+        store->owns_slab = true;
+    }
+    if (!slab || !table_init(&store->tables[0], initial_capacity)) {
+        if (store->owns_slab) {
+            slab_destroy(slab);
+        }
+        free(store);
+        return NULL;
+    }
+    store->slab = slab;
+    store->rehash_index = -1;
+    store->min_capacity = initial_capacity;
+    store->size = 0;
+    timer_wheel_init(&store->timers, kv_now_ms());
+    kv_memory_charge(store, table_memory(initial_capacity));
+    return store;
+}
+
+void kv_store_destroy(KVStore *store) {
+    if (!store) return;
+    table_free(&store->tables[0]);
+    table_free(&store->tables[1]);
+    if (store->owns_slab) {
+        slab_destroy(store->slab);
+    }
+    free(store);
+}
+
+bool kv_set_value_expire(KVStore *store, const char *key, size_t key_length, KVValue *value, uint64_t expire_ms) {
+    if (!store || !key || !value) return false;
+    rehash_step(store, REHASH_STEP);
+    size_t hash = kv_hash_key(key, key_length);
+    HashEntry **link = find_entry(store, key, key_length, hash, NULL);
+    // 淘汰可能删除同一链表中的其他条目，之后只使用条目指针，不再使用 link
+    HashEntry *entry = link ? *link : NULL;
+    if (!kv_reserve(store, entry, key_length, value, expire_ms)) return false;
+    if (entry) {
+        if (!kv_entry_set_expire(store, entry, expire_ms)) return false;
+        kv_entry_replace_value(store, entry, value);
+        return true;
+    }
+    HashEntry *new_entry = kv_entry_create(store->slab, key, key_length, value, hash);
+    if (!new_entry) return false;
+    kv_entry_attach(store, new_entry);
+    if (!kv_entry_set_expire(store, new_entry, expire_ms)) {
+        kv_entry_detach(store, new_entry);
+        kv_entry_free(new_entry);
+        return false;
+    }
+    // rehash 期间新条目直接写入新表
+    HashTable *table = &store->tables[is_rehashing(store) ? 1 : 0];
+    size_t index = hash & (table->capacity - 1);
+    new_entry->next = table->buckets[index];
+    table->buckets[index] = new_entry;
+    table->used++;
+    store->size++;
+    check_load_factor(store);
+    return true;
+}
+
+KVValue *kv_get_value(KVStore *store, const char *key, size_t key_length) {
+    if (!store || !key) return NULL;
+    rehash_step(store, REHASH_STEP);
+    HashEntry *entry = find_live(store, key, key_length, kv_hash_key(key, key_length));
+    kv_entry_touch(store, entry);
+    return entry ? kv_value_retain(entry->value) : NULL;
+}
+
+HashEntry *kv_find_entry(KVStore *store, const char *key, size_t key_length) {
+    rehash_step(store, REHASH_STEP);
+    return find_live(store, key, key_length, kv_hash_key(key, key_length));
+}
+
+void kv_get_values(KVStore *store, const KVKey *keys, size_t count, KVValue **values) {
+    size_t hashes[KV_BATCH_WINDOW];
+    for (size_t base = 0; base < count; base += KV_BATCH_WINDOW) {
+        size_t n = count - base < KV_BATCH_WINDOW ? count - base : KV_BATCH_WINDOW;
+        rehash_step(store, REHASH_STEP);
+        // 第一遍预取桶槽，第二遍预取链表头条目，第三遍探测时两级访问大多已在缓存中
+        const HashTable *table = &store->tables[0];
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = kv_hash_key(keys[base + i].data, keys[base + i].length);
+            __builtin_prefetch(&table->buckets[hashes[i] & (table->capacity - 1)]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            HashEntry *head = table->buckets[hashes[i] & (table->capacity - 1)];
+            if (head) __builtin_prefetch(head);
+        }
+        for (size_t i = 0; i < n; i++) {
+            HashEntry *entry = find_live(store, keys[base + i].data, keys[base + i].length, hashes[i]);
+            kv_entry_touch(store, entry);
+            values[base + i] = entry ? kv_value_retain(entry->value) : NULL;
+        }
+    }
+}
+
+bool kv_delete(KVStore *store, const char *key, size_t key_length) {
+    if (!store || !key) return false;
+    rehash_step(store, REHASH_STEP);
+    HashTable *table = NULL;
+    HashEntry **link = find_entry(store, key, key_length, kv_hash_key(key, key_length), &table);
+    if (!link) return false;
+    // 已过期的键同样删除，但按不存在处理
+    bool expired = !store->loading && kv_entry_expired(*link);
+    remove_at(store, table, link);
+    return !expired;
+}
+
+void kv_store_foreach(KVStore *store, KVVisitFn visit, void *arg) {
+    for (int t = 0; t < 2; t++) {
+        HashTable *table = &store->tables[t];
+        for (size_t i = 0; i < table->capacity; i++) {
+            for (HashEntry *entry = table->buckets[i]; entry; entry = entry->next) {
+                if (!visit(arg, entry)) return;
+            }
+        }
+    }
+}
+
+size_t kv_size(KVStore *store) {
+    return store ? store->size : 0;
+}
+
+SlabAllocator *kv_store_allocator(KVStore *store) {
+    return store->slab;
+}
+
+TimerWheel *kv_store_timers(KVStore *store) {
+    return &store->timers;
+}
+
+KVEvictor *kv_store_evictor(KVStore *store) {
+    return &store->evictor;
+}
+
+// 槽位编号先是 tables[0] 的桶，rehash 期间接着是 tables[1] 的桶；一个桶中的条目一起取出（超过 max 的部分跳过），
+// 最多访问一整圈
+size_t kv_scan_entries(KVStore *store, size_t *cursor, HashEntry **out, size_t max) {
+    size_t total = store->tables[0].capacity + store->tables[1].capacity;
+    size_t slot = *cursor % total;
+    size_t count = 0;
+    for (size_t visited = 0; visited < total && count < max; visited++) {
+        const HashTable *table = &store->tables[slot < store->tables[0].capacity ? 0 : 1];
+        size_t index = table == &store->tables[0] ? slot : slot - store->tables[0].capacity;
+        for (HashEntry *entry = table->buckets[index]; entry && count < max; entry = entry->next) {
+            out[count++] = entry;
+        }
+        slot = slot + 1 == total ? 0 : slot + 1;
+    }
+    *cursor = slot;
+    return count;
+}
+
+void kv_table_sample(KVStore *store, size_t *cursor, size_t samples, KVTableStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    size_t total = store->tables[0].capacity + store->tables[1].capacity;
+    stats->capacity = total;
+    if (samples > total) samples = total;
+    if (samples == 0) return;
+    size_t stride = total / samples;
+    size_t offset = *cursor % stride;
+    *cursor = offset + 1;
+    for (size_t i = 0; i < samples; i++) {
+        size_t slot = i * stride + offset;
+        const HashTable *table = &store->tables[slot < store->tables[0].capacity ? 0 : 1];
+        size_t index = table == &store->tables[0] ? slot : slot - store->tables[0].capacity;
+        size_t length = 0;
+        for (const HashEntry *entry = table->buckets[index]; entry; entry = entry->next) {
+            length++;
+        }
+        stats->chains[length < KV_CHAIN_LENGTHS ? length : KV_CHAIN_LENGTHS - 1]++;
+    }
+    stats->sampled = samples;
+}
+
+void kv_set_loading(KVStore *store, bool loading) {
+    store->loading = loading;
+}
+
+const char *kv_store_engine(void) {
+    return "chained";
+}
@@ -0,0 +1,532 @@
+#include "kv_store.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 开放寻址（Swiss table）引擎：每个槽位有一个控制字节，一次比较一组控制字节找出候选槽位，
+// 只有控制字节匹配（误判率 1/128）时才访问条目本身，探测过程不追链表指针
+
+#define DEFAULT_CAPACITY 1024
+#define MIGRATE_SLOTS 64        // 每次操作从旧表迁移的槽位数（渐进式 rehash）
+#define MAX_LOAD_NUM 7          // 最大负载因子 7/8
+#define MAX_LOAD_DEN 8
+#define SHRINK_LOAD_FACTOR 8    // 条目数低于容量的 1/8 时缩容
+
+// 控制字节：最高位为 1 表示空槽或墓碑，否则低 7 位是哈希的 H2 部分
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+
+// 组宽度与匹配结果：SIMD 下每个槽位对应掩码中的 1 位，标量下对应 1 个字节的最高位
+#if defined(__AVX2__)
+#define GROUP_WIDTH 32
+#define MASK_SHIFT 0
+typedef uint32_t GroupMask;
+#elif defined(__SSE2__)
+#define GROUP_WIDTH 16
+#define MASK_SHIFT 0
+typedef uint32_t GroupMask;
+#else
+#define GROUP_WIDTH 8
+#define MASK_SHIFT 3
+typedef uint64_t GroupMask;
+#define SWAR_LSBS 0x0101010101010101ULL
+#define SWAR_MSBS 0x8080808080808080ULL
+#endif
+
+typedef struct {
+    uint8_t *ctrl;       // capacity + GROUP_WIDTH 个字节，末尾复制开头一组以便环绕读取
+    HashEntry **slots;
+    size_t capacity;     // 2 的幂，不小于 GROUP_WIDTH
+    size_t used;         // 有效条目数
+    size_t growth_left;  // 达到最大负载前还能占用的空槽数（墓碑不计入）
+} SwissTable;
+
+// 扩容/缩容或清理墓碑时新旧两张表并存，旧表槽位在之后的操作中逐步迁移
+struct KVStore {
+    SwissTable tables[2];  // tables[1] 仅在迁移期间使用
+    long migrate_index;    // 下一个待迁移的旧表槽位，-1 表示未在迁移
+    size_t min_capacity;   // 缩容下限（创建时的容量）
+    size_t size;
+    SlabAllocator *slab;   // 条目从这里分配
+    bool owns_slab;
+    TimerWheel timers;     // 带过期时刻的键的定时器
+    bool loading;          // 正在重放日志：访问时不删除过期的键
+    KVEvictor evictor;     // 内存上限、淘汰状态和命中统计
+};
+
+static inline uint8_t hash_h2(size_t hash) {
+    return (uint8_t)(hash & 0x7F);
+}
+
+static inline size_t hash_h1(size_t hash) {
+    return hash >> 7;
+}
+
+#if defined(__AVX2__)
+static inline GroupMask group_match(const uint8_t *ctrl, uint8_t h2) {
+    __m256i group = _mm256_loadu_si256((const __m256i *)ctrl);
+    return (GroupMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)h2)));
+}
+
+static inline GroupMask group_match_empty(const uint8_t *ctrl) {
+    return group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline GroupMask group_match_free(const uint8_t *ctrl) {
+    return (GroupMask)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)ctrl));
+}
+#elif defined(__SSE2__)
+static inline GroupMask group_match(const uint8_t *ctrl, uint8_t h2) {
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static inline GroupMask group_match_empty(const uint8_t *ctrl) {
+    return group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline GroupMask group_match_free(const uint8_t *ctrl) {
+    return (GroupMask)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+// 第 i 个控制字节放在第 i 个低位字节，mask_first 的位序与槽位顺序一致；小端机器上直接读取，
+// 其他字节序逐字节组装（编译器在大端机器上会合成为一次读取加字节交换）
+static inline uint64_t group_load(const uint8_t *ctrl) {
+    uint64_t group;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&group, ctrl, sizeof(group));
+#else
+    group = 0;
+    for (int i = 0; i < GROUP_WIDTH; i++) {
+        group |= (uint64_t)ctrl[i] << (8 * i);
+    }
+#endif
+    return group;
+}
+
+// 字节内零值检测：可能有误报，调用方会再比较完整哈希和键
+static inline GroupMask group_match(const uint8_t *ctrl, uint8_t h2) {
+    uint64_t x = group_load(ctrl) ^ (SWAR_LSBS * h2);
+    return (x - SWAR_LSBS) & ~x & SWAR_MSBS;
+}
+
+// 空槽的第 1 位为 0，墓碑为 1，有效槽位最高位为 0；结果精确
+static inline GroupMask group_match_empty(const uint8_t *ctrl) {
+    uint64_t group = group_load(ctrl);
+    return group & ~(group << 6) & SWAR_MSBS;
+}
+
+static inline GroupMask group_match_free(const uint8_t *ctrl) {
+    uint64_t group = group_load(ctrl);
+    return group & ~(group << 7) & SWAR_MSBS;
+}
+#endif
+
+static inline size_t mask_first(GroupMask mask) {
+    return (size_t)__builtin_ctzll((unsigned long long)mask) >> MASK_SHIFT;
+}
+
+static inline GroupMask mask_next(GroupMask mask) {
+    return mask & (mask - 1);
+}
+
+static size_t round_up_power_of_two(size_t n) {
+    size_t capacity = GROUP_WIDTH;
+    while (capacity < n) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static size_t max_load(size_t capacity) {
+    return capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
+
+static size_t table_memory(size_t capacity) {
+    return capacity + GROUP_WIDTH + capacity * sizeof(HashEntry *);
+}
+
+static bool table_init(SwissTable *table, size_t capacity) {
+    table->ctrl = malloc(capacity + GROUP_WIDTH);
+    table->slots = malloc(capacity * sizeof(HashEntry *));
+    if (!table->ctrl || !table->slots) {
+        free(table->ctrl);
+        free(table->slots);
+        table->ctrl = NULL;
+        table->slots = NULL;
+        return false;
+    }
+    memset(table->ctrl, CTRL_EMPTY, capacity + GROUP_WIDTH);
+    table->capacity = capacity;
+    table->used = 0;
+    table->growth_left = max_load(capacity);
+    return true;
+}
+
+static void table_release(SwissTable *table) {
+    free(table->ctrl);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static void table_free_entries(SwissTable *table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (!(table->ctrl[i] & CTRL_EMPTY)) {
+            kv_entry_free(table->slots[i]);
+        }
+    }
+}
+
+// 设置控制字节，开头一组同时写入末尾的副本
+static inline void set_ctrl(SwissTable *table, size_t index, uint8_t value) {
+    table->ctrl[index] = value;
+    if (index < GROUP_WIDTH) {
+        table->ctrl[table->capacity + index] = value;
+    }
+}
+
+// 在单张表中查找键，返回槽位下标，不存在时返回 -1
+static long table_find(const SwissTable *table, const char *key, size_t key_length, size_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t pos = hash_h1(hash) & mask;
+    uint8_t h2 = hash_h2(hash);
+    // 控制字节和槽位在不同的数组中，提前预取槽位让两次缓存未命中并行
+    __builtin_prefetch(&table->slots[pos]);
+    for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+        const uint8_t *group = table->ctrl + pos;
+        for (GroupMask m = group_match(group, h2); m; m = mask_next(m)) {
+            size_t index = (pos + mask_first(m)) & mask;
+            HashEntry *entry = table->slots[index];
+            if (entry->hash == hash && entry->key_length == key_length &&
+                memcmp(entry->key, key, key_length) == 0) {
+                return (long)index;
+            }
+        }
+        // 组内有空槽说明探测序列到此为止
+        if (group_match_empty(group)) return -1;
+        if (step > table->capacity) return -1;
+        pos = (pos + step) & mask;
+    }
+}
+
+// 为已知不存在的键找到插入位置（空槽或墓碑）
+static size_t table_find_free(const SwissTable *table, size_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t pos = hash_h1(hash) & mask;
+    for (size_t step = GROUP_WIDTH; ; step += GROUP_WIDTH) {
+        GroupMask m = group_match_free(table->ctrl + pos);
+        if (m) return (pos + mask_first(m)) & mask;
+        pos = (pos + step) & mask;
+    }
+}
+
+// 插入已知不存在的条目，调用方保证 growth_left > 0 或有可复用的墓碑
+static void table_insert(SwissTable *table, HashEntry *entry) {
+    size_t index = table_find_free(table, entry->hash);
+    if (table->ctrl[index] == CTRL_EMPTY && table->growth_left > 0) {
+        table->growth_left--;
+    }
+    set_ctrl(table, index, hash_h2(entry->hash));
+    table->slots[index] = entry;
+    table->used++;
+}
+
+static bool is_migrating(const KVStore *store) {
+    return store->migrate_index != -1;
+}
+
+// 迁移旧表中接下来的 slots 个槽位；全部迁移完成后用新表替换旧表
+static void migrate_step(KVStore *store, size_t slots) {
+    if (!is_migrating(store)) return;
+    SwissTable *from = &store->tables[0];
+    SwissTable *to = &store->tables[1];
+    size_t index = (size_t)store->migrate_index;
+    size_t end = index + slots < from->capacity ? index + slots : from->capacity;
+    for (; index < end && from->used > 0; index++) {
+        if (!(from->ctrl[index] & CTRL_EMPTY)) {
+            table_insert(to, from->slots[index]);
+            set_ctrl(from, index, CTRL_DELETED);
+            from->used--;
+        }
+    }
+    store->migrate_index = (long)index;
+    if (from->used == 0) {
+        kv_memory_uncharge(store, table_memory(from->capacity));
+        table_release(from);
+        *from = *to;
+        memset(to, 0, sizeof(*to));
+        store->migrate_index = -1;
+    }
+}
+
+// 开始迁移到新容量（相同容量时用于清理墓碑）；分配失败时保持原表
+static bool start_resize(KVStore *store, size_t capacity) {
+    if (is_migrating(store)) return false;
+    if (!table_init(&store->tables[1], capacity)) return false;
+    kv_memory_charge(store, table_memory(capacity));
+    store->migrate_index = 0;
+    return true;
+}
+
+// 插入前保证目标表有空间：旧表写满时开始迁移（有效条目不到最大负载一半时按原容量重建以清除墓碑）
+static bool reserve_insert(KVStore *store) {
+    if (is_migrating(store)) {
+        // 新表容量已为迁移期间可能的插入预留空间，正常情况下不会写满
+        return store->tables[1].growth_left > 0;
+    }
+    SwissTable *table = &store->tables[0];
+    if (table->growth_left > 0) return true;
+    size_t capacity = table->used * 2 > max_load(table->capacity) ? table->capacity * 2 : table->capacity;
+    return start_resize(store, capacity);
+}
+
+// 删除后条目过少时缩容；新表要能容纳现有条目和迁移完成前最多插入的条目
+static void check_shrink(KVStore *store) {
+    if (is_migrating(store)) return;
+    size_t capacity = store->tables[0].capacity;
+    if (capacity <= store->min_capacity || store->size >= capacity / SHRINK_LOAD_FACTOR) return;
+    size_t needed = store->size + capacity / MIGRATE_SLOTS + 1;
+    size_t target = round_up_power_of_two(needed * MAX_LOAD_DEN / MAX_LOAD_NUM + 1);
+    if (target < store->min_capacity) target = store->min_capacity;
+    if (target < capacity) {
+        start_resize(store, target);
+    }
+}
+
+// 在两张表中查找键
+static HashEntry *find_entry(KVStore *store, const char *key, size_t key_length, size_t hash,
+                             SwissTable **table_out, long *index_out) {
+    int tables = is_migrating(store) ? 2 : 1;
+    for (int t = 0; t < tables; t++) {
+        SwissTable *table = &store->tables[t];
+        long index = table_find(table, key, key_length, hash);
+        if (index != -1) {
+            if (table_out) *table_out = table;
+            if (index_out) *index_out = index;
+            return table->slots[index];
+        }
+    }
+    return NULL;
+}
+
+// 删除 table 中 index 处的条目：留下墓碑保持其他键的探测序列完整，墓碑由后续插入复用或在重建时清除
+static void remove_at(KVStore *store, SwissTable *table, long index) {
+    HashEntry *entry = table->slots[index];
+    set_ctrl(table, (size_t)index, CTRL_DELETED);
+    table->used--;
+    kv_entry_detach(store, entry);
+    kv_entry_free(entry);
+    store->size--;
+    check_shrink(store);
+}
+
+// 查找未过期的条目，过期的顺便删除
+static HashEntry *find_live(KVStore *store, const char *key, size_t key_length, size_t hash) {
+    SwissTable *table = NULL;
+    long index = -1;
+    HashEntry *entry = find_entry(store, key, key_length, hash, &table, &index);
+    if (entry && !store->loading && kv_entry_expired(entry)) {
+        remove_at(store, table, index);
+        return NULL;
+    }
+    return entry;
+}
+
+KVStore *kv_store_create(size_t initial_capacity, SlabAllocator *slab) {
+    if (initial_capacity == 0) {
+        initial_capacity = DEFAULT_CAPACITY;
+    }
+    initial_capacity = round_up_power_of_two(initial_capacity);
+    KVStore *store = calloc(1, sizeof(KVStore));
+    if (!store) return NULL;
+    if (!slab) {
+        slab = slab_create();
+        store->owns_slab = true;
+    }
+    if (!slab || !table_init(&store->tables[0], initial_capacity)) {
+        if (store->owns_slab) {
+            slab_destroy(slab);
+        }
+        free(store);
+        return NULL;
+    }
+    store->slab = slab;
+    store->migrate_index = -1;
+    store->min_capacity = initial_capacity;
+    store->size = 0;
+    timer_wheel_init(&store->timers, kv_now_ms());
+    kv_memory_charge(store, table_memory(initial_capacity));
+    return store;
+}
+
+void kv_store_destroy(KVStore *store) {
+    if (!store) return;
+    for (int t = 0; t < 2; t++) {
+        table_free_entries(&store->tables[t]);
+        table_release(&store->tables[t]);
+    }
+    if (store->owns_slab) {
+        slab_destroy(store->slab);
+    }
+    free(store);
+}
+
+bool kv_set_value_expire(KVStore *store, const char *key, size_t key_length, KVValue *value, uint64_t expire_ms) {
+    if (!store || !key || !value) return false;
+    migrate_step(store, MIGRATE_SLOTS);
+    size_t hash = kv_hash_key(key, key_length);
+    HashEntry *entry = find_entry(store, key, key_length, hash, NULL, NULL);
+    if (!kv_reserve(store, entry, key_length, value, expire_ms)) return false;
+    if (entry) {
+        if (!kv_entry_set_expire(store, entry, expire_ms)) return false;
+        kv_entry_replace_value(store, entry, value);
+        return true;
+    }
+    if (!reserve_insert(store)) return false;
+    HashEntry *new_entry = kv_entry_create(store->slab, key, key_length, value, hash);
+    if (!new_entry) return false;
+    kv_entry_attach(store, new_entry);
+    if (!kv_entry_set_expire(store, new_entry, expire_ms)) {
+        kv_entry_detach(store, new_entry);
+        kv_entry_free(new_entry);
+        return false;
+    }
+    // 迁移期间新条目直接写入新表
+    table_insert(&store->tables[is_migrating(store) ? 1 : 0], new_entry);
+    store->size++;
+    return true;
+}
+
+KVValue *kv_get_value(KVStore *store, const char *key, size_t key_length) {
+    if (!store || !key) return NULL;
+    migrate_step(store, MIGRATE_SLOTS);
+    HashEntry *entry = find_live(store, key, key_length, kv_hash_key(key, key_length));
+    kv_entry_touch(store, entry);
+    return entry ? kv_value_retain(entry->value) : NULL;
+}
+
+HashEntry *kv_find_entry(KVStore *store, const char *key, size_t key_length) {
+    migrate_step(store, MIGRATE_SLOTS);
+    return find_live(store, key, key_length, kv_hash_key(key, key_length));
+}
+
+void kv_get_values(KVStore *store, const KVKey *keys, size_t count, KVValue **values) {
+    size_t hashes[KV_BATCH_WINDOW];
+    for (size_t base = 0; base < count; base += KV_BATCH_WINDOW) {
+        size_t n = count - base < KV_BATCH_WINDOW ? count - base : KV_BATCH_WINDOW;
+        migrate_step(store, MIGRATE_SLOTS);
+        // 先为整个窗口预取控制字节组和对应槽位，再逐个探测
+        const SwissTable *table = &store->tables[0];
+        size_t mask = table->capacity - 1;
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = kv_hash_key(keys[base + i].data, keys[base + i].length);
+            size_t pos = hash_h1(hashes[i]) & mask;
+            __builtin_prefetch(table->ctrl + pos);
+            __builtin_prefetch(&table->slots[pos]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            HashEntry *entry = find_live(store, keys[base + i].data, keys[base + i].length, hashes[i]);
+            kv_entry_touch(store, entry);
+            values[base + i] = entry ? kv_value_retain(entry->value) : NULL;
+        }
+    }
+}
+
+bool kv_delete(KVStore *store, const char *key, size_t key_length) {
+    if (!store || !key) return false;
+    migrate_step(store, MIGRATE_SLOTS);
+    SwissTable *table = NULL;
+    long index = -1;
+    HashEntry *entry = find_entry(store, key, key_length, kv_hash_key(key, key_length), &table, &index);
+    if (!entry) return false;
+    // 已过期的键同样删除，但按不存在处理
+    bool expired = !store->loading && kv_entry_expired(entry);
+    remove_at(store, table, index);
+    return !expired;
+}
+
+void kv_store_foreach(KVStore *store, KVVisitFn visit, void *arg) {
+    for (int t = 0; t < 2; t++) {
+        SwissTable *table = &store->tables[t];
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (!(table->ctrl[i] & CTRL_EMPTY) && !visit(arg, table->slots[i])) return;
+        }
+    }
+}
+
+size_t kv_size(KVStore *store) {
+    return store ? store->size : 0;
+}
+
+SlabAllocator *kv_store_allocator(KVStore *store) {
+    return store->slab;
+}
+
+TimerWheel *kv_store_timers(KVStore *store) {
+    return &store->timers;
+}
+
+KVEvictor *kv_store_evictor(KVStore *store) {
+    return &store->evictor;
+}
+
+// 槽位编号先是 tables[0] 的槽位，迁移期间接着是 tables[1] 的槽位；按控制字节跳过空槽和墓碑，最多访问一整圈
+size_t kv_scan_entries(KVStore *store, size_t *cursor, HashEntry **out, size_t max) {
+    size_t total = store->tables[0].capacity + store->tables[1].capacity;
+    size_t slot = *cursor % total;
+    size_t count = 0;
+    for (size_t visited = 0; visited < total && count < max; visited++) {
+        const SwissTable *table = &store->tables[slot < store->tables[0].capacity ? 0 : 1];
+        size_t index = table == &store->tables[0] ? slot : slot - store->tables[0].capacity;
+        if (!(table->ctrl[index] & CTRL_EMPTY)) {
+            out[count++] = table->slots[index];
+        }
+        slot = slot + 1 == total ? 0 : slot + 1;
+    }
+    *cursor = slot;
+    return count;
+}
+
+void kv_table_sample(KVStore *store, size_t *cursor, size_t samples, KVTableStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    size_t total = store->tables[0].capacity + store->tables[1].capacity;
+    stats->capacity = total;
+    if (samples > total) samples = total;
+    if (samples == 0) return;
+    size_t stride = total / samples;
+    size_t offset = *cursor % stride;
+    *cursor = offset + 1;
+    for (size_t i = 0; i < samples; i++) {
+        size_t slot = i * stride + offset;
+        const SwissTable *table = &store->tables[slot < store->tables[0].capacity ? 0 : 1];
+        size_t index = table == &store->tables[0] ? slot : slot - store->tables[0].capacity;
+        size_t length = 0;
+        if (!(table->ctrl[index] & CTRL_EMPTY)) {
+            // 与 table_find 相同的探测序列：第 k 组（从 1 起）的起点在初始位置之后 GROUP_WIDTH * k(k-1)/2，
+            // 键在第一个包含它所在槽位的组中被找到
+            size_t mask = table->capacity - 1;
+            size_t distance = (index - (hash_h1(table->slots[index]->hash) & mask)) & mask;
+            size_t start = 0;
+            length = 1;
+            while (length < KV_CHAIN_LENGTHS - 1 && ((distance - start) & mask) >= GROUP_WIDTH) {
+                start += length * GROUP_WIDTH;
+                length++;
+            }
+        }
+        stats->chains[length < KV_CHAIN_LENGTHS ? length : KV_CHAIN_LENGTHS - 1]++;
+    }
+    stats->sampled = samples;
+}
+
+void kv_set_loading(KVStore *store, bool loading) {
+    store->loading = loading;
+}
+
+const char *kv_store_engine(void) {
+    return "swiss";
+}
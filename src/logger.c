@@ -0,0 +1,505 @@
+#include "logger.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_MAX_ARGS 12        // 一条记录最多保存的参数个数（含 * 宽度和精度）
+#define LOG_TEXT_SIZE 128      // 一条记录中 %s 参数副本的总字节数
+#define LOG_LINE_MAX 1024      // 一行输出的上限
+#define LOG_OUTPUT_SIZE 65536  // 后台线程的输出缓冲区
+#define LOG_IDLE_MAX_MS 64     // 缓冲区为空时后台线程的最长休眠间隔
+
+// 参数的原始值：整数统一扩展为 64 位，浮点数为 double，%s 为副本在 text 中的偏移（低 16 位）和长度（高 16 位）
+typedef union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+} LogArg;
+
+// 环形缓冲区的一个槽位，正好 256 字节。sequence 保存槽位的轮次减去槽位下标，
+// 这样全零的初始状态就是"第 0 轮可写"，启动前写入的记录不需要先初始化缓冲区
+typedef struct {
+    atomic_size_t sequence;
+    uint64_t time_ns;
+    const LogSite *site;
+    uint32_t suppressed;       // 此前被限速省略的条数
+    uint16_t text_length;
+    uint8_t arg_count;
+    bool truncated;            // 参数或字符串超出记录空间
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+} LogSlot;
+
+_Static_assert(sizeof(LogSlot) == 256, "LogSlot should stay 256 bytes");
+
+atomic_int g_log_level = LOG_LEVEL_INFO;
+
+static _Alignas(64) LogSlot ring[LOG_RING_SLOTS];
+static _Alignas(64) atomic_size_t ring_head;   // 生产者争用的写入位置
+static _Alignas(64) size_t ring_tail;          // 只由后台线程（或停止后的 logger_stop）读写
+static atomic_size_t dropped_total;
+static atomic_size_t suppressed_total;
+
+static pthread_t writer_thread;
+static bool writer_started = false;
+static atomic_bool writer_running;
+
+// 格式串中一个转换说明的解析结果
+typedef enum { LENGTH_NONE, LENGTH_HH, LENGTH_H, LENGTH_L, LENGTH_LL, LENGTH_Z, LENGTH_J, LENGTH_T, LENGTH_BIG_L } LengthModifier;
+
+typedef struct {
+    const char *start;           // '%'
+    const char *precision_start; // '.'，没有精度时与 length_start 相同
+    const char *length_start;    // 长度修饰符，没有时为转换字符
+    const char *end;             // 转换字符之后
+    char conversion;
+    LengthModifier length;
+    bool width_star;
+    bool precision_star;
+    int precision;               // 字面精度，没有时为 -1
+} FormatSpec;
+
+// 解析从 '%' 开始的一个转换说明；不支持的转换（如 %n）返回 false
+static bool parse_spec(const char *percent, FormatSpec *spec) {
+    const char *p = percent + 1;
+    spec->start = percent;
+    spec->width_star = false;
+    spec->precision_star = false;
+    spec->precision = -1;
+    spec->length = LENGTH_NONE;
+    if (*p == '%') {
+        spec->conversion = '%';
+        spec->precision_start = spec->length_start = p;
+        spec->end = p + 1;
+        return true;
+    }
+    while (*p && strchr("-+ #0", *p)) p++;
+    if (*p == '*') {
+        spec->width_star = true;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    spec->precision_start = p;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->precision_star = true;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') {
+                spec->precision = spec->precision * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+    spec->length_start = p;
+    switch (*p) {
+        case 'h': spec->length = p[1] == 'h' ? LENGTH_HH : LENGTH_H; p += p[1] == 'h' ? 2 : 1; break;
+        case 'l': spec->length = p[1] == 'l' ? LENGTH_LL : LENGTH_L; p += p[1] == 'l' ? 2 : 1; break;
+        case 'z': spec->length = LENGTH_Z; p++; break;
+        case 'j': spec->length = LENGTH_J; p++; break;
+        case 't': spec->length = LENGTH_T; p++; break;
+        case 'L': spec->length = LENGTH_BIG_L; p++; break;
+        default: break;
+    }
+    if (*p == '\0' || !strchr("diouxXcsfFeEgGaAp", *p)) return false;
+    spec->conversion = *p;
+    spec->end = p + 1;
+    return true;
+}
+
+static long long read_signed(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_HH: return (signed char)va_arg(*args, int);
+        case LENGTH_H: return (short)va_arg(*args, int);
+        case LENGTH_L: return va_arg(*args, long);
+        case LENGTH_LL: return va_arg(*args, long long);
+        case LENGTH_Z: return (long long)va_arg(*args, size_t);
+        case LENGTH_J: return va_arg(*args, intmax_t);
+        case LENGTH_T: return va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, int);
+    }
+}
+
+static unsigned long long read_unsigned(va_list *args, LengthModifier length) {
+    switch (length) {
+        case LENGTH_HH: return (unsigned char)va_arg(*args, unsigned);
+        case LENGTH_H: return (unsigned short)va_arg(*args, unsigned);
+        case LENGTH_L: return va_arg(*args, unsigned long);
+        case LENGTH_LL: return va_arg(*args, unsigned long long);
+        case LENGTH_Z: return va_arg(*args, size_t);
+        case LENGTH_J: return va_arg(*args, uintmax_t);
+        case LENGTH_T: return (unsigned long long)va_arg(*args, ptrdiff_t);
+        default: return va_arg(*args, unsigned);
+    }
+}
+
+static void capture_string(LogSlot *slot, LogArg *arg, const char *value, int precision) {
+    if (!value) value = "(null)";
+    size_t room = LOG_TEXT_SIZE - slot->text_length;
+    size_t limit = precision >= 0 && (size_t)precision < room ? (size_t)precision : room;
+    size_t length = strnlen(value, limit);
+    if (length == room && value[length] != '\0' && (precision < 0 || (size_t)precision > room)) {
+        slot->truncated = true;
+    }
+    memcpy(slot->text + slot->text_length, value, length);
+    arg->u = (unsigned long long)slot->text_length | ((unsigned long long)length << 16);
+    slot->text_length += (uint16_t)length;
+}
+
+// 按格式串依次取出参数的原始值，遇到放不下的参数时停止
+static void capture_args(LogSlot *slot, const char *format, va_list *args) {
+    const char *p = format;
+    while ((p = strchr(p, '%')) != NULL) {
+        FormatSpec spec;
+        if (!parse_spec(p, &spec)) break;
+        p = spec.end;
+        if (spec.conversion == '%') continue;
+        unsigned needed = 1 + (spec.width_star ? 1 : 0) + (spec.precision_star ? 1 : 0);
+        if (slot->arg_count + needed > LOG_MAX_ARGS) {
+            slot->truncated = true;
+            break;
+        }
+        int precision = spec.precision;
+        if (spec.width_star) slot->args[slot->arg_count++].i = va_arg(*args, int);
+        if (spec.precision_star) {
+            precision = va_arg(*args, int);
+            slot->args[slot->arg_count++].i = precision;
+        }
+        LogArg *arg = &slot->args[slot->arg_count++];
+        switch (spec.conversion) {
+            case 'd': case 'i':
+                arg->i = read_signed(args, spec.length);
+                break;
+            case 'o': case 'u': case 'x': case 'X':
+                arg->u = read_unsigned(args, spec.length);
+                break;
+            case 'c':
+                arg->i = va_arg(*args, int);
+                break;
+            case 'p':
+                arg->p = va_arg(*args, void *);
+                break;
+            case 's':
+                capture_string(slot, arg, va_arg(*args, const char *), precision);
+                break;
+            default:
+                arg->d = spec.length == LENGTH_BIG_L ? (double)va_arg(*args, long double) : va_arg(*args, double);
+                break;
+        }
+    }
+}
+
+static LogSlot* ring_claim(size_t *position) {
+    size_t pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    for (;;) {
+        size_t index = pos & (LOG_RING_SLOTS - 1);
+        LogSlot *slot = &ring[index];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire) + index;
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *position = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL; // 缓冲区已满
+        } else {
+            pos = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        }
+    }
+}
+
+static uint64_t realtime_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now); // vDSO，不进入内核
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// 同一调用位置每秒最多 LOG_RATE_LIMIT 条；窗口切换时的竞争只会让个别记录多放行或多省略，不影响正确性
+static bool rate_limited(LogSite *site, uint64_t now_ns) {
+    unsigned second = (unsigned)(now_ns / 1000000000ULL);
+    unsigned window = atomic_load_explicit(&site->window, memory_order_relaxed);
+    if (window != second &&
+        atomic_compare_exchange_strong_explicit(&site->window, &window, second,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) < LOG_RATE_LIMIT) return false;
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&suppressed_total, 1, memory_order_relaxed);
+    return true;
+}
+
+void log_write(LogSite *site, const char *format, ...) {
+    uint64_t now = realtime_ns();
+    if (rate_limited(site, now)) return;
+    size_t position;
+    LogSlot *slot = ring_claim(&position);
+    if (!slot) {
+        atomic_fetch_add_explicit(&dropped_total, 1, memory_order_relaxed);
+        return;
+    }
+    slot->time_ns = now;
+    slot->site = site;
+    slot->suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    slot->text_length = 0;
+    slot->arg_count = 0;
+    slot->truncated = false;
+    va_list args;
+    va_start(args, format);
+    capture_args(slot, format, &args);
+    va_end(args);
+    atomic_store_explicit(&slot->sequence, position + 1 - (position & (LOG_RING_SLOTS - 1)), memory_order_release);
+}
+
+// 后台线程的输出缓冲区；ERROR 和 WARN 写到 stderr，其余写到 stdout，切换流之前先写出已缓冲的部分
+typedef struct {
+    char data[LOG_OUTPUT_SIZE];
+    size_t length;
+    FILE *stream;
+    time_t cached_second;
+    char cached_time[32];
+} LogOutput;
+
+static LogOutput output;
+
+static void output_flush(void) {
+    if (output.length > 0 && output.stream) {
+        fwrite(output.data, 1, output.length, output.stream);
+        fflush(output.stream);
+    }
+    output.length = 0;
+}
+
+static void output_printf(const char *format, ...) {
+    size_t room = sizeof(output.data) - output.length;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(output.data + output.length, room, format, args);
+    va_end(args);
+    if (written > 0) output.length += (size_t)written < room ? (size_t)written : room - 1;
+}
+
+static void output_append(const char *data, size_t length) {
+    size_t room = sizeof(output.data) - output.length - 1;
+    if (length > room) length = room;
+    memcpy(output.data + output.length, data, length);
+    output.length += length;
+}
+
+// 按级别选择输出流并写出行首的时间和级别；本地时间每秒只换算一次
+static void output_begin(LogLevel level, uint64_t time_ns) {
+    FILE *stream = level <= LOG_LEVEL_WARN ? stderr : stdout;
+    if (stream != output.stream || sizeof(output.data) - output.length < LOG_LINE_MAX) {
+        output_flush();
+        output.stream = stream;
+    }
+    time_t second = (time_t)(time_ns / 1000000000ULL);
+    if (second != output.cached_second || output.cached_time[0] == '\0') {
+        struct tm local;
+        localtime_r(&second, &local);
+        strftime(output.cached_time, sizeof(output.cached_time), "%Y-%m-%d %H:%M:%S", &local);
+        output.cached_second = second;
+    }
+    output_printf("%s.%03u %-5s ", output.cached_time, (unsigned)(time_ns / 1000000ULL % 1000), logger_level_name(level));
+}
+
+// 输出一个转换：width 和 precision 为 * 时依次作为参数传入
+#define OUTPUT_CONVERSION(spec_text, stars, star_count, value) do { \
+    if ((star_count) == 0) output_printf(spec_text, value); \
+    else if ((star_count) == 1) output_printf(spec_text, (stars)[0], value); \
+    else output_printf(spec_text, (stars)[0], (stars)[1], value); \
+} while (0)
+
+// 按格式串和记录中的原始值还原一行文本。每个转换说明去掉长度修饰符后按保存的类型重新组装：
+// 整数一律用 ll，%s 改为 %.*s 并传入副本的长度
+static void format_record(const LogSlot *slot) {
+    const char *format = slot->site->format;
+    const char *line_start = output.data + output.length;
+    unsigned next_arg = 0;
+    const char *p = format;
+    while (*p) {
+        const char *percent = strchr(p, '%');
+        if (!percent) {
+            output_append(p, strlen(p));
+            break;
+        }
+        output_append(p, (size_t)(percent - p));
+        FormatSpec spec;
+        if (!parse_spec(percent, &spec)) {
+            output_append(percent, strlen(percent));
+            break;
+        }
+        p = spec.end;
+        if (spec.conversion == '%') {
+            output_append("%", 1);
+            continue;
+        }
+        unsigned needed = 1 + (spec.width_star ? 1 : 0) + (spec.precision_star ? 1 : 0);
+        if (next_arg + needed > slot->arg_count) break;
+        int stars[3];
+        int star_count = 0;
+        if (spec.width_star) stars[star_count++] = (int)slot->args[next_arg++].i;
+        if (spec.precision_star) stars[star_count++] = (int)slot->args[next_arg++].i;
+        const LogArg *arg = &slot->args[next_arg++];
+
+        char spec_text[32];
+        size_t prefix = (size_t)((spec.conversion == 's' ? spec.precision_start : spec.length_start) - spec.start);
+        if (prefix > sizeof(spec_text) - 8) prefix = sizeof(spec_text) - 8;
+        memcpy(spec_text, spec.start, prefix);
+        switch (spec.conversion) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+                spec_text[prefix++] = 'l';
+                spec_text[prefix++] = 'l';
+                spec_text[prefix++] = spec.conversion;
+                spec_text[prefix] = '\0';
+                if (spec.conversion == 'd' || spec.conversion == 'i') {
+                    OUTPUT_CONVERSION(spec_text, stars, star_count, arg->i);
+                } else {
+                    OUTPUT_CONVERSION(spec_text, stars, star_count, arg->u);
+                }
+                break;
+            case 's': {
+                memcpy(spec_text + prefix, ".*s", 4);
+                // 精度已在记录时用于截取副本，这里换成副本的实际长度
+                if (spec.precision_star) star_count--;
+                stars[star_count++] = (int)(arg->u >> 16);
+                OUTPUT_CONVERSION(spec_text, stars, star_count, slot->text + (arg->u & 0xffff));
+                break;
+            }
+            case 'c':
+                spec_text[prefix++] = 'c';
+                spec_text[prefix] = '\0';
+                OUTPUT_CONVERSION(spec_text, stars, star_count, (int)arg->i);
+                break;
+            case 'p':
+                spec_text[prefix++] = 'p';
+                spec_text[prefix] = '\0';
+                OUTPUT_CONVERSION(spec_text, stars, star_count, arg->p);
+                break;
+            default:
+                spec_text[prefix++] = spec.conversion;
+                spec_text[prefix] = '\0';
+                OUTPUT_CONVERSION(spec_text, stars, star_count, arg->d);
+                break;
+        }
+    }
+    // 一行不超过 LOG_LINE_MAX，后面的附注总能放下
+    size_t line_length = (size_t)(output.data + output.length - line_start);
+    if (line_length > LOG_LINE_MAX - 128) output.length -= line_length - (LOG_LINE_MAX - 128);
+    if (slot->truncated) output_append(" ...", 4);
+    if (slot->suppressed > 0) output_printf("（此前 %u 条同一位置的日志被限速省略）", slot->suppressed);
+    output_append("\n", 1);
+}
+
+// 写出缓冲区中已完成的记录，返回条数；只由唯一的消费者调用
+static size_t ring_drain(void) {
+    size_t count = 0;
+    for (;;) {
+        size_t index = ring_tail & (LOG_RING_SLOTS - 1);
+        LogSlot *slot = &ring[index];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) + index != ring_tail + 1) break;
+        output_begin(slot->site->level, slot->time_ns);
+        format_record(slot);
+        atomic_store_explicit(&slot->sequence, ring_tail + LOG_RING_SLOTS - index, memory_order_release);
+        ring_tail++;
+        count++;
+    }
+    output_flush();
+    return count;
+}
+
+// 丢弃的条数增加后补一行说明
+static void report_dropped(size_t *reported) {
+    size_t dropped = logger_dropped();
+    if (dropped == *reported) return;
+    output_begin(LOG_LEVEL_WARN, realtime_ns());
+    output_printf("日志缓冲区已满，丢弃了 %zu 条日志\n", dropped - *reported);
+    output_flush();
+    *reported = dropped;
+}
+
+static size_t reported_dropped = 0;
+
+// 缓冲区为空时从 1 ms 开始逐次加倍休眠，最长 LOG_IDLE_MAX_MS；生产者从不唤醒本线程，写日志不进系统调用
+static void* logger_main(void *arg) {
+    (void)arg;
+    unsigned idle_ms = 1;
+    while (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        size_t written = ring_drain();
+        report_dropped(&reported_dropped);
+        if (written > 0) {
+            idle_ms = 1;
+            continue;
+        }
+        struct timespec pause = {0, (long)idle_ms * 1000000L};
+        nanosleep(&pause, NULL);
+        if (idle_ms < LOG_IDLE_MAX_MS) idle_ms *= 2;
+    }
+    return NULL;
+}
+
+bool logger_start(void) {
+    if (writer_started) return true;
+    atomic_store_explicit(&writer_running, true, memory_order_release);
+    if (pthread_create(&writer_thread, NULL, logger_main, NULL) != 0) {
+        atomic_store_explicit(&writer_running, false, memory_order_release);
+        return false;
+    }
+    writer_started = true;
+    return true;
+}
+
+void logger_stop(void) {
+    if (writer_started) {
+        atomic_store_explicit(&writer_running, false, memory_order_release);
+        pthread_join(writer_thread, NULL);
+        writer_started = false;
+    }
+    ring_drain();
+    report_dropped(&reported_dropped);
+}
+
+void logger_set_level(LogLevel level) {
+    atomic_store_explicit(&g_log_level, (int)level, memory_order_relaxed);
+}
+
+bool logger_parse_level(const char *name, LogLevel *level) {
+    static const LogLevel levels[] = {LOG_LEVEL_ERROR, LOG_LEVEL_WARN, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG};
+    static const char *const names[] = {"error", "warn", "info", "debug"};
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = levels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* logger_level_name(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR: return "ERROR";
+        case LOG_LEVEL_WARN: return "WARN";
+        case LOG_LEVEL_INFO: return "INFO";
+        case LOG_LEVEL_DEBUG: return "DEBUG";
+        default: return "UNKNOWN";
+    }
+}
+
+size_t logger_dropped(void) {
+    return atomic_load_explicit(&dropped_total, memory_order_relaxed);
+}
+
+size_t logger_suppressed(void) {
+    return atomic_load_explicit(&suppressed_total, memory_order_relaxed);
+}
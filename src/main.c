@@ -2,37 +2,81 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <sys/resource.h>
 #include "kqueue_net.h"
 
 // 全局服务器实例，用于信号处理
 static KVServer *g_server = NULL;
 
-// 全局详细日志标志
-bool g_verbose = false;
-
 // 信号处理函数
 void signal_handler(int sig) {
     if (sig == SIGINT || sig == SIGTERM) {
-        printf("\n收到停止信号，正在关闭服务器...\n");
+        LOG_INFO("收到停止信号，正在关闭服务器...");
         if (g_server) {
             server_stop(g_server);
         }
     }
 }
 
+// 把打开文件数的软限制提高到硬限制，连接表按需增长，并发连接数只受该限制约束
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1 || limit.rlim_cur == limit.rlim_max) return;
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) {
+        LOG_WARN("无法提高打开文件数限制");
+    }
+}
+
+// 解析 "请求头,请求体,空闲,发送" 四个以秒为单位的连接期限，0 表示不限制
+static bool parse_timeouts(const char *text, ServerTimeouts *timeouts) {
+    uint32_t *fields[] = {&timeouts->header_ms, &timeouts->body_ms, &timeouts->idle_ms, &timeouts->write_ms};
+    const char *cursor = text;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        char *endptr = NULL;
+        long parsed = strtol(cursor, &endptr, 10);
+        if (endptr == cursor || parsed < 0 || parsed > 86400) return false;
+        if (*endptr != (i + 1 < sizeof(fields) / sizeof(fields[0]) ? ',' : '\0')) return false;
+        *fields[i] = (uint32_t)parsed * 1000;
+        cursor = endptr + 1;
+    }
+    return true;
+}
+
 // 打印使用说明
 void print_usage(const char *program_name) {
     printf("用法: %s [选项] [端口号]\n", program_name);
     printf("  端口号: 服务器监听的端口号 (默认: 8080)\n");
     printf("\n");
     printf("选项:\n");
-    printf("  -v, --verbose     启用详细日志输出\n");
+    printf("  -v, --verbose     启用详细日志输出（等同于 -L debug）\n");
+    printf("  -L, --log-level <级别> 日志级别: error、warn、info（默认）或 debug\n");
+    printf("  -e, --engine <名称> IO 引擎: loop（默认，epoll/kqueue）或 io_uring（Linux）\n");
+    printf("  -t, --threads <N>   反应器线程数，每个线程拥有一个键空间分片（默认: CPU 核数）\n");
+    printf("  -b, --max-body <MB> 请求体（值）大小上限，单位 MB（默认: 64）\n");
+    printf("  -o, --max-output <MB> 所有连接待发送输出的总上限，单位 MB（默认: 256）\n");
+    printf("  -r, --resp-port <端口> 同时在该端口提供 Redis 协议（RESP）访问（默认: 不启用）\n");
+    printf("  -a, --aof-dir <目录> 启用追加日志持久化，日志写入该目录，启动时从中恢复数据（默认: 不启用）\n");
+    printf("  -f, --fsync <策略>  日志落盘策略: always（响应前同步）、no（由系统决定）或同步间隔毫秒数（默认: 1000）\n");
+    printf("  -s, --snapshot <文件> 快照文件，BGSAVE 或 POST /admin/snapshot 时在后台写入；未启用追加日志时启动从中恢复\n");
+    printf("  -S, --snapshot-interval <秒> 每隔该秒数自动写一次快照（默认: 0，只按请求写）\n");
+    printf("  -m, --maxmemory <MB> 键空间的内存上限，单位 MB，按反应器均分（默认: 0，不限）\n");
+    printf("  -E, --eviction <策略> 达到上限后的淘汰策略: noeviction（拒绝写入，默认）、clock、lru 或 lfu\n");
+    printf("  -T, --timeouts <请求头,请求体,空闲,发送> 连接期限，单位秒，0 表示不限制（默认: 10,30,300,30）\n");
     printf("  -h, --help        显示此帮助信息\n");
     printf("\n");
     printf("示例:\n");
     printf("  %s        # 使用默认端口 8080\n", program_name);
     printf("  %s 9000   # 使用端口 9000\n", program_name);
     printf("  %s -v 8080 # 启用详细日志，使用端口 8080\n", program_name);
+    printf("  %s -L warn 8080 # 只输出警告和错误（不记录每个新连接）\n", program_name);
+    printf("  %s -e io_uring 8080 # 使用 io_uring 引擎\n", program_name);
+    printf("  %s -t 4 8080 # 使用 4 个反应器线程\n", program_name);
+    printf("  %s -r 6379 8080 # 同时在 6379 端口接受 redis-cli / redis-benchmark 连接\n", program_name);
+    printf("  %s -a data -f always 8080 # 修改写入 data 目录，每个响应发出前日志已落盘\n", program_name);
+    printf("  %s -s dump.cxs -S 600 8080 # 每 10 分钟写一次快照，重启时从快照恢复\n", program_name);
+    printf("  %s -m 1024 -E lru 8080 # 作为 1 GB 的缓存运行，按近似 LRU 淘汰\n", program_name);
+    printf("  %s -T 5,20,60,20 8080 # 收紧连接期限，空闲 1 分钟的连接被关闭\n", program_name);
     printf("\n");
     printf("路径说明:\n");
     printf("  /             - 重定向到 /web/\n");
@@ -40,20 +84,42 @@ void print_usage(const char *program_name) {
     printf("  /api/{key}    - KV 操作 API\n");
     printf("  /health       - 健康检查端点\n");
     printf("  /test_connection - 连接测试端点\n");
+    printf("  /ttl/{key}    - 键的过期时间（GET 查询，POST 设置，DELETE 取消）\n");
+    printf("  /admin/snapshot  - 快照状态（GET）和触发快照（POST）\n");
+    printf("  /metrics      - Prometheus 格式的运行指标\n");
     printf("\n");
     printf("API 使用说明:\n");
     printf("  GET /api/key      - 获取键值\n");
-    printf("  POST /api/key     - 设置键值 (请求体为值)\n");
+    printf("  POST /api/key     - 设置键值 (请求体为值，X-TTL 头部或 ?ttl= 指定存活秒数)\n");
     printf("  DELETE /api/key   - 删除键值\n");
     printf("\n");
     printf("测试示例:\n");
     printf("  curl -X POST http://localhost:8080/api/mykey -d 'myvalue'\n");
     printf("  curl http://localhost:8080/api/mykey\n");
     printf("  curl -X DELETE http://localhost:8080/api/mykey\n");
+    printf("\n");
+    printf("RESP 命令（-r 启用）:\n");
+    printf("  GET、SET [EX|PX]、SETEX、PSETEX、DEL、EXISTS、EXPIRE、PEXPIRE、EXPIREAT、PEXPIREAT、TTL、PTTL、\n");
+    printf("  PERSIST、MGET、MSET、DBSIZE、PING、ECHO、BGREWRITEAOF、BGSAVE、QUIT\n");
+    printf("  redis-cli -p 6379 set mykey myvalue\n");
 }
 
 int main(int argc, char *argv[]) {
     int port = 8080; // 默认端口
+    ServerEngine engine = SERVER_ENGINE_LOOP;
+    int threads = 0; // 0 表示使用默认值
+    size_t max_body = 0; // 0 表示使用默认值
+    size_t max_output = 0; // 0 表示使用默认值
+    int resp_port = 0; // 0 表示不启用
+    const char *aof_dir = NULL; // NULL 表示不启用持久化
+    FsyncPolicy fsync_policy = FSYNC_INTERVAL;
+    int fsync_interval = PERSIST_DEFAULT_FSYNC_MS;
+    const char *snapshot_path = NULL; // NULL 表示不启用快照
+    int snapshot_interval = 0;
+    size_t max_memory = 0; // 0 表示不限
+    KVEvictPolicy evict_policy = KV_EVICT_NONE;
+    ServerTimeouts timeouts;
+    bool custom_timeouts = false;
     int arg_index = 1;
 
     // 解析命令行参数
@@ -62,8 +128,128 @@ int main(int argc, char *argv[]) {
             print_usage(argv[0]);
             return 0;
         } else if (strcmp(argv[arg_index], "-v") == 0 || strcmp(argv[arg_index], "--verbose") == 0) {
-            g_verbose = true;
+            logger_set_level(LOG_LEVEL_DEBUG);
             arg_index++;
+        } else if (strcmp(argv[arg_index], "-L") == 0 || strcmp(argv[arg_index], "--log-level") == 0) {
+            LogLevel level;
+            if (arg_index + 1 >= argc || !logger_parse_level(argv[arg_index + 1], &level)) {
+                fprintf(stderr, "错误: 日志级别必须是 error、warn、info 或 debug\n");
+                return 1;
+            }
+            logger_set_level(level);
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-e") == 0 || strcmp(argv[arg_index], "--engine") == 0) {
+            if (arg_index + 1 >= argc) {
+                fprintf(stderr, "错误: %s 需要引擎名称\n", argv[arg_index]);
+                return 1;
+            }
+            const char *name = argv[arg_index + 1];
+            if (strcmp(name, "loop") == 0) {
+                engine = SERVER_ENGINE_LOOP;
+            } else if (strcmp(name, "io_uring") == 0) {
+                engine = SERVER_ENGINE_IO_URING;
+            } else {
+                fprintf(stderr, "错误: 未知的 IO 引擎 '%s'（可选: loop, io_uring）\n", name);
+                return 1;
+            }
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-t") == 0 || strcmp(argv[arg_index], "--threads") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || parsed < 1 || parsed > MAX_REACTORS) {
+                fprintf(stderr, "错误: 线程数必须是 1-%d 之间的整数\n", MAX_REACTORS);
+                return 1;
+            }
+            threads = (int)parsed;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-b") == 0 || strcmp(argv[arg_index], "--max-body") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || parsed < 1 || parsed > 4096) {
+                fprintf(stderr, "错误: 请求体上限必须是 1-4096 之间的整数（MB）\n");
+                return 1;
+            }
+            max_body = (size_t)parsed * 1024 * 1024;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-o") == 0 || strcmp(argv[arg_index], "--max-output") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || parsed < 1 || parsed > 65536) {
+                fprintf(stderr, "错误: 输出上限必须是 1-65536 之间的整数（MB）\n");
+                return 1;
+            }
+            max_output = (size_t)parsed * 1024 * 1024;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-r") == 0 || strcmp(argv[arg_index], "--resp-port") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || parsed < 1 || parsed > 65535) {
+                fprintf(stderr, "错误: RESP 端口号必须是 1-65535 之间的整数\n");
+                return 1;
+            }
+            resp_port = (int)parsed;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-a") == 0 || strcmp(argv[arg_index], "--aof-dir") == 0) {
+            if (arg_index + 1 >= argc || argv[arg_index + 1][0] == '\0') {
+                fprintf(stderr, "错误: %s 需要日志目录\n", argv[arg_index]);
+                return 1;
+            }
+            aof_dir = argv[arg_index + 1];
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-f") == 0 || strcmp(argv[arg_index], "--fsync") == 0) {
+            const char *policy = arg_index + 1 < argc ? argv[arg_index + 1] : "";
+            char *endptr = NULL;
+            long parsed = strtol(policy, &endptr, 10);
+            if (strcmp(policy, "always") == 0) {
+                fsync_policy = FSYNC_ALWAYS;
+            } else if (strcmp(policy, "no") == 0) {
+                fsync_policy = FSYNC_NO;
+            } else if (endptr != policy && *endptr == '\0' && parsed >= 1 && parsed <= 3600000) {
+                fsync_policy = FSYNC_INTERVAL;
+                fsync_interval = (int)parsed;
+            } else {
+                fprintf(stderr, "错误: 落盘策略必须是 always、no 或 1-3600000 之间的毫秒数\n");
+                return 1;
+            }
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-s") == 0 || strcmp(argv[arg_index], "--snapshot") == 0) {
+            if (arg_index + 1 >= argc || argv[arg_index + 1][0] == '\0') {
+                fprintf(stderr, "错误: %s 需要快照文件路径\n", argv[arg_index]);
+                return 1;
+            }
+            snapshot_path = argv[arg_index + 1];
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-S") == 0 || strcmp(argv[arg_index], "--snapshot-interval") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : -1;
+            if (!endptr || *endptr != '\0' || parsed < 0 || parsed > 604800) {
+                fprintf(stderr, "错误: 快照间隔必须是 0-604800 之间的整数（秒）\n");
+                return 1;
+            }
+            snapshot_interval = (int)parsed;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-m") == 0 || strcmp(argv[arg_index], "--maxmemory") == 0) {
+            char *endptr = NULL;
+            long parsed = arg_index + 1 < argc ? strtol(argv[arg_index + 1], &endptr, 10) : -1;
+            if (!endptr || *endptr != '\0' || parsed < 0 || parsed > 16777216) {
+                fprintf(stderr, "错误: 内存上限必须是 0-16777216 之间的整数（MB）\n");
+                return 1;
+            }
+            max_memory = (size_t)parsed * 1024 * 1024;
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-E") == 0 || strcmp(argv[arg_index], "--eviction") == 0) {
+            if (arg_index + 1 >= argc || !kv_evict_policy_parse(argv[arg_index + 1], &evict_policy)) {
+                fprintf(stderr, "错误: 淘汰策略必须是 noeviction、clock、lru 或 lfu\n");
+                return 1;
+            }
+            arg_index += 2;
+        } else if (strcmp(argv[arg_index], "-T") == 0 || strcmp(argv[arg_index], "--timeouts") == 0) {
+            if (arg_index + 1 >= argc || !parse_timeouts(argv[arg_index + 1], &timeouts)) {
+                fprintf(stderr, "错误: 连接期限必须是逗号分隔的 4 个 0-86400 之间的整数（秒）: 请求头,请求体,空闲,发送\n");
+                return 1;
+            }
+            custom_timeouts = true;
+            arg_index += 2;
         } else {
             // 尝试解析为端口号
             char *endptr;
@@ -81,25 +267,84 @@ int main(int argc, char *argv[]) {
     }
 
     printf("=== KV 存储服务器 ===\n");
-    printf("基于 kqueue 的高性能内存键值存储服务\n");
+    printf("基于 %s 的高性能内存键值存储服务\n", server_engine_name(engine));
     printf("支持 HTTP 协议的 GET、POST、DELETE 操作\n");
     printf("========================\n\n");
+    fflush(stdout);
+
+    // 之后的输出都经过异步日志，退出时（包括出错返回）写出缓冲区中剩余的记录
+    if (!logger_start()) {
+        fprintf(stderr, "错误: 无法启动日志线程\n");
+        return 1;
+    }
+    atexit(logger_stop);
 
     // 创建服务器
     g_server = server_create(port);
     if (!g_server) {
-        fprintf(stderr, "错误: 无法创建服务器\n");
+        LOG_ERROR("无法创建服务器");
+        return 1;
+    }
+
+    if (!server_set_engine(g_server, engine)) {
+        LOG_WARN("当前构建不支持 %s 引擎，使用 %s 事件循环",
+                 server_engine_name(engine), event_loop_backend());
+    }
+
+    if (threads > 0) {
+        server_set_threads(g_server, threads);
+    }
+
+    if (max_body > 0) {
+        server_set_max_body(g_server, max_body);
+    }
+
+    if (max_output > 0) {
+        server_set_max_output(g_server, max_output);
+    }
+
+    if (resp_port > 0 && !server_set_resp_port(g_server, resp_port)) {
+        LOG_ERROR("RESP 端口 %d 不能与 HTTP 端口相同", resp_port);
+        server_destroy(g_server);
         return 1;
     }
 
+    if (aof_dir && !server_set_append_log(g_server, aof_dir, fsync_policy, fsync_interval)) {
+        LOG_ERROR("无法启用追加日志");
+        server_destroy(g_server);
+        return 1;
+    }
+
+    if (snapshot_interval > 0 && !snapshot_path) {
+        LOG_ERROR("-S 需要同时用 -s 指定快照文件");
+        server_destroy(g_server);
+        return 1;
+    }
+
+    if (snapshot_path && !server_set_snapshot(g_server, snapshot_path, snapshot_interval)) {
+        LOG_ERROR("无法启用快照");
+        server_destroy(g_server);
+        return 1;
+    }
+
+    if (max_memory > 0) {
+        server_set_max_memory(g_server, max_memory, evict_policy);
+        LOG_INFO("键空间内存上限 %zu MB，淘汰策略: %s", max_memory / (1024 * 1024), kv_evict_policy_name(evict_policy));
+    }
+
+    if (custom_timeouts) {
+        server_set_timeouts(g_server, &timeouts);
+    }
+
     // 设置信号处理
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     signal(SIGPIPE, SIG_IGN); // 忽略 SIGPIPE 信号
+    raise_fd_limit();
 
     // 启动服务器
     if (!server_start(g_server)) {
-        fprintf(stderr, "错误: 无法启动服务器\n");
+        LOG_ERROR("无法启动服务器");
         server_destroy(g_server);
         return 1;
     }
@@ -111,6 +356,6 @@ int main(int argc, char *argv[]) {
     server_destroy(g_server);
     g_server = NULL;
 
-    printf("服务器已正常退出\n");
+    LOG_INFO("服务器已正常退出");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "metrics.h"
+#include "kqueue_net.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUB_COUNT (1U << METRIC_HIST_SUB_BITS)
+#define INITIAL_TEXT_CAPACITY 16384
+
+// 单独计数的状态码，顺序即 http_responses 的列顺序；其余的计入最后一列
+static const int http_codes[METRIC_HTTP_CODES - 1] = {
+    200, 201, 202, 204, 302, 304, 400, 404, 405, 409, 411, 413, 431, 500, 503
+};
+
+int metric_http_code_index(int status_code) {
+    for (int i = 0; i < METRIC_HTTP_CODES - 1; i++) {
+        if (http_codes[i] == status_code) return i;
+    }
+    return METRIC_HTTP_CODES - 1;
+}
+
+int metric_http_code(int index) {
+    return index >= 0 && index < METRIC_HTTP_CODES - 1 ? http_codes[index] : 0;
+}
+
+const char* metric_stage_name(MetricStage stage) {
+    switch (stage) {
+        case METRIC_STAGE_PARSE: return "parse";
+        case METRIC_STAGE_STORE: return "store";
+        case METRIC_STAGE_SEND: return "send";
+        default: return "unknown";
+    }
+}
+
+// 小于 SUB_COUNT 的值各占一个桶；之后每个 [2^m, 2^(m+1)) 区间按最高位之后的 METRIC_HIST_SUB_BITS 位分成 SUB_COUNT 个桶
+static size_t bucket_index(uint64_t ns) {
+    if (ns < SUB_COUNT) return (size_t)ns;
+    if (ns >> METRIC_HIST_MAX_BITS) return METRIC_HIST_BUCKETS - 1;
+    unsigned shift = 63 - (unsigned)__builtin_clzll(ns) - METRIC_HIST_SUB_BITS;
+    return ((size_t)(shift + 1) << METRIC_HIST_SUB_BITS) | (size_t)((ns >> shift) & (SUB_COUNT - 1));
+}
+
+// 桶的上界（不含）
+static uint64_t bucket_upper(size_t index) {
+    if (index < SUB_COUNT) return index + 1;
+    unsigned shift = (unsigned)(index >> METRIC_HIST_SUB_BITS) - 1;
+    return ((uint64_t)(SUB_COUNT | (index & (SUB_COUNT - 1))) + 1) << shift;
+}
+
+void metric_histogram_record(MetricHistogram *histogram, uint64_t ns) {
+    metric_add(&histogram->buckets[bucket_index(ns)], 1);
+    metric_add(&histogram->count, 1);
+    metric_add(&histogram->sum_ns, (size_t)ns);
+}
+
+void metric_histogram_merge(MetricHistogramSnapshot *snapshot, const MetricHistogram *histogram) {
+    for (size_t i = 0; i < METRIC_HIST_BUCKETS; i++) {
+        snapshot->buckets[i] += metric_read(&histogram->buckets[i]);
+    }
+    snapshot->count += metric_read(&histogram->count);
+    snapshot->sum_ns += metric_read(&histogram->sum_ns);
+}
+
+void metrics_text_init(MetricsText *text) {
+    text->data = NULL;
+    text->length = 0;
+    text->cap = 0;
+    text->failed = false;
+}
+
+void metrics_text_free(MetricsText *text) {
+    free(text->data);
+    metrics_text_init(text);
+}
+
+void metrics_text_printf(MetricsText *text, const char *format, ...) {
+    if (text->failed) return;
+    for (;;) {
+        size_t space = text->cap - text->length;
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text->data ? text->data + text->length : NULL, space, format, args);
+        va_end(args);
+        if (written < 0) {
+            text->failed = true;
+            return;
+        }
+        if ((size_t)written < space) {
+            text->length += (size_t)written;
+            return;
+        }
+        size_t new_cap = text->cap > 0 ? text->cap * 2 : INITIAL_TEXT_CAPACITY;
+        while (new_cap - text->length <= (size_t)written) {
+            new_cap *= 2;
+        }
+        char *data = realloc(text->data, new_cap);
+        if (!data) {
+            text->failed = true;
+            return;
+        }
+        text->data = data;
+        text->cap = new_cap;
+    }
+}
+
+void metrics_text_family(MetricsText *text, const char *name, const char *type, const char *help) {
+    metrics_text_printf(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// 输出的桶边界：2^7 纳秒（128 纳秒）到 2^35 纳秒（约 34 秒）之间的每个 2 的幂，
+// 都与内部的桶边界对齐，累计值是精确的
+#define EXPORT_MIN_BITS 7
+#define EXPORT_MAX_BITS 35
+
+void metrics_text_histogram(MetricsText *text, const char *name, const char *labels,
+                            const MetricHistogramSnapshot *snapshot) {
+    const char *separator = labels[0] ? "," : "";
+    size_t cumulative = 0;
+    size_t index = 0;
+    for (unsigned bits = EXPORT_MIN_BITS; bits <= EXPORT_MAX_BITS; bits++) {
+        uint64_t bound = 1ULL << bits;
+        while (index < METRIC_HIST_BUCKETS && bucket_upper(index) <= bound) {
+            cumulative += snapshot->buckets[index++];
+        }
+        metrics_text_printf(text, "%s_bucket{%s%sle=\"%.12g\"} %zu\n", name, labels, separator,
+                            (double)bound / 1e9, cumulative);
+    }
+    while (index < METRIC_HIST_BUCKETS) {
+        cumulative += snapshot->buckets[index++];
+    }
+    metrics_text_printf(text, "%s_bucket{%s%sle=\"+Inf\"} %zu\n", name, labels, separator, cumulative);
+    metrics_text_printf(text, "%s_sum{%s} %.9f\n", name, labels, (double)snapshot->sum_ns / 1e9);
+    // 计数与各桶分别读取，取桶的累计值，保证 _count 与 +Inf 桶一致
+    metrics_text_printf(text, "%s_count{%s} %zu\n", name, labels, cumulative);
+}
+
+// 汇总各反应器的计数（只读原子计数，不需要跨线程同步），按文本格式输出
+void metrics_text_server(MetricsText *text, struct KVServer *server) {
+    metrics_text_family(text, "c_x_info", "gauge", "Server build and configuration");
+    metrics_text_printf(text, "c_x_info{io_engine=\"%s\",store_engine=\"%s\",eviction=\"%s\"} 1\n",
+                        server_engine_name(server->engine), kv_store_engine(),
+                        kv_evict_policy_name(server->evict_policy));
+
+    metrics_text_family(text, "c_x_http_responses_total", "counter", "HTTP responses by request method and status code");
+    for (int method = 0; method < METRIC_HTTP_METHODS; method++) {
+        for (int code = 0; code < METRIC_HTTP_CODES; code++) {
+            size_t total = 0;
+            for (int i = 0; i < server->reactor_count; i++) {
+                total += metric_read(&server->reactors[i].metrics.http_responses[method][code]);
+            }
+            if (total == 0) continue;
+            char code_label[16];
+            if (metric_http_code(code) != 0) {
+                snprintf(code_label, sizeof(code_label), "%d", metric_http_code(code));
+            } else {
+                snprintf(code_label, sizeof(code_label), "other");
+            }
+            metrics_text_printf(text, "c_x_http_responses_total{method=\"%s\",code=\"%s\"} %zu\n",
+                                http_method_to_string((HttpMethod)method), code_label, total);
+        }
+    }
+
+    // 各反应器的标量计数：名称、类型、说明和在 ReactorMetrics 中的位置
+    static const struct {
+        const char *name;
+        const char *type;
+        const char *help;
+        size_t offset;
+    } scalars[] = {
+        {"c_x_resp_commands_total", "counter", "RESP commands executed", offsetof(ReactorMetrics, resp_commands)},
+        {"c_x_resp_errors_total", "counter", "RESP error replies", offsetof(ReactorMetrics, resp_errors)},
+        {"c_x_received_bytes_total", "counter", "Bytes read from client connections", offsetof(ReactorMetrics, bytes_in)},
+        {"c_x_sent_bytes_total", "counter", "Bytes written to client connections", offsetof(ReactorMetrics, bytes_out)},
+        {"c_x_connections_accepted_total", "counter", "Client connections accepted", offsetof(ReactorMetrics, accepted)},
+        {"c_x_connection_timeouts_total", "counter", "Client connections closed by a deadline", offsetof(ReactorMetrics, timeouts)},
+    };
+    for (size_t s = 0; s < sizeof(scalars) / sizeof(scalars[0]); s++) {
+        size_t total = 0;
+        for (int i = 0; i < server->reactor_count; i++) {
+            total += metric_read((const atomic_size_t *)((const char *)&server->reactors[i].metrics + scalars[s].offset));
+        }
+        metrics_text_family(text, scalars[s].name, scalars[s].type, scalars[s].help);
+        metrics_text_printf(text, "%s %zu\n", scalars[s].name, total);
+    }
+
+    long connections = 0;
+    SlabStats memory = {0};
+    KVCacheStats cache = {0};
+    size_t chains[KV_CHAIN_LENGTHS] = {0};
+    for (int i = 0; i < server->reactor_count; i++) {
+        Reactor *shard = &server->reactors[i];
+        SlabStats stats;
+        KVCacheStats shard_cache;
+        connections += atomic_load_explicit(&shard->clients.active, memory_order_relaxed);
+        slab_stats(shard->slab, &stats);
+        kv_cache_stats(shard->kv_store, &shard_cache);
+        memory.requested_bytes += stats.requested_bytes;
+        memory.used_bytes += stats.used_bytes;
+        memory.reserved_bytes += stats.reserved_bytes;
+        cache.memory += shard_cache.memory;
+        cache.limit += shard_cache.limit;
+        cache.hits += shard_cache.hits;
+        cache.misses += shard_cache.misses;
+        cache.evictions += shard_cache.evictions;
+        for (int length = 0; length < KV_CHAIN_LENGTHS; length++) {
+            chains[length] += metric_read(&shard->metrics.table_chains[length]);
+        }
+    }
+    metrics_text_family(text, "c_x_connections", "gauge", "Open client connections");
+    metrics_text_printf(text, "c_x_connections %ld\n", connections);
+
+    metrics_text_family(text, "c_x_log_dropped_total", "counter", "Log records dropped because the log ring was full");
+    metrics_text_printf(text, "c_x_log_dropped_total %zu\n", logger_dropped());
+    metrics_text_family(text, "c_x_log_suppressed_total", "counter", "Log records suppressed by the per-call-site rate limit");
+    metrics_text_printf(text, "c_x_log_suppressed_total %zu\n", logger_suppressed());
+
+    metrics_text_family(text, "c_x_store_keys", "gauge", "Keys in the in-memory store of each shard");
+    for (int i = 0; i < server->reactor_count; i++) {
+        metrics_text_printf(text, "c_x_store_keys{shard=\"%d\"} %zu\n", i,
+                            metric_read(&server->reactors[i].metrics.table_keys));
+    }
+    metrics_text_family(text, "c_x_store_mapped_keys", "gauge", "Keys of each shard still served from the mapped snapshot");
+    for (int i = 0; i < server->reactor_count; i++) {
+        metrics_text_printf(text, "c_x_store_mapped_keys{shard=\"%d\"} %zu\n", i,
+                            metric_read(&server->reactors[i].metrics.mapped_keys));
+    }
+    metrics_text_family(text, "c_x_store_buckets", "gauge", "Index buckets (slots) of each shard");
+    for (int i = 0; i < server->reactor_count; i++) {
+        metrics_text_printf(text, "c_x_store_buckets{shard=\"%d\"} %zu\n", i,
+                            metric_read(&server->reactors[i].metrics.table_buckets));
+    }
+    metrics_text_family(text, "c_x_store_load_factor", "gauge", "In-memory keys per index bucket of each shard");
+    for (int i = 0; i < server->reactor_count; i++) {
+        size_t buckets = metric_read(&server->reactors[i].metrics.table_buckets);
+        size_t keys = metric_read(&server->reactors[i].metrics.table_keys);
+        metrics_text_printf(text, "c_x_store_load_factor{shard=\"%d\"} %.4f\n", i,
+                            buckets ? (double)keys / (double)buckets : 0.0);
+    }
+    metrics_text_family(text, "c_x_store_chain_length", "gauge",
+                        "Estimated index buckets by chain length (probe groups for the swiss engine), sampled");
+    for (int length = 0; length < KV_CHAIN_LENGTHS; length++) {
+        metrics_text_printf(text, "c_x_store_chain_length{length=\"%d%s\"} %zu\n", length,
+                            length == KV_CHAIN_LENGTHS - 1 ? "+" : "", chains[length]);
+    }
+
+    metrics_text_family(text, "c_x_store_memory_bytes", "gauge", "Memory charged to the key space");
+    metrics_text_printf(text, "c_x_store_memory_bytes %zu\n", cache.memory);
+    metrics_text_family(text, "c_x_store_max_memory_bytes", "gauge", "Key space memory limit, 0 if unlimited");
+    metrics_text_printf(text, "c_x_store_max_memory_bytes %zu\n", cache.limit);
+    metrics_text_family(text, "c_x_store_hits_total", "counter", "Key lookups that found the key in memory");
+    metrics_text_printf(text, "c_x_store_hits_total %zu\n", cache.hits);
+    metrics_text_family(text, "c_x_store_misses_total", "counter", "Key lookups that missed the in-memory store");
+    metrics_text_printf(text, "c_x_store_misses_total %zu\n", cache.misses);
+    metrics_text_family(text, "c_x_store_evictions_total", "counter", "Keys evicted by the memory limit");
+    metrics_text_printf(text, "c_x_store_evictions_total %zu\n", cache.evictions);
+    metrics_text_family(text, "c_x_slab_bytes", "gauge", "Slab allocator memory");
+    metrics_text_printf(text, "c_x_slab_bytes{kind=\"requested\"} %zu\n", memory.requested_bytes);
+    metrics_text_printf(text, "c_x_slab_bytes{kind=\"used\"} %zu\n", memory.used_bytes);
+    metrics_text_printf(text, "c_x_slab_bytes{kind=\"reserved\"} %zu\n", memory.reserved_bytes);
+
+    // 阶段延迟：各反应器的直方图按桶相加；每 METRIC_TIMING_SAMPLE 次操作取样一次
+    MetricHistogramSnapshot *stages = calloc(METRIC_STAGE_COUNT, sizeof(MetricHistogramSnapshot));
+    if (stages) {
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            for (int i = 0; i < server->reactor_count; i++) {
+                metric_histogram_merge(&stages[stage], &server->reactors[i].metrics.stages[stage]);
+            }
+        }
+        metrics_text_family(text, "c_x_stage_duration_seconds", "histogram",
+                            "Sampled duration of request parsing, store operations and sends");
+        for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+            char labels[32];
+            snprintf(labels, sizeof(labels), "stage=\"%s\"", metric_stage_name((MetricStage)stage));
+            metrics_text_histogram(text, "c_x_stage_duration_seconds", labels, &stages[stage]);
+        }
+        free(stages);
+    } else {
+        text->failed = true;
+    }
+}
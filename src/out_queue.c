@@ -0,0 +1,125 @@
+#include "out_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool out_queue_push_segment(OutQueue *queue, KVValue *value, size_t offset, size_t length) {
+    if (queue->seg_count == queue->seg_cap) {
+        size_t new_cap = queue->seg_cap ? queue->seg_cap * 2 : 16;
+        OutSegment *new_segs = realloc(queue->segs, new_cap * sizeof(OutSegment));
+        if (!new_segs) return false;
+        queue->segs = new_segs;
+        queue->seg_cap = new_cap;
+    }
+    OutSegment *segment = &queue->segs[queue->seg_count++];
+    segment->value = value;
+    segment->offset = offset;
+    segment->length = length;
+    queue->pending += length;
+    return true;
+}
+
+// 保证缓冲区末尾至少有 length 字节空闲，返回写入位置；写完后用 out_queue_commit 提交
+char* out_queue_reserve(OutQueue *queue, size_t length) {
+    if (queue->buf_len + length > queue->buf_cap) {
+        size_t new_cap = queue->buf_cap ? queue->buf_cap : 4096;
+        while (new_cap < queue->buf_len + length) {
+            new_cap *= 2;
+        }
+        char *new_buf = realloc(queue->buf, new_cap);
+        if (!new_buf) return NULL;
+        queue->buf = new_buf;
+        queue->buf_cap = new_cap;
+    }
+    return queue->buf + queue->buf_len;
+}
+
+// 把 out_queue_reserve 返回位置上写入的 length 字节加入队列
+bool out_queue_commit(OutQueue *queue, size_t length) {
+    if (length == 0) return true;
+    // 紧接在上一个缓冲区分段之后时直接扩展该分段
+    OutSegment *last = queue->seg_count > queue->seg_head ? &queue->segs[queue->seg_count - 1] : NULL;
+    if (last && !last->value && last->offset + last->length == queue->buf_len) {
+        last->length += length;
+        queue->pending += length;
+    } else if (!out_queue_push_segment(queue, NULL, queue->buf_len, length)) {
+        return false;
+    }
+    queue->buf_len += length;
+    return true;
+}
+
+bool out_queue_append(OutQueue *queue, const char *data, size_t length) {
+    if (length == 0) return true;
+    char *dest = out_queue_reserve(queue, length);
+    if (!dest) return false;
+    memcpy(dest, data, length);
+    return out_queue_commit(queue, length);
+}
+
+bool out_queue_append_value(OutQueue *queue, KVValue *value) {
+    if (value->length < OUT_QUEUE_INLINE_MAX) {
+        return out_queue_append(queue, value->data, value->length);
+    }
+    if (!out_queue_push_segment(queue, kv_value_retain(value), 0, value->length)) {
+        kv_value_release(value);
+        return false;
+    }
+    return true;
+}
+
+// 从第一个未发送的分段开始填充 iovec，返回使用的数量
+int out_queue_fill_iov(const OutQueue *queue, struct iovec *iov, int max_iov) {
+    int count = 0;
+    for (size_t i = queue->seg_head; i < queue->seg_count && count < max_iov; i++) {
+        const OutSegment *segment = &queue->segs[i];
+        const char *base = segment->value ? segment->value->data : queue->buf + segment->offset;
+        size_t skip = i == queue->seg_head ? queue->head_sent : 0;
+        iov[count].iov_base = (void *)(base + skip);
+        iov[count].iov_len = segment->length - skip;
+        count++;
+    }
+    return count;
+}
+
+// 标记 bytes 字节已发送，释放已发完的值引用；全部发送后重置缓冲区
+void out_queue_consume(OutQueue *queue, size_t bytes) {
+    if (bytes > queue->pending) bytes = queue->pending;
+    queue->pending -= bytes;
+    while (bytes > 0 && queue->seg_head < queue->seg_count) {
+        OutSegment *segment = &queue->segs[queue->seg_head];
+        size_t left = segment->length - queue->head_sent;
+        if (bytes < left) {
+            queue->head_sent += bytes;
+            return;
+        }
+        bytes -= left;
+        kv_value_release(segment->value);
+        segment->value = NULL;
+        queue->seg_head++;
+        queue->head_sent = 0;
+    }
+    if (queue->pending == 0) {
+        queue->buf_len = 0;
+        queue->seg_count = 0;
+        queue->seg_head = 0;
+        queue->head_sent = 0;
+    }
+}
+
+void out_queue_clear(OutQueue *queue) {
+    for (size_t i = queue->seg_head; i < queue->seg_count; i++) {
+        kv_value_release(queue->segs[i].value);
+    }
+    queue->buf_len = 0;
+    queue->seg_count = 0;
+    queue->seg_head = 0;
+    queue->head_sent = 0;
+    queue->pending = 0;
+}
+
+void out_queue_free(OutQueue *queue) {
+    out_queue_clear(queue);
+    free(queue->buf);
+    free(queue->segs);
+    memset(queue, 0, sizeof(*queue));
+}
@@ -0,0 +1,1049 @@
+#include "persistence.h"
+#include "append_log.h"
+#include "server_internal.h"
+#include "kv_store.h"
+#include "snapshot.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PERSIST_DIR_MAX 2048
+#define PERSIST_PATH_MAX (PERSIST_DIR_MAX + 512) // 目录加文件名
+#define DUMP_FLUSH_SIZE (1024 * 1024) // 重写子进程缓冲到该大小后写入一次
+#define SNAPSHOT_REPORT_MS 5000       // 快照进行中每隔这么久输出一次进度
+#define SNAPSHOT_CHILD_NICE 10        // 写快照的子进程降低优先级，少占反应器的 CPU
+
+// 后台子进程的种类，同一时间只有一个
+typedef enum {
+    CHILD_NONE,
+    CHILD_REWRITE,  // 重写追加日志的基础文件
+    CHILD_SNAPSHOT  // 写快照文件
+} ChildKind;
+
+// 启动时需要重放的一个文件
+typedef struct {
+    uint64_t generation;
+    bool base;            // 基础文件排在同一代的增量日志之前
+    int shard;
+    uint64_t size;
+} PersistFile;
+
+struct Persistence {
+    KVServer *server;
+    bool log_enabled;              // 配置了日志目录
+    char dir[PERSIST_DIR_MAX];
+    FsyncPolicy policy;
+    int interval_ms;
+    PersistFile *replay;           // 按代数排列，只在反应器线程启动前写入
+    size_t replay_count;
+    uint64_t generation;           // 当前增量日志的代数
+    uint64_t base_bytes;           // 最近的基础文件大小
+    uint64_t older_bytes;          // 比当前代数旧、下次重写成功后删除的增量日志大小
+    uint64_t synced[MAX_REACTORS]; // 各分片日志已同步到的字节数（后台线程使用）
+    pid_t child;                   // 正在运行的子进程，0 表示没有
+    ChildKind child_kind;
+    uint64_t child_generation;     // 重写子进程写出的基础文件代数
+    struct timespec child_started;
+    char snapshot_path[PERSIST_DIR_MAX]; // 快照文件，空字符串表示未配置
+    int snapshot_interval_s;       // 定时快照的间隔，0 表示只按请求写
+    struct timespec last_snapshot; // 上次开始快照（或后台线程启动）的时刻
+    struct timespec last_report;
+    struct timespec snapshot_started; // 由 lock 保护
+    SnapshotProgress *progress;    // 与写快照的子进程共享的进度
+    SnapshotStatus snapshot;       // 快照状态，由 lock 保护
+    bool snapshot_requested;
+    pthread_t thread;
+    bool thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stopping;
+    bool rewrite_requested;
+};
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void base_path(const Persistence *p, uint64_t generation, const char *suffix, char *path) {
+    snprintf(path, PERSIST_PATH_MAX, "%s/base-%" PRIu64 ".%s", p->dir, generation, suffix);
+}
+
+static void incr_path(const Persistence *p, uint64_t generation, int shard, char *path) {
+    snprintf(path, PERSIST_PATH_MAX, "%s/incr-%" PRIu64 "-%d.cxl", p->dir, generation, shard);
+}
+
+// 新建、改名和删除的文件在目录落盘后才能在崩溃后可见
+static bool sync_dir(const char *dir) {
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+// 解析目录中的日志文件名；*tmp 为重写未完成留下的临时文件
+static bool parse_name(const char *name, PersistFile *file, bool *tmp) {
+    unsigned long long generation;
+    int shard, end = 0;
+    memset(file, 0, sizeof(*file));
+    *tmp = false;
+    if (sscanf(name, "incr-%llu-%d.cxl%n", &generation, &shard, &end) == 2 && name[end] == '\0' && shard >= 0) {
+        file->generation = generation;
+        file->shard = shard;
+        return true;
+    }
+    end = 0;
+    if (sscanf(name, "base-%llu.cxl%n", &generation, &end) == 1 && name[end] == '\0') {
+        file->generation = generation;
+        file->base = true;
+        return true;
+    }
+    end = 0;
+    if (sscanf(name, "base-%llu.tmp%n", &generation, &end) == 1 && name[end] == '\0') {
+        file->generation = generation;
+        file->base = true;
+        *tmp = true;
+        return true;
+    }
+    return false;
+}
+
+static void file_path(const Persistence *p, const PersistFile *file, char *path) {
+    if (file->base) {
+        base_path(p, file->generation, "cxl", path);
+    } else {
+        incr_path(p, file->generation, file->shard, path);
+    }
+}
+
+static int compare_files(const void *a, const void *b) {
+    const PersistFile *x = a, *y = b;
+    if (x->generation != y->generation) return x->generation < y->generation ? -1 : 1;
+    if (x->base != y->base) return x->base ? -1 : 1;
+    return x->shard - y->shard;
+}
+
+// 删除代数小于 keep 的文件和重写留下的临时文件
+static void remove_old_files(Persistence *p, uint64_t keep) {
+    DIR *dir = opendir(p->dir);
+    if (!dir) return;
+    struct dirent *entry;
+    char path[PERSIST_PATH_MAX];
+    while ((entry = readdir(dir)) != NULL) {
+        PersistFile file;
+        bool tmp;
+        if (!parse_name(entry->d_name, &file, &tmp)) continue;
+        if (file.generation < keep || (tmp && !(p->child > 0 && file.generation == p->child_generation))) {
+            snprintf(path, sizeof(path), "%s/%s", p->dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    sync_dir(p->dir);
+}
+
+Persistence* persistence_create(KVServer *server) {
+    const char *dir = server->log_dir ? server->log_dir : "";
+    const char *snapshot = server->snapshot_path ? server->snapshot_path : "";
+    if (strlen(dir) >= PERSIST_DIR_MAX || strlen(snapshot) >= PERSIST_DIR_MAX) return NULL;
+    Persistence *p = calloc(1, sizeof(Persistence));
+    if (!p) return NULL;
+    // 进度计数放在共享映射中，fork 后子进程的更新父进程可见
+    p->progress = mmap(NULL, sizeof(SnapshotProgress), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p->progress == MAP_FAILED) {
+        free(p);
+        return NULL;
+    }
+    atomic_init(&p->progress->keys, 0);
+    atomic_init(&p->progress->bytes, 0);
+    atomic_init(&p->progress->elapsed_us, 0);
+    p->server = server;
+    p->log_enabled = dir[0] != '\0';
+    snprintf(p->dir, sizeof(p->dir), "%s", dir);
+    p->policy = server->fsync_policy;
+    p->interval_ms = server->fsync_interval_ms > 0 ? server->fsync_interval_ms : PERSIST_DEFAULT_FSYNC_MS;
+    snprintf(p->snapshot_path, sizeof(p->snapshot_path), "%s", snapshot);
+    p->snapshot_interval_s = server->snapshot_interval_s;
+    p->snapshot.configured = snapshot[0] != '\0';
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    return p;
+}
+
+void persistence_destroy(Persistence *p) {
+    if (!p) return;
+    persistence_stop(p);
+    free(p->replay);
+    munmap(p->progress, sizeof(SnapshotProgress));
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    free(p);
+}
+
+bool persistence_open(Persistence *p) {
+    if (!p->log_enabled) {
+        if (p->snapshot.configured) {
+            LOG_INFO("快照文件 %s（定时快照: %s）", p->snapshot_path, p->snapshot_interval_s > 0 ? "启用" : "不启用");
+        }
+        return true;
+    }
+    if (mkdir(p->dir, 0755) == -1 && errno != EEXIST) {
+        LOG_ERROR("创建日志目录 %s 失败: %s", p->dir, strerror(errno));
+        return false;
+    }
+    DIR *dir = opendir(p->dir);
+    if (!dir) {
+        LOG_ERROR("打开日志目录 %s 失败: %s", p->dir, strerror(errno));
+        return false;
+    }
+    // 找出最新的基础文件，它之前的文件都已包含在其中
+    PersistFile *files = NULL;
+    size_t count = 0, cap = 0;
+    uint64_t newest_base = 0, newest = 0;
+    bool have_base = false;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        PersistFile file;
+        bool tmp;
+        if (!parse_name(entry->d_name, &file, &tmp) || tmp) continue;
+        if (count == cap) {
+            size_t new_cap = cap > 0 ? cap * 2 : 16;
+            PersistFile *grown = realloc(files, new_cap * sizeof(PersistFile));
+            if (!grown) {
+                closedir(dir);
+                free(files);
+                return false;
+            }
+            files = grown;
+            cap = new_cap;
+        }
+        files[count++] = file;
+        if (file.generation > newest) newest = file.generation;
+        if (file.base && (!have_base || file.generation > newest_base)) {
+            newest_base = file.generation;
+            have_base = true;
+        }
+    }
+    closedir(dir);
+
+    char path[PERSIST_PATH_MAX];
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        PersistFile *file = &files[i];
+        if (have_base && (file->generation < newest_base || (file->base && file->generation != newest_base))) {
+            continue;
+        }
+        file_path(p, file, path);
+        struct stat st;
+        if (stat(path, &st) == 0) {
+            file->size = (uint64_t)st.st_size;
+            if (file->base) {
+                p->base_bytes = file->size;
+            } else {
+                p->older_bytes += file->size;
+            }
+        }
+        files[kept++] = *file;
+    }
+    qsort(files, kept, sizeof(PersistFile), compare_files);
+    p->replay = files;
+    p->replay_count = kept;
+    p->generation = newest + 1;
+    remove_old_files(p, have_base ? newest_base : 0);
+
+    KVServer *server = p->server;
+    for (int i = 0; i < server->reactor_count; i++) {
+        incr_path(p, p->generation, i, path);
+        if (!append_log_open(&server->reactors[i].log, path)) {
+            LOG_ERROR("创建追加日志 %s 失败: %s", path, strerror(errno));
+            return false;
+        }
+        p->synced[i] = APPEND_LOG_HEADER_SIZE;
+    }
+    sync_dir(p->dir);
+    LOG_INFO("追加日志目录 %s（落盘策略: %s，待重放 %zu 个文件，%.2f MB）", p->dir, fsync_policy_name(p->policy),
+             kept, (double)(p->base_bytes + p->older_bytes) / (1024.0 * 1024.0));
+    return true;
+}
+
+// 重放时只把属于本分片的记录写入存储，不再写入日志
+typedef struct {
+    Reactor *reactor;
+    size_t shard_count;
+    size_t applied;
+    bool failed;
+} ReplayState;
+
+static bool replay_set(ReplayState *state, const char *key, size_t key_length, const char *value,
+                       size_t value_length, uint64_t expire_ms) {
+    Reactor *reactor = state->reactor;
+    KVValue *stored = kv_value_create(reactor->slab, value, value_length);
+    bool ok = stored && kv_set_value_expire(reactor->kv_store, key, key_length, stored, expire_ms);
+    kv_value_release(stored);
+    if (!ok) {
+        state->failed = true;
+    }
+    return ok;
+}
+
+// 过期时刻是绝对时间：重放到已经过期的 EXPIRE 记录时直接删除该键
+static bool replay_record(void *arg, AppendLogOp op, const char *key, size_t key_length,
+                          const char *value, size_t value_length) {
+    ReplayState *state = arg;
+    Reactor *reactor = state->reactor;
+    if (kv_shard_index(key, key_length, state->shard_count) != (size_t)reactor->id) return true;
+    if (op == APPEND_LOG_SET) {
+        if (!replay_set(state, key, key_length, value, value_length, 0)) return false;
+    } else if (op == APPEND_LOG_EXPIRE) {
+        // 已经过去的时刻同样设置：之后的记录可能取消它，重放结束后仍过期的键由主动过期删除
+        kv_set_expire(reactor->kv_store, key, key_length, append_log_expire_time(value, value_length));
+    } else {
+        kv_delete(reactor->kv_store, key, key_length);
+    }
+    state->applied++;
+    return true;
+}
+
+static void replay_logs(Persistence *p, Reactor *reactor) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ReplayState state = {reactor, (size_t)p->server->reactor_count, 0, false};
+    char path[PERSIST_PATH_MAX];
+    kv_set_loading(reactor->kv_store, true);
+    for (size_t i = 0; i < p->replay_count && !state.failed; i++) {
+        const PersistFile *file = &p->replay[i];
+        file_path(p, file, path);
+        uint64_t valid, size;
+        if (!append_log_replay(path, replay_record, &state, &valid, &size)) {
+            if (reactor->id == 0) LOG_WARN("无法读取日志文件 %s，已跳过", path);
+            continue;
+        }
+        // 崩溃时最后一批记录可能只写了一部分，之后的内容丢弃
+        if (valid < size && reactor->id == 0) {
+            LOG_WARN("日志文件 %s 在偏移 %" PRIu64 " 处不完整或损坏，忽略其后的 %" PRIu64 " 字节",
+                     path, valid, size - valid);
+        }
+    }
+    kv_set_loading(reactor->kv_store, false);
+    if (state.failed) {
+        LOG_ERROR("反应器 %d: 重放日志时内存不足，数据不完整", reactor->id);
+    }
+    if (p->replay_count > 0) {
+        LOG_INFO("反应器 %d: 从日志恢复 %zu 个键（重放 %zu 条记录，用时 %.1f ms）", reactor->id,
+                 kv_size(reactor->kv_store), state.applied, elapsed_ms(&start));
+    }
+}
+
+static bool load_snapshot_record(void *arg, const char *key, size_t key_length, const char *value,
+                                 size_t value_length, uint64_t expire_ms) {
+    ReplayState *state = arg;
+    if (kv_shard_index(key, key_length, state->shard_count) != (size_t)state->reactor->id) return true;
+    if (expire_ms != 0 && expire_ms <= kv_now_ms()) return true;
+    if (!replay_set(state, key, key_length, value, value_length, expire_ms)) return false;
+    state->applied++;
+    return true;
+}
+
+// 从快照恢复本分片：分片数与快照一致时只读自己的分区，否则扫描全部分区并按键筛选
+static void load_snapshot(Persistence *p, Reactor *reactor) {
+    SnapshotFile file;
+    if (!snapshot_open(&file, p->snapshot_path)) {
+        if (reactor->id == 0 && access(p->snapshot_path, F_OK) == 0) {
+            LOG_WARN("快照文件 %s 无法读取或格式错误，未加载", p->snapshot_path);
+        }
+        return;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ReplayState state = {reactor, (size_t)p->server->reactor_count, 0, false};
+    uint32_t shard_count = file.header->shard_count;
+    bool same_layout = shard_count == (uint32_t)p->server->reactor_count;
+    uint32_t first = same_layout ? (uint32_t)reactor->id : 0;
+    uint32_t last = same_layout ? first + 1 : shard_count;
+    for (uint32_t section = first; section < last && !state.failed; section++) {
+        if (!snapshot_visit_section(&file, section, load_snapshot_record, &state)) {
+            LOG_WARN("反应器 %d: 快照分区 %u 校验失败，已跳过", reactor->id, section);
+        }
+    }
+    snapshot_close(&file);
+    if (state.failed) {
+        LOG_ERROR("反应器 %d: 加载快照时内存不足，数据不完整", reactor->id);
+    }
+    LOG_INFO("反应器 %d: 从快照恢复 %zu 个键（用时 %.1f ms）", reactor->id, kv_size(reactor->kv_store),
+             elapsed_ms(&start));
+}
+
+// 分片数与快照一致时直接映射本分片的分区，键在读取时或由反应器在空闲轮次中逐步复制到内存
+static bool map_snapshot(Persistence *p, Reactor *reactor) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    SnapshotShard *base = malloc(sizeof(SnapshotShard));
+    if (!base) return false;
+    if (!snapshot_shard_open(base, p->snapshot_path, (uint32_t)reactor->id, (uint32_t)p->server->reactor_count)) {
+        free(base);
+        return false;
+    }
+    reactor->base = base;
+    reactor->base_opened = start;
+    LOG_INFO("反应器 %d: 映射快照分区（%zu 个键，用时 %.1f ms），后台合并到内存", reactor->id, base->live,
+             elapsed_ms(&start));
+    return true;
+}
+
+void persistence_load_shard(Persistence *p, Reactor *reactor) {
+    // 启用追加日志时以日志为准，快照只用于备份
+    if (p->log_enabled) {
+        replay_logs(p, reactor);
+    } else if (p->snapshot.configured && !map_snapshot(p, reactor)) {
+        load_snapshot(p, reactor);
+    }
+}
+
+// 把上次同步后有新写入的日志落盘；文件由后台线程切换，fd 在这里读取是安全的
+static void sync_logs(Persistence *p) {
+    KVServer *server = p->server;
+    for (int i = 0; i < server->reactor_count; i++) {
+        AppendLog *log = &server->reactors[i].log;
+        uint64_t written = atomic_load_explicit(&log->written, memory_order_relaxed);
+        if (written == p->synced[i]) continue;
+        if (fdatasync(log->fd) == -1) {
+            LOG_ERROR("同步追加日志失败: %s", strerror(errno));
+            continue;
+        }
+        p->synced[i] = written;
+    }
+}
+
+static uint64_t current_bytes(Persistence *p) {
+    uint64_t total = 0;
+    KVServer *server = p->server;
+    for (int i = 0; i < server->reactor_count; i++) {
+        total += atomic_load_explicit(&server->reactors[i].log.written, memory_order_relaxed);
+    }
+    return total;
+}
+
+static bool rewrite_due(Persistence *p) {
+    uint64_t total = p->base_bytes + p->older_bytes + current_bytes(p);
+    return total > PERSIST_REWRITE_MIN_SIZE &&
+           total > p->base_bytes + p->base_bytes * PERSIST_REWRITE_GROWTH / 100;
+}
+
+// 重写子进程：把所有分片的条目作为 SET 记录（带过期时刻的再加一条 EXPIRE）写入临时文件，
+// 落盘后改名为基础文件
+static bool dump_entry(void *arg, const HashEntry *entry) {
+    AppendLog *out = arg;
+    if (!append_log_set(out, entry->key, entry->key_length, entry->value->data, entry->value->length)) {
+        return false;
+    }
+    if (entry->expiry && !append_log_expire(out, entry->key, entry->key_length, kv_entry_expire(entry))) {
+        return false;
+    }
+    return out->len < DUMP_FLUSH_SIZE || append_log_write(out);
+}
+
+// 子进程只使用标准输入输出和自己打开的文件。继承的监听套接字、客户端连接、增量日志和事件循环的描述符
+// 全部关闭，否则子进程存活期间父进程关闭的连接不会真正断开，重启的服务器也无法绑定端口
+static void close_inherited_fds(void) {
+#ifdef C_X_HAVE_CLOSE_RANGE
+    if (close_range(3, ~0U, 0) == 0) return;
+#endif
+    // 没有 close_range（或内核不支持）时逐个关闭，上限为描述符数的软限制
+    struct rlimit limit;
+    int max_fd = 65536;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < (rlim_t)INT_MAX) {
+        max_fd = (int)limit.rlim_cur;
+    }
+    for (int fd = 3; fd < max_fd; fd++) {
+        close(fd);
+    }
+}
+
+// 子进程不执行服务器的停止处理，收到停止信号直接退出
+static void reset_child_signals(void) {
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+static void write_base_and_exit(Persistence *p, uint64_t generation) {
+    char tmp[PERSIST_PATH_MAX], path[PERSIST_PATH_MAX];
+    base_path(p, generation, "tmp", tmp);
+    base_path(p, generation, "cxl", path);
+    AppendLog out;
+    append_log_init(&out);
+    if (!append_log_open(&out, tmp)) _exit(1);
+    KVServer *server = p->server;
+    for (int i = 0; i < server->reactor_count; i++) {
+        kv_store_foreach(server->reactors[i].kv_store, dump_entry, &out);
+    }
+    bool ok = append_log_write(&out) && !append_log_pending(&out) && fdatasync(out.fd) == 0;
+    close(out.fd);
+    if (ok && rename(tmp, path) == 0 && sync_dir(p->dir)) _exit(0);
+    unlink(tmp);
+    _exit(1);
+}
+
+// 开始一次重写：切换到新一代增量日志后 fork，子进程写出切换时刻的全部数据；
+// 切换和 fork 在所有反应器暂停时进行，新旧日志的分界与子进程看到的数据一致
+static void start_rewrite(Persistence *p) {
+    KVServer *server = p->server;
+    int count = server->reactor_count;
+    uint64_t generation = p->generation + 1;
+    int fds[MAX_REACTORS];
+    char path[PERSIST_PATH_MAX];
+    for (int i = 0; i < count; i++) {
+        incr_path(p, generation, i, path);
+        fds[i] = append_log_create_file(path);
+        if (fds[i] == -1) {
+            LOG_ERROR("重写追加日志失败: 创建 %s: %s", path, strerror(errno));
+            while (--i >= 0) {
+                close(fds[i]);
+                incr_path(p, generation, i, path);
+                unlink(path);
+            }
+            return;
+        }
+    }
+    sync_dir(p->dir);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (!server_pause_reactors(server)) {
+        for (int i = 0; i < count; i++) {
+            close(fds[i]);
+            incr_path(p, generation, i, path);
+            unlink(path);
+        }
+        return;
+    }
+    uint64_t old_bytes[MAX_REACTORS];
+    for (int i = 0; i < count; i++) {
+        AppendLog *log = &server->reactors[i].log;
+        old_bytes[i] = atomic_load_explicit(&log->written, memory_order_relaxed);
+        fds[i] = append_log_swap(log, fds[i]);
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close_inherited_fds();
+        reset_child_signals();
+        write_base_and_exit(p, generation);
+    }
+    server_resume_reactors(server);
+    double paused_ms = elapsed_ms(&start);
+
+    // 旧日志的内容在暂停时已全部写出，落盘后关闭；重写成功后连同旧基础文件一起删除
+    for (int i = 0; i < count; i++) {
+        if (p->policy != FSYNC_NO) fdatasync(fds[i]);
+        close(fds[i]);
+        p->older_bytes += old_bytes[i];
+        p->synced[i] = APPEND_LOG_HEADER_SIZE;
+    }
+    p->generation = generation;
+    if (pid == -1) {
+        LOG_ERROR("重写追加日志失败: fork: %s", strerror(errno));
+        return;
+    }
+    p->child = pid;
+    p->child_kind = CHILD_REWRITE;
+    p->child_generation = generation;
+    p->child_started = start;
+    LOG_INFO("开始重写追加日志（第 %" PRIu64 " 代，子进程 %d，反应器暂停 %.2f ms）", generation, (int)pid, paused_ms);
+}
+
+// 写快照：所有反应器暂停时 fork，子进程以较低优先级把 fork 时刻的数据写入快照文件，
+// 父进程的反应器立即恢复，之后只在写时复制时付出代价
+static void start_snapshot(Persistence *p) {
+    KVServer *server = p->server;
+    int count = server->reactor_count;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    p->last_snapshot = start;
+    p->last_report = start;
+    if (!server_pause_reactors(server)) return;
+    uint64_t total = 0;
+    SnapshotSource sources[MAX_REACTORS];
+    for (int i = 0; i < count; i++) {
+        Reactor *reactor = &server->reactors[i];
+        sources[i].store = reactor->kv_store;
+        sources[i].base = reactor->base;
+        total += reactor_key_count(reactor);
+    }
+    atomic_store_explicit(&p->progress->keys, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->progress->bytes, 0, memory_order_relaxed);
+    atomic_store_explicit(&p->progress->elapsed_us, 0, memory_order_relaxed);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close_inherited_fds();
+        reset_child_signals();
+        setpriority(PRIO_PROCESS, 0, SNAPSHOT_CHILD_NICE);
+        _exit(snapshot_write(p->snapshot_path, sources, count, p->progress) ? 0 : 1);
+    }
+    server_resume_reactors(server);
+    double paused_ms = elapsed_ms(&start);
+    if (pid == -1) {
+        LOG_ERROR("写快照失败: fork: %s", strerror(errno));
+        pthread_mutex_lock(&p->lock);
+        p->snapshot_requested = false;
+        p->snapshot.has_last = true;
+        p->snapshot.last_ok = false;
+        p->snapshot.last_finished = (long long)time(NULL);
+        pthread_mutex_unlock(&p->lock);
+        return;
+    }
+    p->child = pid;
+    p->child_kind = CHILD_SNAPSHOT;
+    p->child_started = start;
+    pthread_mutex_lock(&p->lock);
+    p->snapshot_requested = false;
+    p->snapshot.running = true;
+    p->snapshot_started = start;
+    p->snapshot.keys_total = total;
+    p->snapshot.pause_ms = paused_ms;
+    pthread_mutex_unlock(&p->lock);
+    LOG_INFO("开始写快照 %s（%" PRIu64 " 个键，子进程 %d，反应器暂停 %.2f ms）", p->snapshot_path, total, (int)pid,
+             paused_ms);
+}
+
+static void finish_rewrite(Persistence *p, bool ok, int status) {
+    char path[PERSIST_PATH_MAX];
+    if (ok) {
+        base_path(p, p->child_generation, "cxl", path);
+        struct stat st;
+        p->base_bytes = stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+        p->older_bytes = 0;
+        remove_old_files(p, p->child_generation);
+        LOG_INFO("追加日志重写完成（第 %" PRIu64 " 代，基础文件 %.2f MB，用时 %.1f ms）", p->child_generation,
+                 (double)p->base_bytes / (1024.0 * 1024.0), elapsed_ms(&p->child_started));
+        return;
+    }
+    LOG_ERROR("追加日志重写失败（子进程状态 %d）", status);
+    base_path(p, p->child_generation, "tmp", path);
+    unlink(path);
+}
+
+static void finish_snapshot(Persistence *p, bool ok, int status) {
+    double duration = elapsed_ms(&p->child_started);
+    uint64_t keys = atomic_load_explicit(&p->progress->keys, memory_order_relaxed);
+    uint64_t bytes = atomic_load_explicit(&p->progress->bytes, memory_order_relaxed);
+    if (ok) {
+        // 后台线程按固定间隔检查子进程，用时以子进程自己的计时为准，再加上 fork 前的暂停
+        double pause_ms = p->snapshot.pause_ms;
+        duration = pause_ms + (double)atomic_load_explicit(&p->progress->elapsed_us, memory_order_relaxed) / 1000.0;
+        struct stat st;
+        if (stat(p->snapshot_path, &st) == 0) bytes = (uint64_t)st.st_size;
+        LOG_INFO("快照完成 %s（%" PRIu64 " 个键，%.2f MB，用时 %.1f ms）", p->snapshot_path, keys,
+                 (double)bytes / (1024.0 * 1024.0), duration);
+    } else {
+        LOG_ERROR("写快照失败（子进程状态 %d）", status);
+        char tmp[PERSIST_PATH_MAX];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", p->snapshot_path);
+        unlink(tmp);
+    }
+    pthread_mutex_lock(&p->lock);
+    SnapshotStatus *snapshot = &p->snapshot;
+    snapshot->running = false;
+    snapshot->has_last = true;
+    snapshot->last_ok = ok;
+    snapshot->last_keys = keys;
+    snapshot->last_bytes = bytes;
+    snapshot->last_duration_ms = duration;
+    snapshot->last_pause_ms = snapshot->pause_ms;
+    snapshot->last_finished = (long long)time(NULL);
+    pthread_mutex_unlock(&p->lock);
+}
+
+// 检查子进程，block 为 true 时等待其退出
+static void check_child(Persistence *p, bool block) {
+    int status;
+    pid_t result = waitpid(p->child, &status, block ? 0 : WNOHANG);
+    if (result == 0) {
+        if (p->child_kind == CHILD_SNAPSHOT && elapsed_ms(&p->last_report) >= SNAPSHOT_REPORT_MS) {
+            clock_gettime(CLOCK_MONOTONIC, &p->last_report);
+            uint64_t keys = atomic_load_explicit(&p->progress->keys, memory_order_relaxed);
+            uint64_t bytes = atomic_load_explicit(&p->progress->bytes, memory_order_relaxed);
+            uint64_t total = p->snapshot.keys_total;
+            LOG_INFO("快照进度: %" PRIu64 "/%" PRIu64 " 个键（%.0f%%），已写入 %.2f MB", keys, total,
+                     total > 0 ? 100.0 * (double)keys / (double)total : 100.0, (double)bytes / (1024.0 * 1024.0));
+        }
+        return;
+    }
+    bool ok = result == p->child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    ChildKind kind = p->child_kind;
+    p->child = 0;
+    p->child_kind = CHILD_NONE;
+    if (kind == CHILD_REWRITE) {
+        finish_rewrite(p, ok, status);
+    } else {
+        finish_snapshot(p, ok, status);
+    }
+}
+
+static bool snapshot_due(Persistence *p) {
+    return p->snapshot.configured && p->snapshot_interval_s > 0 &&
+           elapsed_ms(&p->last_snapshot) >= (double)p->snapshot_interval_s * 1000.0;
+}
+
+static void* persistence_thread_main(void *arg) {
+    Persistence *p = arg;
+    struct timespec last_sync;
+    clock_gettime(CLOCK_MONOTONIC, &last_sync);
+    p->last_snapshot = last_sync;
+    int tick_ms = p->log_enabled && p->policy == FSYNC_INTERVAL && p->interval_ms < PERSIST_TICK_MS
+                ? p->interval_ms : PERSIST_TICK_MS;
+    pthread_mutex_lock(&p->lock);
+    while (!p->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)tick_ms * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&p->cond, &p->lock, &deadline);
+        if (p->stopping) break;
+        // 子进程运行期间收到的请求保留到它结束后再执行
+        bool rewrite = p->rewrite_requested && p->child == 0;
+        if (rewrite) p->rewrite_requested = false;
+        // 快照请求在子进程启动后才清除，查询状态时请求要么在排队要么已在进行
+        bool snapshot = !rewrite && p->snapshot_requested && p->child == 0;
+        pthread_mutex_unlock(&p->lock);
+
+        if (p->log_enabled && p->policy == FSYNC_INTERVAL && elapsed_ms(&last_sync) >= p->interval_ms) {
+            sync_logs(p);
+            clock_gettime(CLOCK_MONOTONIC, &last_sync);
+        }
+        if (p->child > 0) {
+            check_child(p, false);
+        } else if (p->log_enabled && (rewrite || rewrite_due(p))) {
+            start_rewrite(p);
+        } else if (snapshot || snapshot_due(p)) {
+            start_snapshot(p);
+        }
+
+        pthread_mutex_lock(&p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+bool persistence_start(Persistence *p) {
+    if (pthread_create(&p->thread, NULL, persistence_thread_main, p) != 0) return false;
+    p->thread_started = true;
+    return true;
+}
+
+void persistence_stop(Persistence *p) {
+    if (!p || !p->thread_started) return;
+    pthread_mutex_lock(&p->lock);
+    p->stopping = true;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+    p->thread_started = false;
+    if (p->child > 0) {
+        kill(p->child, SIGKILL);
+        check_child(p, true);
+    }
+    // 反应器已退出：写出最后一批记录并落盘
+    KVServer *server = p->server;
+    for (int i = 0; i < server->reactor_count; i++) {
+        AppendLog *log = &server->reactors[i].log;
+        append_log_write(log);
+        if (p->policy != FSYNC_NO && log->fd != -1) fdatasync(log->fd);
+    }
+}
+
+bool persistence_request_rewrite(Persistence *p) {
+    if (!p->log_enabled) return false;
+    pthread_mutex_lock(&p->lock);
+    bool accepted = !p->rewrite_requested;
+    p->rewrite_requested = true;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return accepted;
+}
+
+bool persistence_request_snapshot(Persistence *p) {
+    if (!p->snapshot.configured) return false;
+    pthread_mutex_lock(&p->lock);
+    p->snapshot_requested = true;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return true;
+}
+
+void persistence_snapshot_status(Persistence *p, SnapshotStatus *status) {
+    pthread_mutex_lock(&p->lock);
+    *status = p->snapshot;
+    status->requested = p->snapshot_requested;
+    if (status->running) {
+        status->keys_written = atomic_load_explicit(&p->progress->keys, memory_order_relaxed);
+        status->bytes_written = atomic_load_explicit(&p->progress->bytes, memory_order_relaxed);
+        status->elapsed_ms = elapsed_ms(&p->snapshot_started);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+// 快照状态的 JSON 表示（/admin/snapshot 的响应体），返回写入的长度
+size_t persistence_snapshot_json(Persistence *p, char *buffer, size_t size) {
+    SnapshotStatus status;
+    persistence_snapshot_status(p, &status);
+    int length = snprintf(buffer, size,
+        "{\"requested\":%s,\"running\":%s,\"keys_total\":%" PRIu64 ",\"keys_written\":%" PRIu64 ","
+        "\"bytes_written\":%" PRIu64 ",\"elapsed_ms\":%.1f,\"pause_ms\":%.2f",
+        status.requested ? "true" : "false", status.running ? "true" : "false", status.keys_total,
+        status.keys_written, status.bytes_written, status.elapsed_ms, status.pause_ms);
+    if (status.has_last) {
+        length += snprintf(buffer + length, size - (size_t)length,
+            ",\"last\":{\"ok\":%s,\"keys\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"duration_ms\":%.1f,"
+            "\"pause_ms\":%.2f,\"finished\":%lld}",
+            status.last_ok ? "true" : "false", status.last_keys, status.last_bytes, status.last_duration_ms,
+            status.last_pause_ms, status.last_finished);
+    }
+    length += snprintf(buffer + length, size - (size_t)length, "}");
+    return (size_t)length;
+}
+
+const char* fsync_policy_name(FsyncPolicy policy) {
+    switch (policy) {
+        case FSYNC_ALWAYS: return "always";
+        case FSYNC_INTERVAL: return "interval";
+        case FSYNC_NO: return "no";
+        default: return "unknown";
+    }
+}
+
+// 追加日志不可用（写出或同步失败、缓冲区内存不足）：之后的写操作被拒绝，
+// 直到 reactor_commit_log 重新写出日志成功（类似 Redis 的 MISCONF）
+static void reactor_fail_log(Reactor *reactor) {
+    if (!reactor->log_failed) {
+        LOG_ERROR("反应器 %d: 追加日志不可用，恢复前拒绝写操作", reactor->id);
+    }
+    reactor->log_failed = true;
+}
+
+// 写操作修改存储之前确认日志可用，并为要追加的记录（至多一条 SET 或 DELETE 加一条 EXPIRE）预留空间，
+// 修改成功后追加不会因内存不足失败。返回 false 时拒绝写操作，调用方按 reactor->log_failed 与键不存在区分
+bool shard_log_reserve(Reactor *reactor, size_t key_length, size_t value_length) {
+    if (reactor->log.fd == -1) return true;
+    if (reactor->log_failed) return false;
+    size_t bytes = 2 * (APPEND_LOG_RECORD_MAX_OVERHEAD + key_length) + value_length + sizeof(uint64_t);
+    if (append_log_reserve(&reactor->log, bytes)) return true;
+    LOG_ERROR("反应器 %d: 追加日志缓冲区内存不足", reactor->id);
+    // 记录没有追加，日志与存储仍然一致，下一次提交即可恢复
+    reactor->log_retry_ms = 0;
+    reactor_fail_log(reactor);
+    return false;
+}
+
+// 预留空间之后的追加只在淘汰记录占用了预留的空间时才可能失败，此时存储已经修改，日志进入失败状态
+void shard_log_appended(Reactor *reactor, bool ok) {
+    if (!ok) {
+        LOG_ERROR("反应器 %d: 追加日志缓冲区内存不足，记录丢失", reactor->id);
+        reactor_fail_log(reactor);
+    }
+}
+
+// 落盘策略为 always 且本轮有未同步的日志记录时，响应要等 reactor_commit_log 同步之后再发出；
+// 日志不可用期间写操作都被拒绝，其他响应不依赖缓冲区中积压的记录，照常发出
+bool reactor_log_unsynced(const Reactor *reactor) {
+    return reactor->log_sync_always && !reactor->log_failed && append_log_pending(&reactor->log);
+}
+
+// 写出日志缓冲区（always 策略下同步），返回缓冲区中的记录是否已经落盘（或按策略交给了系统）。
+// 失败时日志进入失败状态，之后每隔 LOG_RETRY_INTERVAL_MS 重试一次，成功后恢复接受写操作
+static bool reactor_flush_log(Reactor *reactor) {
+    AppendLog *log = &reactor->log;
+    if (!reactor->log_failed && !append_log_pending(log)) return true;
+    if (reactor->log_failed && reactor->now_ms < reactor->log_retry_ms) return false;
+    bool ok = append_log_write(log);
+    if (ok && reactor->log_sync_always && fdatasync(log->fd) == -1) {
+        LOG_ERROR("反应器 %d: 同步追加日志失败: %s", reactor->id, strerror(errno));
+        ok = false;
+    }
+    if (!ok) {
+        reactor->log_retry_ms = reactor->now_ms + LOG_RETRY_INTERVAL_MS;
+        reactor_fail_log(reactor);
+    } else if (reactor->log_failed) {
+        LOG_INFO("反应器 %d: 追加日志恢复，重新接受写操作", reactor->id);
+        reactor->log_failed = false;
+    }
+    return ok;
+}
+
+// 持久化线程的暂停请求：写出本轮的日志记录后停在这里，直到持久化线程恢复所有反应器；
+// 过期的请求（发起者已放弃等待）直接忽略
+void reactor_pause(Reactor *reactor, unsigned epoch) {
+    KVServer *server = reactor->server;
+    // 暂停期间旧日志会被换掉，等待同步的响应依赖的记录必须先在旧文件中落盘；
+    // 失败时日志进入失败状态，这些响应由本轮的 reactor_commit_log 作废
+    reactor_flush_log(reactor);
+    pthread_mutex_lock(&server->pause_lock);
+    if (server->pause_epoch == epoch) {
+        server->paused++;
+        pthread_cond_broadcast(&server->pause_cond);
+        while (server->pause_epoch == epoch) {
+            pthread_cond_wait(&server->pause_cond, &server->pause_lock);
+        }
+    }
+    pthread_mutex_unlock(&server->pause_lock);
+}
+
+// 让所有反应器在处理完手头的事件后暂停（日志缓冲区已写出），由持久化线程调用；
+// 服务器停止时放弃等待并返回 false。返回 true 后必须调用 server_resume_reactors
+bool server_pause_reactors(KVServer *server) {
+    pthread_mutex_lock(&server->pause_lock);
+    unsigned epoch = server->pause_epoch;
+    server->paused = 0;
+    pthread_mutex_unlock(&server->pause_lock);
+    for (int i = 0; i < server->reactor_count; i++) {
+        ShardMessage *message = shard_message_create(SHARD_OP_PAUSE, "", 0, NULL);
+        if (!message) {
+            server_resume_reactors(server);
+            return false;
+        }
+        message->client_gen = epoch;
+        shard_mailbox_post(&server->reactors[i].mailbox, message);
+    }
+    pthread_mutex_lock(&server->pause_lock);
+    while (server->paused < server->reactor_count && server->running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 100 * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&server->pause_cond, &server->pause_lock, &deadline);
+    }
+    bool paused = server->paused == server->reactor_count;
+    pthread_mutex_unlock(&server->pause_lock);
+    if (!paused) {
+        server_resume_reactors(server);
+    }
+    return paused;
+}
+
+void server_resume_reactors(KVServer *server) {
+    pthread_mutex_lock(&server->pause_lock);
+    server->pause_epoch++;
+    pthread_cond_broadcast(&server->pause_cond);
+    pthread_mutex_unlock(&server->pause_lock);
+}
+
+// 日志未能落盘：丢弃连接尚未发出的响应并关闭连接，客户端收不到这批写操作的确认
+static void reactor_discard_output(Reactor *reactor, ClientConnection *client) {
+    LOG_DEBUG("反应器 %d: 日志未能落盘，关闭连接 fd %d，不发送响应", reactor->id, client->fd);
+    out_queue_clear(&client->out);
+    server_client_output_update(reactor, client);
+    client->close_after_write = true;
+    shutdown(client->fd, SHUT_RDWR);
+}
+
+// 本轮的日志记录同步前暂缓发送，连接登记到反应器，由 reactor_commit_log 继续处理；
+// 内存不足无法登记时当场写出并同步日志，失败时丢弃响应
+bool server_hold_client_output(Reactor *reactor, ClientConnection *client) {
+    if (!reactor_log_unsynced(reactor)) return false;
+    if (client->output_held) return true;
+    if (reactor->held_count == reactor->held_cap) {
+        size_t new_cap = reactor->held_cap > 0 ? reactor->held_cap * 2 : MAX_EVENTS;
+        ClientConnection **held = realloc(reactor->held_clients, new_cap * sizeof(ClientConnection *));
+        if (!held) {
+            if (!reactor_flush_log(reactor)) reactor_discard_output(reactor, client);
+            return false;
+        }
+        reactor->held_clients = held;
+        reactor->held_cap = new_cap;
+    }
+    reactor->held_clients[reactor->held_count++] = client;
+    client->output_held = true;
+    return true;
+}
+
+// 组提交：把本轮事件处理追加的日志记录一次写出（always 策略下同步），
+// 然后发出等待这批记录的跨分片应答和连接响应。每轮事件处理结束时由 IO 引擎调用。
+// 日志未能写出或同步时不确认这批写操作：跨分片应答改为错误，已生成响应的连接丢弃输出并关闭
+void reactor_commit_log(Reactor *reactor) {
+    if (reactor->log.fd == -1) return;
+    do {
+        bool synced = reactor_flush_log(reactor);
+        while (reactor->held_replies) {
+            ShardMessage *message = reactor->held_replies;
+            reactor->held_replies = atomic_load_explicit(&message->next, memory_order_relaxed);
+            if (!synced) {
+                if (message->op == SHARD_OP_BATCH) {
+                    if (shard_op_writes(message->batch->op)) {
+                        atomic_store_explicit(&message->batch->failed, true, memory_order_relaxed);
+                    }
+                } else {
+                    message->failed = shard_op_writes(message->op);
+                }
+            }
+            shard_mailbox_post(&reactor->server->reactors[message->origin].mailbox, message);
+        }
+        // 发出响应时会继续处理连接中的后续请求，新追加的记录和再次等待的连接在下一次循环中提交
+        size_t count = reactor->held_count;
+        for (size_t i = 0; i < count; i++) {
+            ClientConnection *client = reactor->held_clients[i];
+            if (client->fd == -1 || !client->output_held) continue;
+            client->output_held = false;
+            if (!synced) reactor_discard_output(reactor, client);
+            reactor->complete(reactor, client);
+        }
+        reactor->held_count -= count;
+        memmove(reactor->held_clients, reactor->held_clients + count,
+                reactor->held_count * sizeof(ClientConnection *));
+    } while (reactor->held_count > 0);
+}
+
+// 把映射的快照分区中剩余的记录按文件顺序复制到内存存储，每轮最多 BASE_MERGE_BATCH 条，
+// 全部合并后解除映射。内存不足或达到内存上限而留在分区中的记录继续从映射读取
+// （合并不淘汰已有的键，达到上限时直接结束合并）
+void reactor_merge_base(Reactor *reactor) {
+    SnapshotShard *base = reactor->base;
+    if (!snapshot_shard_merging(base)) return;
+    for (int i = 0; i < BASE_MERGE_BATCH; i++) {
+        const char *key, *data;
+        size_t key_length, length;
+        uint64_t expire_ms;
+        int64_t slot = snapshot_shard_next(base, &key, &key_length, &data, &length, &expire_ms);
+        if (slot < 0) break;
+        if (!kv_memory_fits(reactor->kv_store, key_length, length)) {
+            base->cursor = base->records_length;
+            break;
+        }
+        KVValue *value = kv_value_create(reactor->slab, data, length);
+        if (value && kv_set_value_expire(reactor->kv_store, key, key_length, value, expire_ms)) {
+            snapshot_shard_drop(base, slot);
+        }
+        kv_value_release(value);
+    }
+    if (snapshot_shard_merging(base)) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (double)(now.tv_sec - reactor->base_opened.tv_sec) +
+                     (double)(now.tv_nsec - reactor->base_opened.tv_nsec) / 1e9;
+    if (base->corrupt > 0) {
+        LOG_ERROR("反应器 %d: 快照分区中 %zu 条记录校验失败，已丢弃", reactor->id, base->corrupt);
+    }
+    if (base->live > 0) {
+        LOG_WARN("反应器 %d: 内存不足或达到内存上限，%zu 个键继续从映射的快照读取", reactor->id, base->live);
+        return;
+    }
+    LOG_INFO("反应器 %d: 快照分区已全部合并到内存（%zu 个键，用时 %.1f s）", reactor->id,
+             kv_size(reactor->kv_store), seconds);
+    snapshot_shard_close(base);
+    free(base);
+    reactor->base = NULL;
+}
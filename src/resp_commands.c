@@ -0,0 +1,252 @@
+#include "server_internal.h"
+#include <stdio.h>
+#include <string.h>
+
+// 写入 RESP 错误应答并计数
+void write_resp_error(ClientConnection *client, const char *message) {
+    metric_add(&client->metrics->resp_errors, 1);
+    resp_write_error(&client->out, message);
+}
+
+// 写入 RESP 错误应答，消息中引用命令名（过长时截断）
+static void write_resp_command_error(ClientConnection *client, const char *format, KVKey name) {
+    char message[128];
+    snprintf(message, sizeof(message), format, (int)(name.length > 64 ? 64 : name.length), name.data);
+    write_resp_error(client, message);
+}
+
+// 把 RESP 命令的时间参数换算成过期时刻：unit_ms 为参数单位的毫秒数，absolute 时参数是 Unix 时刻，
+// 否则是距现在的时长。已经过去的时刻换算为 1（执行时删除该键）；不是整数或超出 MAX_TTL_MS 时返回 false
+static bool resp_expire_time(KVKey arg, uint64_t unit_ms, bool absolute, uint64_t *expire_ms) {
+    uint64_t now = kv_now_ms();
+    long long limit = (long long)((now + MAX_TTL_MS) / unit_ms);
+    long long amount;
+    if (!resp_arg_to_integer(arg, &amount) || amount > limit || amount < -limit) return false;
+    long long at = amount * (long long)unit_ms + (absolute ? 0 : (long long)now);
+    if (at > (long long)(now + MAX_TTL_MS)) return false;
+    *expire_ms = at <= (long long)now ? 1 : (uint64_t)at;
+    return true;
+}
+
+// SET 的 EX / PX 选项和 SETEX / PSETEX 的存活时间，必须是正整数；错误时写入错误应答并返回 false
+static bool resp_set_expire(ClientConnection *client, KVKey name, KVKey arg, uint64_t unit_ms,
+                            uint64_t *expire_ms) {
+    long long amount;
+    if (!resp_arg_to_integer(arg, &amount)) {
+        write_resp_error(client, "ERR value is not an integer or out of range");
+        return false;
+    }
+    if (amount <= 0 || !resp_expire_time(arg, unit_ms, false, expire_ms)) {
+        write_resp_command_error(client, "ERR invalid expire time in '%.*s' command", name);
+        return false;
+    }
+    return true;
+}
+
+// 把 KV 操作结果转换为 RESP 应答：GET 为批量字符串或空值，SET 为 +OK，DEL / EXISTS / EXPIRE / PERSIST
+// 为 0 或 1，TTL / PTTL 为剩余秒数或毫秒数（键不存在时为 -2，不过期时为 -1）
+void write_resp_kv_reply(ClientConnection *client, const ShardMessage *message) {
+    switch (message->op) {
+        case SHARD_OP_GET:
+            resp_write_bulk(&client->out, message->ok ? message->value : NULL);
+            break;
+        case SHARD_OP_SET:
+            if (message->ok) {
+                resp_write_simple(&client->out, "OK");
+            } else {
+                write_internal_error(client);
+            }
+            break;
+        case SHARD_OP_DELETE:
+        case SHARD_OP_EXISTS:
+        case SHARD_OP_EXPIRE:
+        case SHARD_OP_PERSIST:
+            resp_write_integer(&client->out, message->ok);
+            break;
+        case SHARD_OP_TTL:
+        case SHARD_OP_PTTL:
+            if (!message->ok || message->expire_ms == 0) {
+                resp_write_integer(&client->out, message->ok ? -1 : -2);
+            } else {
+                uint64_t ms = remaining_ms(message->expire_ms);
+                resp_write_integer(&client->out, (long long)(message->op == SHARD_OP_TTL ? (ms + 500) / 1000 : ms));
+            }
+            break;
+        case SHARD_OP_COUNT:
+        case SHARD_OP_BATCH:
+        case SHARD_OP_PAUSE:
+            break;
+    }
+}
+
+// 批次的 RESP 应答：MGET 按请求顺序返回数组，MSET 为 +OK，DEL / EXISTS 为项数，DBSIZE 为键数
+void write_resp_batch_reply(ClientConnection *client, const ShardBatch *batch) {
+    size_t done = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        done += batch->ok[i];
+    }
+    switch (batch->op) {
+        case SHARD_OP_GET:
+            resp_write_array(&client->out, batch->count);
+            for (size_t j = 0; j < batch->count; j++) {
+                resp_write_bulk(&client->out, batch->values[batch->order[j]]);
+            }
+            break;
+        case SHARD_OP_SET:
+            if (done == batch->count) {
+                resp_write_simple(&client->out, "OK");
+            } else {
+                write_internal_error(client);
+            }
+            break;
+        case SHARD_OP_DELETE:
+        case SHARD_OP_EXISTS:
+            resp_write_integer(&client->out, (long long)done);
+            break;
+        case SHARD_OP_COUNT:
+            resp_write_integer(&client->out, (long long)atomic_load_explicit(&batch->total, memory_order_relaxed));
+            break;
+        case SHARD_OP_TTL:
+        case SHARD_OP_PTTL:
+        case SHARD_OP_EXPIRE:
+        case SHARD_OP_PERSIST:
+        case SHARD_OP_BATCH:
+        case SHARD_OP_PAUSE:
+            break;
+    }
+}
+
+// 执行一条 RESP 命令：GET、SET（可带 EX / PX）、SETEX、PSETEX、DEL、EXISTS、EXPIRE、PEXPIRE、EXPIREAT、
+// PEXPIREAT、TTL、PTTL、PERSIST、MGET、MSET、DBSIZE、PING、ECHO、BGREWRITEAOF、BGSAVE、QUIT。
+// 参数指向连接的读缓冲区，键和值在写入存储或转发前复制；多键命令按分片分组后与批量 API 一样执行
+void process_resp_command(Reactor *reactor, ClientConnection *client, const KVKey *args, size_t argc) {
+    KVKey name = args[0];
+    LOG_DEBUG("RESP 命令: %.*s，参数个数: %zu", (int)(name.length > 64 ? 64 : name.length), name.data, argc - 1);
+    ShardOp batch_op;
+    size_t stride = 1;
+    if (resp_arg_equals(name, "GET")) {
+        if (argc != 2) goto wrong_arity;
+        run_kv_op(reactor, client, SHARD_OP_GET, args[1].data, args[1].length, NULL, 0);
+        return;
+    } else if (resp_arg_equals(name, "SET") || resp_arg_equals(name, "SETEX") || resp_arg_equals(name, "PSETEX")) {
+        // SET key value [EX seconds | PX milliseconds]；SETEX / PSETEX key time value
+        KVKey data;
+        uint64_t expire_ms = 0;
+        if (resp_arg_equals(name, "SET")) {
+            if (argc < 3) goto wrong_arity;
+            data = args[2];
+            if (argc == 5 && (resp_arg_equals(args[3], "EX") || resp_arg_equals(args[3], "PX"))) {
+                if (!resp_set_expire(client, name, args[4], resp_arg_equals(args[3], "EX") ? 1000 : 1,
+                                     &expire_ms)) {
+                    return;
+                }
+            } else if (argc > 3) {
+                // 不支持 NX、XX、KEEPTTL 等其他选项
+                write_resp_error(client, "ERR syntax error");
+                return;
+            }
+        } else {
+            if (argc != 4) goto wrong_arity;
+            if (!resp_set_expire(client, name, args[2], resp_arg_equals(name, "SETEX") ? 1000 : 1, &expire_ms)) {
+                return;
+            }
+            data = args[3];
+        }
+        KVValue *value = kv_value_create(reactor->slab, data.data, data.length);
+        if (!value) {
+            write_internal_error(client);
+            return;
+        }
+        run_kv_op(reactor, client, SHARD_OP_SET, args[1].data, args[1].length, value, expire_ms);
+        return;
+    } else if (resp_arg_equals(name, "EXPIRE") || resp_arg_equals(name, "PEXPIRE") ||
+               resp_arg_equals(name, "EXPIREAT") || resp_arg_equals(name, "PEXPIREAT")) {
+        if (argc != 3) goto wrong_arity;
+        bool seconds = resp_arg_equals(name, "EXPIRE") || resp_arg_equals(name, "EXPIREAT");
+        bool absolute = resp_arg_equals(name, "EXPIREAT") || resp_arg_equals(name, "PEXPIREAT");
+        uint64_t expire_ms;
+        if (!resp_expire_time(args[2], seconds ? 1000 : 1, absolute, &expire_ms)) {
+            write_resp_error(client, "ERR value is not an integer or out of range");
+            return;
+        }
+        run_kv_op(reactor, client, SHARD_OP_EXPIRE, args[1].data, args[1].length, NULL, expire_ms);
+        return;
+    } else if (resp_arg_equals(name, "TTL") || resp_arg_equals(name, "PTTL") || resp_arg_equals(name, "PERSIST")) {
+        if (argc != 2) goto wrong_arity;
+        ShardOp op = resp_arg_equals(name, "TTL") ? SHARD_OP_TTL
+                   : resp_arg_equals(name, "PTTL") ? SHARD_OP_PTTL : SHARD_OP_PERSIST;
+        run_kv_op(reactor, client, op, args[1].data, args[1].length, NULL, 0);
+        return;
+    } else if (resp_arg_equals(name, "DEL") || resp_arg_equals(name, "EXISTS")) {
+        if (argc < 2) goto wrong_arity;
+        batch_op = resp_arg_equals(name, "DEL") ? SHARD_OP_DELETE : SHARD_OP_EXISTS;
+        if (argc == 2) {
+            run_kv_op(reactor, client, batch_op, args[1].data, args[1].length, NULL, 0);
+            return;
+        }
+    } else if (resp_arg_equals(name, "MGET")) {
+        if (argc < 2) goto wrong_arity;
+        batch_op = SHARD_OP_GET;
+    } else if (resp_arg_equals(name, "MSET")) {
+        if (argc < 3 || argc % 2 == 0) goto wrong_arity;
+        batch_op = SHARD_OP_SET;
+        stride = 2;
+    } else if (resp_arg_equals(name, "DBSIZE")) {
+        if (argc != 1) goto wrong_arity;
+        batch_op = SHARD_OP_COUNT;
+    } else if (resp_arg_equals(name, "PING")) {
+        if (argc > 2) goto wrong_arity;
+        if (argc == 2) {
+            resp_write_bulk_data(&client->out, args[1].data, args[1].length);
+        } else {
+            resp_write_simple(&client->out, "PONG");
+        }
+        return;
+    } else if (resp_arg_equals(name, "ECHO")) {
+        if (argc != 2) goto wrong_arity;
+        resp_write_bulk_data(&client->out, args[1].data, args[1].length);
+        return;
+    } else if (resp_arg_equals(name, "BGREWRITEAOF")) {
+        if (argc != 1) goto wrong_arity;
+        if (!reactor->server->log_dir) {
+            write_resp_error(client, "ERR append log is not enabled");
+            return;
+        }
+        persistence_request_rewrite(reactor->server->persistence);
+        resp_write_simple(&client->out, "Background append only file rewriting scheduled");
+        return;
+    } else if (resp_arg_equals(name, "BGSAVE")) {
+        if (argc != 1) goto wrong_arity;
+        if (!reactor->server->snapshot_path) {
+            write_resp_error(client, "ERR snapshot file is not configured");
+            return;
+        }
+        persistence_request_snapshot(reactor->server->persistence);
+        resp_write_simple(&client->out, "Background saving started");
+        return;
+    } else if (resp_arg_equals(name, "QUIT")) {
+        resp_write_simple(&client->out, "OK");
+        client->close_after_write = true;
+        return;
+    } else {
+        write_resp_command_error(client, "ERR unknown command '%.*s'", name);
+        return;
+    }
+
+    size_t count = (argc - 1) / stride;
+    if (count > MAX_BATCH_KEYS) {
+        write_resp_error(client, "ERR too many keys");
+        return;
+    }
+    size_t shard_start[MAX_REACTORS + 1];
+    ShardBatch *batch = create_batch(reactor, batch_op, args + 1, count, stride, shard_start);
+    if (!batch) {
+        write_internal_error(client);
+        return;
+    }
+    run_batch(reactor, client, batch, shard_start);
+    return;
+
+wrong_arity:
+    write_resp_command_error(client, "ERR wrong number of arguments for '%.*s' command", name);
+}
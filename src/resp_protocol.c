@@ -0,0 +1,180 @@
+#include "resp_protocol.h"
+#include <ctype.h>
+#include <string.h>
+
+#define RESP_MAX_DIGITS 18 // 长度字段最多的位数，更长的一定超过任何上限
+
+// 读取 "<整数>\r\n"；数据不足时返回 RESP_PARSE_INCOMPLETE，成功时 *cursor 移到下一行
+static int parse_number(const char **cursor, const char *end, long long *value) {
+    const char *p = *cursor;
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    const char *digits = p;
+    long long n = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (p - digits >= RESP_MAX_DIGITS) return RESP_PARSE_ERROR;
+        n = n * 10 + (*p - '0');
+        p++;
+    }
+    if (end - p < 2) return p < end && *p != '\r' ? RESP_PARSE_ERROR : RESP_PARSE_INCOMPLETE;
+    if (p == digits || p[0] != '\r' || p[1] != '\n') return RESP_PARSE_ERROR;
+    *value = negative ? -n : n;
+    *cursor = p + 2;
+    return RESP_PARSE_COMPLETE;
+}
+
+// "*<个数>\r\n" 之后是个数个 "$<长度>\r\n<字节>\r\n"，参数可以包含任意字节
+static int parse_multibulk(const char *data, size_t length, size_t max_bulk, RespCommand *command) {
+    const char *p = data + 1;
+    const char *end = data + length;
+    long long count;
+    int result = parse_number(&p, end, &count);
+    if (result != RESP_PARSE_COMPLETE) return result;
+    if (count > RESP_MAX_ARGS) return RESP_PARSE_ERROR;
+    if (count <= 0) {
+        // 空数组和空值数组不是命令，跳过
+        command->argc = 0;
+        command->length = (size_t)(p - data);
+        return RESP_PARSE_COMPLETE;
+    }
+    if ((size_t)count > command->arg_cap) {
+        command->argc = (size_t)count;
+        return RESP_PARSE_NEED_ARGS;
+    }
+    for (long long i = 0; i < count; i++) {
+        if (p == end) return RESP_PARSE_INCOMPLETE;
+        if (*p != '$') return RESP_PARSE_ERROR;
+        p++;
+        long long bulk_length;
+        result = parse_number(&p, end, &bulk_length);
+        if (result != RESP_PARSE_COMPLETE) return result;
+        if (bulk_length < 0 || (unsigned long long)bulk_length > max_bulk) return RESP_PARSE_ERROR;
+        // 已知长度，数据不足时不扫描参数内容，大参数分多次到达时每次解析的代价与参数个数成正比
+        if ((size_t)(end - p) < (size_t)bulk_length + 2) return RESP_PARSE_INCOMPLETE;
+        if (p[bulk_length] != '\r' || p[bulk_length + 1] != '\n') return RESP_PARSE_ERROR;
+        command->args[i].data = p;
+        command->args[i].length = (size_t)bulk_length;
+        p += bulk_length + 2;
+    }
+    command->argc = (size_t)count;
+    command->length = (size_t)(p - data);
+    return RESP_PARSE_COMPLETE;
+}
+
+// 内联命令：一行文本按空格和制表符分隔，不支持引号
+static int parse_inline(const char *data, size_t length, RespCommand *command) {
+    const char *newline = memchr(data, '\n', length);
+    if (!newline) return length > RESP_MAX_INLINE ? RESP_PARSE_ERROR : RESP_PARSE_INCOMPLETE;
+    const char *line_end = newline;
+    if (line_end > data && line_end[-1] == '\r') line_end--;
+    size_t argc = 0;
+    const char *p = data;
+    for (;;) {
+        while (p < line_end && (*p == ' ' || *p == '\t')) p++;
+        if (p == line_end) break;
+        const char *start = p;
+        while (p < line_end && *p != ' ' && *p != '\t') p++;
+        if (argc < command->arg_cap) {
+            command->args[argc].data = start;
+            command->args[argc].length = (size_t)(p - start);
+        }
+        argc++;
+    }
+    command->argc = argc;
+    if (argc > command->arg_cap) return RESP_PARSE_NEED_ARGS;
+    command->length = (size_t)(newline + 1 - data);
+    return RESP_PARSE_COMPLETE;
+}
+
+int resp_parse_command(const char *data, size_t length, size_t max_bulk, RespCommand *command) {
+    if (length == 0) return RESP_PARSE_INCOMPLETE;
+    return data[0] == '*' ? parse_multibulk(data, length, max_bulk, command) : parse_inline(data, length, command);
+}
+
+bool resp_arg_equals(KVKey arg, const char *name) {
+    size_t length = strlen(name);
+    if (arg.length != length) return false;
+    for (size_t i = 0; i < length; i++) {
+        if (toupper((unsigned char)arg.data[i]) != name[i]) return false;
+    }
+    return true;
+}
+
+bool resp_arg_to_integer(KVKey arg, long long *value) {
+    size_t i = 0;
+    bool negative = arg.length > 0 && arg.data[0] == '-';
+    if (negative) i++;
+    if (i == arg.length || arg.length - i > 18) return false;
+    long long result = 0;
+    for (; i < arg.length; i++) {
+        if (arg.data[i] < '0' || arg.data[i] > '9') return false;
+        result = result * 10 + (arg.data[i] - '0');
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+// 写入 "<prefix><整数>\r\n"，整数按十进制就地写进输出缓冲区
+static bool write_number_line(OutQueue *queue, char prefix, long long value) {
+    char *out = out_queue_reserve(queue, 24);
+    if (!out) return false;
+    char digits[20];
+    size_t count = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    size_t length = 0;
+    out[length++] = prefix;
+    if (value < 0) out[length++] = '-';
+    while (count > 0) {
+        out[length++] = digits[--count];
+    }
+    out[length++] = '\r';
+    out[length++] = '\n';
+    return out_queue_commit(queue, length);
+}
+
+// 写入 "<prefix>text\r\n"，text 中的换行替换为空格，保证应答是一行
+static bool write_line(OutQueue *queue, char prefix, const char *text) {
+    size_t length = strlen(text);
+    char *out = out_queue_reserve(queue, length + 3);
+    if (!out) return false;
+    out[0] = prefix;
+    for (size_t i = 0; i < length; i++) {
+        out[i + 1] = text[i] == '\r' || text[i] == '\n' ? ' ' : text[i];
+    }
+    out[length + 1] = '\r';
+    out[length + 2] = '\n';
+    return out_queue_commit(queue, length + 3);
+}
+
+bool resp_write_simple(OutQueue *queue, const char *text) {
+    return write_line(queue, '+', text);
+}
+
+bool resp_write_error(OutQueue *queue, const char *message) {
+    return write_line(queue, '-', message);
+}
+
+bool resp_write_integer(OutQueue *queue, long long value) {
+    return write_number_line(queue, ':', value);
+}
+
+bool resp_write_array(OutQueue *queue, size_t count) {
+    return write_number_line(queue, '*', (long long)count);
+}
+
+bool resp_write_bulk(OutQueue *queue, KVValue *value) {
+    if (!value) return out_queue_append(queue, "$-1\r\n", 5);
+    return write_number_line(queue, '$', (long long)value->length) &&
+           out_queue_append_value(queue, value) &&
+           out_queue_append(queue, "\r\n", 2);
+}
+
+bool resp_write_bulk_data(OutQueue *queue, const char *data, size_t length) {
+    return write_number_line(queue, '$', (long long)length) &&
+           out_queue_append(queue, data, length) &&
+           out_queue_append(queue, "\r\n", 2);
+}
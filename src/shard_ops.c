@@ -0,0 +1,308 @@
+#include "server_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+// 把映射的快照分区中的键复制到内存存储，返回值的引用；之后分区中的记录失效，只从存储读取。
+// 读取时 evict 为 false：达到内存上限后只返回值，记录留在分区中，不为了复制而淘汰其他键
+static KVValue* shard_promote(Reactor *reactor, const char *key, size_t key_length, bool evict) {
+    const char *data;
+    size_t length;
+    uint64_t expire_ms;
+    int64_t slot = snapshot_shard_find(reactor->base, key, key_length, &data, &length, &expire_ms);
+    if (slot < 0) return NULL;
+    KVValue *value = kv_value_create(reactor->slab, data, length);
+    if (value && (evict || kv_memory_fits(reactor->kv_store, key_length, length)) &&
+        kv_set_value_expire(reactor->kv_store, key, key_length, value, expire_ms)) {
+        snapshot_shard_drop(reactor->base, slot);
+    }
+    return value;
+}
+
+// 读取本分片：先查内存存储，再查映射的快照分区
+static KVValue* shard_get(Reactor *reactor, const char *key, size_t key_length) {
+    KVValue *value = kv_get_value(reactor->kv_store, key, key_length);
+    if (value || !reactor->base) return value;
+    return shard_promote(reactor, key, key_length, false);
+}
+
+// 本分片的键数，包括映射的快照分区中尚未失效的记录
+size_t reactor_key_count(Reactor *reactor) {
+    return kv_size(reactor->kv_store) + (reactor->base ? reactor->base->live : 0);
+}
+
+// 写入本分片并追加到日志，日志记录在本轮事件处理结束时由 reactor_commit_log 一次写出；
+// expire_ms 为过期时刻（0 表示不过期，同时取消原有的过期时刻）。映射的快照分区中的同名记录失效
+static bool shard_set(Reactor *reactor, const char *key, size_t key_length, KVValue *value, uint64_t expire_ms) {
+    if (!shard_log_reserve(reactor, key_length, value->length)) return false;
+    if (!kv_set_value_expire(reactor->kv_store, key, key_length, value, expire_ms)) return false;
+    if (reactor->base) {
+        snapshot_shard_drop(reactor->base, snapshot_shard_find(reactor->base, key, key_length, NULL, NULL, NULL));
+    }
+    if (reactor->log.fd != -1) {
+        shard_log_appended(reactor, append_log_set(&reactor->log, key, key_length, value->data, value->length) &&
+                                    (expire_ms == 0 ||
+                                     append_log_expire(&reactor->log, key, key_length, expire_ms)));
+    }
+    return true;
+}
+
+// 淘汰的键同样作为删除写入日志，重放后与内存中的内容一致
+void shard_evicted(void *arg, const HashEntry *entry) {
+    Reactor *reactor = arg;
+    if (reactor->log.fd != -1) {
+        shard_log_appended(reactor, append_log_delete(&reactor->log, entry->key, entry->key_length));
+    }
+}
+
+static bool shard_delete(Reactor *reactor, const char *key, size_t key_length) {
+    if (!shard_log_reserve(reactor, key_length, 0)) return false;
+    bool removed = kv_delete(reactor->kv_store, key, key_length);
+    if (reactor->base) {
+        int64_t slot = snapshot_shard_find(reactor->base, key, key_length, NULL, NULL, NULL);
+        snapshot_shard_drop(reactor->base, slot);
+        removed = removed || slot >= 0;
+    }
+    if (!removed) return false;
+    if (reactor->log.fd != -1) {
+        shard_log_appended(reactor, append_log_delete(&reactor->log, key, key_length));
+    }
+    return true;
+}
+
+// 查询本分片中键的过期时刻（0 表示不过期），键不存在时返回 false
+static bool shard_ttl(Reactor *reactor, const char *key, size_t key_length, uint64_t *expire_ms) {
+    if (kv_get_expire(reactor->kv_store, key, key_length, expire_ms)) return true;
+    return reactor->base && snapshot_shard_find(reactor->base, key, key_length, NULL, NULL, expire_ms) >= 0;
+}
+
+// 修改本分片中已有键的过期时刻（0 表示取消）并追加到日志，键不存在时返回 false。
+// 已经过去的时刻直接删除该键；映射的快照分区中的键先复制到内存存储
+static bool shard_expire(Reactor *reactor, const char *key, size_t key_length, uint64_t expire_ms) {
+    if (expire_ms != 0 && expire_ms <= kv_now_ms()) return shard_delete(reactor, key, key_length);
+    if (!shard_log_reserve(reactor, key_length, 0)) return false;
+    bool ok = kv_set_expire(reactor->kv_store, key, key_length, expire_ms);
+    if (!ok && reactor->base) {
+        KVValue *value = shard_promote(reactor, key, key_length, true);
+        ok = value && kv_set_expire(reactor->kv_store, key, key_length, expire_ms);
+        kv_value_release(value);
+    }
+    if (!ok) return false;
+    if (reactor->log.fd != -1) {
+        shard_log_appended(reactor, append_log_expire(&reactor->log, key, key_length, expire_ms));
+    }
+    return true;
+}
+
+// 在本线程拥有的分片上执行批次中 [start, start + count) 的项；GET 交给存储批量查找
+static void execute_batch(Reactor *reactor, ShardBatch *batch, size_t start, size_t count) {
+    struct KVStore *store = reactor->kv_store;
+    KVKey *keys = batch->keys;
+    switch (batch->op) {
+        case SHARD_OP_GET:
+            kv_get_values(store, keys + start, count, batch->values + start);
+            for (size_t i = start; reactor->base && i < start + count; i++) {
+                if (!batch->values[i]) {
+                    batch->values[i] = shard_promote(reactor, keys[i].data, keys[i].length, false);
+                }
+            }
+            break;
+        case SHARD_OP_SET:
+            for (size_t i = start; i < start + count; i++) {
+                batch->ok[i] = shard_set(reactor, keys[i].data, keys[i].length, batch->values[i], 0);
+            }
+            break;
+        case SHARD_OP_DELETE:
+            for (size_t i = start; i < start + count; i++) {
+                batch->ok[i] = shard_delete(reactor, keys[i].data, keys[i].length);
+            }
+            break;
+        case SHARD_OP_EXISTS:
+            // 查到的值在这里释放（引用计数是原子的），只把是否存在带回发起线程
+            kv_get_values(store, keys + start, count, batch->values + start);
+            for (size_t i = start; i < start + count; i++) {
+                batch->ok[i] = batch->values[i] != NULL ||
+                               (reactor->base && snapshot_shard_find(reactor->base, keys[i].data, keys[i].length,
+                                                                     NULL, NULL, NULL) >= 0);
+                kv_value_release(batch->values[i]);
+                batch->values[i] = NULL;
+            }
+            break;
+        case SHARD_OP_COUNT:
+            atomic_fetch_add_explicit(&batch->total, reactor_key_count(reactor), memory_order_relaxed);
+            break;
+        case SHARD_OP_TTL:
+        case SHARD_OP_PTTL:
+        case SHARD_OP_EXPIRE:
+        case SHARD_OP_PERSIST:
+        case SHARD_OP_BATCH:
+        case SHARD_OP_PAUSE:
+            break;
+    }
+    if (reactor->log_failed && shard_op_writes(batch->op)) {
+        atomic_store_explicit(&batch->failed, true, memory_order_relaxed);
+    }
+}
+
+// 在本线程拥有的分片上执行 KV 操作；GET 成功时 message->value 为存储中值的引用
+void execute_shard_op(Reactor *reactor, ShardMessage *message) {
+    uint64_t start = message->op != SHARD_OP_PAUSE ? metrics_start(&reactor->metrics, METRIC_STAGE_STORE) : 0;
+    switch (message->op) {
+        case SHARD_OP_GET:
+            message->value = shard_get(reactor, message->key, message->key_length);
+            message->ok = message->value != NULL;
+            break;
+        case SHARD_OP_SET:
+            message->ok = shard_set(reactor, message->key, message->key_length, message->value, message->expire_ms);
+            break;
+        case SHARD_OP_DELETE:
+            message->ok = shard_delete(reactor, message->key, message->key_length);
+            break;
+        case SHARD_OP_EXISTS: {
+            KVValue *value = kv_get_value(reactor->kv_store, message->key, message->key_length);
+            message->ok = value != NULL ||
+                          (reactor->base && snapshot_shard_find(reactor->base, message->key, message->key_length,
+                                                                NULL, NULL, NULL) >= 0);
+            kv_value_release(value);
+            break;
+        }
+        case SHARD_OP_TTL:
+        case SHARD_OP_PTTL:
+            message->ok = shard_ttl(reactor, message->key, message->key_length, &message->expire_ms);
+            break;
+        case SHARD_OP_EXPIRE:
+            message->ok = shard_expire(reactor, message->key, message->key_length, message->expire_ms);
+            break;
+        case SHARD_OP_PERSIST: {
+            uint64_t expire_ms;
+            message->ok = shard_ttl(reactor, message->key, message->key_length, &expire_ms) && expire_ms != 0 &&
+                          shard_expire(reactor, message->key, message->key_length, 0);
+            break;
+        }
+        case SHARD_OP_COUNT:
+            break;
+        case SHARD_OP_BATCH:
+            execute_batch(reactor, message->batch, message->batch_start, message->batch_count);
+            break;
+        case SHARD_OP_PAUSE:
+            break;
+    }
+    // 写操作因日志不可用被拒绝时应答为错误，不能当作键不存在
+    message->failed = reactor->log_failed && shard_op_writes(message->op);
+    metrics_finish(&reactor->metrics, METRIC_STAGE_STORE, start);
+}
+
+// 创建批次：第 j 项的键是 args[j * stride]，SET 的值是 args[j * stride + 1]（复制进新值）。
+// 项按所属分片分组存放（同一分片内保持请求顺序），shard_start[s] 是分片 s 的第一项；内存不足时返回 NULL
+ShardBatch* create_batch(Reactor *reactor, ShardOp op, const KVKey *args, size_t count, size_t stride,
+                         size_t *shard_start) {
+    size_t key_bytes = 0;
+    for (size_t j = 0; j < count; j++) {
+        key_bytes += args[j * stride].length;
+    }
+    char *key_storage;
+    ShardBatch *batch = shard_batch_create(op, count, key_bytes, &key_storage);
+    if (!batch) return NULL;
+
+    // 计算每一项所属的分片（暂存在 order 中）并按分片计数
+    int shard_count = reactor->server->reactor_count;
+    memset(shard_start, 0, (size_t)(shard_count + 1) * sizeof(size_t));
+    for (size_t j = 0; j < count; j++) {
+        const KVKey *key = &args[j * stride];
+        batch->order[j] = (uint32_t)kv_shard_index(key->data, key->length, (size_t)shard_count);
+        shard_start[batch->order[j] + 1]++;
+    }
+    for (int shard = 0; shard < shard_count; shard++) {
+        shard_start[shard + 1] += shard_start[shard];
+    }
+
+    // 按分片分组复制键，SET 的值复制进新值
+    size_t next_slot[MAX_REACTORS];
+    memcpy(next_slot, shard_start, (size_t)shard_count * sizeof(size_t));
+    for (size_t j = 0; j < count; j++) {
+        const KVKey *key = &args[j * stride];
+        size_t i = next_slot[batch->order[j]]++;
+        batch->order[j] = (uint32_t)i;
+        memcpy(key_storage, key->data, key->length);
+        batch->keys[i].data = key_storage;
+        batch->keys[i].length = key->length;
+        key_storage += key->length;
+        if (op == SHARD_OP_SET) {
+            batch->values[i] = kv_value_create(reactor->slab, key[1].data, key[1].length);
+            if (!batch->values[i]) {
+                shard_batch_free(batch);
+                return NULL;
+            }
+        }
+    }
+    return batch;
+}
+
+// 执行批次：本分片的一段直接执行，其他分片各投递一条消息（COUNT 发给每个分片），
+// 全部应答后由 reactor_drain_mailbox 写入响应并释放批次；不需要等待时立即完成
+void run_batch(Reactor *reactor, ClientConnection *client, ShardBatch *batch, const size_t *shard_start) {
+    int shard_count = reactor->server->reactor_count;
+    LOG_DEBUG("批量操作 %d，%zu 项，分布在 %d 个分片", batch->op, batch->count, shard_count);
+    for (int shard = 0; shard < shard_count; shard++) {
+        size_t start = shard_start[shard];
+        size_t shard_items = shard_start[shard + 1] - start;
+        if (shard_items == 0 && batch->op != SHARD_OP_COUNT) continue;
+        if (shard == reactor->id) {
+            execute_batch(reactor, batch, start, shard_items);
+            continue;
+        }
+        ShardMessage *message = shard_message_create(SHARD_OP_BATCH, "", 0, NULL);
+        if (!message) {
+            // 其余分片照常执行，全部应答后整个批次按内部错误应答，不把未执行的项当作未命中返回
+            batch->incomplete = true;
+            continue;
+        }
+        message->batch = batch;
+        message->batch_start = start;
+        message->batch_count = shard_items;
+        message->origin = reactor->id;
+        message->client = client;
+        message->client_gen = client->generation;
+        batch->pending++;
+        shard_mailbox_post(&reactor->server->reactors[shard].mailbox, message);
+    }
+    if (batch->pending > 0) {
+        client->awaiting_shard = true;
+        return;
+    }
+    write_batch_response(client, batch);
+    shard_batch_free(batch);
+}
+
+// 执行单键操作，消耗 value 的引用：键属于其他分片时把请求投递给拥有者线程，应答返回后再写入响应；
+// 否则直接在本分片执行并写入响应。expire_ms 为 SET / EXPIRE 要设置的过期时刻
+void run_kv_op(Reactor *reactor, ClientConnection *client, ShardOp op, const char *key, size_t key_length,
+               KVValue *value, uint64_t expire_ms) {
+    int owner = (int)kv_shard_index(key, key_length, (size_t)reactor->server->reactor_count);
+    if (owner != reactor->id) {
+        ShardMessage *message = shard_message_create(op, key, key_length, value);
+        kv_value_release(value);
+        if (!message) {
+            write_internal_error(client);
+            return;
+        }
+        LOG_DEBUG("键 '%.*s' 属于分片 %d，转发请求", (int)key_length, key, owner);
+        message->origin = reactor->id;
+        message->client = client;
+        message->client_gen = client->generation;
+        message->expire_ms = expire_ms;
+        client->awaiting_shard = true;
+        shard_mailbox_post(&reactor->server->reactors[owner].mailbox, message);
+        return;
+    }
+
+    ShardMessage local;
+    memset(&local, 0, sizeof(local));
+    local.op = op;
+    local.key = (char *)key;
+    local.key_length = key_length;
+    local.value = value;
+    local.expire_ms = expire_ms;
+    execute_shard_op(reactor, &local);
+    write_kv_response(client, &local);
+    kv_value_release(local.value);
+}
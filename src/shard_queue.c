@@ -0,0 +1,158 @@
+#include "shard_queue.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+void shard_queue_init(ShardQueue *queue) {
+    atomic_store_explicit(&queue->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, &queue->stub, memory_order_relaxed);
+    queue->tail = &queue->stub;
+}
+
+void shard_queue_push(ShardQueue *queue, ShardMessage *message) {
+    atomic_store_explicit(&message->next, NULL, memory_order_relaxed);
+    ShardMessage *prev = atomic_exchange_explicit(&queue->head, message, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, message, memory_order_release);
+}
+
+// 只能由消费者线程调用；生产者正在入队时可能暂时返回 NULL，唤醒通知保证稍后再取
+ShardMessage* shard_queue_pop(ShardQueue *queue) {
+    ShardMessage *tail = queue->tail;
+    ShardMessage *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (tail == &queue->stub) {
+        if (!next) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    ShardMessage *head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail != head) return NULL;
+    shard_queue_push(queue, &queue->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+bool shard_mailbox_init(ShardMailbox *mailbox) {
+    shard_queue_init(&mailbox->queue);
+    atomic_store(&mailbox->notified, false);
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) return false;
+    mailbox->wake_read_fd = fd;
+    mailbox->wake_write_fd = fd;
+#else
+    int fds[2];
+    if (pipe(fds) == -1) return false;
+    for (int i = 0; i < 2; i++) {
+        int flags = fcntl(fds[i], F_GETFL, 0);
+        fcntl(fds[i], F_SETFL, flags | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    mailbox->wake_read_fd = fds[0];
+    mailbox->wake_write_fd = fds[1];
+#endif
+    return true;
+}
+
+void shard_mailbox_destroy(ShardMailbox *mailbox) {
+    ShardMessage *message;
+    while ((message = shard_queue_pop(&mailbox->queue)) != NULL) {
+        shard_message_free(message);
+    }
+    if (mailbox->wake_read_fd != -1) close(mailbox->wake_read_fd);
+    if (mailbox->wake_write_fd != -1 && mailbox->wake_write_fd != mailbox->wake_read_fd) {
+        close(mailbox->wake_write_fd);
+    }
+    mailbox->wake_read_fd = -1;
+    mailbox->wake_write_fd = -1;
+}
+
+void shard_mailbox_wake(ShardMailbox *mailbox) {
+    uint64_t one = 1;
+    ssize_t n;
+    do {
+        n = write(mailbox->wake_write_fd, &one, sizeof(one));
+    } while (n == -1 && errno == EINTR);
+}
+
+void shard_mailbox_post(ShardMailbox *mailbox, ShardMessage *message) {
+    shard_queue_push(&mailbox->queue, message);
+    // 消费者确认前的多次投递只需要一次系统调用
+    if (!atomic_exchange_explicit(&mailbox->notified, true, memory_order_acq_rel)) {
+        shard_mailbox_wake(mailbox);
+    }
+}
+
+void shard_mailbox_ack(ShardMailbox *mailbox, bool drain_fd) {
+    if (drain_fd) {
+        uint64_t buf[8];
+        while (read(mailbox->wake_read_fd, buf, sizeof(buf)) > 0) {
+        }
+    }
+    // 先清除标志再取队列：之后入队的消息一定会触发新的唤醒
+    atomic_store_explicit(&mailbox->notified, false, memory_order_seq_cst);
+}
+
+ShardMessage* shard_mailbox_take(ShardMailbox *mailbox) {
+    return shard_queue_pop(&mailbox->queue);
+}
+
+// 键与消息在同一次分配中
+ShardMessage* shard_message_create(ShardOp op, const char *key, size_t key_length, KVValue *value) {
+    ShardMessage *message = calloc(1, sizeof(ShardMessage) + key_length + 1);
+    if (!message) return NULL;
+    message->op = op;
+    message->key = (char *)(message + 1);
+    memcpy(message->key, key, key_length);
+    message->key_length = key_length;
+    message->value = kv_value_retain(value);
+    return message;
+}
+
+void shard_message_free(ShardMessage *message) {
+    if (message) {
+        kv_value_release(message->value);
+        free(message);
+    }
+}
+
+// 各数组按对齐要求从大到小排列，键存储在最后
+ShardBatch* shard_batch_create(ShardOp op, size_t count, size_t key_bytes, char **key_storage) {
+    size_t size = sizeof(ShardBatch) + count * (sizeof(KVKey) + sizeof(KVValue *) + sizeof(uint32_t) + sizeof(bool))
+                + key_bytes;
+    ShardBatch *batch = calloc(1, size);
+    if (!batch) return NULL;
+    batch->op = op;
+    batch->count = count;
+    atomic_init(&batch->total, 0);
+    atomic_init(&batch->failed, false);
+    batch->keys = (KVKey *)(batch + 1);
+    batch->values = (KVValue **)(batch->keys + count);
+    batch->order = (uint32_t *)(batch->values + count);
+    batch->ok = (bool *)(batch->order + count);
+    *key_storage = (char *)(batch->ok + count);
+    return batch;
+}
+
+void shard_batch_free(ShardBatch *batch) {
+    if (batch) {
+        for (size_t i = 0; i < batch->count; i++) {
+            kv_value_release(batch->values[i]);
+        }
+        free(batch);
+    }
+}
@@ -0,0 +1,256 @@
+#include "slab.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define PAGE_HEADER_SIZE ((sizeof(SlabPage) + 63) & ~(size_t)63)
+
+// 远程释放的对象在自身内存中记录链表指针和大小（最小的大小类为 16 字节）
+typedef struct RemoteObject {
+    struct RemoteObject *next;
+    size_t size;
+} RemoteObject;
+
+// 大对象前的头部，释放时找到所属分配器更新统计
+typedef struct {
+    SlabAllocator *owner;
+    size_t size;
+} LargeHeader;
+
+// 16..128 每 16 字节一档；之后每个 2 的幂区间 (2^k, 2^(k+1)] 均分 4 档
+static unsigned size_class(size_t size) {
+    if (size <= 128) {
+        return size == 0 ? 0 : (unsigned)((size + 15) / 16 - 1);
+    }
+    size_t s = size - 1;
+    unsigned log = 63 - (unsigned)__builtin_clzll((unsigned long long)s);
+    unsigned quarter = (unsigned)(s >> (log - 2)) & 3;
+    return 8 + (log - 7) * 4 + quarter;
+}
+
+static size_t class_size(unsigned index) {
+    if (index < 8) return (index + 1) * 16;
+    unsigned log = 7 + (index - 8) / 4;
+    unsigned quarter = (index - 8) % 4;
+    return ((size_t)1 << log) + (quarter + 1) * ((size_t)1 << (log - 2));
+}
+
+// 统计只有所有者线程写入，不需要原子读改写
+static inline void counter_add(atomic_size_t *counter, size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta,
+                          memory_order_relaxed);
+}
+
+static inline void counter_sub(atomic_size_t *counter, size_t delta) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) - delta,
+                          memory_order_relaxed);
+}
+
+static inline SlabPage *page_of(void *ptr) {
+    return (SlabPage *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+// 映射按页大小对齐的一页：多映射一页，再裁掉首尾多余部分
+static void *map_aligned_page(void) {
+    size_t length = SLAB_PAGE_SIZE * 2;
+    char *raw = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    uintptr_t aligned = ((uintptr_t)raw + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+    size_t head = aligned - (uintptr_t)raw;
+    if (head > 0) {
+        munmap(raw, head);
+    }
+    size_t tail = length - head - SLAB_PAGE_SIZE;
+    if (tail > 0) {
+        munmap((char *)aligned + SLAB_PAGE_SIZE, tail);
+    }
+    return (void *)aligned;
+}
+
+static void class_link(SlabClass *cls, SlabPage *page) {
+    page->prev = NULL;
+    page->next = cls->available;
+    if (cls->available) {
+        cls->available->prev = page;
+    }
+    cls->available = page;
+    page->listed = true;
+}
+
+static void class_unlink(SlabClass *cls, SlabPage *page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        cls->available = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->prev = page->next = NULL;
+    page->listed = false;
+}
+
+static SlabPage *page_create(SlabAllocator *slab, unsigned index) {
+    SlabPage *page = map_aligned_page();
+    if (!page) return NULL;
+    page->owner = slab;
+    page->free_list = NULL;
+    page->class_index = index;
+    page->capacity = (uint32_t)((SLAB_PAGE_SIZE - PAGE_HEADER_SIZE) / slab->classes[index].object_size);
+    page->in_use = 0;
+    page->carved = 0;
+    page->all_prev = NULL;
+    page->all_next = slab->pages;
+    if (slab->pages) {
+        slab->pages->all_prev = page;
+    }
+    slab->pages = page;
+    class_link(&slab->classes[index], page);
+    counter_add(&slab->reserved_bytes, SLAB_PAGE_SIZE);
+    return page;
+}
+
+static void page_release(SlabAllocator *slab, SlabPage *page) {
+    if (page->listed) {
+        class_unlink(&slab->classes[page->class_index], page);
+    }
+    if (page->all_prev) {
+        page->all_prev->all_next = page->all_next;
+    } else {
+        slab->pages = page->all_next;
+    }
+    if (page->all_next) {
+        page->all_next->all_prev = page->all_prev;
+    }
+    munmap(page, SLAB_PAGE_SIZE);
+    counter_sub(&slab->reserved_bytes, SLAB_PAGE_SIZE);
+}
+
+// 所有者线程归还对象；页变空且该大小类还有其他可用页时把页还给系统
+static void local_free(SlabAllocator *slab, SlabPage *page, void *ptr, size_t size) {
+    SlabClass *cls = &slab->classes[page->class_index];
+    *(void **)ptr = page->free_list;
+    page->free_list = ptr;
+    page->in_use--;
+    counter_sub(&slab->requested_bytes, size);
+    counter_sub(&slab->used_bytes, cls->object_size);
+    if (!page->listed) {
+        class_link(cls, page);
+    }
+    if (page->in_use == 0 && (cls->available != page || page->next)) {
+        page_release(slab, page);
+    }
+}
+
+void slab_drain_remote(SlabAllocator *slab) {
+    if (!atomic_load_explicit(&slab->remote_free, memory_order_relaxed)) return;
+    RemoteObject *object = atomic_exchange_explicit(&slab->remote_free, NULL, memory_order_acquire);
+    while (object) {
+        RemoteObject *next = object->next;
+        local_free(slab, page_of(object), object, object->size);
+        object = next;
+    }
+}
+
+SlabAllocator *slab_create(void) {
+    SlabAllocator *slab = calloc(1, sizeof(SlabAllocator));
+    if (!slab) return NULL;
+    for (unsigned i = 0; i < SLAB_CLASS_COUNT; i++) {
+        slab->classes[i].object_size = class_size(i);
+    }
+    atomic_init(&slab->remote_free, NULL);
+    atomic_init(&slab->requested_bytes, 0);
+    atomic_init(&slab->used_bytes, 0);
+    atomic_init(&slab->reserved_bytes, 0);
+    atomic_init(&slab->large_bytes, 0);
+    return slab;
+}
+
+void slab_destroy(SlabAllocator *slab) {
+    if (!slab) return;
+    SlabPage *page = slab->pages;
+    while (page) {
+        SlabPage *next = page->all_next;
+        munmap(page, SLAB_PAGE_SIZE);
+        page = next;
+    }
+    free(slab);
+}
+
+void *slab_alloc(SlabAllocator *slab, size_t size) {
+    if (size > SLAB_MAX_OBJECT) {
+        LargeHeader *header = malloc(sizeof(LargeHeader) + size);
+        if (!header) return NULL;
+        header->owner = slab;
+        header->size = size;
+        atomic_fetch_add_explicit(&slab->large_bytes, size, memory_order_relaxed);
+        return header + 1;
+    }
+    // 第一次分配的线程成为所有者（分配器在主线程创建，在反应器线程中使用）
+    if (!slab->owner_set) {
+        slab->owner_thread = pthread_self();
+        slab->owner_set = true;
+    }
+    slab_drain_remote(slab);
+    unsigned index = size_class(size);
+    SlabClass *cls = &slab->classes[index];
+    SlabPage *page = cls->available;
+    if (!page) {
+        page = page_create(slab, index);
+        if (!page) return NULL;
+    }
+    void *ptr;
+    if (page->free_list) {
+        ptr = page->free_list;
+        page->free_list = *(void **)ptr;
+    } else {
+        ptr = (char *)page + PAGE_HEADER_SIZE + (size_t)page->carved * cls->object_size;
+        page->carved++;
+    }
+    page->in_use++;
+    if (page->in_use == page->capacity) {
+        class_unlink(cls, page);
+    }
+    counter_add(&slab->requested_bytes, size);
+    counter_add(&slab->used_bytes, cls->object_size);
+    return ptr;
+}
+
+void slab_free(void *ptr, size_t size) {
+    if (!ptr) return;
+    if (size > SLAB_MAX_OBJECT) {
+        LargeHeader *header = (LargeHeader *)ptr - 1;
+        atomic_fetch_sub_explicit(&header->owner->large_bytes, header->size, memory_order_relaxed);
+        free(header);
+        return;
+    }
+    SlabPage *page = page_of(ptr);
+    SlabAllocator *slab = page->owner;
+    if (pthread_equal(pthread_self(), slab->owner_thread)) {
+        local_free(slab, page, ptr, size);
+        return;
+    }
+    // 其他线程：压入所有者的远程释放栈（所有者一次取走整个栈，不存在 ABA 问题）
+    RemoteObject *object = ptr;
+    object->size = size;
+    void *head = atomic_load_explicit(&slab->remote_free, memory_order_relaxed);
+    do {
+        object->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&slab->remote_free, &head, object,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+size_t slab_object_size(size_t size) {
+    return size > SLAB_MAX_OBJECT ? size : class_size(size_class(size));
+}
+
+void slab_stats(SlabAllocator *slab, SlabStats *stats) {
+    size_t large = atomic_load_explicit(&slab->large_bytes, memory_order_relaxed);
+    stats->requested_bytes = atomic_load_explicit(&slab->requested_bytes, memory_order_relaxed) + large;
+    stats->used_bytes = atomic_load_explicit(&slab->used_bytes, memory_order_relaxed) + large;
+    stats->reserved_bytes = atomic_load_explicit(&slab->reserved_bytes, memory_order_relaxed) + large;
+}
@@ -0,0 +1,494 @@
+#include "snapshot.h"
+#include "append_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SNAPSHOT_BUFFER_SIZE (1024 * 1024)
+#define SNAPSHOT_WRITEBACK_CHUNK (64ULL * 1024 * 1024) // 每写出这么多字节就开始回写并丢弃页缓存
+#define SNAPSHOT_PROGRESS_STEP 1024                    // 每写入这么多个键更新一次进度
+
+// 快照写入器：带缓冲的顺序写入，记录区的 CRC 随写入累积，当前分区的索引在内存中构建
+typedef struct {
+    int fd;
+    char *buf;
+    size_t len;
+    uint64_t pos;           // 已交给 write 的文件偏移
+    uint64_t writeback_pos; // 已请求回写并丢弃页缓存的位置
+    uint32_t crc;
+    uint64_t keys;
+    uint64_t *index;
+    uint64_t index_mask;
+    bool failed;
+    SnapshotProgress *progress;
+} SnapshotWriter;
+
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writer_flush(SnapshotWriter *writer) {
+    if (writer->failed) return false;
+    if (writer->len == 0) return true;
+    if (!write_all(writer->fd, writer->buf, writer->len)) {
+        writer->failed = true;
+        return false;
+    }
+    writer->pos += writer->len;
+    writer->len = 0;
+    if (writer->progress) {
+        atomic_store_explicit(&writer->progress->bytes, writer->pos, memory_order_relaxed);
+    }
+    // 大快照不应挤掉服务进程的页缓存：分段启动回写，已落盘的部分从缓存中丢弃
+    if (writer->pos - writer->writeback_pos >= SNAPSHOT_WRITEBACK_CHUNK) {
+#ifdef __linux__
+        sync_file_range(writer->fd, (off_t)writer->writeback_pos, (off_t)(writer->pos - writer->writeback_pos),
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+        posix_fadvise(writer->fd, (off_t)writer->writeback_pos, (off_t)(writer->pos - writer->writeback_pos),
+                      POSIX_FADV_DONTNEED);
+        writer->writeback_pos = writer->pos;
+    }
+    return true;
+}
+
+static bool writer_append(SnapshotWriter *writer, const void *data, size_t length) {
+    const char *p = data;
+    writer->crc = append_log_crc32c(writer->crc, p, length);
+    while (length > 0) {
+        if (writer->len == SNAPSHOT_BUFFER_SIZE && !writer_flush(writer)) return false;
+        size_t n = SNAPSHOT_BUFFER_SIZE - writer->len;
+        if (n > length) n = length;
+        memcpy(writer->buf + writer->len, p, n);
+        writer->len += n;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+static uint32_t record_crc(uint64_t expire_ms, const void *key, size_t key_length, const void *value,
+                           size_t value_length) {
+    uint32_t crc = append_log_crc32c(0, &expire_ms, sizeof(expire_ms));
+    return append_log_crc32c(append_log_crc32c(crc, key, key_length), value, value_length);
+}
+
+// 索引槽数：不小于键数的 4/3 的 2 的幂，空分区没有索引
+static uint64_t index_slots_for(uint64_t keys) {
+    if (keys == 0) return 0;
+    uint64_t slots = 8;
+    while (slots < keys + keys / 3 + 1) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+static bool write_record(SnapshotWriter *writer, const char *key, size_t key_length, const char *value,
+                         size_t value_length, uint64_t expire_ms, uint64_t hash) {
+    static const char padding[SNAPSHOT_ALIGN] = {0};
+    uint64_t offset = writer->pos + writer->len;
+    if (key_length > UINT32_MAX || offset > SNAPSHOT_SLOT_OFFSET_MASK) {
+        writer->failed = true;
+        return false;
+    }
+    SnapshotRecord record = {value_length, expire_ms, (uint32_t)key_length,
+                             record_crc(expire_ms, key, key_length, value, value_length)};
+    size_t length = sizeof(record) + key_length + value_length;
+    size_t pad = (SNAPSHOT_ALIGN - length % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+    if (!writer_append(writer, &record, sizeof(record)) ||
+        !writer_append(writer, key, key_length) ||
+        !writer_append(writer, value, value_length) ||
+        !writer_append(writer, padding, pad)) {
+        return false;
+    }
+    uint64_t slot = hash & writer->index_mask;
+    while (writer->index[slot] != 0) {
+        slot = (slot + 1) & writer->index_mask;
+    }
+    writer->index[slot] = (hash & ~SNAPSHOT_SLOT_OFFSET_MASK) | offset;
+    writer->keys++;
+    if (writer->progress && writer->keys % SNAPSHOT_PROGRESS_STEP == 0) {
+        atomic_fetch_add_explicit(&writer->progress->keys, SNAPSHOT_PROGRESS_STEP, memory_order_relaxed);
+    }
+    return true;
+}
+
+static bool write_entry(void *arg, const HashEntry *entry) {
+    return write_record(arg, entry->key, entry->key_length, entry->value->data, entry->value->length,
+                        kv_entry_expire(entry), (uint64_t)entry->hash);
+}
+
+static bool write_base_record(void *arg, const char *key, size_t key_length, const char *value,
+                              size_t value_length, uint64_t expire_ms) {
+    return write_record(arg, key, key_length, value, value_length, expire_ms,
+                        (uint64_t)kv_hash_key(key, key_length));
+}
+
+// 改名后的目录项要在目录落盘后才能在崩溃后可见
+static bool sync_parent_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char dir[4096];
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == path) {
+        snprintf(dir, sizeof(dir), "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+bool snapshot_write(const char *path, const SnapshotSource *sources, int count, SnapshotProgress *progress) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) return false;
+    size_t table_size = sizeof(SnapshotHeader) + (size_t)count * sizeof(SnapshotSection);
+    unsigned char *table = calloc(1, table_size);
+    SnapshotWriter writer = {0};
+    writer.buf = malloc(SNAPSHOT_BUFFER_SIZE);
+    writer.progress = progress;
+    writer.fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (!table || !writer.buf || writer.fd == -1) {
+        if (writer.fd != -1) close(writer.fd);
+        free(table);
+        free(writer.buf);
+        return false;
+    }
+
+    // 文件头和分区表最后写入，先占位
+    SnapshotHeader *header = (SnapshotHeader *)table;
+    SnapshotSection *sections = (SnapshotSection *)(table + sizeof(SnapshotHeader));
+    writer_append(&writer, table, table_size);
+    for (int i = 0; i < count && !writer.failed; i++) {
+        const SnapshotSource *source = &sources[i];
+        uint64_t slots = index_slots_for(kv_size(source->store) + (source->base ? source->base->live : 0));
+        writer.index = slots > 0 ? calloc(slots, sizeof(uint64_t)) : NULL;
+        writer.index_mask = slots > 0 ? slots - 1 : 0;
+        if (slots > 0 && !writer.index) {
+            writer.failed = true;
+            break;
+        }
+        sections[i].offset = writer.pos + writer.len;
+        writer.crc = 0;
+        uint64_t keys_before = writer.keys;
+        kv_store_foreach(source->store, write_entry, &writer);
+        if (source->base) {
+            snapshot_shard_foreach(source->base, write_base_record, &writer);
+        }
+        sections[i].length = writer.pos + writer.len - sections[i].offset;
+        sections[i].key_count = writer.keys - keys_before;
+        sections[i].crc = writer.crc;
+        // 记录和索引都按 8 字节对齐，索引映射后可以直接按 uint64_t 访问
+        sections[i].index_offset = writer.pos + writer.len;
+        sections[i].index_slots = slots;
+        if (slots > 0) {
+            writer_append(&writer, writer.index, slots * sizeof(uint64_t));
+        }
+        free(writer.index);
+        writer.index = NULL;
+    }
+    bool ok = writer_flush(&writer);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = SNAPSHOT_VERSION;
+    header->shard_count = (uint32_t)count;
+    header->created_ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    header->key_count = writer.keys;
+    header->crc = append_log_crc32c(0, table, table_size);
+    ok = ok && pwrite(writer.fd, table, table_size, 0) == (ssize_t)table_size && fdatasync(writer.fd) == 0;
+    if (progress) {
+        atomic_store_explicit(&progress->keys, writer.keys, memory_order_relaxed);
+    }
+    close(writer.fd);
+    free(table);
+    free(writer.buf);
+    if (!ok || rename(tmp, path) != 0 || !sync_parent_dir(path)) {
+        unlink(tmp);
+        return false;
+    }
+    if (progress) {
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        uint64_t elapsed = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000 + (uint64_t)end.tv_nsec / 1000 -
+                           (uint64_t)start.tv_nsec / 1000;
+        atomic_store_explicit(&progress->elapsed_us, elapsed, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool snapshot_open(SnapshotFile *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    const SnapshotHeader *header = data;
+    size_t table_size = sizeof(SnapshotHeader) + (size_t)header->shard_count * sizeof(SnapshotSection);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION ||
+        header->shard_count == 0 || header->shard_count > 4096 || table_size > size) {
+        munmap(data, size);
+        return false;
+    }
+    // 校验文件头和分区表（crc 字段按 0 计算）
+    SnapshotHeader copy = *header;
+    copy.crc = 0;
+    uint32_t crc = append_log_crc32c(0, &copy, sizeof(copy));
+    crc = append_log_crc32c(crc, (const unsigned char *)data + sizeof(SnapshotHeader), table_size - sizeof(SnapshotHeader));
+    const SnapshotSection *sections = (const SnapshotSection *)((const unsigned char *)data + sizeof(SnapshotHeader));
+    bool valid = crc == header->crc;
+    for (uint32_t i = 0; valid && i < header->shard_count; i++) {
+        const SnapshotSection *section = &sections[i];
+        uint64_t slots = section->index_slots;
+        valid = section->offset <= size && section->length <= size - section->offset &&
+                section->offset % SNAPSHOT_ALIGN == 0 && section->index_offset % SNAPSHOT_ALIGN == 0 &&
+                section->index_offset <= size && slots <= (size - section->index_offset) / sizeof(uint64_t) &&
+                (slots & (slots - 1)) == 0 && (slots > 0 || section->key_count == 0);
+    }
+    if (!valid) {
+        munmap(data, size);
+        return false;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    file->data = data;
+    file->size = size;
+    file->header = header;
+    file->sections = sections;
+    return true;
+}
+
+void snapshot_close(SnapshotFile *file) {
+    if (file->data) {
+        munmap((void *)file->data, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+// 解析记录区中 offset 处的记录，越界时返回 false；next 为下一条记录的偏移
+static bool parse_record(const unsigned char *records, uint64_t length, uint64_t offset, SnapshotRecord *record,
+                         const unsigned char **key, uint64_t *next) {
+    if (offset > length || length - offset < sizeof(*record)) return false;
+    memcpy(record, records + offset, sizeof(*record));
+    uint64_t body = length - offset - sizeof(*record);
+    if (record->key_length > body || record->value_length > body - record->key_length) return false;
+    *key = records + offset + sizeof(*record);
+    uint64_t size = sizeof(*record) + record->key_length + record->value_length;
+    *next = offset + size + (SNAPSHOT_ALIGN - size % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+    return true;
+}
+
+bool snapshot_visit_section(const SnapshotFile *file, uint32_t section, SnapshotVisitFn visit, void *arg) {
+    if (section >= file->header->shard_count) return false;
+    const SnapshotSection *s = &file->sections[section];
+    const unsigned char *records = file->data + s->offset;
+    if (append_log_crc32c(0, records, s->length) != s->crc) return false;
+    uint64_t offset = 0;
+    while (offset < s->length) {
+        SnapshotRecord record;
+        const unsigned char *key;
+        uint64_t next;
+        if (!parse_record(records, s->length, offset, &record, &key, &next)) return false;
+        if (!visit(arg, (const char *)key, record.key_length, (const char *)key + record.key_length,
+                   (size_t)record.value_length, record.expire_ms)) {
+            return true;
+        }
+        offset = next;
+    }
+    return true;
+}
+
+bool snapshot_shard_open(SnapshotShard *shard, const char *path, uint32_t section, uint32_t shard_count) {
+    memset(shard, 0, sizeof(*shard));
+    SnapshotFile file;
+    if (!snapshot_open(&file, path)) return false;
+    if (file.header->shard_count != shard_count || section >= shard_count) {
+        snapshot_close(&file);
+        return false;
+    }
+    const SnapshotSection *s = &file.sections[section];
+    shard->dropped = calloc(s->index_slots / 8 + 1, 1);
+    if (!shard->dropped) {
+        snapshot_close(&file);
+        return false;
+    }
+    shard->data = file.data;
+    shard->size = file.size;
+    shard->records = file.data + s->offset;
+    shard->records_length = s->length;
+    shard->index = s->index_slots > 0 ? (const uint64_t *)(file.data + s->index_offset) : NULL;
+    shard->index_mask = s->index_slots > 0 ? s->index_slots - 1 : 0;
+    shard->live = (size_t)s->key_count;
+    // 查找是随机访问：取消顺序读的提示，本分区的索引提前异步读入
+    madvise((void *)file.data, file.size, MADV_NORMAL);
+    if (s->index_slots > 0) {
+        uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)shard->index & ~(page - 1);
+        madvise((void *)begin, (uintptr_t)shard->index + s->index_slots * sizeof(uint64_t) - begin, MADV_WILLNEED);
+    }
+    return true;
+}
+
+void snapshot_shard_close(SnapshotShard *shard) {
+    if (shard->data) {
+        munmap((void *)shard->data, shard->size);
+    }
+    free(shard->dropped);
+    memset(shard, 0, sizeof(*shard));
+}
+
+static bool slot_dropped(const SnapshotShard *shard, uint64_t slot) {
+    return (shard->dropped[slot / 8] >> (slot % 8)) & 1;
+}
+
+void snapshot_shard_drop(SnapshotShard *shard, int64_t slot) {
+    if (slot < 0 || slot_dropped(shard, (uint64_t)slot)) return;
+    shard->dropped[slot / 8] |= (uint8_t)(1u << (slot % 8));
+    shard->live--;
+}
+
+static bool record_expired(const SnapshotRecord *record, uint64_t now) {
+    return record->expire_ms != 0 && record->expire_ms <= now;
+}
+
+// 找到指向记录区中 offset 处记录的索引槽，索引与记录不一致时返回 -1
+static int64_t slot_of_record(const SnapshotShard *shard, const unsigned char *key, size_t key_length,
+                              uint64_t offset) {
+    if (!shard->index) return -1;
+    uint64_t hash = (uint64_t)kv_hash_key((const char *)key, key_length);
+    uint64_t target = (hash & ~SNAPSHOT_SLOT_OFFSET_MASK) | (uint64_t)(shard->records - shard->data + offset);
+    uint64_t slot = hash & shard->index_mask;
+    for (uint64_t probes = 0; probes <= shard->index_mask; probes++) {
+        uint64_t entry = shard->index[slot];
+        if (entry == 0) return -1;
+        if (entry == target) return (int64_t)slot;
+        slot = (slot + 1) & shard->index_mask;
+    }
+    return -1;
+}
+
+int64_t snapshot_shard_find(SnapshotShard *shard, const char *key, size_t key_length, const char **value,
+                            size_t *value_length, uint64_t *expire_ms) {
+    if (!shard->index) return -1;
+    uint64_t hash = (uint64_t)kv_hash_key(key, key_length);
+    uint64_t tag = hash & ~SNAPSHOT_SLOT_OFFSET_MASK;
+    uint64_t records_offset = (uint64_t)(shard->records - shard->data);
+    uint64_t slot = hash & shard->index_mask;
+    for (uint64_t probes = 0; probes <= shard->index_mask; probes++, slot = (slot + 1) & shard->index_mask) {
+        uint64_t entry = shard->index[slot];
+        if (entry == 0) return -1;
+        if ((entry & ~SNAPSHOT_SLOT_OFFSET_MASK) != tag) continue;
+        // 偏移不在本分区时减法回绕，解析失败
+        SnapshotRecord record;
+        const unsigned char *record_key;
+        uint64_t next;
+        if (!parse_record(shard->records, shard->records_length, (entry & SNAPSHOT_SLOT_OFFSET_MASK) - records_offset,
+                          &record, &record_key, &next) ||
+            record.key_length != key_length || memcmp(record_key, key, key_length) != 0) {
+            continue;
+        }
+        if (slot_dropped(shard, slot)) return -1;
+        if (record.expire_ms != 0 && record_expired(&record, kv_now_ms())) {
+            snapshot_shard_drop(shard, (int64_t)slot);
+            return -1;
+        }
+        if (value) {
+            const unsigned char *data = record_key + key_length;
+            if (record_crc(record.expire_ms, record_key, key_length, data, record.value_length) != record.crc) {
+                shard->corrupt++;
+                snapshot_shard_drop(shard, (int64_t)slot);
+                return -1;
+            }
+            *value = (const char *)data;
+            *value_length = (size_t)record.value_length;
+        }
+        if (expire_ms) *expire_ms = record.expire_ms;
+        return (int64_t)slot;
+    }
+    return -1;
+}
+
+int64_t snapshot_shard_next(SnapshotShard *shard, const char **key, size_t *key_length, const char **value,
+                            size_t *value_length, uint64_t *expire_ms) {
+    uint64_t now = kv_now_ms();
+    while (shard->cursor < shard->records_length) {
+        SnapshotRecord record;
+        const unsigned char *record_key;
+        uint64_t next;
+        if (!parse_record(shard->records, shard->records_length, shard->cursor, &record, &record_key, &next)) {
+            shard->cursor = shard->records_length;
+            break;
+        }
+        int64_t slot = slot_of_record(shard, record_key, record.key_length, shard->cursor);
+        shard->cursor = next;
+        if (slot < 0 || slot_dropped(shard, (uint64_t)slot)) continue;
+        if (record_expired(&record, now)) {
+            snapshot_shard_drop(shard, slot);
+            continue;
+        }
+        const unsigned char *data = record_key + record.key_length;
+        if (record_crc(record.expire_ms, record_key, record.key_length, data, record.value_length) != record.crc) {
+            shard->corrupt++;
+            snapshot_shard_drop(shard, slot);
+            continue;
+        }
+        *key = (const char *)record_key;
+        *key_length = record.key_length;
+        *value = (const char *)data;
+        *value_length = (size_t)record.value_length;
+        *expire_ms = record.expire_ms;
+        return slot;
+    }
+    return -1;
+}
+
+bool snapshot_shard_merging(const SnapshotShard *shard) {
+    return shard->cursor < shard->records_length;
+}
+
+void snapshot_shard_foreach(const SnapshotShard *shard, SnapshotVisitFn visit, void *arg) {
+    uint64_t now = kv_now_ms();
+    uint64_t offset = 0;
+    while (offset < shard->records_length) {
+        SnapshotRecord record;
+        const unsigned char *key;
+        uint64_t next;
+        if (!parse_record(shard->records, shard->records_length, offset, &record, &key, &next)) return;
+        int64_t slot = slot_of_record(shard, key, record.key_length, offset);
+        offset = next;
+        if (slot < 0 || slot_dropped(shard, (uint64_t)slot) || record_expired(&record, now)) continue;
+        const unsigned char *data = key + record.key_length;
+        if (record_crc(record.expire_ms, key, record.key_length, data, record.value_length) != record.crc) continue;
+        if (!visit(arg, (const char *)key, record.key_length, (const char *)data, (size_t)record.value_length,
+                   record.expire_ms)) {
+            return;
+        }
+    }
+}
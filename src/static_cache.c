@@ -0,0 +1,213 @@
+#include "static_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#define STAT_MTIME(st) ((st).st_mtimespec)
+#else
+#define STAT_MTIME(st) ((st).st_mtim)
+#endif
+
+#define GZIP_SUFFIX ".gz"
+#define INDEX_NAME "index.html"
+
+void static_cache_init(StaticCache *cache, SlabAllocator *slab) {
+    cache->slab = slab;
+    cache->assets = NULL;
+}
+
+static void variant_clear(StaticVariant *variant) {
+    kv_value_release(variant->body);
+    memset(variant, 0, sizeof(*variant));
+}
+
+static void asset_free(StaticAsset *asset) {
+    variant_clear(&asset->identity);
+    variant_clear(&asset->gzip);
+    free(asset);
+}
+
+void static_cache_destroy(StaticCache *cache) {
+    StaticAsset *asset = cache->assets;
+    while (asset) {
+        StaticAsset *next = asset->next;
+        asset_free(asset);
+        asset = next;
+    }
+    cache->assets = NULL;
+}
+
+// 把请求路径规范为相对 STATIC_ROOT 的文件名：目录映射到 index.html；
+// 每个片段必须非空且不以 '.' 开头（拒绝 ".."、隐藏文件和 "//"），不能含 '\0' 或 '\\'
+static bool normalize_name(const char *name, size_t length, char *out) {
+    bool directory = length == 0 || name[length - 1] == '/';
+    size_t total = length + (directory ? sizeof(INDEX_NAME) - 1 : 0);
+    if (total + sizeof(GZIP_SUFFIX) - 1 > STATIC_MAX_NAME) return false;
+    bool segment_start = true;
+    for (size_t i = 0; i < length; i++) {
+        char c = name[i];
+        if (c == '\0' || c == '\\') return false;
+        if (segment_start && (c == '.' || c == '/')) return false;
+        segment_start = c == '/';
+    }
+    memcpy(out, name, length);
+    if (directory) {
+        memcpy(out + length, INDEX_NAME, sizeof(INDEX_NAME) - 1);
+    }
+    out[total] = '\0';
+    return true;
+}
+
+// 按扩展名确定 Content-Type，未知的扩展名按二进制数据发送
+static HttpContentType content_type_for(const char *name) {
+    const char *dot = strrchr(name, '.');
+    const char *slash = strrchr(name, '/');
+    if (!dot || (slash && dot < slash)) return HTTP_CONTENT_BINARY;
+    const char *ext = dot + 1;
+    if (strcasecmp(ext, "html") == 0 || strcasecmp(ext, "htm") == 0) return HTTP_CONTENT_HTML;
+    if (strcasecmp(ext, "css") == 0) return HTTP_CONTENT_CSS;
+    if (strcasecmp(ext, "js") == 0 || strcasecmp(ext, "mjs") == 0) return HTTP_CONTENT_JS;
+    if (strcasecmp(ext, "json") == 0) return HTTP_CONTENT_JSON;
+    if (strcasecmp(ext, "svg") == 0) return HTTP_CONTENT_SVG;
+    if (strcasecmp(ext, "png") == 0) return HTTP_CONTENT_PNG;
+    if (strcasecmp(ext, "ico") == 0) return HTTP_CONTENT_ICO;
+    if (strcasecmp(ext, "txt") == 0) return HTTP_CONTENT_TEXT;
+    return HTTP_CONTENT_BINARY;
+}
+
+// 缓存的内容与磁盘上的文件是否不同（编辑器通常写入新文件再改名，inode 也会变化）
+static bool variant_stale(const StaticVariant *variant, const struct stat *st) {
+    return !variant->body ||
+           variant->mtime.tv_sec != STAT_MTIME(*st).tv_sec ||
+           variant->mtime.tv_nsec != STAT_MTIME(*st).tv_nsec ||
+           variant->size != st->st_size ||
+           variant->inode != st->st_ino;
+}
+
+// 读入文件的一种表示并生成实体标签和额外头部；失败时保留原来的内容
+static bool load_variant(StaticCache *cache, StaticVariant *variant, const char *path, bool gzip) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || (unsigned long long)st.st_size > STATIC_MAX_FILE_SIZE) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    KVValue *body = kv_value_alloc(cache->slab, size);
+    if (!body) {
+        close(fd);
+        return false;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, body->data + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    close(fd);
+    if (done != size) {
+        kv_value_release(body);
+        return false;
+    }
+
+    variant_clear(variant);
+    variant->body = body;
+    variant->mtime = STAT_MTIME(st);
+    variant->size = st.st_size;
+    variant->inode = st.st_ino;
+    // 秒级的修改时间加大小不足以区分同一秒内大小不变的修改，标签还包括纳秒和 inode
+    snprintf(variant->etag, sizeof(variant->etag), "\"%llx-%llx.%lx-%llx%s\"",
+             (unsigned long long)st.st_ino, (unsigned long long)STAT_MTIME(st).tv_sec,
+             (unsigned long)STAT_MTIME(st).tv_nsec, (unsigned long long)st.st_size, gzip ? "-gz" : "");
+    snprintf(variant->headers, sizeof(variant->headers),
+             "ETag: %s\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Vary: Accept-Encoding\r\n"
+             "%s",
+             variant->etag, gzip ? "Content-Encoding: gzip\r\n" : "");
+    return true;
+}
+
+// 检查原文件和预压缩文件，有变化时重新读入；原文件已不存在或不可读时返回 false
+static bool refresh_asset(StaticCache *cache, StaticAsset *asset) {
+    char path[sizeof(STATIC_ROOT) + STATIC_MAX_NAME + 1];
+    int length = snprintf(path, sizeof(path), "%s/%s", STATIC_ROOT, asset->name);
+    struct stat st;
+    if (stat(path, &st) == -1) return false;
+    if (variant_stale(&asset->identity, &st) && !load_variant(cache, &asset->identity, path, false)) {
+        return false;
+    }
+
+    // 预压缩文件比原文件旧时视为过期，不再使用
+    memcpy(path + length, GZIP_SUFFIX, sizeof(GZIP_SUFFIX));
+    if (stat(path, &st) == -1 || !S_ISREG(st.st_mode) ||
+        STAT_MTIME(st).tv_sec < asset->identity.mtime.tv_sec) {
+        variant_clear(&asset->gzip);
+    } else if (variant_stale(&asset->gzip, &st) && !load_variant(cache, &asset->gzip, path, true)) {
+        variant_clear(&asset->gzip);
+    }
+    return true;
+}
+
+const StaticAsset* static_cache_lookup(StaticCache *cache, const char *name, size_t length) {
+    char normalized[STATIC_MAX_NAME + 1];
+    if (!normalize_name(name, length, normalized)) return NULL;
+
+    StaticAsset **link = &cache->assets;
+    StaticAsset *asset;
+    while ((asset = *link) && strcmp(asset->name, normalized) != 0) {
+        link = &asset->next;
+    }
+    time_t now = time(NULL);
+    if (asset) {
+        if (now - asset->checked_at < STATIC_RECHECK_INTERVAL) return asset;
+    } else {
+        asset = calloc(1, sizeof(StaticAsset));
+        if (!asset) return NULL;
+        strcpy(asset->name, normalized);
+        asset->type = content_type_for(asset->name);
+        *link = asset;
+    }
+    asset->checked_at = now;
+    if (!refresh_asset(cache, asset)) {
+        *link = asset->next;
+        asset_free(asset);
+        return NULL;
+    }
+    return asset;
+}
+
+const StaticVariant* static_asset_variant(const StaticAsset *asset, bool accept_gzip) {
+    return accept_gzip && asset->gzip.body ? &asset->gzip : &asset->identity;
+}
+
+bool static_variant_matches(const StaticVariant *variant, HttpSpan if_none_match) {
+    if (!variant->body || if_none_match.length == 0) return false;
+    size_t etag_length = strlen(variant->etag);
+    const char *p = if_none_match.data;
+    const char *end = p + if_none_match.length;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ',')) p++;
+        if (p == end) break;
+        if (*p == '*') return true;
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/') p += 2;
+        const char *tag_end = p;
+        if (tag_end < end && *tag_end == '"') {
+            tag_end++;
+            while (tag_end < end && *tag_end != '"') tag_end++;
+            if (tag_end < end) tag_end++;
+        }
+        if ((size_t)(tag_end - p) == etag_length && memcmp(p, variant->etag, etag_length) == 0) return true;
+        p = tag_end;
+        while (p < end && *p != ',') p++;
+    }
+    return false;
+}
@@ -0,0 +1,140 @@
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static void list_init(TimerNode *head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static bool list_empty(const TimerNode *head) {
+    return head->next == head;
+}
+
+static void list_append(TimerNode *head, TimerNode *node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void list_unlink(TimerNode *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+// 把 from 中的节点整体移到 to 的末尾
+static void list_splice(TimerNode *to, TimerNode *from) {
+    if (list_empty(from)) return;
+    from->next->prev = to->prev;
+    to->prev->next = from->next;
+    from->prev->next = to;
+    to->prev = from->prev;
+    list_init(from);
+}
+
+static uint64_t rotate_right(uint64_t bits, unsigned count) {
+    return count == 0 ? bits : (bits >> count) | (bits << (64 - count));
+}
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+        wheel->occupied[level] = 0;
+    }
+    list_init(&wheel->cascading);
+    wheel->now = now;
+}
+
+// 按到期刻度与当前刻度的距离选择层：第 l 层放距离在 [64^l, 64^(l+1)) 内的定时器，
+// 槽号取到期刻度在该层的位数，槽中的定时器在当前刻度到达 (expire >> 6l) << 6l 时下放
+static void place(TimerWheel *wheel, TimerNode *node) {
+    uint64_t expire = node->expire > wheel->now ? node->expire : wheel->now;
+    uint64_t delta = expire - wheel->now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && (delta >> (TIMER_WHEEL_BITS * (level + 1))) != 0) {
+        level++;
+    }
+    if ((delta >> (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) != 0) {
+        // 超出范围：放在最高层最远的槽，下放时按真实的到期刻度重新放置
+        expire = wheel->now + ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1);
+    }
+    unsigned slot = (unsigned)(expire >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+    list_append(&wheel->slots[level][slot], node);
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+void timer_wheel_add(TimerWheel *wheel, TimerNode *node, uint64_t expire) {
+    timer_wheel_remove(node);
+    node->expire = expire;
+    place(wheel, node);
+}
+
+void timer_wheel_remove(TimerNode *node) {
+    if (node->next) {
+        list_unlink(node);
+    }
+}
+
+uint64_t timer_wheel_next(TimerWheel *wheel) {
+    if (!list_empty(&wheel->cascading)) return wheel->now;
+    uint64_t next = TIMER_WHEEL_NEVER;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        unsigned shift = TIMER_WHEEL_BITS * (unsigned)level;
+        unsigned current = (unsigned)(wheel->now >> shift) & SLOT_MASK;
+        // 第 0 层从当前槽找起；更高层的当前槽要整整一圈之后才下放，从下一个槽找起
+        unsigned start = level == 0 ? current : (current + 1) & SLOT_MASK;
+        while (wheel->occupied[level]) {
+            unsigned distance = (unsigned)__builtin_ctzll(rotate_right(wheel->occupied[level], start));
+            unsigned slot = (start + distance) & SLOT_MASK;
+            if (list_empty(&wheel->slots[level][slot])) {
+                wheel->occupied[level] &= ~(1ULL << slot);
+                continue;
+            }
+            uint64_t tick = level == 0 ? wheel->now + distance
+                                       : ((wheel->now >> shift) + distance + 1) << shift;
+            if (tick < next) next = tick;
+            break;
+        }
+    }
+    return next;
+}
+
+TimerNode* timer_wheel_expire(TimerWheel *wheel, uint64_t now, size_t *budget) {
+    while (*budget > 0) {
+        if (!list_empty(&wheel->cascading)) {
+            TimerNode *node = wheel->cascading.next;
+            list_unlink(node);
+            place(wheel, node);
+            (*budget)--;
+            continue;
+        }
+        TimerNode *head = &wheel->slots[0][wheel->now & SLOT_MASK];
+        if (!list_empty(head)) {
+            TimerNode *node = head->next;
+            list_unlink(node);
+            (*budget)--;
+            return node;
+        }
+        if (now <= wheel->now) return NULL;
+        // 直接跳到下一个有到期定时器或需要下放的刻度，中间的空槽不逐个访问
+        uint64_t next = timer_wheel_next(wheel);
+        if (next > now) {
+            wheel->now = now;
+            return NULL;
+        }
+        wheel->now = next;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            unsigned shift = TIMER_WHEEL_BITS * (unsigned)level;
+            if ((next & ((1ULL << shift) - 1)) != 0) break;
+            unsigned slot = (unsigned)(next >> shift) & SLOT_MASK;
+            list_splice(&wheel->cascading, &wheel->slots[level][slot]);
+            wheel->occupied[level] &= ~(1ULL << slot);
+        }
+    }
+    return NULL;
+}
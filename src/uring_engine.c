@@ -0,0 +1,620 @@
+#include "uring_engine.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user_data 编码：高位为连接指针（至少 8 字节对齐），低 3 位为操作类型
+enum {
+    URING_OP_ACCEPT = 1,
+    URING_OP_RECV = 2,
+    URING_OP_SEND = 3,
+    URING_OP_CLOSE = 4,
+    URING_OP_PROVIDE = 5,
+    URING_OP_WAKE = 6,
+    URING_OP_ACCEPT_RESP = 7 // RESP 监听套接字的 accept
+};
+#define URING_OP_MASK 0x7ULL
+
+// 精简的 io_uring 封装：只包含本服务器用到的提交/完成队列操作
+typedef struct {
+    int ring_fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sqe_tail; // 本地已填充但尚未发布的 SQE 位置
+    unsigned sqe_head; // 已发布到 sq_tail 的位置
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+    char *buffers; // 接收缓冲区池，按 bid 索引
+    uint64_t wake_value; // 信箱唤醒 fd 的读取目标
+    struct __kernel_timespec timeout; // 等待完成事件的超时
+    Reactor *reactor;
+    // 提交队列满（内核暂时不接收新请求，例如完成队列溢出）时未能提交的操作，下一轮事件处理开始时重试
+    ClientConnection *deferred;  // 需要重新决定接收、发送或关闭的连接，通过 next_deferred 链接
+    unsigned *deferred_bids;     // 未能归还给内核的接收缓冲区
+    unsigned deferred_bid_count;
+    bool deferred_accept;        // HTTP 监听套接字的 accept 需要重新提交
+    bool deferred_accept_resp;   // RESP 监听套接字的 accept 需要重新提交
+    bool deferred_wake;          // 信箱唤醒 fd 的读取需要重新提交
+} UringContext;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_destroy(UringContext *ctx) {
+    if (ctx->sqes && ctx->sqes != MAP_FAILED) munmap(ctx->sqes, ctx->sqes_size);
+    if (ctx->cq_ptr && ctx->cq_ptr != MAP_FAILED && ctx->cq_ptr != ctx->sq_ptr) munmap(ctx->cq_ptr, ctx->cq_size);
+    if (ctx->sq_ptr && ctx->sq_ptr != MAP_FAILED) munmap(ctx->sq_ptr, ctx->sq_size);
+    if (ctx->ring_fd != -1) close(ctx->ring_fd);
+    free(ctx->buffers);
+    free(ctx->deferred_bids);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ring_fd = -1;
+}
+
+static bool uring_init(UringContext *ctx, unsigned entries) {
+    memset(ctx, 0, sizeof(*ctx));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ctx->ring_fd = sys_io_uring_setup(entries, &params);
+    if (ctx->ring_fd < 0) {
+        ctx->ring_fd = -1;
+        return false;
+    }
+
+    ctx->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ctx->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ctx->cq_size > ctx->sq_size) ctx->sq_size = ctx->cq_size;
+        ctx->cq_size = ctx->sq_size;
+    }
+    ctx->sq_ptr = mmap(NULL, ctx->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ctx->ring_fd, IORING_OFF_SQ_RING);
+    if (ctx->sq_ptr == MAP_FAILED) {
+        uring_destroy(ctx);
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ctx->cq_ptr = ctx->sq_ptr;
+    } else {
+        ctx->cq_ptr = mmap(NULL, ctx->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ctx->ring_fd, IORING_OFF_CQ_RING);
+        if (ctx->cq_ptr == MAP_FAILED) {
+            uring_destroy(ctx);
+            return false;
+        }
+    }
+    ctx->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ctx->sqes = mmap(NULL, ctx->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ctx->ring_fd, IORING_OFF_SQES);
+    if (ctx->sqes == MAP_FAILED) {
+        uring_destroy(ctx);
+        return false;
+    }
+
+    char *sq = ctx->sq_ptr;
+    ctx->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ctx->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ctx->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ctx->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ctx->sq_entries = params.sq_entries;
+    char *cq = ctx->cq_ptr;
+    ctx->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ctx->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ctx->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ctx->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    ctx->sqe_head = ctx->sqe_tail = *ctx->sq_tail;
+    // 带超时的等待需要 IORING_ENTER_EXT_ARG（5.11），多次触发的 accept 本来就要求更新的内核
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        uring_destroy(ctx);
+        errno = ENOSYS;
+        return false;
+    }
+    return true;
+}
+
+// 把本地填充的 SQE 发布给内核，返回待提交数量
+static unsigned uring_flush_sq(UringContext *ctx) {
+    unsigned tail = *ctx->sq_tail;
+    unsigned mask = *ctx->sq_mask;
+    while (ctx->sqe_head != ctx->sqe_tail) {
+        ctx->sq_array[tail & mask] = ctx->sqe_head & mask;
+        tail++;
+        ctx->sqe_head++;
+    }
+    __atomic_store_n(ctx->sq_tail, tail, __ATOMIC_RELEASE);
+    return tail - __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+}
+
+// 提交并等待至少 wait_nr 个完成事件
+static int uring_submit(UringContext *ctx, unsigned wait_nr) {
+    unsigned to_submit = uring_flush_sq(ctx);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    if (to_submit == 0 && wait_nr == 0) return 0;
+    int ret = sys_io_uring_enter(ctx->ring_fd, to_submit, wait_nr, flags);
+    return ret < 0 ? -errno : ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(UringContext *ctx) {
+    unsigned head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+    if (ctx->sqe_tail - head >= ctx->sq_entries) {
+        // 提交队列已满：先把已有请求提交给内核再继续（依赖未同步日志的发送不会在队列中，见 uring_after_input）
+        uring_submit(ctx, 0);
+        head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+        if (ctx->sqe_tail - head >= ctx->sq_entries) return NULL;
+    }
+    struct io_uring_sqe *sqe = &ctx->sqes[ctx->sqe_tail & *ctx->sq_mask];
+    ctx->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// 连接的操作未能提交：记入重试链表，下一轮由 uring_retry_deferred 按连接当前的状态重新提交
+static void defer_client(UringContext *ctx, ClientConnection *client) {
+    if (client->uring_deferred) return;
+    client->uring_deferred = true;
+    client->next_deferred = ctx->deferred;
+    ctx->deferred = client;
+}
+
+static uint64_t make_user_data(ClientConnection *client, unsigned op) {
+    return (uint64_t)(uintptr_t)client | op;
+}
+
+// 提交并等待：timeout_ms 为 -1 时等到至少一个完成事件，为 0 时只提交不等待，否则最多等待 timeout_ms 毫秒，
+// 超时随 io_uring_enter 传入（IORING_ENTER_EXT_ARG），不占用提交队列
+static int uring_submit_wait(UringContext *ctx, int timeout_ms) {
+    if (timeout_ms <= 0) return uring_submit(ctx, timeout_ms < 0 ? 1 : 0);
+    ctx->timeout.tv_sec = timeout_ms / 1000;
+    ctx->timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&ctx->timeout;
+    unsigned to_submit = uring_flush_sq(ctx);
+    int ret = (int)syscall(__NR_io_uring_enter, ctx->ring_fd, to_submit, 1,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret < 0) return errno == ETIME ? 0 : -errno;
+    return ret;
+}
+
+static bool queue_provide_buffers(UringContext *ctx, unsigned bid, unsigned count) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        // 每个缓冲区同一时刻最多等待归还一次，数组容量足够
+        for (unsigned i = 0; i < count; i++) {
+            ctx->deferred_bids[ctx->deferred_bid_count++] = bid + i;
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = (int)count;
+    sqe->addr = (uint64_t)(uintptr_t)(ctx->buffers + (size_t)bid * BUFFER_SIZE);
+    sqe->len = BUFFER_SIZE;
+    sqe->off = bid;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = make_user_data(NULL, URING_OP_PROVIDE);
+    return true;
+}
+
+// op 为 URING_OP_ACCEPT 或 URING_OP_ACCEPT_RESP，完成时据此决定新连接的协议
+static bool queue_accept(UringContext *ctx, int listen_fd, unsigned op) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        if (op == URING_OP_ACCEPT_RESP) {
+            ctx->deferred_accept_resp = true;
+        } else {
+            ctx->deferred_accept = true;
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = make_user_data(NULL, op);
+    return true;
+}
+
+// 由内核从缓冲区池中选择接收缓冲区，空闲连接不占用接收内存
+static bool queue_recv(UringContext *ctx, ClientConnection *client) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        defer_client(ctx, client);
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->fd;
+    sqe->len = BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = make_user_data(client, URING_OP_RECV);
+    client->recv_pending = true;
+    return true;
+}
+
+// 关闭连接；client 为 NULL 时只关闭 fd（例如分配连接失败）
+static bool queue_close(UringContext *ctx, ClientConnection *client, int fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        // 没有连接对象的 fd 直接同步关闭
+        if (client) {
+            defer_client(ctx, client);
+        } else {
+            close(fd);
+        }
+        return false;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = make_user_data(client, URING_OP_CLOSE);
+    if (client) client->closing = true;
+    return true;
+}
+
+static bool has_output(const ClientConnection *client) {
+    return client->out.pending > 0 || client->sending.pending > 0;
+}
+
+// 用 sendmsg 发送输出队列（响应头和存储中的值组成 iovec，值不复制）；
+// 每个连接同一时刻只有一个在途发送：发送开始时把输出队列换到 sending，之后生成的响应写入新的输出队列
+// close_after 为 true 且本次能发完全部数据时链接关闭操作，两个 SQE 在同一批次中提交
+static bool queue_send(UringContext *ctx, ClientConnection *client, bool close_after) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        defer_client(ctx, client);
+        return false;
+    }
+    if (client->sending.pending == 0) {
+        OutQueue drained = client->sending;
+        client->sending = client->out;
+        client->out = drained;
+    }
+    int iov_count = out_queue_fill_iov(&client->sending, client->send_iov, OUT_QUEUE_MAX_IOV);
+    size_t bytes = 0;
+    for (int i = 0; i < iov_count; i++) {
+        bytes += client->send_iov[i].iov_len;
+    }
+    if (bytes < client->sending.pending || client->out.pending > 0) {
+        close_after = false; // 还有后续批次，由 handle_send 继续
+    }
+    memset(&client->send_msg, 0, sizeof(client->send_msg));
+    client->send_msg.msg_iov = client->send_iov;
+    client->send_msg.msg_iovlen = iov_count;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = client->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&client->send_msg;
+    sqe->len = 1;
+    // MSG_WAITALL 让内核在短写时继续发送，保证后续发送和链接的 close 在数据全部发出后执行
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->user_data = make_user_data(client, URING_OP_SEND);
+    client->send_pending = true;
+    client->send_started = metrics_start(client->metrics, METRIC_STAGE_SEND);
+    if (close_after) {
+        sqe->flags = IOSQE_IO_LINK;
+        // close 未能提交时取消链接（否则会链接到之后的其他请求），发送完成后由 handle_send 关闭
+        if (!queue_close(ctx, client, client->fd)) sqe->flags = 0;
+    }
+    return true;
+}
+
+// 根据输入处理结果提交发送、继续接收或关闭连接
+static void uring_after_input(UringContext *ctx, ClientConnection *client, ClientState state) {
+    if (client->closing) return;
+    // 响应依赖的日志记录同步之前不提交发送，由 reactor_commit_log 继续处理
+    if (server_hold_client_output(ctx->reactor, client)) return;
+    if (client->send_pending) {
+        // 在途发送完成后由 handle_send 继续
+        if (state == CLIENT_NEED_MORE && !client->recv_pending) queue_recv(ctx, client);
+        return;
+    }
+    switch (state) {
+        case CLIENT_CLOSE_AFTER_WRITE:
+            if (client->recv_pending) {
+                // 等待在途接收结束后再关闭，shutdown 让它立即完成
+                shutdown(client->fd, SHUT_RD);
+            } else if (has_output(client)) {
+                queue_send(ctx, client, true);
+            } else {
+                queue_close(ctx, client, client->fd);
+            }
+            break;
+        case CLIENT_NEED_MORE:
+            if (has_output(client)) queue_send(ctx, client, false);
+            if (!client->recv_pending) queue_recv(ctx, client);
+            break;
+        case CLIENT_AWAITING_SHARD: // 应答到达前不再读取，保证响应顺序
+        case CLIENT_OUTPUT_FULL:    // 输出积压超过上限时不再读取，发送完成后由 handle_send 继续处理
+            // 已生成的响应先发送
+            if (has_output(client)) queue_send(ctx, client, false);
+            break;
+    }
+}
+
+// 读取信箱唤醒 fd，其他反应器投递消息时完成
+static bool queue_wake_read(UringContext *ctx, int wake_fd) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ctx);
+    if (!sqe) {
+        ctx->deferred_wake = true;
+        return false;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ctx->wake_value;
+    sqe->len = sizeof(ctx->wake_value);
+    sqe->user_data = make_user_data(NULL, URING_OP_WAKE);
+    return true;
+}
+
+// 跨分片应答到达后，继续处理流水线中的请求并把响应加入下一批提交
+static void uring_complete(Reactor *reactor, ClientConnection *client) {
+    uring_after_input(reactor->engine_data, client, server_process_client_input(reactor, client));
+}
+
+static void handle_accept(Reactor *reactor, UringContext *ctx, struct io_uring_cqe *cqe, ClientProtocol protocol) {
+    if (!(cqe->flags & IORING_CQE_F_MORE) && reactor->server->running) {
+        // multishot accept 已终止（例如出错），重新提交
+        if (protocol == CLIENT_PROTOCOL_RESP) {
+            queue_accept(ctx, reactor->resp_fd, URING_OP_ACCEPT_RESP);
+        } else {
+            queue_accept(ctx, reactor->server_fd, URING_OP_ACCEPT);
+        }
+    }
+    if (cqe->res < 0) {
+        LOG_DEBUG("accept 失败: %s", strerror(-cqe->res));
+        return;
+    }
+    int client_fd = cqe->res;
+    ClientConnection *client = server_acquire_client(reactor, client_fd, protocol);
+    if (!client) {
+        LOG_DEBUG("分配连接失败，关闭 fd %d", client_fd);
+        queue_close(ctx, NULL, client_fd);
+        return;
+    }
+    LOG_DEBUG("io_uring 接受新连接，fd: %d", client_fd);
+    queue_recv(ctx, client);
+}
+
+static void handle_recv(Reactor *reactor, UringContext *ctx, ClientConnection *client,
+                        struct io_uring_cqe *cqe) {
+    client->recv_pending = false;
+    if (cqe->res == -ENOBUFS && !client->close_after_write) {
+        // 缓冲区池暂时耗尽，等待已提交的归还操作后重试
+        queue_recv(ctx, client);
+        return;
+    }
+    if (cqe->res <= 0 || client->close_after_write) {
+        if (cqe->res == 0) {
+            LOG_DEBUG("客户端 fd %d 关闭连接", client->fd);
+        } else if (cqe->res < 0) {
+            LOG_DEBUG("从客户端 fd %d 读取数据失败: %s", client->fd, strerror(-cqe->res));
+        }
+        if (cqe->res > 0) {
+            queue_provide_buffers(ctx, cqe->flags >> IORING_CQE_BUFFER_SHIFT, 1);
+        }
+        client->close_after_write = true;
+        if (!client->awaiting_shard) {
+            uring_after_input(ctx, client, CLIENT_CLOSE_AFTER_WRITE);
+        }
+        return;
+    }
+
+    unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    size_t bytes_read = (size_t)cqe->res;
+    const char *data = ctx->buffers + (size_t)bid * BUFFER_SIZE;
+    // 复制到连接的读缓冲区或正在流式接收的值中；请求体收完后剩余数据属于下一个请求
+    for (size_t copied = 0; copied < bytes_read; ) {
+        char *target;
+        size_t space;
+        if (!server_client_read_buffer(reactor, client, &target, &space)) {
+            queue_provide_buffers(ctx, bid, 1);
+            client->close_after_write = true;
+            if (!client->awaiting_shard) uring_after_input(ctx, client, CLIENT_CLOSE_AFTER_WRITE);
+            return;
+        }
+        size_t chunk = bytes_read - copied < space ? bytes_read - copied : space;
+        memcpy(target, data + copied, chunk);
+        server_client_read_done(reactor, client, chunk);
+        copied += chunk;
+    }
+    // 数据已复制，立即把缓冲区归还给内核
+    queue_provide_buffers(ctx, bid, 1);
+
+    LOG_DEBUG("从客户端 fd %d 读取 %zu 字节", client->fd, bytes_read);
+    uring_after_input(ctx, client, server_process_client_input(reactor, client));
+}
+
+static void handle_send(Reactor *reactor, UringContext *ctx, ClientConnection *client, struct io_uring_cqe *cqe) {
+    client->send_pending = false;
+    metrics_finish(&reactor->metrics, METRIC_STAGE_SEND, client->send_started);
+    client->send_started = 0;
+    if (cqe->res > 0) {
+        out_queue_consume(&client->sending, (size_t)cqe->res);
+        metric_add(&reactor->metrics.bytes_out, (size_t)cqe->res);
+    }
+    if (client->closing) return; // 链接的 close 随后完成
+    if (cqe->res < 0) {
+        LOG_DEBUG("发送响应失败，fd: %d: %s", client->fd, strerror(-cqe->res));
+        // 字节流已不完整，丢弃尚未发送的响应并关闭
+        out_queue_clear(&client->sending);
+        out_queue_clear(&client->out);
+        client->close_after_write = true;
+        if (!client->awaiting_shard) uring_after_input(ctx, client, CLIENT_CLOSE_AFTER_WRITE);
+        return;
+    }
+    // 发送后积压减少，继续处理因输出积压而暂停的请求
+    uring_after_input(ctx, client, server_process_client_input(reactor, client));
+}
+
+static void handle_close(Reactor *reactor, ClientConnection *client, struct io_uring_cqe *cqe) {
+    if (!client) return;
+    if (cqe->res == -ECANCELED && client->fd != -1) {
+        // 链接的 send 失败导致 close 被取消，直接同步关闭
+        close(client->fd);
+    }
+    LOG_DEBUG("io_uring 连接关闭完成，fd: %d", client->fd);
+    server_release_client(reactor, client);
+}
+
+static void handle_completion(Reactor *reactor, UringContext *ctx, struct io_uring_cqe *cqe) {
+    unsigned op = (unsigned)(cqe->user_data & URING_OP_MASK);
+    ClientConnection *client = (ClientConnection *)(uintptr_t)(cqe->user_data & ~URING_OP_MASK);
+    switch (op) {
+        case URING_OP_ACCEPT:
+            handle_accept(reactor, ctx, cqe, CLIENT_PROTOCOL_HTTP);
+            break;
+        case URING_OP_ACCEPT_RESP:
+            handle_accept(reactor, ctx, cqe, CLIENT_PROTOCOL_RESP);
+            break;
+        case URING_OP_RECV:
+            handle_recv(reactor, ctx, client, cqe);
+            break;
+        case URING_OP_SEND:
+            handle_send(reactor, ctx, client, cqe);
+            break;
+        case URING_OP_CLOSE:
+            handle_close(reactor, client, cqe);
+            break;
+        case URING_OP_WAKE:
+            shard_mailbox_ack(&reactor->mailbox, false);
+            reactor_drain_mailbox(reactor);
+            if (reactor->server->running) {
+                queue_wake_read(ctx, reactor->mailbox.wake_read_fd);
+            }
+            break;
+        case URING_OP_PROVIDE:
+            if (cqe->res < 0) {
+                LOG_DEBUG("归还接收缓冲区失败: %s", strerror(-cqe->res));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// 重新提交上一轮因提交队列满而未能提交的操作；再次失败的操作重新记录，留到下一轮
+static void uring_retry_deferred(UringContext *ctx) {
+    Reactor *reactor = ctx->reactor;
+    unsigned bid_count = ctx->deferred_bid_count;
+    ctx->deferred_bid_count = 0;
+    for (unsigned i = 0; i < bid_count; i++) {
+        queue_provide_buffers(ctx, ctx->deferred_bids[i], 1);
+    }
+    if (ctx->deferred_accept) {
+        ctx->deferred_accept = false;
+        queue_accept(ctx, reactor->server_fd, URING_OP_ACCEPT);
+    }
+    if (ctx->deferred_accept_resp) {
+        ctx->deferred_accept_resp = false;
+        queue_accept(ctx, reactor->resp_fd, URING_OP_ACCEPT_RESP);
+    }
+    if (ctx->deferred_wake) {
+        ctx->deferred_wake = false;
+        queue_wake_read(ctx, reactor->mailbox.wake_read_fd);
+    }
+    ClientConnection *client = ctx->deferred;
+    ctx->deferred = NULL;
+    while (client) {
+        ClientConnection *next = client->next_deferred;
+        client->uring_deferred = false;
+        client->next_deferred = NULL;
+        // 按连接当前的状态重新决定要提交的操作；已经释放的连接跳过
+        if (client->fd != -1) uring_complete(reactor, client);
+        client = next;
+    }
+}
+
+static bool uring_has_deferred(const UringContext *ctx) {
+    return ctx->deferred || ctx->deferred_bid_count > 0 || ctx->deferred_accept || ctx->deferred_accept_resp ||
+           ctx->deferred_wake;
+}
+
+bool uring_engine_run(Reactor *reactor) {
+    KVServer *server = reactor->server;
+    if (!server->running) return false;
+    UringContext ctx;
+    if (!uring_init(&ctx, URING_ENTRIES)) {
+        LOG_WARN("io_uring 初始化失败: %s", strerror(errno));
+        return false;
+    }
+    ctx.reactor = reactor;
+    ctx.buffers = malloc((size_t)URING_BUF_COUNT * BUFFER_SIZE);
+    ctx.deferred_bids = malloc(URING_BUF_COUNT * sizeof(unsigned));
+    if (!ctx.buffers || !ctx.deferred_bids) {
+        uring_destroy(&ctx);
+        return false;
+    }
+    queue_provide_buffers(&ctx, 0, URING_BUF_COUNT);
+    queue_accept(&ctx, reactor->server_fd, URING_OP_ACCEPT);
+    if (reactor->resp_fd != -1) {
+        queue_accept(&ctx, reactor->resp_fd, URING_OP_ACCEPT_RESP);
+    }
+    queue_wake_read(&ctx, reactor->mailbox.wake_read_fd);
+    if (uring_submit(&ctx, 0) < 0) {
+        LOG_ERROR("io_uring 提交失败");
+        uring_destroy(&ctx);
+        return false;
+    }
+
+    reactor->engine_data = &ctx;
+    reactor->complete = uring_complete;
+    LOG_INFO("反应器 %d 使用 io_uring 引擎，队列深度 %u", reactor->id, ctx.sq_entries);
+
+    while (server->running) {
+        uring_retry_deferred(&ctx);
+        // 上一轮处理中产生的所有 SQE 在这里一次提交，同时等待新的完成事件；
+        // 本轮的日志记录先写出（always 策略下同步），响应在日志之后才交给内核
+        reactor_commit_log(reactor);
+        // 映射的快照分区尚未合并完时只提交不等待，空闲的轮次用来合并；有带过期时刻的键时最多等到下一个到期；
+        // 还有未能提交的操作时最多等待 1 毫秒，让下一轮尽快重试
+        int timeout_ms = reactor_wait_timeout(reactor);
+        if (uring_has_deferred(&ctx) && (timeout_ms < 0 || timeout_ms > 1)) timeout_ms = 1;
+        int ret = uring_submit_wait(&ctx, timeout_ms);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+            LOG_ERROR("io_uring_enter: %s", strerror(-ret));
+            break;
+        }
+        reactor_update_clock(reactor);
+
+        unsigned head = *ctx.cq_head;
+        unsigned tail = __atomic_load_n(ctx.cq_tail, __ATOMIC_ACQUIRE);
+        unsigned mask = *ctx.cq_mask;
+        while (head != tail) {
+            handle_completion(reactor, &ctx, &ctx.cqes[head & mask]);
+            head++;
+        }
+        __atomic_store_n(ctx.cq_head, head, __ATOMIC_RELEASE);
+        if (reactor->base) {
+            reactor_merge_base(reactor);
+        }
+        reactor_expire_keys(reactor);
+        reactor_reap_clients(reactor);
+        slab_drain_remote(reactor->slab);
+        reactor_sample_metrics(reactor);
+    }
+
+    reactor->engine_data = NULL;
+    uring_destroy(&ctx);
+    return true;
+}
@@ -0,0 +1,106 @@
+#!/bin/bash
+
+# 追加日志测试：4 个反应器线程、-f always，写入后重启从日志恢复；
+# 日志末尾的记录写了一半或后面跟着垃圾字节时，重放到此为止，之前的数据完整恢复；
+# BGREWRITEAOF 后切换到新一代的基础文件和增量日志，旧文件被删除，重启后数据不变
+
+source "$(dirname "$0")/test_helpers.sh"
+
+AOF_DIR="$TEST_DIR/aof"
+KEYS=300
+
+start_aof() {
+    start_server -t 4 -a "$AOF_DIR" -f always
+}
+
+# check_keys <描述> <起始> <结束> <值前缀>：键 k起始..k结束 的值依次为 值前缀+序号
+check_keys() {
+    local command="MGET" expected="" i value
+    for i in $(seq "$2" "$3"); do
+        command+=" k$i"
+        value="$4$i"
+        expected+="\$${#value}"$'\n'"$value"$'\n'
+    done
+    check "$1" "*$(($3 - $2 + 1))"$'\n'"${expected}+OK" "$(resp "$command")"
+}
+
+# incr_files：目录中的增量日志文件名，以空格分隔
+incr_files() {
+    (cd "$AOF_DIR" && ls incr-*.cxl 2>/dev/null | tr '\n' ' ' | sed 's/ $//')
+}
+
+echo "=== 追加日志测试 ==="
+echo
+
+echo "1. 启动服务器并写入"
+start_aof
+COMMANDS=()
+for i in $(seq "$KEYS"); do
+    COMMANDS+=("SET k$i v$i")
+done
+COMMANDS+=("SET k1 changed" "DEL k2" "SET ttl_key t EX 3600" "SET gone_key g PX 1" "DEL missing")
+resp "${COMMANDS[@]}" >/dev/null
+check "HTTP 写入" "201" "$(http_code -X POST -d "from http" "$SERVER_URL/api/http_key")"
+check "HTTP 删除" "204" "$(http_code -X DELETE "$SERVER_URL/api/k3")"
+sleep 0.1
+check "键数" ":$KEYS" "$(resp "DBSIZE" | head -1)"
+echo
+
+echo "2. 重启后从日志恢复"
+stop_server
+start_aof
+check "键数不变" ":$KEYS" "$(resp "DBSIZE" | head -1)"
+check "覆盖写入的值" "changed" "$(curl -s -m 10 "$SERVER_URL/api/k1")"
+check "删除的键不存在" ":0 :0 :0 +OK" "$(resp "EXISTS k2" "EXISTS k3" "EXISTS gone_key" | tr '\n' ' ' | sed 's/ $//')"
+check_keys "其余的键" 4 "$KEYS" v
+check "HTTP 写入的键" "from http" "$(curl -s -m 10 "$SERVER_URL/api/http_key")"
+check_true "过期时间保留" [ "$(resp "PTTL ttl_key" | head -1 | tr -d ':')" -gt 3500000 ]
+echo
+
+echo "3. 日志末尾写了一半的记录和垃圾字节"
+resp "SET k4 after_restart" "SET torn_key torn" >/dev/null
+stop_server
+# 最后一条记录截掉 3 个字节，模拟崩溃时只写了一部分；其他分片的日志末尾追加垃圾字节
+TORN_FILE=$(cd "$AOF_DIR" && grep -l torn_key incr-*.cxl | head -1)
+check_true "找到含最后一条记录的日志文件" [ -n "$TORN_FILE" ]
+truncate -s -3 "$AOF_DIR/$TORN_FILE"
+for file in "$AOF_DIR"/incr-*.cxl; do
+    [ "$(basename "$file")" == "$TORN_FILE" ] || printf '\x01\x05\x00\x00\x00garbage' >>"$file"
+done
+start_aof
+check_true "日志记录了损坏的位置" grep -q "不完整或损坏" "$TEST_DIR/server.log"
+check "写了一半的记录被丢弃" ":0" "$(resp "EXISTS torn_key" | head -1)"
+check "之前的记录照常重放" "after_restart" "$(curl -s -m 10 "$SERVER_URL/api/k4")"
+check_keys "其余的键" 5 "$KEYS" v
+check "键数" ":$KEYS" "$(resp "DBSIZE" | head -1)"
+echo
+
+echo "4. BGREWRITEAOF 切换到新一代日志"
+BEFORE=$(incr_files)
+check "BGREWRITEAOF 应答" "+Background append only file rewriting scheduled" "$(resp "BGREWRITEAOF" | head -1)"
+# 基础文件改名完成、旧一代的增量日志被删除后重写才算结束
+for _ in $(seq 100); do
+    BASE=$(cd "$AOF_DIR" && ls base-*.cxl 2>/dev/null)
+    [ -n "$BASE" ] && [ "$(incr_files | wc -w)" -eq 4 ] && break
+    sleep 0.1
+done
+GENERATION=${BASE#base-}
+GENERATION=${GENERATION%.cxl}
+check_true "生成基础文件" [ -n "$GENERATION" ]
+check "增量日志切换到第 $GENERATION 代" \
+    "incr-$GENERATION-0.cxl incr-$GENERATION-1.cxl incr-$GENERATION-2.cxl incr-$GENERATION-3.cxl" "$(incr_files)"
+check_true "旧的增量日志已删除" [ "$BEFORE" != "$(incr_files)" ]
+resp "SET k5 after_rewrite" "DEL k6" >/dev/null
+echo
+
+echo "5. 重写后重启"
+stop_server
+start_aof
+check "基础文件之后的修改" "after_rewrite" "$(curl -s -m 10 "$SERVER_URL/api/k5")"
+check "基础文件之后的删除" "404" "$(http_code "$SERVER_URL/api/k6")"
+check "基础文件中的值" "after_restart" "$(curl -s -m 10 "$SERVER_URL/api/k4")"
+check_keys "其余的键" 7 "$KEYS" v
+check "键数" ":$((KEYS - 1))" "$(resp "DBSIZE" | head -1)"
+check_true "过期时间保留" [ "$(resp "PTTL ttl_key" | head -1 | tr -d ':')" -gt 3500000 ]
+
+finish
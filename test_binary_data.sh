@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# 二进制数据测试：键和值按长度处理，可以包含 NUL 等任意字节；
+# 用 4 个反应器线程，键分布在不同分片上，跨分片转发时同样按长度复制
+
+source "$(dirname "$0")/test_helpers.sh"
+
+echo "=== 二进制数据测试 ==="
+echo
+
+echo "1. 启动 4 个反应器线程的服务器"
+start_server -t 4
+echo
+
+echo "2. HTTP：值中含 NUL 和 0xFF，键用 %00 编码"
+printf 'head\x00\x00middle\xff\x00tail' >"$TEST_DIR/small.bin"
+head -c 200000 /dev/urandom >"$TEST_DIR/large.bin"
+check "写入小值" "201" "$(http_code -X POST --data-binary @"$TEST_DIR/small.bin" "$SERVER_URL/api/bin%00key")"
+curl -s -m 10 -o "$TEST_DIR/small.out" "$SERVER_URL/api/bin%00key"
+check_true "读回的小值逐字节相同" cmp -s "$TEST_DIR/small.bin" "$TEST_DIR/small.out"
+check "NUL 之前的前缀是另一个键" "404" "$(http_code "$SERVER_URL/api/bin")"
+check "写入 200 KB 随机值" "201" "$(http_code -X POST --data-binary @"$TEST_DIR/large.bin" "$SERVER_URL/api/bin%00large")"
+curl -s -m 10 -o "$TEST_DIR/large.out" "$SERVER_URL/api/bin%00large"
+check_true "读回的随机值逐字节相同" cmp -s "$TEST_DIR/large.bin" "$TEST_DIR/large.out"
+echo
+
+echo "3. HTTP：只差在 NUL 之后的多个键分布在各分片上"
+MISMATCH=0
+for i in $(seq 1 32); do
+    printf 'value\x00%d' "$i" >"$TEST_DIR/value.bin"
+    curl -s -m 10 -o /dev/null -X POST --data-binary @"$TEST_DIR/value.bin" "$SERVER_URL/api/k%00$i"
+done
+for i in $(seq 1 32); do
+    printf 'value\x00%d' "$i" >"$TEST_DIR/value.bin"
+    curl -s -m 10 -o "$TEST_DIR/value.out" "$SERVER_URL/api/k%00$i"
+    cmp -s "$TEST_DIR/value.bin" "$TEST_DIR/value.out" || MISMATCH=$((MISMATCH + 1))
+done
+check "32 个键读回的值都正确" "0" "$MISMATCH"
+echo
+
+echo "4. RESP：键和值中含 NUL，与 HTTP 共享同一份数据"
+printf '*3\r\n$3\r\nSET\r\n$5\r\nr\x00k\x00z\r\n$6\r\nv\x00x\x00\x00y\r\n*2\r\n$3\r\nGET\r\n$5\r\nr\x00k\x00z\r\n' |
+    resp_raw >"$TEST_DIR/resp.out"
+printf '+OK\n$6\nv\x00x\x00\x00y\n+OK\n' >"$TEST_DIR/resp.expected"
+check_true "SET 和 GET 的应答逐字节相同" cmp -s "$TEST_DIR/resp.expected" "$TEST_DIR/resp.out"
+curl -s -m 10 -o "$TEST_DIR/cross.out" "$SERVER_URL/api/r%00k%00z"
+printf 'v\x00x\x00\x00y' >"$TEST_DIR/cross.expected"
+check_true "HTTP 读到 RESP 写入的值" cmp -s "$TEST_DIR/cross.expected" "$TEST_DIR/cross.out"
+printf '*2\r\n$3\r\nGET\r\n$4\r\nbin\x00\r\n' | resp_raw >"$TEST_DIR/prefix.out"
+check "RESP 读前缀键 bin\\0 不存在" "\$-1 +OK" "$(tr '\n' ' ' <"$TEST_DIR/prefix.out" | sed 's/ $//')"
+echo
+
+echo "5. 批量接口：netstring 中的键含 NUL"
+printf '5:b\x00one,4:1\x00\xffx,5:b\x00two,3:2\x002,' >"$TEST_DIR/batch_set.bin"
+check "批量写入的项数" "2" "$(curl -s -m 10 -X POST --data-binary @"$TEST_DIR/batch_set.bin" "$SERVER_URL/batch/set")"
+printf '5:b\x00two,5:b\x00nil,5:b\x00one,' >"$TEST_DIR/batch_get.bin"
+curl -s -m 10 -o "$TEST_DIR/batch.out" -X POST --data-binary @"$TEST_DIR/batch_get.bin" "$SERVER_URL/batch/get"
+printf '3:2\x002,-,4:1\x00\xffx,' >"$TEST_DIR/batch.expected"
+check_true "批量读取按请求顺序返回" cmp -s "$TEST_DIR/batch.expected" "$TEST_DIR/batch.out"
+
+finish
@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# 内存上限测试：以很小的 -m 写入超过上限的数据，noeviction 拒绝需要更多内存的写入，
+# clock、lru、lfu 淘汰旧键后照常写入；键空间的用量不超过上限，/metrics 的命中、未命中和淘汰数与实际读写一致，
+# 写入期间反复读取的热键比只写一次的键更多地留在内存中
+
+source "$(dirname "$0")/test_helpers.sh"
+
+KEYS=3000   # 每个键约 1 KB，总量约 3 MB，是 1 MB 上限的三倍
+HOT=50
+VALUE=$(printf 'v%.0s' $(seq 1000))
+
+# fill <前缀> <起始> <结束>：流水线写入键 <前缀><序号>，输出每条回复（最后一条是 QUIT 的 +OK）
+fill() {
+    local i
+    for i in $(seq "$2" "$3"); do
+        resp_encode SET "$1$i" "$VALUE"
+    done | resp_raw
+}
+
+# read_hot：读取全部热键
+read_hot() {
+    local command="MGET" i
+    for i in $(seq "$HOT"); do
+        command+=" hot$i"
+    done
+    resp "$command" >/dev/null
+}
+
+# present <前缀> <起始> <结束>：这些键中仍然存在的个数
+present() {
+    local command="EXISTS" i
+    for i in $(seq "$2" "$3"); do
+        command+=" $1$i"
+    done
+    resp "$command" | head -1 | tr -d ':'
+}
+
+# dbsize：总键数
+dbsize() {
+    resp "DBSIZE" | head -1 | tr -d ':'
+}
+
+# within_limit：键空间的用量不超过上限
+within_limit() {
+    local used limit
+    used=$(metric c_x_store_memory_bytes)
+    limit=$(metric c_x_store_max_memory_bytes)
+    [ "$limit" -gt 0 ] && [ "$used" -le "$limit" ]
+}
+
+echo "=== 内存上限测试 ==="
+echo
+
+echo "1. noeviction：超过上限的写入被拒绝"
+start_server -t 2 -m 1 -E noeviction
+REPLIES=$(fill cold 1 "$KEYS")
+OK=$(($(grep -c '^+OK$' <<<"$REPLIES") - 1))
+check_true "部分写入成功" test "$OK" -gt 0 -a "$OK" -lt "$KEYS"
+check "其余写入返回内存不足" "$((KEYS - OK))" "$(grep -c '^-ERR out of memory$' <<<"$REPLIES")"
+check "HTTP 写入返回 500" "500" "$(http_code -X POST -d "$VALUE" "$SERVER_URL/api/rejected")"
+check "没有淘汰" "0" "$(metric c_x_store_evictions_total)"
+check "键数等于成功的写入" "$OK" "$(dbsize)"
+check_true "用量不超过上限" within_limit
+FIRST=$(resp "SET cold1 $VALUE" | head -1)
+check "覆盖写入不变大时照常执行" "+OK" "$FIRST"
+HITS=$(metric c_x_store_hits_total)
+MISSES=$(metric c_x_store_misses_total)
+resp "MGET cold1 cold2 missing1 missing2 missing3" >/dev/null
+check "命中数" "$((HITS + 2))" "$(metric c_x_store_hits_total)"
+check "未命中数" "$((MISSES + 3))" "$(metric c_x_store_misses_total)"
+stop_server
+echo
+
+STEP=2
+for POLICY in clock lru lfu; do
+    echo "$STEP. $POLICY：淘汰旧键后照常写入"
+    start_server -t 2 -m 1 -E "$POLICY"
+    check_true "/metrics 报告淘汰策略" grep -q "eviction=\"$POLICY\"" <(curl -s -m 10 "$SERVER_URL/metrics")
+    fill hot 1 "$HOT" >/dev/null
+    # 分批写入冷键，每批之后读取热键；批次之间间隔超过访问时钟的刻度
+    BATCH=$((KEYS / 30))
+    REJECTED=0
+    for round in $(seq 0 29); do
+        REPLIES=$(fill cold $((round * BATCH + 1)) $(((round + 1) * BATCH)))
+        REJECTED=$((REJECTED + $(grep -vc '^+OK$' <<<"$REPLIES")))
+        read_hot
+        sleep 0.02
+    done
+    check "全部写入成功" "0" "$REJECTED"
+    EVICTED=$(metric c_x_store_evictions_total)
+    SIZE=$(dbsize)
+    check_true "有键被淘汰" test "$EVICTED" -gt 0
+    check "键数加淘汰数等于写入的键数" "$((KEYS + HOT))" "$((SIZE + EVICTED))"
+    check_true "用量不超过上限" within_limit
+    HOT_LEFT=$(present hot 1 "$HOT")
+    COLD_LEFT=$(present cold 1 "$KEYS")
+    echo "     热键留下 $HOT_LEFT/$HOT，冷键留下 $COLD_LEFT/$KEYS"
+    check_true "热键留下的比例高于冷键" test $((HOT_LEFT * KEYS)) -gt $((COLD_LEFT * HOT))
+    HITS=$(metric c_x_store_hits_total)
+    MISSES=$(metric c_x_store_misses_total)
+    COMMAND="MGET"
+    for i in $(seq 1 "$KEYS"); do COMMAND+=" cold$i"; done
+    resp "$COMMAND" >/dev/null
+    check "命中数增加留下的冷键数" "$((HITS + COLD_LEFT))" "$(metric c_x_store_hits_total)"
+    check "未命中数增加淘汰的冷键数" "$((MISSES + KEYS - COLD_LEFT))" "$(metric c_x_store_misses_total)"
+    stop_server
+    echo
+    STEP=$((STEP + 1))
+done
+
+finish
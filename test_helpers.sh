@@ -0,0 +1,128 @@
+#!/bin/bash
+
+# 自检测试脚本共用的函数：启动/停止服务器、检查结果、发送 RESP 命令
+# 用法：在测试脚本中 source "$(dirname "$0")/test_helpers.sh"
+# 环境变量：C_X_BIN 服务器程序（默认 ./build/c_x），TEST_PORT HTTP 端口（默认 18080），
+#           RESP 端口为 TEST_PORT+1；C_X_ARGS 追加到每次启动的参数（如 "-e io_uring"）
+
+cd "$(dirname "$0")" || exit 1
+
+C_X_BIN=${C_X_BIN:-./build/c_x}
+TEST_PORT=${TEST_PORT:-18080}
+RESP_PORT=$((TEST_PORT + 1))
+SERVER_URL="http://localhost:$TEST_PORT"
+TEST_DIR=$(mktemp -d "${TMPDIR:-/tmp}/c_x_test.XXXXXX")
+SERVER_PID=""
+FAILURES=0
+
+if [ ! -x "$C_X_BIN" ]; then
+    echo "找不到服务器程序 $C_X_BIN，请先编译或用 C_X_BIN 指定"
+    exit 1
+fi
+
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill -9 "$SERVER_PID" 2>/dev/null
+    rm -rf "$TEST_DIR"
+}
+trap cleanup EXIT
+
+# 等待 HTTP 端口可用
+wait_server() {
+    for _ in $(seq 100); do
+        curl -s -m 1 -o /dev/null "$SERVER_URL/health" && return 0
+        kill -0 "$SERVER_PID" 2>/dev/null || break
+        sleep 0.1
+    done
+    echo "服务器启动失败，日志:"
+    cat "$TEST_DIR/server.log"
+    exit 1
+}
+
+# start_server [参数...]：在 TEST_PORT 上启动服务器（同时开启 RESP 端口），输出追加到 $TEST_DIR/server.log
+start_server() {
+    # shellcheck disable=SC2086
+    "$C_X_BIN" "$TEST_PORT" -r "$RESP_PORT" $C_X_ARGS "$@" >>"$TEST_DIR/server.log" 2>&1 &
+    SERVER_PID=$!
+    wait_server
+}
+
+# 发送 SIGINT 并等待服务器正常退出
+stop_server() {
+    [ -z "$SERVER_PID" ] && return
+    kill -INT "$SERVER_PID" 2>/dev/null
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=""
+}
+
+# check <描述> <期望值> <实际值>
+check() {
+    if [ "$2" == "$3" ]; then
+        echo "  ✅ $1"
+    else
+        echo "  ❌ $1（期望: $2，实际: $3）"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+# check_true <描述> <命令...>：命令成功即通过
+check_true() {
+    local desc=$1
+    shift
+    if "$@"; then
+        echo "  ✅ $desc"
+    else
+        echo "  ❌ $desc"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+# http_code <curl 参数...>：只输出状态码
+http_code() {
+    curl -s -m 10 -o /dev/null -w "%{http_code}" "$@"
+}
+
+# metric <名称>：/metrics 中该指标的值，带标签的多行求和
+metric() {
+    curl -s -m 10 "$SERVER_URL/metrics" | awk -v name="$1" '$1 == name || index($1, name "{") == 1 { sum += $2 } END { print sum + 0 }'
+}
+
+# resp_encode <参数...>：把一条命令编码为 RESP 数组，参数按字节计长
+resp_encode() {
+    local LC_ALL=C
+    printf '*%d\r\n' $#
+    for arg in "$@"; do
+        printf '$%d\r\n%s\r\n' ${#arg} "$arg"
+    done
+}
+
+# resp <命令>...：每个参数是一条以空格分隔的命令，按顺序流水线发送后再发 QUIT，
+# 输出全部回复（去掉 \r）。需要二进制或带空格的参数时用 resp_raw
+resp() {
+    local command
+    {
+        for command in "$@"; do
+            # shellcheck disable=SC2086
+            resp_encode $command
+        done
+    } | resp_raw
+}
+
+# resp_raw：把标准输入原样发到 RESP 端口，再发 QUIT，输出全部回复（去掉 \r）
+resp_raw() {
+    exec 3<>"/dev/tcp/127.0.0.1/$RESP_PORT" || return 1
+    { cat; resp_encode QUIT; } >&3
+    timeout 10 tr -d '\r' <&3
+    exec 3<&-
+}
+
+# 输出结果并以失败数作为退出码
+finish() {
+    stop_server
+    echo
+    if [ "$FAILURES" -eq 0 ]; then
+        echo "=== 全部通过 ==="
+        exit 0
+    fi
+    echo "=== $FAILURES 项失败 ==="
+    exit 1
+}
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# 日志输出阻塞测试：服务器的标准输出接到一个从不读取的管道上，
+# 确认反应器线程不会因写日志而阻塞，请求照常完成，多出的日志只被限速计数或丢弃
+
+source "$(dirname "$0")/test_helpers.sh"
+
+REQUESTS=2000
+
+echo "=== 日志输出阻塞测试 ==="
+echo
+
+echo "1. 以 -v 启动服务器，输出接到不读取的管道"
+mkfifo "$TEST_DIR/output"
+sleep 120 <"$TEST_DIR/output" &
+READER_PID=$!
+# shellcheck disable=SC2086
+"$C_X_BIN" "$TEST_PORT" -v $C_X_ARGS >"$TEST_DIR/output" 2>&1 &
+SERVER_PID=$!
+wait_server
+echo
+
+echo "2. 每个请求新建一个连接，共 $REQUESTS 个"
+START=$(date +%s%N)
+CODES=$(timeout 30 curl -s -o /dev/null -w "\n%{http_code}\n" -H "Connection: close" \
+    -X POST -d "value" "$SERVER_URL/api/stall_[1-$REQUESTS]" | grep -c "^201$")
+ELAPSED=$((($(date +%s%N) - START) / 1000000))
+check "全部请求成功" "$REQUESTS" "$CODES"
+echo "  用时 ${ELAPSED} 毫秒"
+echo
+
+echo "3. 检查日志计数"
+SUPPRESSED=$(metric c_x_log_suppressed_total)
+DROPPED=$(metric c_x_log_dropped_total)
+echo "  限速省略: $SUPPRESSED，缓冲区满丢弃: $DROPPED"
+check_true "每连接的日志被限速" [ "$SUPPRESSED" -gt 0 ]
+check "服务器仍可访问" "200" "$(http_code "$SERVER_URL/health")"
+
+# 关闭管道的读端，日志线程退出前的写出随即失败返回，服务器可以正常退出
+kill "$READER_PID"
+wait "$READER_PID" 2>/dev/null
+
+finish
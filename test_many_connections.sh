@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# 大量并发连接测试：同时保持的连接数远超连接表的初始容量（1024 个 fd），
+# 每个连接都能收发请求，全部关闭后连接数回到 0
+# 环境变量：CONNECTIONS 同时打开的连接数（默认 10000，受文件描述符上限限制）
+
+source "$(dirname "$0")/test_helpers.sh"
+
+# 服务器和本脚本都需要足够的文件描述符，先提高到硬上限（服务器启动后继承）
+ulimit -n "$(ulimit -Hn)" 2>/dev/null
+CONNECTIONS=${CONNECTIONS:-10000}
+MAX_CONNECTIONS=$(($(ulimit -n) - 100))
+if [ "$CONNECTIONS" -gt "$MAX_CONNECTIONS" ]; then
+    echo "文件描述符上限为 $(ulimit -n)，连接数减为 $MAX_CONNECTIONS"
+    CONNECTIONS=$MAX_CONNECTIONS
+fi
+
+# 服务器当前的连接数（含查询本身的连接）
+connection_count() {
+    curl -s -m 10 "$SERVER_URL/health" | sed -n 's/.*"connections":\([0-9]*\).*/\1/p'
+}
+
+echo "=== 大量并发连接测试（$CONNECTIONS 个连接）==="
+echo
+
+echo "1. 启动服务器"
+start_server -t 2
+check "写入测试键" "201" "$(http_code -X POST -d "shared" "$SERVER_URL/api/conn_key")"
+echo
+
+echo "2. 同时打开 $CONNECTIONS 个连接"
+FDS=()
+for _ in $(seq "$CONNECTIONS"); do
+    exec {fd}<>"/dev/tcp/127.0.0.1/$TEST_PORT" || break
+    FDS+=("$fd")
+done
+check "连接全部建立" "$CONNECTIONS" "${#FDS[@]}"
+# 连接在反应器接受后才计数，稍等片刻
+for _ in $(seq 50); do
+    [ "$(connection_count)" -gt "$CONNECTIONS" ] && break
+    sleep 0.1
+done
+check "服务器的连接数" "$((CONNECTIONS + 1))" "$(connection_count)"
+echo
+
+echo "3. 每个连接发送一个请求并读取响应"
+for fd in "${FDS[@]}"; do
+    printf 'GET /api/conn_key HTTP/1.1\r\n\r\n' >&"$fd"
+done
+OK=0
+for fd in "${FDS[@]}"; do
+    read -r -t 10 line <&"$fd" && [ "$line" == $'HTTP/1.1 200 OK\r' ] && OK=$((OK + 1))
+done
+check "全部连接收到 200" "$CONNECTIONS" "$OK"
+echo
+
+echo "4. 关闭全部连接"
+for fd in "${FDS[@]}"; do
+    exec {fd}<&-
+done
+for _ in $(seq 50); do
+    [ "$(connection_count)" == "1" ] && break
+    sleep 0.1
+done
+check "连接数回到 0（只剩查询本身）" "1" "$(connection_count)"
+check "关闭后仍可读写" "shared" "$(curl -s -m 10 "$SERVER_URL/api/conn_key")"
+
+finish
@@ -0,0 +1,128 @@
+#!/bin/bash
+
+# 运行指标测试：/metrics 的文本格式（每个指标族有 HELP 和 TYPE，样本都属于声明过的族），
+# 已知请求之后 HTTP 响应和 RESP 命令的计数准确，阶段耗时直方图的桶累计递增且 _count 等于 +Inf 桶
+
+source "$(dirname "$0")/test_helpers.sh"
+
+METRICS="$TEST_DIR/metrics.txt"
+
+# scrape：把 /metrics 保存到 $METRICS
+scrape() {
+    curl -s -m 10 "$SERVER_URL/metrics" >"$METRICS"
+}
+
+# value <样本名（含标签）>：$METRICS 中该样本的值，没有时为 0
+value() {
+    awk -v name="$1" '$1 == name { print $2; found = 1 } END { if (!found) print 0 }' "$METRICS"
+}
+
+# families_declared：每个 TYPE 前都有同名的 HELP，每个样本都属于声明过的族（直方图带 _bucket、_sum、_count 后缀）
+families_declared() {
+    awk '
+        /^# HELP / { help[$3] = 1; next }
+        /^# TYPE / { if (!help[$3]) { print "没有 HELP: " $3; bad = 1 } type[$3] = $4; next }
+        /^#/ { next }
+        {
+            name = $1
+            sub(/\{.*/, "", name)
+            base = name
+            sub(/_(bucket|sum|count)$/, "", base)
+            if (!(name in type) && type[base] != "histogram") { print "未声明的样本: " name; bad = 1 }
+        }
+        END { exit bad }
+    ' "$METRICS"
+}
+
+# histograms_consistent：每个直方图序列的桶累计值不减，_count 等于 le="+Inf" 的桶
+histograms_consistent() {
+    awk '
+        /^#/ { next }
+        $1 ~ /_bucket\{/ {
+            series = $1
+            sub(/,?le="[^"]*"\}$/, "}", series)
+            sub(/_bucket\{/, "{", series)
+            if ((series in last) && $2 < last[series]) { print "桶递减: " $1; bad = 1 }
+            last[series] = $2
+            if ($1 ~ /le="\+Inf"\}$/) inf[series] = $2
+            next
+        }
+        $1 ~ /_count\{/ {
+            series = $1
+            sub(/_count\{/, "{", series)
+            count[series] = $2
+        }
+        END {
+            for (s in inf) {
+                if (!(s in count) || count[s] != inf[s]) { print "_count 与 +Inf 桶不同: " s; bad = 1 }
+                n++
+            }
+            if (n == 0) { print "没有直方图"; bad = 1 }
+            exit bad
+        }
+    ' "$METRICS"
+}
+
+echo "=== 运行指标测试 ==="
+echo
+
+echo "1. 启动 2 个反应器线程的服务器"
+start_server -t 2
+echo
+
+echo "2. 文本格式"
+check "状态码" "200" "$(http_code "$SERVER_URL/metrics")"
+check "Content-Type" "text/plain" "$(curl -s -m 10 -o /dev/null -w '%{content_type}' "$SERVER_URL/metrics")"
+scrape
+check_true "每个指标族都有 HELP 和 TYPE" families_declared
+check "阶段耗时是直方图" "# TYPE c_x_stage_duration_seconds histogram" "$(grep '^# TYPE c_x_stage_duration_seconds ' "$METRICS")"
+check "不输出分位数的 gauge" "0" "$(grep -c 'quantile' "$METRICS")"
+echo
+
+echo "3. 已知请求后的计数"
+scrape
+GET_200=$(value 'c_x_http_responses_total{method="GET",code="200"}')
+GET_404=$(value 'c_x_http_responses_total{method="GET",code="404"}')
+POST_201=$(value 'c_x_http_responses_total{method="POST",code="201"}')
+DELETE_204=$(value 'c_x_http_responses_total{method="DELETE",code="204"}')
+RESP_COMMANDS=$(value c_x_resp_commands_total)
+RESP_ERRORS=$(value c_x_resp_errors_total)
+for i in $(seq 20); do
+    http_code -X POST -d "value$i" "$SERVER_URL/api/key$i" >/dev/null
+done
+for i in $(seq 20); do
+    http_code "$SERVER_URL/api/key$i" >/dev/null
+done
+for i in $(seq 5); do
+    http_code "$SERVER_URL/api/missing$i" >/dev/null
+done
+for i in $(seq 3); do
+    http_code -X DELETE "$SERVER_URL/api/key$i" >/dev/null
+done
+resp "GET key4" "GET key1" "NOSUCHCOMMAND" "PING" >/dev/null
+scrape
+# 上一次抓取本身也是一个 GET 200，在它自己的输出之后才计入
+check "GET 200" "$((GET_200 + 20 + 1))" "$(value 'c_x_http_responses_total{method="GET",code="200"}')"
+check "GET 404" "$((GET_404 + 5))" "$(value 'c_x_http_responses_total{method="GET",code="404"}')"
+check "POST 201" "$((POST_201 + 20))" "$(value 'c_x_http_responses_total{method="POST",code="201"}')"
+check "DELETE 204" "$((DELETE_204 + 3))" "$(value 'c_x_http_responses_total{method="DELETE",code="204"}')"
+# QUIT 也是一条命令
+check "RESP 命令数" "$((RESP_COMMANDS + 5))" "$(value c_x_resp_commands_total)"
+check "RESP 错误应答数" "$((RESP_ERRORS + 1))" "$(value c_x_resp_errors_total)"
+check_true "接受过连接" test "$(value c_x_connections_accepted_total)" -gt 0
+check_true "收发字节数" test "$(value c_x_received_bytes_total)" -gt 0 -a "$(value c_x_sent_bytes_total)" -gt 0
+# 存储规模最多每秒取样一次
+for _ in $(seq 30); do
+    [ "$(metric c_x_store_keys)" == "17" ] && break
+    sleep 0.1
+done
+check "存储中的键数（取样）" "17" "$(metric c_x_store_keys)"
+echo
+
+echo "4. 阶段耗时直方图"
+check_true "桶累计递增，_count 等于 +Inf 桶" histograms_consistent
+for stage in parse store send; do
+    check_true "$stage 有取样" test "$(value "c_x_stage_duration_seconds_count{stage=\"$stage\"}")" -gt 0
+done
+
+finish
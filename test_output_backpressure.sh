@@ -0,0 +1,45 @@
+#!/bin/bash
+
+# 输出背压测试：客户端流水线发送大量读取大值的请求但暂不读取响应，
+# 服务器在该连接的待发送输出达到上限后暂停处理它后续的请求，其他连接照常服务；
+# 客户端开始读取后，全部响应按请求顺序发出
+
+source "$(dirname "$0")/test_helpers.sh"
+
+REQUESTS=400
+VALUE_SIZE=262144
+
+echo "=== 输出背压测试 ==="
+echo
+
+echo "1. 启动单个反应器的服务器，写入 256 KB 的值"
+start_server -t 1
+head -c "$VALUE_SIZE" /dev/zero | tr '\0' 'v' >"$TEST_DIR/value"
+check "写入大值" "201" "$(http_code -X POST --data-binary @"$TEST_DIR/value" "$SERVER_URL/api/big")"
+echo
+
+echo "2. 一个连接流水线发送 $REQUESTS 个 GET（约 100 MB 响应），之后是 POST 和 GET，暂不读取"
+exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+{
+    for _ in $(seq "$REQUESTS"); do
+        printf 'GET /api/big HTTP/1.1\r\n\r\n'
+    done
+    printf 'POST /api/after HTTP/1.1\r\nContent-Length: 4\r\n\r\ndone'
+    printf 'GET /api/after HTTP/1.1\r\nConnection: close\r\n\r\n'
+} >&3
+sleep 1
+check "排在后面的 POST 尚未执行" "404" "$(http_code "$SERVER_URL/api/after")"
+check "其他连接照常服务" "200" "$(curl -s -m 2 -o /dev/null -w "%{http_code}" "$SERVER_URL/health")"
+check "其他连接读取大值" "$VALUE_SIZE" "$(curl -s -m 5 "$SERVER_URL/api/big" | wc -c)"
+echo
+
+echo "3. 开始读取响应"
+timeout 60 cat <&3 >"$TEST_DIR/responses"
+exec 3<&-
+check "收到全部 GET 的 200" "$((REQUESTS + 1))" "$(grep -ao "HTTP/1\.1 200" "$TEST_DIR/responses" | wc -l)"
+check "POST 按顺序执行" "1" "$(grep -ao "HTTP/1\.1 201" "$TEST_DIR/responses" | wc -l)"
+check "最后一个响应是 POST 写入的值" "done" "$(tail -c 4 "$TEST_DIR/responses")"
+check_true "响应体总长度正确" [ "$(wc -c <"$TEST_DIR/responses")" -gt $((REQUESTS * VALUE_SIZE)) ]
+check "服务器仍可访问" "200" "$(http_code "$SERVER_URL/health")"
+
+finish
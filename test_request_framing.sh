@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# 请求分帧测试：请求头和按 Content-Length 接收的请求体分多次到达、大请求体流式接收后紧跟流水线请求，
+# 以及超过大小上限的请求（413、431）
+
+source "$(dirname "$0")/test_helpers.sh"
+
+# send_pieces <文件...>：在一个连接上依次发送各文件，每段之间停顿 0.2 秒，使服务器分多次读到；
+# 输出全部响应（最后一个请求应带 Connection: close）
+send_pieces() {
+    exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT" || return 1
+    for piece in "$@"; do
+        cat "$piece" >&3
+        sleep 0.2
+    done
+    timeout 10 cat <&3
+    exec 3<&-
+}
+
+# status_lines：响应中的状态码，以空格分隔（后一个响应紧接在前一个响应体之后，不一定在行首）
+status_lines() {
+    grep -ao "HTTP/1\.1 [0-9][0-9][0-9]" | awk '{ printf "%s%s", sep, $2; sep = " " }'
+}
+
+echo "=== 请求分帧测试 ==="
+echo
+
+echo "1. 启动服务器，请求体上限 1 MB"
+start_server -b 1
+echo
+
+echo "2. 请求体分两次到达"
+printf 'POST /api/split_small HTTP/1.1\r\nContent-Length: 11\r\nConnection: close\r\n\r\nhello' >"$TEST_DIR/a1"
+printf ' world' >"$TEST_DIR/a2"
+check "写入成功" "201" "$(send_pieces "$TEST_DIR/a1" "$TEST_DIR/a2" | status_lines)"
+check "读回完整的请求体" "hello world" "$(curl -s -m 10 "$SERVER_URL/api/split_small")"
+echo
+
+echo "3. 请求头在一行中间断开"
+printf 'POST /api/split_header HTTP/1.1\r\nContent-Le' >"$TEST_DIR/b1"
+printf 'ngth: 5\r\nConnection: close\r\n\r\nabcde' >"$TEST_DIR/b2"
+check "写入成功" "201" "$(send_pieces "$TEST_DIR/b1" "$TEST_DIR/b2" | status_lines)"
+check "读回请求体" "abcde" "$(curl -s -m 10 "$SERVER_URL/api/split_header")"
+echo
+
+echo "4. 300 KB 请求体分三段流式接收，最后一段后紧跟流水线请求"
+head -c 300000 /dev/urandom >"$TEST_DIR/large.bin"
+printf 'POST /api/split_large HTTP/1.1\r\nContent-Length: 300000\r\n\r\n' >"$TEST_DIR/c1"
+head -c 1000 "$TEST_DIR/large.bin" >>"$TEST_DIR/c1"
+head -c 150000 "$TEST_DIR/large.bin" | tail -c 149000 >"$TEST_DIR/c2"
+tail -c 150000 "$TEST_DIR/large.bin" >"$TEST_DIR/c3"
+printf 'GET /api/split_small HTTP/1.1\r\nConnection: close\r\n\r\n' >>"$TEST_DIR/c3"
+send_pieces "$TEST_DIR/c1" "$TEST_DIR/c2" "$TEST_DIR/c3" >"$TEST_DIR/c.out"
+check "两个请求按顺序响应" "201 200" "$(status_lines <"$TEST_DIR/c.out")"
+check_true "流水线请求的响应体正确" grep -aq "hello world" "$TEST_DIR/c.out"
+curl -s -m 10 -o "$TEST_DIR/large.out" "$SERVER_URL/api/split_large"
+check_true "读回的请求体逐字节相同" cmp -s "$TEST_DIR/large.bin" "$TEST_DIR/large.out"
+echo
+
+echo "5. 超过上限的请求"
+printf 'POST /api/too_large HTTP/1.1\r\nContent-Length: 2000000\r\n\r\n' >"$TEST_DIR/d1"
+check "请求体超过上限返回 413" "413" "$(send_pieces "$TEST_DIR/d1" | status_lines)"
+check "超限的值没有写入" "404" "$(http_code "$SERVER_URL/api/too_large")"
+{
+    printf 'GET /api/key HTTP/1.1\r\nX-Padding: '
+    head -c 10000 /dev/zero | tr '\0' 'a'
+    printf '\r\n\r\n'
+} >"$TEST_DIR/e1"
+check "请求头超过 8 KB 返回 431" "431" "$(send_pieces "$TEST_DIR/e1" | status_lines)"
+head -c 9000 /dev/zero | tr '\0' 'b' >"$TEST_DIR/f1"
+check "请求头没有结尾且超过 8 KB 返回 431" "431" "$(send_pieces "$TEST_DIR/f1" | status_lines)"
+check "服务器仍可访问" "200" "$(http_code "$SERVER_URL/health")"
+
+finish
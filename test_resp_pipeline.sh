@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# RESP 流水线测试：4 个反应器线程，一个连接中流水线发送跨分片的单键命令和多键命令（MSET、MGET、DEL、
+# EXISTS），有的在本分片执行，有的转发给其他分片；应答必须按命令顺序返回
+
+source "$(dirname "$0")/test_helpers.sh"
+
+echo "=== RESP 流水线测试 ==="
+echo
+
+echo "1. 启动 4 个反应器线程的服务器"
+start_server -t 4
+echo
+
+echo "2. 多键命令：键分布在各分片上"
+COMMANDS=(
+    "MSET k1 v1 k2 v2 k3 v3 k4 v4 k5 v5 k6 v6 k7 v7 k8 v8"
+    "MGET k8 k1 missing k5 k2"
+    "DEL k1 k3 k5 missing"
+    "MGET k1 k2 k3 k4"
+    "EXISTS k2 k4 k1 k6"
+    "DBSIZE"
+    "PING"
+)
+EXPECTED='+OK
+*5
+$2
+v8
+$2
+v1
+$-1
+$2
+v5
+$2
+v2
+:3
+*4
+$-1
+$2
+v2
+$-1
+$2
+v4
+:3
+:5
++PONG
++OK'
+check "应答按命令顺序返回" "$EXPECTED" "$(resp "${COMMANDS[@]}")"
+echo
+
+echo "3. 200 组交错的单键命令：写入本组的键，读取并删除上一组的键"
+COMMANDS=()
+EXPECTED=""
+for i in $(seq 200); do
+    COMMANDS+=("SET key$i value$i" "GET key$((i - 1))" "DEL key$((i - 1))")
+    if [ "$i" -eq 1 ]; then
+        EXPECTED+=$'+OK\n$-1\n:0\n'
+    else
+        PREV="value$((i - 1))"
+        EXPECTED+=$'+OK\n'"\$${#PREV}"$'\n'"$PREV"$'\n:1\n'
+    fi
+done
+COMMANDS+=("DBSIZE")
+# 第 2 部分留下 5 个键，本部分只剩 key200
+EXPECTED+=$':6\n+OK'
+check "601 条应答按命令顺序返回" "$EXPECTED" "$(resp "${COMMANDS[@]}")"
+
+finish
@@ -0,0 +1,97 @@
+#!/bin/bash
+
+# 慢客户端测试：连接期限为 请求头 1 秒、请求体 1 秒、空闲 2 秒；
+# 逐字节发送请求头的 slowloris 连接在请求头期限到达时被关闭，不因持续有字节到达而延长；
+# 请求体只要求持续有进展，停止发送的连接被关闭；空闲的保持连接被关闭；大量慢连接不影响其他连接
+
+source "$(dirname "$0")/test_helpers.sh"
+
+SLOW_CONNECTIONS=50
+
+# closed_after <毫秒下限> <毫秒上限>：在 fd 3 上等待服务器关闭连接，用时在范围内即成功
+closed_after() {
+    local start elapsed
+    start=$(date +%s%N)
+    timeout 10 cat <&3 >/dev/null
+    elapsed=$((($(date +%s%N) - start) / 1000000))
+    echo "  连接在 ${elapsed} 毫秒后关闭"
+    [ "$elapsed" -ge "$1" ] && [ "$elapsed" -le "$2" ]
+}
+
+# trickle <次数> <间隔秒> <字节>：在后台每隔一段时间向 fd 3 发送一个字节，TRICKLE_PID 为后台进程
+trickle() {
+    (
+        for _ in $(seq "$1"); do
+            sleep "$2"
+            printf '%s' "$3" >&3 2>/dev/null || break
+        done
+    ) &
+    TRICKLE_PID=$!
+}
+
+# connection_count：服务器当前的连接数（含查询本身的连接）
+connection_count() {
+    curl -s -m 10 "$SERVER_URL/health" | sed -n 's/.*"connections":\([0-9]*\).*/\1/p'
+}
+
+echo "=== 慢客户端测试 ==="
+echo
+
+echo "1. 启动服务器，期限为 请求头 1 秒、请求体 1 秒、空闲 2 秒"
+start_server -t 1 -T 1,1,2,30
+echo
+
+echo "2. slowloris：每 0.2 秒发送请求头的一个字节"
+exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+printf 'GET /api/slow HTTP/1.1\r\nX-Slow: ' >&3
+trickle 40 0.2 a
+check_true "请求头期限到达时关闭，不因字节到达而延长" closed_after 800 2000
+kill "$TRICKLE_PID" 2>/dev/null
+wait "$TRICKLE_PID" 2>/dev/null
+exec 3<&-
+check "计入超时的连接数" "1" "$(metric c_x_connection_timeouts_total)"
+echo
+
+echo "3. 请求体持续有进展时不超时，停止发送后关闭"
+exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+printf 'POST /api/slow_body HTTP/1.1\r\nContent-Length: 6\r\nConnection: close\r\n\r\n' >&3
+trickle 6 0.5 b
+timeout 10 cat <&3 >"$TEST_DIR/body.out"
+wait "$TRICKLE_PID" 2>/dev/null
+exec 3<&-
+check_true "历时 3 秒的请求体写入成功" grep -aq "HTTP/1.1 201" "$TEST_DIR/body.out"
+check "写入的值" "bbbbbb" "$(curl -s -m 10 "$SERVER_URL/api/slow_body")"
+exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+printf 'POST /api/stalled HTTP/1.1\r\nContent-Length: 100\r\n\r\n0123456789' >&3
+check_true "请求体停止发送 1 秒后关闭" closed_after 800 2000
+exec 3<&-
+check "未完成的写入没有执行" "404" "$(http_code "$SERVER_URL/api/stalled")"
+echo
+
+echo "4. 空闲的保持连接"
+exec 3<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+printf 'GET /api/slow_body HTTP/1.1\r\n\r\n' >&3
+read -r -t 5 line <&3
+check "保持连接上的请求成功" $'HTTP/1.1 200 OK\r' "$line"
+check_true "空闲 2 秒后关闭" closed_after 1800 3000
+exec 3<&-
+echo
+
+echo "5. $SLOW_CONNECTIONS 个只发送部分请求头的连接"
+BEFORE=$(metric c_x_connection_timeouts_total)
+FDS=()
+for _ in $(seq "$SLOW_CONNECTIONS"); do
+    exec {fd}<>"/dev/tcp/127.0.0.1/$TEST_PORT"
+    printf 'GET /api/slow HTTP/1.1\r\nHost: ' >&"$fd"
+    FDS+=("$fd")
+done
+check "其他连接照常服务" "bbbbbb" "$(curl -s -m 2 "$SERVER_URL/api/slow_body")"
+sleep 1.5
+check "慢连接全部被关闭" "1" "$(connection_count)"
+check "计入超时的连接数" "$((BEFORE + SLOW_CONNECTIONS))" "$(metric c_x_connection_timeouts_total)"
+for fd in "${FDS[@]}"; do
+    exec {fd}<&-
+done
+check "服务器仍可访问" "200" "$(http_code "$SERVER_URL/health")"
+
+finish
@@ -0,0 +1,149 @@
+#!/bin/bash
+
+# 快照测试：4 个反应器线程，BGSAVE 和 POST /admin/snapshot 在后台写快照并报告进度；
+# 快照是请求时刻的数据，之后的写入不在其中；以不同的线程数重启时扫描全部分区按键恢复；
+# 以相同的线程数重启时映射各自的分区，读取和修改立即可用，后台合并到内存；
+# 达到内存上限时其余的键继续从映射读取，此时写的快照同样包含它们
+
+source "$(dirname "$0")/test_helpers.sh"
+
+SNAPSHOT="$TEST_DIR/dump.cxs"
+KEYS=2000
+
+# check_keys <描述> <起始> <结束> <值前缀>：键 k起始..k结束 的值依次为 值前缀+序号
+check_keys() {
+    local command="MGET" expected="" i value
+    for i in $(seq "$2" "$3"); do
+        command+=" k$i"
+        value="$4$i"
+        expected+="\$${#value}"$'\n'"$value"$'\n'
+    done
+    check "$1" "*$(($3 - $2 + 1))"$'\n'"${expected}+OK" "$(resp "$command")"
+}
+
+# snapshot_field <字段>：/admin/snapshot 返回的 JSON 中该字段的值（last 中的同名字段在后）
+snapshot_field() {
+    curl -s -m 10 "$SERVER_URL/admin/snapshot" | grep -o "\"$1\":[^,}]*" | tail -1 | cut -d: -f2
+}
+
+# wait_log <次数> <文本>：等待日志中该文本出现 N 次
+wait_log() {
+    for _ in $(seq 100); do
+        [ "$(grep -c "$2" "$TEST_DIR/server.log")" -ge "$1" ] && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+# wait_snapshot：等待已请求的快照写完（请求在应答前已登记，之后 requested 和 running 都为 false）
+wait_snapshot() {
+    for _ in $(seq 100); do
+        [ "$(snapshot_field requested) $(snapshot_field running)" == "false false" ] && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+echo "=== 快照测试 ==="
+echo
+
+echo "1. 启动 4 个反应器线程的服务器并写入 $KEYS 个键"
+start_server -t 4 -s "$SNAPSHOT"
+COMMANDS=()
+for i in $(seq "$KEYS"); do
+    COMMANDS+=("SET k$i v$i")
+done
+COMMANDS+=("SET ttl_key t EX 3600")
+resp "${COMMANDS[@]}" >/dev/null
+check "快照状态" "200" "$(http_code "$SERVER_URL/admin/snapshot")"
+check "没有正在写的快照" "false" "$(snapshot_field running)"
+echo
+
+echo "2. BGSAVE"
+check "BGSAVE 应答" "+Background saving started" "$(resp "BGSAVE" | head -1)"
+check_true "快照完成" wait_snapshot
+check "快照成功" "true" "$(snapshot_field ok)"
+check "快照中的键数" "$((KEYS + 1))" "$(snapshot_field keys)"
+check_true "快照文件已写入" [ -s "$SNAPSHOT" ]
+echo
+
+echo "3. POST /admin/snapshot，之后的写入不在快照中"
+resp "SET k1 changed" "DEL k2" "SET gone_key g PX 500" >/dev/null
+check "请求快照返回 202" "202" "$(http_code -X POST "$SERVER_URL/admin/snapshot")"
+check_true "快照完成" wait_snapshot
+check "快照中的键数" "$((KEYS + 1))" "$(snapshot_field keys)"
+check_true "报告用时" [ -n "$(snapshot_field duration_ms)" ]
+resp "SET after_snapshot x" "SET k3 after" >/dev/null
+# 等 gone_key 过期
+sleep 0.6
+echo
+
+echo "4. 以 2 个反应器线程重启，扫描全部分区恢复"
+stop_server
+start_server -t 2 -s "$SNAPSHOT"
+check "键数" ":$KEYS" "$(resp "DBSIZE" | head -1)"
+check "快照前的修改" "changed" "$(curl -s -m 10 "$SERVER_URL/api/k1")"
+check "快照前的删除" ":0" "$(resp "EXISTS k2" | head -1)"
+check "快照后的写入不在其中" ":0 \$2 v3 +OK" "$(resp "EXISTS after_snapshot" "GET k3" | tr '\n' ' ' | sed 's/ $//')"
+check_keys "其余的键" 4 "$KEYS" v
+check_true "过期时间保留" [ "$(resp "PTTL ttl_key" | head -1 | tr -d ':')" -gt 3500000 ]
+check "已过期的键不再加载" "404" "$(http_code "$SERVER_URL/api/gone_key")"
+echo
+
+echo "5. 以相同的 4 个反应器线程重启，映射快照分区"
+stop_server
+: >"$TEST_DIR/server.log"
+start_server -t 4 -s "$SNAPSHOT"
+resp "SET k1 overlay" "DEL k5" "EXPIRE k6 3600" >/dev/null
+check "映射后立即写入" "overlay" "$(curl -s -m 10 "$SERVER_URL/api/k1")"
+check "键数" ":$((KEYS - 1))" "$(resp "DBSIZE" | head -1)"
+check "合并不覆盖映射后的修改" "overlay :0 +OK" \
+    "$(resp "GET k1" "EXISTS k5" | sed -n '2p;3p;4p' | tr '\n' ' ' | sed 's/ $//')"
+check_true "映射后设置的过期时间" [ "$(resp "PTTL k6" | head -1 | tr -d ':')" -gt 3500000 ]
+check_keys "其余的键" 7 "$KEYS" v
+# 存储规模最多每秒取样一次
+for _ in $(seq 30); do
+    [ "$(metric c_x_store_mapped_keys)" == "0" ] && break
+    sleep 0.1
+done
+check "没有留在映射中的键" "0" "$(metric c_x_store_mapped_keys)"
+# 标准输出重定向到文件时退出前才写出，停止服务器后再检查映射和合并的日志
+stop_server
+check "4 个分区都被映射" "4" "$(grep -c "映射快照分区" "$TEST_DIR/server.log")"
+check "4 个分区都合并到内存" "4" "$(grep -c "快照分区已全部合并到内存" "$TEST_DIR/server.log")"
+echo
+
+echo "6. 内存上限 1 MB，大值留在映射中"
+start_server -t 4 -s "$SNAPSHOT"
+head -c 100000 /dev/urandom >"$TEST_DIR/big.bin"
+for i in $(seq 40); do
+    curl -s -m 10 -o /dev/null -X POST --data-binary @"$TEST_DIR/big.bin" "$SERVER_URL/api/big$i"
+done
+resp "BGSAVE" >/dev/null
+check_true "快照完成" wait_snapshot
+stop_server
+start_server -t 4 -s "$SNAPSHOT" -m 1
+check_true "合并在内存上限处停止" wait_log 1 "继续从映射的快照读取"
+MAPPED=$(metric c_x_store_mapped_keys)
+check_true "有键留在映射中（$MAPPED 个）" [ "$MAPPED" -gt 0 ]
+MISMATCH=0
+for i in $(seq 40); do
+    curl -s -m 10 -o "$TEST_DIR/big.out" "$SERVER_URL/api/big$i"
+    cmp -s "$TEST_DIR/big.bin" "$TEST_DIR/big.out" || MISMATCH=$((MISMATCH + 1))
+done
+check "40 个大值读回都正确" "0" "$MISMATCH"
+check "删除映射中的键" "204 204" "$(http_code -X DELETE "$SERVER_URL/api/big1") $(http_code -X DELETE "$SERVER_URL/api/big40")"
+check "删除后不存在" "404 404" "$(http_code "$SERVER_URL/api/big1") $(http_code "$SERVER_URL/api/big40")"
+check "键数包括映射中的键" ":$((KEYS + 38))" "$(resp "DBSIZE" | head -1)"
+resp "BGSAVE" >/dev/null
+check_true "映射中写快照完成" wait_snapshot
+check "快照包括映射中的键" "$((KEYS + 38))" "$(snapshot_field keys)"
+stop_server
+start_server -t 4 -s "$SNAPSHOT"
+check "不限内存重启后的键数" ":$((KEYS + 38))" "$(resp "DBSIZE" | head -1)"
+curl -s -m 10 -o "$TEST_DIR/big.out" "$SERVER_URL/api/big20"
+check_true "大值读回正确" cmp -s "$TEST_DIR/big.bin" "$TEST_DIR/big.out"
+check "删除的键不在快照中" "404" "$(http_code "$SERVER_URL/api/big1")"
+
+finish
+
@@ -0,0 +1,83 @@
+#!/bin/bash
+
+# 静态文件缓存测试：ETag 和 If-None-Match 的 304，文件修改后（包括同一秒内大小不变的修改和改名替换）
+# 标签变化并重新加载，预压缩的 .gz 只发给接受 gzip 的客户端并带 Vary: Accept-Encoding
+
+source "$(dirname "$0")/test_helpers.sh"
+
+# 服务器从工作目录下的 web/ 读取静态文件，在临时目录中启动
+C_X_BIN=$(realpath "$C_X_BIN")
+cd "$TEST_DIR" || exit 1
+mkdir web
+
+# header <名称> <curl 参数...>：响应中该头部的值
+header() {
+    local name=$1
+    shift
+    curl -s -m 10 -D - -o /dev/null "$@" | tr -d '\r' | awk -v name="$name" 'tolower($1) == tolower(name ":") { sub(/^[^:]*: */, ""); print }'
+}
+
+# 等待服务器重新检查文件（每个文件每秒最多 stat 一次）
+wait_recheck() {
+    sleep 1.2
+}
+
+echo "=== 静态文件缓存测试 ==="
+echo
+
+echo "1. 启动服务器"
+printf 'version-a\n' >web/page.txt
+start_server
+echo
+
+echo "2. 首次请求和重新验证"
+check "首次请求 200" "200" "$(http_code "$SERVER_URL/web/page.txt")"
+check "内容" "version-a" "$(curl -s -m 10 "$SERVER_URL/web/page.txt")"
+TAG_A=$(header ETag "$SERVER_URL/web/page.txt")
+check_true "带 ETag" test -n "$TAG_A"
+check "相同的 ETag 返回 304" "304" "$(http_code -H "If-None-Match: $TAG_A" "$SERVER_URL/web/page.txt")"
+check "弱比较和列表中的标签" "304" "$(http_code -H "If-None-Match: \"other\", W/$TAG_A" "$SERVER_URL/web/page.txt")"
+check "不同的 ETag 返回 200" "200" "$(http_code -H 'If-None-Match: "other"' "$SERVER_URL/web/page.txt")"
+echo
+
+echo "3. 原地修改，大小不变"
+printf 'version-b\n' >web/page.txt
+wait_recheck
+TAG_B=$(header ETag "$SERVER_URL/web/page.txt")
+check_true "ETag 变化" test -n "$TAG_B" -a "$TAG_B" != "$TAG_A"
+check "旧的 ETag 返回 200" "200" "$(http_code -H "If-None-Match: $TAG_A" "$SERVER_URL/web/page.txt")"
+check "读到新内容" "version-b" "$(curl -s -m 10 "$SERVER_URL/web/page.txt")"
+echo
+
+echo "4. 写入新文件后改名替换，保留修改时间和大小"
+printf 'version-c\n' >web/page.new
+touch -r web/page.txt web/page.new
+mv web/page.new web/page.txt
+wait_recheck
+TAG_C=$(header ETag "$SERVER_URL/web/page.txt")
+check_true "ETag 变化" test -n "$TAG_C" -a "$TAG_C" != "$TAG_B"
+check "旧的 ETag 返回 200" "200" "$(http_code -H "If-None-Match: $TAG_B" "$SERVER_URL/web/page.txt")"
+check "读到新内容" "version-c" "$(curl -s -m 10 "$SERVER_URL/web/page.txt")"
+echo
+
+echo "5. 预压缩的 .gz"
+printf '<html>gzip test</html>\n' >web/index.html
+gzip -k web/index.html
+check "接受 gzip 时发送压缩版本" "gzip" "$(header Content-Encoding -H 'Accept-Encoding: gzip' "$SERVER_URL/web/")"
+check "压缩版本带 Vary" "Accept-Encoding" "$(header Vary -H 'Accept-Encoding: gzip' "$SERVER_URL/web/")"
+check "解压后内容相同" "<html>gzip test</html>" "$(curl -s -m 10 --compressed "$SERVER_URL/web/")"
+check "不接受 gzip 时发送原文件" "" "$(header Content-Encoding "$SERVER_URL/web/")"
+check "原文件也带 Vary" "Accept-Encoding" "$(header Vary "$SERVER_URL/web/")"
+TAG_GZ=$(header ETag -H 'Accept-Encoding: gzip' "$SERVER_URL/web/")
+TAG_ID=$(header ETag "$SERVER_URL/web/")
+check_true "两种表示的 ETag 不同" test -n "$TAG_GZ" -a "$TAG_GZ" != "$TAG_ID"
+check "压缩版本的 ETag 返回 304" "304" "$(http_code -H 'Accept-Encoding: gzip' -H "If-None-Match: $TAG_GZ" "$SERVER_URL/web/")"
+check "原文件的 ETag 不匹配压缩版本" "200" "$(http_code -H 'Accept-Encoding: gzip' -H "If-None-Match: $TAG_ID" "$SERVER_URL/web/")"
+echo
+
+echo "6. 不合法的路径"
+check "上级目录" "404" "$(http_code --path-as-is "$SERVER_URL/web/../test_helpers.sh")"
+check "隐藏文件" "404" "$(http_code "$SERVER_URL/web/.hidden")"
+check "不存在的文件" "404" "$(http_code "$SERVER_URL/web/missing.txt")"
+
+finish
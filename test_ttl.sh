@@ -0,0 +1,93 @@
+#!/bin/bash
+
+# 过期时间测试：HTTP 的 X-TTL 头部、ttl 查询参数和 /ttl/ 接口，RESP 的 SET EX/PX、EXPIRE、PTTL、PERSIST 等；
+# 两种协议看到同一个过期时刻；过期的键访问时不再返回，不访问的键也由时间轮主动删除
+
+source "$(dirname "$0")/test_helpers.sh"
+
+# ttl_ms <键>：GET /ttl/<键> 返回的剩余毫秒数
+ttl_ms() {
+    curl -s -m 10 "$SERVER_URL/ttl/$1" | sed -n 's/.*"ttl_ms":\(-\{0,1\}[0-9]*\).*/\1/p'
+}
+
+# in_range <值> <下限> <上限>
+in_range() {
+    [ -n "$1" ] && [ "$1" -ge "$2" ] && [ "$1" -le "$3" ]
+}
+
+echo "=== 过期时间测试 ==="
+echo
+
+echo "1. 启动 4 个反应器线程的服务器"
+start_server -t 4
+echo
+
+echo "2. HTTP 写入时指定存活时间"
+check "X-TTL 头部" "201" "$(http_code -X POST -H "X-TTL: 30" -d "token" "$SERVER_URL/api/session")"
+check_true "剩余约 30 秒" in_range "$(ttl_ms session)" 29000 30000
+check "ttl 查询参数，带小数" "201" "$(http_code -X POST -d "1234" "$SERVER_URL/api/otp?ttl=0.5")"
+check_true "剩余不超过 500 毫秒" in_range "$(ttl_ms otp)" 1 500
+check "不过期的键" "201" "$(http_code -X POST -d "plain" "$SERVER_URL/api/plain")"
+check "不过期时为 -1" "-1" "$(ttl_ms plain)"
+check "键不存在时 404" "404" "$(http_code "$SERVER_URL/ttl/missing")"
+check "格式错误的 X-TTL" "400" "$(http_code -X POST -H "X-TTL: abc" -d "x" "$SERVER_URL/api/bad")"
+check "X-TTL 为 0" "400" "$(http_code -X POST -H "X-TTL: 0" -d "x" "$SERVER_URL/api/bad")"
+check "被拒绝的写入没有执行" "404" "$(http_code "$SERVER_URL/api/bad")"
+echo
+
+echo "3. /ttl/ 接口修改和取消过期"
+check "重新设置为 60 秒" "204" "$(http_code -X POST "$SERVER_URL/ttl/session?ttl=60")"
+check_true "剩余约 60 秒" in_range "$(ttl_ms session)" 59000 60000
+check "用 X-TTL 重新设置" "204" "$(http_code -X POST -H "X-TTL: 90" "$SERVER_URL/ttl/session")"
+check_true "剩余约 90 秒" in_range "$(ttl_ms session)" 89000 90000
+check "没有指定存活时间" "400" "$(http_code -X POST "$SERVER_URL/ttl/session")"
+check "不存在的键" "404" "$(http_code -X POST "$SERVER_URL/ttl/missing?ttl=5")"
+check "取消过期" "204" "$(http_code -X DELETE "$SERVER_URL/ttl/session")"
+check "取消后为 -1" "-1" "$(ttl_ms session)"
+check "值不变" "token" "$(curl -s -m 10 "$SERVER_URL/api/session")"
+http_code -X POST -H "X-TTL: 30" -d "again" "$SERVER_URL/api/rewrite" >/dev/null
+check "不带存活时间覆盖写入" "201" "$(http_code -X POST -d "again" "$SERVER_URL/api/rewrite")"
+check "覆盖写入取消原有的过期时刻" "-1" "$(ttl_ms rewrite)"
+echo
+
+echo "4. RESP 命令"
+EXPECTED='+OK
+:100
++OK
+:1
+:0
+:1
+:-1
+:-2
++OK
++OK
+:1
+:0
++OK'
+check "SET EX、TTL、EXPIRE、PERSIST、SETEX、PSETEX、EXPIREAT" "$EXPECTED" "$(resp \
+    "SET r1 v EX 100" "TTL r1" "SET r2 v" "EXPIRE r2 50" "EXPIRE missing 50" "PERSIST r1" "TTL r1" "TTL missing" \
+    "SETEX r3 20 v" "PSETEX r4 20000 v" "EXPIREAT r2 $(($(date +%s) - 1))" "EXISTS r2")"
+check_true "PTTL 与 SETEX 一致" in_range "$(resp "PTTL r3" | head -1 | tr -d ':')" 19000 20000
+check_true "PSETEX 的毫秒数" in_range "$(resp "PTTL r4" | head -1 | tr -d ':')" 19000 20000
+check "PEXPIRE" ":1" "$(resp "PEXPIRE r1 5000" | head -1)"
+check_true "HTTP 看到 RESP 设置的过期时间" in_range "$(ttl_ms r1)" 4000 5000
+check "RESP 看到 HTTP 设置的过期时间" ":-1 :-2" "$(resp "TTL plain" "TTL bad" | head -2 | tr '\n' ' ' | sed 's/ $//')"
+check "PX 选项" "+OK" "$(resp "SET r5 v PX 300" | head -1)"
+echo
+
+echo "5. 到期后的键"
+sleep 0.6
+check "HTTP 读取到期的键" "404" "$(http_code "$SERVER_URL/api/otp")"
+check "/ttl/ 查询到期的键" "404" "$(http_code "$SERVER_URL/ttl/otp")"
+check "RESP 读取到期的键" "\$-1" "$(resp "GET r5" | head -1)"
+echo
+
+echo "6. 不访问的键由时间轮主动删除"
+BEFORE=$(resp "DBSIZE" | head -1 | tr -d ':')
+curl -s -m 10 -o /dev/null -X POST -H "X-TTL: 0.3" -d "x" "$SERVER_URL/api/active_[1-200]"
+check "写入 200 个短期键" ":$((BEFORE + 200))" "$(resp "DBSIZE" | head -1)"
+sleep 1
+check "到期后不访问也被删除" ":$BEFORE" "$(resp "DBSIZE" | head -1)"
+check_true "过期时间未到的键仍在" in_range "$(ttl_ms r3)" 1 20000
+
+finish
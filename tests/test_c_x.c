@@ -1,5 +1,5 @@
 #include <stdio.h>
-#include "c_x.h"
+#include "version.h"
 
 int main(void) {
     printf("Running tests for C-X version %s\n", C_X_VERSION);
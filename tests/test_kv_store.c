@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kv_store.h"
+
+// 存储引擎的单元测试：渐进式 rehash 的扩容和缩容、删除后再插入复用墓碑（开放寻址引擎）
+// 不让表增长、内存记账在清空后回到初始值。每个引擎各构建一个可执行文件
+
+#define GROW_KEYS 20000
+#define KEEP_KEYS 100
+#define MIN_CAPACITY 64
+#define CHURN_LIVE 400
+#define CHURN_ROUNDS 100000
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static size_t make_key(char *buf, size_t i) {
+    return (size_t)snprintf(buf, 32, "key:%zu", i);
+}
+
+// 索引的桶（槽位）数，渐进式 rehash 期间为两张表之和
+static size_t capacity(KVStore *store) {
+    size_t cursor = 0;
+    KVTableStats stats;
+    kv_table_sample(store, &cursor, 0, &stats);
+    return stats.capacity;
+}
+
+// 用未命中的读取推动渐进式 rehash，直到迁移完成、容量不再变化（每次操作至少推进一个桶，
+// 一轮与容量相同次数的读取足以迁移完一张表）
+static void settle(KVStore *store) {
+    size_t last = 0;
+    for (int round = 0; round < 100 && capacity(store) != last; round++) {
+        last = capacity(store);
+        for (size_t i = 0; i < last; i++) {
+            CHECK(kv_get_value(store, "missing", 7) == NULL, "missing key found");
+        }
+    }
+}
+
+// 键 i 的值为 "v<i>"
+static bool has_value(KVStore *store, size_t i) {
+    char key[32], expected[32];
+    size_t key_length = make_key(key, i);
+    int expected_length = snprintf(expected, sizeof(expected), "v%zu", i);
+    KVValue *value = kv_get_value(store, key, key_length);
+    bool ok = value && value->length == (size_t)expected_length && memcmp(value->data, expected, value->length) == 0;
+    kv_value_release(value);
+    return ok;
+}
+
+static bool set_key(KVStore *store, size_t i) {
+    char key[32], value[32];
+    size_t key_length = make_key(key, i);
+    int value_length = snprintf(value, sizeof(value), "v%zu", i);
+    return kv_set(store, key, key_length, value, (size_t)value_length);
+}
+
+static bool delete_key(KVStore *store, size_t i) {
+    char key[32];
+    size_t key_length = make_key(key, i);
+    return kv_delete(store, key, key_length);
+}
+
+static bool count_entry(void *arg, const HashEntry *entry) {
+    (void)entry;
+    (*(size_t *)arg)++;
+    return true;
+}
+
+static size_t foreach_count(KVStore *store) {
+    size_t count = 0;
+    kv_store_foreach(store, count_entry, &count);
+    return count;
+}
+
+static size_t store_memory(KVStore *store) {
+    KVCacheStats stats;
+    kv_cache_stats(store, &stats);
+    return stats.memory;
+}
+
+// 插入到远超初始容量，扩容期间和之后所有键都能读到；删除大部分后缩容，留下的键不受影响
+static void test_grow_and_shrink(void) {
+    printf("rehash grow/shrink\n");
+    KVStore *store = kv_store_create(MIN_CAPACITY, NULL);
+    CHECK(store != NULL, "create failed");
+    if (!store) return;
+    size_t initial_memory = store_memory(store);
+    CHECK(capacity(store) == MIN_CAPACITY, "initial capacity %zu", capacity(store));
+
+    bool resized = false;
+    for (size_t i = 0; i < GROW_KEYS; i++) {
+        CHECK(set_key(store, i), "set %zu failed", i);
+        size_t current = capacity(store);
+        if (current > MIN_CAPACITY) resized = true;
+        if (i % 997 == 0) {
+            // 迁移中途：新旧两张表中的键都能读到，遍历恰好访问每个键一次
+            CHECK(has_value(store, 0) && has_value(store, i / 2) && has_value(store, i), "lookup during grow at %zu", i);
+            CHECK(foreach_count(store) == i + 1, "foreach during grow: %zu != %zu", foreach_count(store), i + 1);
+        }
+    }
+    CHECK(resized, "table never grew");
+    settle(store);
+    size_t grown = capacity(store);
+    CHECK(grown >= GROW_KEYS, "grown capacity %zu < %d keys", grown, GROW_KEYS);
+    CHECK(kv_size(store) == GROW_KEYS, "size %zu", kv_size(store));
+    size_t missing = 0;
+    for (size_t i = 0; i < GROW_KEYS; i++) {
+        missing += !has_value(store, i);
+    }
+    CHECK(missing == 0, "%zu keys lost after grow", missing);
+
+    for (size_t i = KEEP_KEYS; i < GROW_KEYS; i++) {
+        CHECK(delete_key(store, i), "delete %zu failed", i);
+        if (i % 997 == 0) {
+            CHECK(has_value(store, 0) && has_value(store, KEEP_KEYS - 1), "lookup during shrink at %zu", i);
+        }
+    }
+    settle(store);
+    size_t shrunk = capacity(store);
+    CHECK(shrunk < grown / 8 && shrunk >= MIN_CAPACITY, "capacity after shrink %zu (grown %zu)", shrunk, grown);
+    CHECK(kv_size(store) == KEEP_KEYS && foreach_count(store) == KEEP_KEYS, "size after shrink %zu", kv_size(store));
+    for (size_t i = 0; i < KEEP_KEYS; i++) {
+        CHECK(has_value(store, i), "key %zu lost after shrink", i);
+    }
+    CHECK(!has_value(store, KEEP_KEYS) && !has_value(store, GROW_KEYS - 1), "deleted key still present");
+
+    // 全部删除后回到最小容量，内存记账回到创建时的值
+    for (size_t i = 0; i < KEEP_KEYS; i++) {
+        CHECK(delete_key(store, i), "delete %zu failed", i);
+    }
+    settle(store);
+    CHECK(capacity(store) == MIN_CAPACITY, "capacity when empty %zu", capacity(store));
+    CHECK(store_memory(store) == initial_memory, "memory when empty %zu != %zu", store_memory(store), initial_memory);
+    kv_store_destroy(store);
+}
+
+// 反复删除并重新插入同一个键：开放寻址引擎复用墓碑，链地址法复用桶，表都不增长也不重建
+static void test_reinsert_reuses_slot(void) {
+    printf("delete/reinsert reuses the slot\n");
+    KVStore *store = kv_store_create(1024, NULL);
+    CHECK(store != NULL, "create failed");
+    if (!store) return;
+    for (size_t i = 0; i < CHURN_LIVE; i++) {
+        CHECK(set_key(store, i), "set %zu failed", i);
+    }
+    for (size_t round = 0; round < CHURN_ROUNDS; round++) {
+        size_t i = round % CHURN_LIVE;
+        CHECK(delete_key(store, i), "delete %zu failed", i);
+        CHECK(set_key(store, i), "reinsert %zu failed", i);
+        if (capacity(store) != 1024) {
+            CHECK(false, "table resized at round %zu: capacity %zu", round, capacity(store));
+            break;
+        }
+    }
+    CHECK(kv_size(store) == CHURN_LIVE, "size %zu", kv_size(store));
+    for (size_t i = 0; i < CHURN_LIVE; i++) {
+        CHECK(has_value(store, i), "key %zu lost", i);
+    }
+    kv_store_destroy(store);
+}
+
+// 不断删除旧键、插入新键：墓碑被复用或在按原容量重建时清除，表不会因墓碑堆积而扩容
+static void test_churn_does_not_grow(void) {
+    printf("churn with distinct keys keeps the capacity\n");
+    KVStore *store = kv_store_create(1024, NULL);
+    CHECK(store != NULL, "create failed");
+    if (!store) return;
+    for (size_t i = 0; i < CHURN_LIVE; i++) {
+        CHECK(set_key(store, i), "set %zu failed", i);
+    }
+    size_t largest = 0;
+    for (size_t i = CHURN_LIVE; i < CHURN_LIVE + CHURN_ROUNDS; i++) {
+        CHECK(delete_key(store, i - CHURN_LIVE), "delete %zu failed", i - CHURN_LIVE);
+        CHECK(set_key(store, i), "set %zu failed", i);
+        size_t current = capacity(store);
+        if (current > largest) largest = current;
+    }
+    // 重建期间新旧两张表同为 1024
+    CHECK(largest <= 2 * 1024, "capacity reached %zu", largest);
+    settle(store);
+    CHECK(capacity(store) == 1024, "capacity after churn %zu", capacity(store));
+    CHECK(kv_size(store) == CHURN_LIVE && foreach_count(store) == CHURN_LIVE, "size %zu", kv_size(store));
+    size_t missing = 0;
+    for (size_t i = CHURN_ROUNDS; i < CHURN_ROUNDS + CHURN_LIVE; i++) {
+        missing += !has_value(store, i);
+    }
+    CHECK(missing == 0, "%zu live keys lost", missing);
+    CHECK(!has_value(store, 0) && !has_value(store, CHURN_ROUNDS - 1), "deleted key still present");
+    kv_store_destroy(store);
+}
+
+int main(void) {
+    printf("KV store engine: %s\n", kv_store_engine());
+    test_grow_and_shrink();
+    test_reinsert_reuses_slot();
+    test_churn_does_not_grow();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kv_store.h"
+#include "slab.h"
+
+// slab 分配器的单元测试：其他线程释放的对象进入远程释放栈，不改动所有者的统计，
+// 由所有者线程 slab_drain_remote（或下一次分配）回收，之后空页归还系统、对象被重新使用
+
+#define OBJECTS 10000
+#define OBJECT_SIZE 100
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    void **objects;
+    KVValue **values;
+    size_t count;
+} RemoteFree;
+
+// 在另一个线程中释放全部对象和值（值的最后一个引用在这里释放）
+static void *free_remotely(void *arg) {
+    RemoteFree *work = arg;
+    for (size_t i = 0; i < work->count; i++) {
+        slab_free(work->objects[i], OBJECT_SIZE);
+        kv_value_release(work->values[i]);
+    }
+    return NULL;
+}
+
+static bool remote_stack_empty(SlabAllocator *slab) {
+    return atomic_load_explicit(&slab->remote_free, memory_order_acquire) == NULL;
+}
+
+static void test_remote_free_drained_by_owner(void) {
+    printf("remote frees drained by the owner\n");
+    SlabAllocator *slab = slab_create();
+    CHECK(slab != NULL, "create failed");
+    if (!slab) return;
+    RemoteFree work;
+    work.count = OBJECTS;
+    work.objects = calloc(OBJECTS, sizeof(void *));
+    work.values = calloc(OBJECTS, sizeof(KVValue *));
+    if (!work.objects || !work.values) {
+        CHECK(false, "out of memory");
+        free(work.objects);
+        free(work.values);
+        slab_destroy(slab);
+        return;
+    }
+    SlabStats empty;
+    slab_stats(slab, &empty);
+    for (size_t i = 0; i < OBJECTS; i++) {
+        work.objects[i] = slab_alloc(slab, OBJECT_SIZE);
+        memset(work.objects[i], 0xab, OBJECT_SIZE);
+        work.values[i] = kv_value_create(slab, "value", 5);
+        CHECK(work.objects[i] && work.values[i], "allocation %zu failed", i);
+    }
+    SlabStats full;
+    slab_stats(slab, &full);
+    CHECK(full.used_bytes > empty.used_bytes, "used bytes did not grow");
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, free_remotely, &work) == 0, "pthread_create failed");
+    pthread_join(thread, NULL);
+
+    // 远程释放只压入栈，所有者的统计不变，页也没有归还
+    SlabStats pending;
+    slab_stats(slab, &pending);
+    CHECK(!remote_stack_empty(slab), "remote stack is empty after remote frees");
+    CHECK(pending.used_bytes == full.used_bytes, "used bytes changed by remote frees: %zu -> %zu",
+          full.used_bytes, pending.used_bytes);
+    CHECK(pending.reserved_bytes == full.reserved_bytes, "pages released by a remote thread");
+
+    slab_drain_remote(slab);
+    SlabStats drained;
+    slab_stats(slab, &drained);
+    CHECK(remote_stack_empty(slab), "remote stack not empty after drain");
+    CHECK(drained.used_bytes == empty.used_bytes, "used bytes after drain %zu != %zu",
+          drained.used_bytes, empty.used_bytes);
+    CHECK(drained.requested_bytes == empty.requested_bytes, "requested bytes after drain %zu != %zu",
+          drained.requested_bytes, empty.requested_bytes);
+    CHECK(drained.reserved_bytes < full.reserved_bytes, "no pages returned after drain");
+
+    // 回收的空间被重新使用：再分配同样多的对象，保留的内存不超过第一次
+    for (size_t i = 0; i < OBJECTS; i++) {
+        work.objects[i] = slab_alloc(slab, OBJECT_SIZE);
+        CHECK(work.objects[i] != NULL, "reallocation %zu failed", i);
+    }
+    SlabStats reused;
+    slab_stats(slab, &reused);
+    CHECK(reused.reserved_bytes <= full.reserved_bytes, "reserved bytes grew on reuse: %zu > %zu",
+          reused.reserved_bytes, full.reserved_bytes);
+
+    // 下一次分配也会先回收远程释放栈
+    work.count = OBJECTS / 2;
+    for (size_t i = 0; i < work.count; i++) {
+        work.values[i] = kv_value_create(slab, "value", 5);
+    }
+    slab_stats(slab, &full);
+    CHECK(pthread_create(&thread, NULL, free_remotely, &work) == 0, "pthread_create failed");
+    pthread_join(thread, NULL);
+    void *extra = slab_alloc(slab, OBJECT_SIZE);
+    SlabStats after_alloc;
+    slab_stats(slab, &after_alloc);
+    CHECK(remote_stack_empty(slab), "allocation did not drain the remote stack");
+    CHECK(after_alloc.used_bytes < full.used_bytes, "remote frees not reclaimed by allocation");
+    slab_free(extra, OBJECT_SIZE);
+    for (size_t i = OBJECTS / 2; i < OBJECTS; i++) {
+        slab_free(work.objects[i], OBJECT_SIZE);
+    }
+    SlabStats final;
+    slab_stats(slab, &final);
+    CHECK(final.used_bytes == empty.used_bytes, "used bytes at the end %zu != %zu", final.used_bytes, empty.used_bytes);
+
+    free(work.objects);
+    free(work.values);
+    slab_destroy(slab);
+}
+
+int main(void) {
+    test_remote_free_drained_by_owner();
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All tests passed!\n");
+    return 0;
+}